@@ -9,6 +9,7 @@ from aws_cdk import (
     aws_iam as iam,
     aws_events as events,
     aws_events_targets as targets,
+    aws_logs as logs,
 )
 from constructs import Construct
 
@@ -75,7 +76,7 @@ class ComputeStack(Stack):
             "SensorDataRule",
             rule_name="CarbonReadySensorDataRule",
             topic_rule_payload=iot.CfnTopicRule.TopicRulePayloadProperty(
-                sql="SELECT * FROM 'carbonready/farm/+/sensor/data' WHERE EXISTS(hash)",
+                sql="SELECT * FROM 'carbonready/farm/+/sensor/data' WHERE EXISTS(hash) OR EXISTS(batch)",
                 actions=[
                     iot.CfnTopicRule.ActionProperty(
                         lambda_=iot.CfnTopicRule.LambdaActionProperty(
@@ -88,6 +89,75 @@ class ComputeStack(Stack):
             ),
         )
 
+        # Compressed sensor data arrives as binary heatshrink payloads,
+        # forwarded base64-encoded with a content-encoding marker
+        self.compressed_sensor_data_rule = iot.CfnTopicRule(
+            self,
+            "CompressedSensorDataRule",
+            rule_name="CarbonReadyCompressedSensorDataRule",
+            topic_rule_payload=iot.CfnTopicRule.TopicRulePayloadProperty(
+                sql="SELECT encode(*, 'base64') AS payload, 'heatshrink' AS contentEncoding FROM 'carbonready/farm/+/sensor/data/heatshrink'",
+                actions=[
+                    iot.CfnTopicRule.ActionProperty(
+                        lambda_=iot.CfnTopicRule.LambdaActionProperty(
+                            function_arn=self.data_ingestion_lambda.function_arn
+                        )
+                    )
+                ],
+                rule_disabled=False,
+                aws_iot_sql_version="2016-03-23",
+            ),
+        )
+
+        # MessagePack sensor data carries no IDs; they come from the topic
+        # (carbonready/farm/<farmId>/device/<deviceId>/sensor/msgpack)
+        self.binary_sensor_data_rule = iot.CfnTopicRule(
+            self,
+            "BinarySensorDataRule",
+            rule_name="CarbonReadyBinarySensorDataRule",
+            topic_rule_payload=iot.CfnTopicRule.TopicRulePayloadProperty(
+                sql="SELECT encode(*, 'base64') AS payload, 'msgpack' AS contentType, topic(3) AS farmId, topic(5) AS deviceId FROM 'carbonready/farm/+/device/+/sensor/msgpack'",
+                actions=[
+                    iot.CfnTopicRule.ActionProperty(
+                        lambda_=iot.CfnTopicRule.LambdaActionProperty(
+                            function_arn=self.data_ingestion_lambda.function_arn
+                        )
+                    )
+                ],
+                rule_disabled=False,
+                aws_iot_sql_version="2016-03-23",
+            ),
+        )
+
+        # Device health summaries go to CloudWatch Logs for fleet-wide
+        # queries (slowest stages, heap, RSSI per device)
+        self.device_metrics_log_group = logs.LogGroup(
+            self,
+            "DeviceMetricsLogGroup",
+            log_group_name="/carbonready/device-metrics",
+            retention=logs.RetentionDays.THREE_MONTHS,
+        )
+        self.device_metrics_log_group.grant_write(iot_rule_role)
+
+        self.device_metrics_rule = iot.CfnTopicRule(
+            self,
+            "DeviceMetricsRule",
+            rule_name="CarbonReadyDeviceMetricsRule",
+            topic_rule_payload=iot.CfnTopicRule.TopicRulePayloadProperty(
+                sql="SELECT *, topic(3) AS farmId FROM 'carbonready/farm/+/device/+/metrics'",
+                actions=[
+                    iot.CfnTopicRule.ActionProperty(
+                        cloudwatch_logs=iot.CfnTopicRule.CloudwatchLogsActionProperty(
+                            log_group_name=self.device_metrics_log_group.log_group_name,
+                            role_arn=iot_rule_role.role_arn,
+                        )
+                    )
+                ],
+                rule_disabled=False,
+                aws_iot_sql_version="2016-03-23",
+            ),
+        )
+
         # AI Processing Lambda
         # Performs carbon calculations on a scheduled basis
         self.ai_processing_lambda = lambda_.Function(
@@ -34,7 +34,10 @@ class IoTStack(Stack):
                         "Effect": "Allow",
                         "Action": ["iot:Publish"],
                         "Resource": [
-                            f"arn:aws:iot:{self.region}:{self.account}:topic/carbonready/farm/${{iot:Connection.Thing.Attributes[farmId]}}/sensor/data"
+                            f"arn:aws:iot:{self.region}:{self.account}:topic/carbonready/farm/${{iot:Connection.Thing.Attributes[farmId]}}/sensor/data",
+                            f"arn:aws:iot:{self.region}:{self.account}:topic/carbonready/farm/${{iot:Connection.Thing.Attributes[farmId]}}/sensor/data/heatshrink",
+                            f"arn:aws:iot:{self.region}:{self.account}:topic/carbonready/farm/${{iot:Connection.Thing.Attributes[farmId]}}/device/${{iot:Connection.Thing.ThingName}}/sensor/msgpack",
+                            f"arn:aws:iot:{self.region}:{self.account}:topic/carbonready/farm/${{iot:Connection.Thing.Attributes[farmId]}}/device/${{iot:Connection.Thing.ThingName}}/metrics",
                         ],
                     },
                     {
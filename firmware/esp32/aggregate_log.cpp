@@ -0,0 +1,535 @@
+// CarbonReady Aggregate Log Implementation
+
+#include "aggregate_log.h"
+#include <LittleFS.h>
+#include "local_storage.h"
+
+// Identifies a valid aggregate tail file ("CRA1")
+#define AGGREGATE_TAIL_MAGIC 0x31415243
+
+// Tail position, persisted in the log's tail file
+struct AggregateTail {
+  uint32_t magic;
+  uint32_t segment;  // Oldest segment still holding records
+  uint32_t record;   // Removed records at the start of that segment
+};
+
+AggregateLog::AggregateLog(const char* dir, uint32_t bucketSeconds, int maxSegments)
+  : dir(dir), bucketSeconds(bucketSeconds), maxSegments(maxSegments) {
+  firstSegment = 0;
+  headSegment = 0;
+  headRecords = 0;
+  tailRecord = 0;
+  count = 0;
+  building = false;
+}
+
+bool AggregateLog::begin() {
+  if (!LittleFS.exists(dir) && !LittleFS.mkdir(dir)) {
+    Serial.printf("Error: Failed to create %s\n", dir);
+    return false;
+  }
+  
+  return scanSegments();
+}
+
+bool AggregateLog::add(const AggregateRecord& record) {
+  uint32_t recordBucket = record.timestamp / bucketSeconds;
+  bool resuming = !building;
+  
+  if (building && recordBucket != bucket) {
+    AggregateRecord finished;
+    packBucket(finished);
+    building = false;
+    if (!appendRecord(finished)) {
+      return false;
+    }
+  }
+  
+  if (!building) {
+    building = true;
+    bucket = recordBucket;
+    firstTimestamp = record.timestamp;
+    lastTimestamp = record.timestamp + record.span;
+    samples = 0;
+    soilProbeCount = record.soilProbeCount;
+    for (int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+      sums[i] = 0;
+      mins[i] = record.min[i];
+      maxs[i] = record.max[i];
+    }
+    for (int i = 0; i < AGGREGATE_RECORD_PROBES - 1; i++) {
+      probeSums[i] = 0;
+    }
+    
+    // A bucket the last pass ended in carries on in its record
+    AggregateRecord last;
+    if (resuming && takeLastRecord(recordBucket, last)) {
+      mergeRecord(last);
+    }
+  }
+  
+  mergeRecord(record);
+  return true;
+}
+
+bool AggregateLog::finish() {
+  bool success = true;
+  
+  if (building) {
+    AggregateRecord finished;
+    packBucket(finished);
+    building = false;
+    success = appendRecord(finished);
+  }
+  
+  if (headFile) {
+    headFile.flush();
+  }
+  
+  return success;
+}
+
+int AggregateLog::getCount() {
+  return count;
+}
+
+int AggregateLog::getSegmentCount() {
+  return headRecords > 0 ? headSegment - firstSegment + 1 : 0;
+}
+
+int AggregateLog::getFreeSlots() {
+  int segments = getSegmentCount();
+  int free = (maxSegments - segments) * OFFLINE_SEGMENT_RECORDS;
+  if (segments > 0) {
+    free += OFFLINE_SEGMENT_RECORDS - headRecords;
+  }
+  return max(free, 0);
+}
+
+int AggregateLog::readOldest(SensorReadings* readings, ReadingSummary* summaries, int maxCount) {
+  int wanted = min((int)count, maxCount);
+  int read = 0;
+  uint32_t segment = firstSegment;
+  uint32_t slot = tailRecord;
+  
+  while (read < wanted) {
+    char path[32];
+    segmentPath(segment, path, sizeof(path));
+    
+    File file = LittleFS.open(path, "r");
+    if (!file || !file.seek(slot * sizeof(AggregateRecord), SeekSet)) {
+      Serial.println("Error: Failed to open aggregate segment for reading");
+      break;
+    }
+    
+    for (; read < wanted && slot < OFFLINE_SEGMENT_RECORDS; read++, slot++) {
+      AggregateRecord record;
+      SensorReadings& out = readings[read];
+      
+      if (file.read((uint8_t*)&record, sizeof(record)) != sizeof(record)) {
+        file.close();
+        return read;
+      }
+      
+      if (summaries != nullptr) {
+        summaries[read].samples = 0;
+      }
+      
+      if (!validRecord(record)) {
+        Serial.println("Error: Corrupt aggregate slot");
+        out.valid = false;
+        out.soilProbeCount = 0;
+        continue;
+      }
+      
+      out.soilMoisture = record.mean[0] / 100.0f;
+      out.soilTemperature = record.mean[1] / 100.0f;
+      out.airTemperature = record.mean[2] / 100.0f;
+      out.humidity = record.mean[3] / 100.0f;
+      out.timestamp = record.timestamp;
+      out.valid = true;
+      out.soilProbeCount = min(record.soilProbeCount, (uint8_t)DS18B20_MAX_PROBES);
+      out.soilTemperatures[0] = out.soilTemperature;
+      for (int i = 1; i < out.soilProbeCount; i++) {
+        out.soilTemperatures[i] = record.soilProbeMeans[i - 1] / 100.0f;
+      }
+      
+      if (summaries != nullptr) {
+        ReadingSummary& summary = summaries[read];
+        summary.span = record.span;
+        summary.samples = record.samples;
+        memcpy(summary.min, record.min, sizeof(summary.min));
+        memcpy(summary.max, record.max, sizeof(summary.max));
+      }
+    }
+    
+    file.close();
+    segment++;
+    slot = 0;
+  }
+  
+  return read;
+}
+
+bool AggregateLog::removeOldest(int removeCount) {
+  if (removeCount <= 0) {
+    return true;
+  }
+  
+  if ((uint32_t)removeCount > count) {
+    removeCount = count;
+  }
+  
+  tailRecord += removeCount;
+  count -= removeCount;
+  
+  char path[32];
+  while (firstSegment < headSegment && tailRecord >= OFFLINE_SEGMENT_RECORDS) {
+    segmentPath(firstSegment, path, sizeof(path));
+    if (!LittleFS.remove(path)) {
+      Serial.println("Warning: Failed to delete synced aggregate segment");
+    }
+    firstSegment++;
+    tailRecord -= OFFLINE_SEGMENT_RECORDS;
+  }
+  
+  if (count == 0 && headRecords > 0) {
+    releaseOldestSegment();
+  }
+  
+  return saveTail();
+}
+
+int AggregateLog::compactInto(AggregateLog& next) {
+  if (getSegmentCount() == 0) {
+    return 0;
+  }
+  
+  char path[32];
+  segmentPath(firstSegment, path, sizeof(path));
+  
+  File file = LittleFS.open(path, "r");
+  if (!file || !file.seek(tailRecord * sizeof(AggregateRecord), SeekSet)) {
+    Serial.println("Error: Failed to open aggregate segment for compaction");
+    return -1;
+  }
+  
+  // Streamed one record at a time; corrupt records are left behind
+  uint32_t end = firstSegment == headSegment ? headRecords : OFFLINE_SEGMENT_RECORDS;
+  bool success = true;
+  AggregateRecord record;
+  for (uint32_t slot = tailRecord; success && slot < end; slot++) {
+    if (file.read((uint8_t*)&record, sizeof(record)) != sizeof(record)) {
+      break;
+    }
+    if (validRecord(record)) {
+      success = next.add(record);
+    }
+  }
+  file.close();
+  
+  // The merged records are on flash before their source goes
+  if (!next.finish() || !success) {
+    return -1;
+  }
+  
+  return dropOldestSegment();
+}
+
+int AggregateLog::dropOldestSegment() {
+  int dropped = releaseOldestSegment();
+  saveTail();
+  return dropped;
+}
+
+int AggregateLog::releaseOldestSegment() {
+  if (getSegmentCount() == 0) {
+    return 0;
+  }
+  
+  char path[32];
+  segmentPath(firstSegment, path, sizeof(path));
+  
+  int dropped;
+  if (firstSegment == headSegment) {
+    headFile.close();
+    dropped = count;
+    headSegment++;
+    firstSegment = headSegment;
+    headRecords = 0;
+    tailRecord = 0;
+    count = 0;
+  } else {
+    dropped = OFFLINE_SEGMENT_RECORDS - tailRecord;
+    firstSegment++;
+    tailRecord = 0;
+    count -= dropped;
+  }
+  
+  if (!LittleFS.remove(path)) {
+    Serial.println("Warning: Failed to delete aggregate segment");
+  }
+  
+  return dropped;
+}
+
+bool AggregateLog::clear() {
+  headFile.close();
+  building = false;
+  
+  bool success = true;
+  for (uint32_t segment = firstSegment; segment <= headSegment; segment++) {
+    char path[32];
+    segmentPath(segment, path, sizeof(path));
+    if (LittleFS.exists(path) && !LittleFS.remove(path)) {
+      success = false;
+    }
+  }
+  
+  headSegment++;
+  firstSegment = headSegment;
+  headRecords = 0;
+  tailRecord = 0;
+  count = 0;
+  
+  return saveTail() && success;
+}
+
+size_t AggregateLog::segmentBytes() {
+  return OFFLINE_SEGMENT_RECORDS * sizeof(AggregateRecord);
+}
+
+bool AggregateLog::packReadings(const SensorReadings& readings, AggregateRecord& record) {
+  if (!readings.valid) {
+    return false;
+  }
+  
+  memset(&record, 0, sizeof(record));
+  record.version = AGGREGATE_RECORD_VERSION;
+  record.soilProbeCount = min(readings.soilProbeCount, (uint8_t)AGGREGATE_RECORD_PROBES);
+  record.timestamp = (uint32_t)readings.timestamp;
+  record.span = 0;
+  record.samples = 1;
+  
+  const float values[AGGREGATE_FIELD_COUNT] = {
+    readings.soilMoisture, readings.soilTemperature, readings.airTemperature, readings.humidity
+  };
+  for (int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+    record.mean[i] = toHundredths(values[i]);
+    record.min[i] = record.mean[i];
+    record.max[i] = record.mean[i];
+  }
+  for (int i = 1; i < record.soilProbeCount; i++) {
+    record.soilProbeMeans[i - 1] = toHundredths(readings.soilTemperatures[i]);
+  }
+  
+  sealRecord(record);
+  return true;
+}
+
+bool AggregateLog::scanSegments() {
+  headFile.close();
+  building = false;
+  
+  File directory = LittleFS.open(dir);
+  if (!directory || !directory.isDirectory()) {
+    Serial.printf("Error: Failed to open %s\n", dir);
+    return false;
+  }
+  
+  bool found = false;
+  uint32_t lowest = 0;
+  uint32_t highest = 0;
+  size_t highestSize = 0;
+  
+  File entry = directory.openNextFile();
+  while (entry) {
+    const char* name = strrchr(entry.name(), '/');
+    name = name ? name + 1 : entry.name();
+    
+    char* end;
+    uint32_t segment = strtoul(name, &end, 16);
+    if (end == name + 8 && strcmp(end, ".seg") == 0) {
+      if (!found || segment < lowest) {
+        lowest = segment;
+      }
+      if (!found || segment > highest) {
+        highest = segment;
+        highestSize = entry.size();
+      }
+      found = true;
+    }
+    
+    entry.close();
+    entry = directory.openNextFile();
+  }
+  directory.close();
+  
+  AggregateTail tail = {AGGREGATE_TAIL_MAGIC, lowest, 0};
+  char path[32];
+  tailPath(path, sizeof(path));
+  File file = LittleFS.open(path, "r");
+  if (file) {
+    AggregateTail stored;
+    if (file.read((uint8_t*)&stored, sizeof(stored)) == sizeof(stored) &&
+        stored.magic == AGGREGATE_TAIL_MAGIC) {
+      tail = stored;
+    }
+    file.close();
+  }
+  
+  // Segments before the tail were drained; a reset interrupted their deletion
+  while (found && lowest < tail.segment) {
+    segmentPath(lowest, path, sizeof(path));
+    LittleFS.remove(path);
+    found = lowest < highest;
+    lowest++;
+  }
+  
+  if (!found) {
+    firstSegment = tail.segment;
+    headSegment = tail.segment;
+    headRecords = 0;
+    tailRecord = 0;
+    count = 0;
+    return true;
+  }
+  
+  firstSegment = lowest;
+  headSegment = highest;
+  headRecords = min(highestSize / sizeof(AggregateRecord), (size_t)OFFLINE_SEGMENT_RECORDS);
+  tailRecord = tail.segment == firstSegment ? tail.record : 0;
+  tailRecord = min(tailRecord, firstSegment == headSegment ? headRecords : (uint32_t)OFFLINE_SEGMENT_RECORDS);
+  count = (headSegment - firstSegment) * OFFLINE_SEGMENT_RECORDS + headRecords - tailRecord;
+  
+  return true;
+}
+
+bool AggregateLog::saveTail() {
+  char path[32];
+  tailPath(path, sizeof(path));
+  
+  File file = LittleFS.open(path, "w");
+  if (!file) {
+    Serial.println("Error: Failed to open aggregate tail file for writing");
+    return false;
+  }
+  
+  AggregateTail tail = {AGGREGATE_TAIL_MAGIC, firstSegment, tailRecord};
+  bool success = file.write((const uint8_t*)&tail, sizeof(tail)) == sizeof(tail);
+  file.close();
+  
+  return success;
+}
+
+bool AggregateLog::appendRecord(const AggregateRecord& record) {
+  if (headRecords >= OFFLINE_SEGMENT_RECORDS) {
+    headFile.close();
+    headSegment++;
+    headRecords = 0;
+  }
+  
+  if (!headFile) {
+    char path[32];
+    segmentPath(headSegment, path, sizeof(path));
+    
+    headFile = LittleFS.open(path, headRecords > 0 ? "r+" : "w");
+    if (!headFile) {
+      Serial.println("Error: Failed to open aggregate segment for writing");
+      return false;
+    }
+  }
+  
+  bool success = headFile.seek(headRecords * sizeof(AggregateRecord), SeekSet) &&
+                 headFile.write((const uint8_t*)&record, sizeof(record)) == sizeof(record);
+  if (!success) {
+    headFile.close();
+    return false;
+  }
+  
+  headRecords++;
+  count++;
+  return true;
+}
+
+void AggregateLog::mergeRecord(const AggregateRecord& record) {
+  // Means are weighted by the readings behind them
+  samples += record.samples;
+  for (int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+    sums[i] += record.mean[i] * (float)record.samples;
+    mins[i] = min(mins[i], record.min[i]);
+    maxs[i] = max(maxs[i], record.max[i]);
+  }
+  for (int i = 0; i < AGGREGATE_RECORD_PROBES - 1; i++) {
+    probeSums[i] += record.soilProbeMeans[i] * (float)record.samples;
+  }
+  soilProbeCount = min(soilProbeCount, record.soilProbeCount);
+  firstTimestamp = min(firstTimestamp, record.timestamp);
+  lastTimestamp = max(lastTimestamp, record.timestamp + record.span);
+}
+
+bool AggregateLog::takeLastRecord(uint32_t recordBucket, AggregateRecord& record) {
+  if (count == 0 || headRecords == 0) {
+    return false;
+  }
+  
+  // Read back through a fresh handle; appendRecord() reopens the head
+  headFile.close();
+  char path[32];
+  segmentPath(headSegment, path, sizeof(path));
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    return false;
+  }
+  bool found = file.seek((headRecords - 1) * sizeof(AggregateRecord), SeekSet) &&
+               file.read((uint8_t*)&record, sizeof(record)) == sizeof(record) &&
+               validRecord(record) && record.timestamp / bucketSeconds == recordBucket;
+  file.close();
+  
+  if (!found) {
+    return false;
+  }
+  
+  // The merged bucket is written over it; until then it stays on flash
+  headRecords--;
+  count--;
+  return true;
+}
+
+void AggregateLog::packBucket(AggregateRecord& record) {
+  memset(&record, 0, sizeof(record));
+  record.version = AGGREGATE_RECORD_VERSION;
+  record.soilProbeCount = soilProbeCount;
+  record.timestamp = firstTimestamp;
+  record.span = lastTimestamp - firstTimestamp;
+  record.samples = samples;
+  
+  for (int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+    record.mean[i] = (int16_t)lroundf(sums[i] / samples);
+    record.min[i] = mins[i];
+    record.max[i] = maxs[i];
+  }
+  for (int i = 1; i < soilProbeCount; i++) {
+    record.soilProbeMeans[i - 1] = (int16_t)lroundf(probeSums[i - 1] / samples);
+  }
+  
+  sealRecord(record);
+}
+
+void AggregateLog::segmentPath(uint32_t segment, char* path, size_t size) {
+  snprintf(path, size, "%s/%08lx.seg", dir, (unsigned long)segment);
+}
+
+void AggregateLog::tailPath(char* path, size_t size) {
+  snprintf(path, size, "%s/tail.bin", dir);
+}
+
+bool AggregateLog::validRecord(const AggregateRecord& record) {
+  return record.version == AGGREGATE_RECORD_VERSION && record.samples > 0 &&
+         record.crc == LocalStorage::crc32((const uint8_t*)&record, offsetof(AggregateRecord, crc));
+}
+
+void AggregateLog::sealRecord(AggregateRecord& record) {
+  record.crc = LocalStorage::crc32((const uint8_t*)&record, offsetof(AggregateRecord, crc));
+}
@@ -0,0 +1,159 @@
+// CarbonReady Aggregate Log
+// One downsampled tier of offline storage (see LocalStorage)
+//
+// Holds AggregateRecords, each the min/max/mean of the readings in one
+// UTC-aligned bucket (an hour or a day), in fixed-size segment files under
+// its own directory. As with the raw segments, records are appended to the
+// newest segment, removal advances a tail persisted in the directory, and
+// a segment is deleted once it is drained or merged into the next tier.
+//
+// Records are merged with add() and finish(): consecutive records in the
+// same bucket become one, weighted by their sample counts. A pass that
+// starts in the bucket the last one ended in rewrites that newest record
+// in place (the only record ever rewritten), so a bucket split across
+// compaction passes is still stored once.
+
+#ifndef AGGREGATE_LOG_H
+#define AGGREGATE_LOG_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "config.h"
+#include "sensor_manager.h"
+
+// Current AggregateRecord layout version
+#define AGGREGATE_RECORD_VERSION 1
+
+// Soil temperature probes an aggregate holds (part of the on-flash layout)
+#define AGGREGATE_RECORD_PROBES 4
+
+static_assert(DS18B20_MAX_PROBES <= AGGREGATE_RECORD_PROBES,
+              "DS18B20_MAX_PROBES exceeds the probes an AggregateRecord holds");
+
+// Fixed-width summary of the readings in one bucket. Values are hundredths,
+// fields in SensorReadings order (see AGGREGATE_FIELD_COUNT).
+struct __attribute__((packed)) AggregateRecord {
+  uint8_t version;         // AGGREGATE_RECORD_VERSION
+  uint8_t soilProbeCount;  // Probes every merged reading had
+  uint16_t reserved;
+  uint32_t timestamp;      // First reading merged (Unix seconds)
+  uint32_t span;           // Seconds from the first to the last reading merged
+  uint32_t samples;        // Readings merged
+  int16_t mean[AGGREGATE_FIELD_COUNT];
+  int16_t min[AGGREGATE_FIELD_COUNT];
+  int16_t max[AGGREGATE_FIELD_COUNT];
+  int16_t soilProbeMeans[AGGREGATE_RECORD_PROBES - 1]; // Later probes
+  uint16_t reserved2;
+  uint32_t crc;            // CRC-32 of all preceding bytes
+};
+
+class AggregateLog {
+public:
+  // Segments live in dir; records merge into buckets of bucketSeconds and
+  // the log keeps at most maxSegments segment files
+  AggregateLog(const char* dir, uint32_t bucketSeconds, int maxSegments);
+  
+  // Create the directory if needed and rebuild positions from it
+  bool begin();
+  
+  // Merge a record into the bucket being built. A record from another
+  // bucket appends the one being built first; the first record after
+  // finish() continues the newest stored record if they share a bucket.
+  bool add(const AggregateRecord& record);
+  
+  // Append the bucket being built and flush (after the last add())
+  bool finish();
+  
+  // Records stored
+  int getCount();
+  
+  // Segment files on flash
+  int getSegmentCount();
+  
+  // Records that can be appended before the log reaches maxSegments
+  int getFreeSlots();
+  
+  // Read up to maxCount of the oldest records as their means and spread,
+  // without removing them. Corrupt records come back with valid=false.
+  int readOldest(SensorReadings* readings, ReadingSummary* summaries, int maxCount);
+  
+  // Remove the oldest records (advances the tail, deletes drained segments)
+  bool removeOldest(int removeCount);
+  
+  // Merge the records left in the oldest segment into next and delete the
+  // segment. Returns the number of records taken, or -1 on failure.
+  int compactInto(AggregateLog& next);
+  
+  // Delete the oldest segment. Returns the number of records lost.
+  int dropOldestSegment();
+  
+  // Delete every record
+  bool clear();
+  
+  // Bytes in a full segment file
+  static size_t segmentBytes();
+  
+  // Pack one reading as a single-sample record (false if it is not valid)
+  static bool packReadings(const SensorReadings& readings, AggregateRecord& record);
+  
+private:
+  const char* dir;
+  uint32_t bucketSeconds;
+  int maxSegments;
+  
+  // Same scheme as LocalStorage's raw segments
+  uint32_t firstSegment;  // Oldest segment on flash
+  uint32_t headSegment;   // Segment being appended to
+  uint32_t headRecords;   // Records written in the head segment
+  uint32_t tailRecord;    // Removed records at the start of firstSegment
+  uint32_t count;
+  
+  File headFile;
+  
+  // Bucket being built by add()
+  bool building;
+  uint32_t bucket;
+  uint32_t firstTimestamp;
+  uint32_t lastTimestamp;
+  uint32_t samples;
+  uint8_t soilProbeCount;
+  float sums[AGGREGATE_FIELD_COUNT];
+  int16_t mins[AGGREGATE_FIELD_COUNT];
+  int16_t maxs[AGGREGATE_FIELD_COUNT];
+  float probeSums[AGGREGATE_RECORD_PROBES - 1];
+  
+  // Rebuild segment pointers from the directory and the tail file
+  bool scanSegments();
+  
+  // Persist the tail position
+  bool saveTail();
+  
+  // Delete the oldest segment without persisting the tail (the caller saves
+  // it). Returns the number of records lost.
+  int releaseOldestSegment();
+  
+  // Append one record to the head segment (flushed by finish())
+  bool appendRecord(const AggregateRecord& record);
+  
+  // Fold a record into the bucket being built
+  void mergeRecord(const AggregateRecord& record);
+  
+  // Take back the newest record if it is in recordBucket; the next append
+  // rewrites its slot
+  bool takeLastRecord(uint32_t recordBucket, AggregateRecord& record);
+  
+  // Pack the bucket being built into a record
+  void packBucket(AggregateRecord& record);
+  
+  // Paths of a segment and of the tail file (buffers of at least 32 bytes)
+  void segmentPath(uint32_t segment, char* path, size_t size);
+  void tailPath(char* path, size_t size);
+  
+  // Check a record's version and CRC
+  static bool validRecord(const AggregateRecord& record);
+  
+  // Seal a packed record with its CRC
+  static void sealRecord(AggregateRecord& record);
+};
+
+#endif // AGGREGATE_LOG_H
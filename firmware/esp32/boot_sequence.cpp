@@ -0,0 +1,214 @@
+// CarbonReady Boot Sequence Implementation
+
+#include "boot_sequence.h"
+#include <WiFi.h>
+#include <time.h>
+#include "metrics.h"
+
+// Anything earlier is the clock counting up from power-on (2001-09-09)
+#define MIN_VALID_EPOCH 1000000000
+
+static const char* const BOOT_STATE_NAMES[] = {
+  "idle", "associating", "time sync", "online", "offline"
+};
+
+BootSequence::BootSequence(PublishPipeline& publishPipeline)
+  : publishPipeline(publishPipeline) {
+  ssid[0] = '\0';
+  password[0] = '\0';
+  fastConnect = false;
+  fellBack = false;
+  state = BOOT_IDLE;
+  startedAt = 0;
+  stateStartedAt = 0;
+  heldCount = 0;
+}
+
+void BootSequence::begin(const char* ssid, const char* password) {
+  startedAt = millis();
+  strlcpy(this->ssid, ssid, sizeof(this->ssid));
+  strlcpy(this->password, password, sizeof(this->password));
+  fastConnect = false;
+  fellBack = false;
+  
+  Serial.printf("Connecting to WiFi: %s\n", ssid);
+  
+  // Credentials come from config; keep the SDK from rewriting them to flash
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+  
+#if WIFI_FAST_RECONNECT
+  WifiCacheEntry cached;
+  if (wifiCache.load(ssid, cached)) {
+#if WIFI_CACHE_STATIC_IP
+    WiFi.config(IPAddress(cached.localIP), IPAddress(cached.gateway),
+                IPAddress(cached.subnet), IPAddress(cached.dns));
+#endif
+    Serial.printf("Direct association on channel %d\n", cached.channel);
+    WiFi.begin(ssid, password, cached.channel, cached.bssid, true);
+    fastConnect = true;
+    enter(BOOT_ASSOCIATING);
+    return;
+  }
+#endif
+  
+  WiFi.begin(ssid, password);
+  enter(BOOT_ASSOCIATING);
+}
+
+bool BootSequence::step() {
+  unsigned long elapsed = millis() - stateStartedAt;
+  
+  switch (state) {
+    case BOOT_IDLE:
+      return false;
+    
+    case BOOT_ASSOCIATING:
+      if (WiFi.status() == WL_CONNECTED) {
+        onConnected();
+        
+        // SNTP runs in the background from here on
+        configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+        
+        if (clockValid()) {
+          Serial.println("Clock preserved in RTC, SNTP corrects drift in the background");
+          enter(BOOT_ONLINE);
+          return true;
+        }
+        enter(BOOT_TIME_SYNC);
+      } else if (fastConnect && (elapsed >= WIFI_FAST_CONNECT_TIMEOUT_MS ||
+                                 WiFi.status() == WL_NO_SSID_AVAIL ||
+                                 WiFi.status() == WL_CONNECT_FAILED)) {
+        fallBackToScan();
+      } else if (elapsed >= BOOT_WIFI_TIMEOUT_MS) {
+        // The WiFi driver keeps reconnecting on its own
+        Serial.println("Warning: WiFi not connected, continuing offline");
+        enter(BOOT_OFFLINE);
+        return true;
+      }
+      return false;
+    
+    case BOOT_TIME_SYNC:
+      if (clockValid()) {
+        time_t now = time(nullptr);
+        struct tm timeinfo;
+        gmtime_r(&now, &timeinfo);
+        Serial.printf("Time synchronized: %04d-%02d-%02d %02d:%02d:%02d UTC\n",
+                      timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
+                      timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
+        releaseHeld();
+        enter(BOOT_ONLINE);
+        return true;
+      }
+      if (elapsed >= BOOT_TIME_SYNC_TIMEOUT_MS) {
+        Serial.println("Warning: Failed to sync time, continuing without it");
+        enter(BOOT_OFFLINE);
+        return true;
+      }
+      return false;
+    
+    case BOOT_ONLINE:
+    case BOOT_OFFLINE:
+      // SNTP may still come through after giving up
+      if (heldCount > 0 && clockValid()) {
+        releaseHeld();
+      }
+      return false;
+  }
+  
+  return false;
+}
+
+void BootSequence::finish() {
+  while (state == BOOT_ASSOCIATING || state == BOOT_TIME_SYNC) {
+    if (!step()) {
+      delay(BOOT_POLL_MS);
+    }
+  }
+}
+
+bool BootSequence::isComplete() {
+  return state == BOOT_ONLINE || state == BOOT_OFFLINE;
+}
+
+bool BootSequence::isOnline() {
+  return state == BOOT_ONLINE;
+}
+
+void BootSequence::submit(const SensorReadings& readings, const ReadingSummary* summary) {
+  if (clockValid()) {
+    // Held readings go first to keep the queue in time order
+    releaseHeld();
+    publishPipeline.submit(readings, summary);
+    return;
+  }
+  
+  if (heldCount == BOOT_HELD_READINGS) {
+    Serial.println("Warning: Clock not set, submitting reading with uptime timestamp");
+    publishPipeline.submit(readings, summary);
+    return;
+  }
+  
+  held[heldCount] = readings;
+  heldSummaries[heldCount].samples = 0;
+  if (summary != nullptr) {
+    heldSummaries[heldCount] = *summary;
+  }
+  heldAt[heldCount] = millis();
+  heldCount++;
+  Serial.printf("Holding reading until the clock is set (%d held)\n", heldCount);
+}
+
+bool BootSequence::clockValid() {
+  return time(nullptr) >= MIN_VALID_EPOCH;
+}
+
+void BootSequence::enter(BootState next) {
+  state = next;
+  stateStartedAt = millis();
+  Serial.printf("Boot: %s after %lu ms\n", BOOT_STATE_NAMES[next],
+                (unsigned long)(stateStartedAt - startedAt));
+}
+
+void BootSequence::onConnected() {
+  uint32_t elapsedMs = millis() - startedAt;
+  deviceMetrics.record(STAGE_WIFI_CONNECT, elapsedMs * 1000);
+  wifiCache.recordConnect(fastConnect, fellBack, elapsedMs);
+  
+  Serial.printf("WiFi connected in %lu ms (%s), IP address: %s\n", (unsigned long)elapsedMs,
+                fastConnect ? "cached AP" : "scan", WiFi.localIP().toString().c_str());
+  
+#if WIFI_FAST_RECONNECT
+  wifiCache.store(ssid);
+#endif
+  fastConnect = false;
+}
+
+void BootSequence::fallBackToScan() {
+  Serial.println("Cached AP did not answer, scanning");
+  wifiCache.invalidate();
+  fastConnect = false;
+  fellBack = true;
+  
+  WiFi.disconnect();
+#if WIFI_CACHE_STATIC_IP
+  // All-zero addresses switch the station back to DHCP
+  WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+#endif
+  WiFi.begin(ssid, password);
+}
+
+void BootSequence::releaseHeld() {
+  time_t now = time(nullptr);
+  unsigned long nowMs = millis();
+  
+  for (int i = 0; i < heldCount; i++) {
+    held[i].timestamp = (unsigned long)now - (nowMs - heldAt[i]) / 1000;
+    publishPipeline.submit(held[i], &heldSummaries[i]);
+  }
+  
+  if (heldCount > 0) {
+    Serial.printf("Re-stamped %d reading(s) taken before time sync\n", heldCount);
+  }
+  heldCount = 0;
+}
@@ -0,0 +1,100 @@
+// CarbonReady Boot Sequence
+// Non-blocking startup: WiFi association, SNTP and sensor warm-up overlap
+//
+// begin() only issues WiFi.begin(); step() polls association and the clock
+// without waiting, so the caller can mount storage, parse certificates and
+// take the first sample while the radio comes up. Each wait is bounded by
+// its boot timeout, after which the device carries on offline.
+//
+// With WIFI_FAST_RECONNECT, begin() associates directly to the BSSID and
+// channel cached by WifiCache (optionally with the cached addresses instead
+// of DHCP). If that has not connected within WIFI_FAST_CONNECT_TIMEOUT_MS the
+// entry is dropped and a normal scanning WiFi.begin() takes over.
+//
+// The system clock lives in the RTC domain and survives resets and deep
+// sleep. When it is still valid at boot, SNTP only corrects drift in the
+// background and nothing waits for it. After a power-on the clock starts at
+// zero; readings taken before SNTP sets it are held here and re-stamped
+// from their uptime once it does.
+
+#ifndef BOOT_SEQUENCE_H
+#define BOOT_SEQUENCE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "sensor_manager.h"
+#include "publish_pipeline.h"
+#include "wifi_cache.h"
+
+enum BootState {
+  BOOT_IDLE,          // begin() not called yet
+  BOOT_ASSOCIATING,   // Waiting for WiFi
+  BOOT_TIME_SYNC,     // WiFi up, waiting for SNTP (power-on only)
+  BOOT_ONLINE,        // Network and clock ready
+  BOOT_OFFLINE        // Gave up waiting; WiFi and SNTP keep retrying
+};
+
+class BootSequence {
+public:
+  BootSequence(PublishPipeline& publishPipeline);
+  
+  // Start WiFi association and return immediately
+  void begin(const char* ssid, const char* password);
+  
+  // Advance without blocking. Returns true on the one call that completes
+  // the sequence (online or given up); keep calling to release held readings
+  // if SNTP only succeeds later.
+  bool step();
+  
+  // Step until the sequence completes (bounded by the boot timeouts)
+  void finish();
+  
+  // Sequence finished (online or offline)
+  bool isComplete();
+  
+  // WiFi associated and clock valid
+  bool isOnline();
+  
+  // Hand a reading (and its window summary, if any) to the publish
+  // pipeline, holding it first if the clock has not been set since power-on
+  void submit(const SensorReadings& readings, const ReadingSummary* summary = nullptr);
+  
+  // System clock holds a real UTC time
+  static bool clockValid();
+  
+private:
+  PublishPipeline& publishPipeline;
+  
+  // Credentials kept for the scan fallback
+  char ssid[33];
+  char password[65];
+  
+  // Direct association to the cached AP in progress / fell back to a scan
+  bool fastConnect;
+  bool fellBack;
+  
+  BootState state;
+  unsigned long startedAt;
+  unsigned long stateStartedAt;
+  
+  // Readings taken before the clock was set, with their summaries and the
+  // millis() they were taken at
+  SensorReadings held[BOOT_HELD_READINGS];
+  ReadingSummary heldSummaries[BOOT_HELD_READINGS];
+  unsigned long heldAt[BOOT_HELD_READINGS];
+  int heldCount;
+  
+  // Switch state and log the time since begin()
+  void enter(BootState next);
+  
+  // Association finished: record timings and refresh the cache
+  void onConnected();
+  
+  // Drop the cached AP and restart association with a full scan
+  void fallBackToScan();
+  
+  // Re-stamp held readings against the now valid clock and submit them
+  void releaseHeld();
+};
+
+#endif // BOOT_SEQUENCE_H
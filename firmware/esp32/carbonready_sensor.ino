@@ -3,32 +3,49 @@
 
 #include <WiFi.h>
 #include <time.h>
+#include <assert.h>
 #include "config.h"
 #include "sensor_manager.h"
 #include "data_processor.h"
 #include "mqtt_client.h"
 #include "local_storage.h"
+#include "tiered_storage.h"
+#include "rtc_buffer.h"
+#include "publish_pipeline.h"
+#include "reading_aggregator.h"
+#include "sensor_task.h"
+#include "runtime_config.h"
+#include "boot_sequence.h"
+#include "soak_harness.h"
+#include <esp_sleep.h>
+#include <esp_system.h>
 
 // Global instances
 SensorManager sensorManager;
 DataProcessor dataProcessor;
 MQTTClientManager mqttClient;
 LocalStorage localStorage;
+TieredStorage tieredStorage(localStorage);
+RtcReadingBuffer rtcBuffer;
+PublishPipeline publishPipeline(mqttClient, tieredStorage, dataProcessor);
+ReadingAggregator readingAggregator;
+SensorTask sensorTask(sensorManager, readingAggregator, publishPipeline);
+BootSequence bootSequence(publishPipeline);
 
-// Configuration (loaded from SPIFFS during provisioning)
+// Configuration (loaded from LittleFS during provisioning)
 String farmId;
 String deviceId;
 String awsEndpoint;
 String wifiSSID;
 String wifiPassword;
 
-// Certificates (loaded from SPIFFS)
+// Certificates (loaded from LittleFS)
 String rootCA;
 String deviceCert;
 String deviceKey;
 
-// Timing
-unsigned long lastReadingTime = 0;
+// Heap watermark established after the first reading cycle
+uint32_t heapBaseline = 0;
 
 void setup() {
   // Initialize serial
@@ -42,7 +59,7 @@ void setup() {
     while (1) delay(1000);
   }
   
-  // Load configuration from SPIFFS
+  // Load configuration from LittleFS
   if (!loadConfiguration()) {
     Serial.println("Fatal: Failed to load configuration");
     Serial.println("Please provision the device first");
@@ -55,127 +72,96 @@ void setup() {
     Serial.printf("Generated device ID: %s\n", deviceId.c_str());
   }
   
-  // Connect to WiFi
-  connectWiFi();
+  // Settings tuned over the commands topic override the config.h defaults
+  runtimeConfig.begin(deviceId.c_str());
+  TunableSettings settings = runtimeConfig.get();
   
-  // Sync time with NTP
-  syncTime();
+  publishPipeline.begin(farmId, deviceId);
   
-  // Initialize sensors
+#if DEEP_SLEEP_MODE
+  // Sample, optionally flush, then deep sleep (does not return). PSRAM
+  // does not survive deep sleep, so readings go straight to flash.
+  runDutyCycle();
+#endif
+  
+  // Short outages buffer in PSRAM; whatever is there goes to flash on a
+  // software restart
+  tieredStorage.begin();
+  esp_register_shutdown_handler(flushStorageOnShutdown);
+  
+  // Fast boot: WiFi associates in the background while the sensors warm
+  // up and the certificates are parsed. The sensor task takes the first
+  // reading right away; loop() starts the network task once WiFi and the
+  // clock are ready.
+  bootSequence.begin(wifiSSID.c_str(), wifiPassword.c_str());
+  
+  // DS18B20 discovery runs now; the DHT22 stabilizes until the first read
   if (!sensorManager.begin()) {
     Serial.println("Warning: Some sensors failed to initialize");
   }
   
-  // Initialize MQTT client
+  // Initialize MQTT client (connects on the first publish)
   mqttClient.begin(awsEndpoint, farmId, deviceId,
                    rootCA.c_str(), deviceCert.c_str(), deviceKey.c_str());
   
-  // Connect to AWS IoT Core
-  if (mqttClient.connect()) {
-    Serial.println("Successfully connected to AWS IoT Core");
-    
-    // Try to sync offline readings
-    syncOfflineReadings();
-  } else {
-    Serial.println("Warning: Failed to connect to AWS IoT Core");
+#if SOAK_TEST_READINGS > 0
+  // Bench boards only: replaces normal operation (does not return)
+  runSoakTest();
+#endif
+  
+#if EDGE_AGGREGATION
+  readingAggregator.begin(settings.aggregationWindowMs);
+  Serial.printf("Sampling every %lu s, reporting every %lu minutes or on change\n",
+                (unsigned long)(settings.sampleIntervalMs / 1000),
+                (unsigned long)(settings.aggregationWindowMs / 60000));
+#endif
+  
+  // Sampling moves to its own task; loop() (the Arduino loop task, on the
+  // same core at lower priority) is the processing task from here on
+  TaskHandle_t processingTask = xTaskGetCurrentTaskHandle();
+  deviceMetrics.watchTask("processing", processingTask);
+  if (!sensorTask.startTask(processingTask)) {
+    Serial.println("Fatal: Failed to start sensor task");
+    while (1) delay(1000);
   }
   
   Serial.println("Setup complete");
-  Serial.printf("Reading interval: %d minutes\n", READING_INTERVAL_MS / 60000);
+  Serial.printf("Reading interval: %lu minutes\n", (unsigned long)(settings.readingIntervalMs / 60000));
 }
 
+// Processing task: steps the boot sequence and turns each reading from
+// the sensor task into a signed message for the network task
 void loop() {
-  // Maintain MQTT connection
-  mqttClient.loop();
-  
-  // Check if it's time for a reading
-  unsigned long currentTime = millis();
-  if (currentTime - lastReadingTime >= READING_INTERVAL_MS) {
-    lastReadingTime = currentTime;
-    
-    Serial.println("\n--- Taking sensor reading ---");
-    
-    // Read sensors
-    SensorReadings readings = sensorManager.readAllSensors();
-    
-    if (!readings.valid) {
-      Serial.println("Error: Invalid sensor readings, skipping transmission");
-      return;
-    }
-    
-    // Create message with hash
-    String message = dataProcessor.createMessage(readings, farmId, deviceId);
-    
-    // Try to publish
-    bool published = mqttClient.publish(message);
-    
-    if (published) {
-      Serial.println("Data transmitted successfully");
-      
-      // If we have offline readings, try to sync them
-      if (localStorage.getStoredCount() > 0) {
-        syncOfflineReadings();
-      }
-    } else {
-      Serial.println("Failed to transmit data after retries");
-      
-      // Store offline
-      if (localStorage.storeReading(message)) {
-        Serial.println("Data stored offline for later transmission");
-      } else {
-        Serial.println("Error: Failed to store data offline");
-      }
+  // Publishing, retries, keepalives and the offline backlog drain run on
+  // the network task once the boot sequence completes
+  if (bootSequence.step()) {
+    if (!publishPipeline.startTask()) {
+      Serial.println("Fatal: Failed to start network task");
+      while (1) delay(1000);
     }
+    Serial.printf("Boot complete (%s) after %lu ms, %d offline readings to sync\n",
+                  bootSequence.isOnline() ? "online" : "offline",
+                  millis(), publishPipeline.getStoredCount());
   }
   
-  // Small delay to prevent watchdog issues
-  delay(100);
-}
-
-void connectWiFi() {
-  Serial.printf("Connecting to WiFi: %s\n", wifiSSID.c_str());
-  
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(wifiSSID.c_str(), wifiPassword.c_str());
-  
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 30) {
-    delay(1000);
-    Serial.print(".");
-    attempts++;
+  // Build and queue the message; never blocks on the broker. Readings
+  // taken before the clock is set wait in the boot sequence.
+  SensorReadings readings;
+  ReadingSummary summary;
+  while (sensorTask.take(readings, &summary)) {
+    bootSequence.submit(readings, &summary);
+    checkHeapWatermark();
   }
   
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.println("\nWiFi connected");
-    Serial.printf("IP address: %s\n", WiFi.localIP().toString().c_str());
-  } else {
-    Serial.println("\nFailed to connect to WiFi");
-  }
+  // Sleep until the next reading, waking to step the boot sequence
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PROCESSING_TASK_POLL_MS));
 }
 
-void syncTime() {
-  Serial.println("Syncing time with NTP...");
-  
-  configTime(0, 0, "pool.ntp.org", "time.nist.gov");
-  
-  int attempts = 0;
-  time_t now = 0;
-  while (now < 1000000000 && attempts < 20) {
-    time(&now);
-    delay(500);
-    attempts++;
-  }
-  
-  if (now > 1000000000) {
-    Serial.println("Time synchronized");
-    struct tm timeinfo;
-    gmtime_r(&now, &timeinfo);
-    Serial.printf("Current UTC time: %04d-%02d-%02d %02d:%02d:%02d\n",
-                  timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
-                  timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-  } else {
-    Serial.println("Warning: Failed to sync time");
-  }
+// Blocking connect for the duty cycle: runs the boot sequence to
+// completion, bounded by BOOT_WIFI_TIMEOUT_MS and BOOT_TIME_SYNC_TIMEOUT_MS
+void connectWiFi() {
+  bootSequence.begin(wifiSSID.c_str(), wifiPassword.c_str());
+  bootSequence.finish();
 }
 
 String generateDeviceId() {
@@ -190,7 +176,7 @@ String generateDeviceId() {
 }
 
 bool loadConfiguration() {
-  // In a real implementation, this would load from SPIFFS
+  // In a real implementation, this would load from LittleFS
   // For now, use values from config.h
   
   farmId = String(FARM_ID);
@@ -205,8 +191,8 @@ bool loadConfiguration() {
     return false;
   }
   
-  // Load certificates from SPIFFS
-  // In a real implementation, certificates would be stored in SPIFFS
+  // Load certificates from LittleFS
+  // In a real implementation, certificates would be stored in LittleFS
   // For now, return true if basic config is present
   
   Serial.println("Configuration loaded:");
@@ -217,44 +203,146 @@ bool loadConfiguration() {
   return true;
 }
 
-void syncOfflineReadings() {
-  int storedCount = localStorage.getStoredCount();
+// Track free heap across reading cycles. The reading path allocates
+// nothing, so steady-state free heap and largest free block must not shrink.
+void checkHeapWatermark() {
+  uint32_t freeHeap = ESP.getFreeHeap();
   
-  if (storedCount == 0) {
+  if (heapBaseline == 0) {
+    heapBaseline = freeHeap;
+    Serial.printf("Heap baseline: %lu bytes free\n", (unsigned long)heapBaseline);
     return;
   }
   
-  Serial.printf("Syncing %d offline readings...\n", storedCount);
+  if (freeHeap + HEAP_WATERMARK_TOLERANCE < heapBaseline) {
+    Serial.printf("Warning: Free heap dropped to %lu bytes (baseline %lu, largest block %lu)\n",
+                  (unsigned long)freeHeap, (unsigned long)heapBaseline,
+                  (unsigned long)ESP.getMaxAllocHeap());
+#if HEAP_WATERMARK_ASSERT
+    assert(freeHeap + HEAP_WATERMARK_TOLERANCE >= heapBaseline);
+#endif
+  }
+}
+
+// Outage soak (SOAK_TEST_READINGS): clear the offline backlog, replay an
+// outage into it, drain it through the real broker connection and print
+// the report as one "SOAK <json>" line, then halt
+void runSoakTest() {
+  bootSequence.finish();
+  if (!bootSequence.isOnline()) {
+    Serial.println("Soak: not online, nothing to drain into");
+    while (1) delay(1000);
+  }
   
-  std::vector<String> readings = localStorage.getAllReadings();
-  int successCount = 0;
+  localStorage.clearReadings();
+  SoakHarness harness(publishPipeline, localStorage);
+  SoakReport report = harness.run(SOAK_TEST_READINGS, runtimeConfig.get().readingIntervalMs);
   
-  for (const String& reading : readings) {
-    if (mqttClient.publish(reading)) {
-      successCount++;
-    } else {
-      Serial.println("Failed to sync offline reading, stopping sync");
-      break;
-    }
-    
-    delay(1000); // Delay between messages to avoid overwhelming the broker
+  static char line[512];
+  if (SoakHarness::writeReport(report, line, sizeof(line)) > 0) {
+    Serial.printf("SOAK %s\n", line);
   }
   
-  if (successCount == storedCount) {
-    Serial.printf("Successfully synced all %d offline readings\n", successCount);
-    localStorage.clearReadings();
-  } else {
-    Serial.printf("Synced %d/%d offline readings\n", successCount, storedCount);
-    
-    // Remove successfully synced readings
-    std::vector<String> remainingReadings;
-    for (int i = successCount; i < storedCount; i++) {
-      remainingReadings.push_back(readings[i]);
-    }
+  while (1) delay(1000);
+}
+
+// Shutdown handler (esp_restart): keep PSRAM readings across the restart
+void flushStorageOnShutdown() {
+  publishPipeline.flushStorage();
+}
+
+// Connect, publish the RTC buffer and offline backlog, then disconnect.
+// Readings that could not be sent are moved to offline storage.
+void flushRtcBuffer() {
+  Serial.printf("Flushing %d buffered readings...\n", rtcBuffer.count());
+  
+  if (WiFi.status() != WL_CONNECTED) {
+    connectWiFi();
+  }
+  
+  if (WiFi.status() == WL_CONNECTED) {
+    mqttClient.begin(awsEndpoint, farmId, deviceId,
+                     rootCA.c_str(), deviceCert.c_str(), deviceKey.c_str());
     
-    localStorage.clearReadings();
-    for (const String& reading : remainingReadings) {
-      localStorage.storeReading(reading);
+    if (mqttClient.connect()) {
+      while (rtcBuffer.count() > 0) {
+        int consumed = publishPipeline.publishBatch(rtcBuffer.readings(), rtcBuffer.count());
+        if (consumed < 0) {
+          break;
+        }
+        rtcBuffer.removeOldest(consumed);
+      }
+      
+      if (rtcBuffer.count() == 0) {
+        publishPipeline.syncOfflineReadings();
+      }
+      
+#if METRICS_ENABLED
+      // Stage timers only cover this wakeup; the WiFi counters span all of them
+      publishPipeline.publishMetrics();
+#endif
+      
+      // Pick up commands queued for the commands topic before sleeping
+      mqttClient.loop();
     }
   }
+  
+  // Anything left over goes to flash so the RTC buffer can keep sampling
+  const SensorReadings* remaining = rtcBuffer.readings();
+  for (int i = 0; i < rtcBuffer.count(); i++) {
+    publishPipeline.storeOffline(remaining[i]);
+  }
+  rtcBuffer.removeOldest(rtcBuffer.count());
+  
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+}
+
+// Deep-sleep duty cycle: sample into RTC memory on every timer wakeup and
+// only bring up WiFi/TLS every sleepFlushEvery wakeups (DEEP_SLEEP_FLUSH_EVERY
+// by default) or when the buffer fills. Commands received during a flush
+// apply from the next wakeup.
+void runDutyCycle() {
+  TunableSettings settings = runtimeConfig.get();
+  rtcBuffer.begin();
+  uint32_t wakeCount = rtcBuffer.recordWakeup();
+  bool coldBoot = esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER;
+  
+  Serial.printf("Duty cycle wakeup %lu (%d buffered)\n",
+                (unsigned long)wakeCount, rtcBuffer.count());
+  
+  // System time survives deep sleep; it only needs NTP after power-on.
+  // Associate while the DHT22 warms up, then read with the clock set.
+  if (coldBoot) {
+    bootSequence.begin(wifiSSID.c_str(), wifiPassword.c_str());
+  }
+  
+  if (!sensorManager.begin()) {
+    Serial.println("Warning: Some sensors failed to initialize");
+  }
+  
+  if (coldBoot) {
+    bootSequence.finish();
+  }
+  
+  SensorReadings readings = sensorManager.readAllSensors();
+  if (readings.valid) {
+    rtcBuffer.append(readings);
+  } else {
+    Serial.println("Error: Invalid sensor readings, skipping");
+  }
+  
+  if (coldBoot || rtcBuffer.isFull() || wakeCount % settings.sleepFlushEvery == 0) {
+    flushRtcBuffer();
+  }
+  
+  // Sleep for the rest of the reading interval
+  uint64_t awakeMs = millis();
+  uint64_t intervalMs = runtimeConfig.get().readingIntervalMs;
+  uint64_t sleepMs = awakeMs < intervalMs ? intervalMs - awakeMs : intervalMs;
+  Serial.printf("Sleeping for %lu ms\n", (unsigned long)sleepMs);
+  Serial.flush();
+  
+  esp_sleep_enable_timer_wakeup(sleepMs * 1000ULL);
+  esp_deep_sleep_start();
 }
@@ -8,10 +8,21 @@
 // WiFi Configuration (to be set during provisioning)
 #define WIFI_SSID ""
 #define WIFI_PASSWORD ""
+#define WIFI_FAST_RECONNECT 1            // Associate to the cached BSSID/channel before scanning
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 3000  // Fall back to a full scan after this long
+#define WIFI_CACHE_STATIC_IP 0           // 1 = reuse the cached DHCP lease addresses (skips DHCP)
 
 // AWS IoT Configuration
 #define AWS_IOT_ENDPOINT ""  // Set during provisioning
 #define MQTT_PORT 8883
+#define MQTT_BUFFER_SIZE 4096      // PubSubClient packet buffer (bounds batch size)
+#define TLS_HANDSHAKE_TIMEOUT_MS 15000
+#define TLS_SESSION_RESUMPTION 1   // Resume cached TLS sessions on reconnect
+#define TLS_SESSION_CACHE_SIZE 2048  // Serialized session bytes kept in RTC memory
+#define MQTT_QOS 0                 // Commands subscription QoS (data publishes use MQTT_PUBLISH_QOS)
+#define MQTT_PUBLISH_QOS 1         // Data publishes: 1 = readings are discarded only on PUBACK
+#define MQTT_INFLIGHT_WINDOW 4     // QoS 1 batches outstanding at once during offline sync
+#define MQTT_PUBACK_TIMEOUT_MS 10000  // Treat a publish as failed without a PUBACK by then
 
 // Farm Configuration
 #define FARM_ID ""  // Set during provisioning
@@ -19,19 +30,89 @@
 
 // Sensor Pin Configuration
 #define DHT22_PIN 4              // GPIO4 for DHT22 (air temp/humidity)
-#define DS18B20_PIN 5            // GPIO5 for DS18B20 (soil temp)
+#define DS18B20_PIN 5            // GPIO5 for DS18B20 (soil temp, one or more probes)
 #define SOIL_MOISTURE_PIN 34     // GPIO34 (ADC1_CH6) for capacitive soil moisture
+#define DS18B20_MAX_PROBES 4     // Soil temperature probes read from the DS18B20 bus
 
-// Timing Configuration
+// Timing Configuration (defaults; tunable at runtime, see runtime_config.h)
 #define READING_INTERVAL_MS (15 * 60 * 1000)  // 15 minutes
 #define RETRY_DELAY_BASE_MS 2000               // Initial retry delay
 #define MAX_RETRIES 3                          // Maximum transmission retries
 
+// Edge Aggregation
+#define EDGE_AGGREGATION 0                     // 1 = sample fast, report one aggregate per window
+#define SAMPLE_INTERVAL_MS (60 * 1000)         // Sampling interval when aggregating
+#define AGGREGATION_WINDOW_MS READING_INTERVAL_MS  // Report window
+#define DEADBAND_SOIL_MOISTURE 5.0             // Report early beyond these changes (0 = off)
+#define DEADBAND_SOIL_TEMPERATURE 1.0
+#define DEADBAND_AIR_TEMPERATURE 2.0
+#define DEADBAND_HUMIDITY 10.0
+
+// Task Layout (sensing and processing on the APP core, networking next to WiFi)
+#define SENSOR_TASK_STACK_SIZE 4096            // Bytes
+#define SENSOR_TASK_PRIORITY 3                 // Above processing, so sensor reads are not preempted
+#define SENSOR_TASK_CORE 1                     // Away from the WiFi stack's interrupts
+#define SENSOR_QUEUE_LENGTH 4                  // Readings waiting for the processing task
+#define PROCESSING_TASK_POLL_MS 100            // Processing (loop()) wait between boot steps
+
+// Network Task
+#define PUBLISH_QUEUE_LENGTH 8                 // Signed messages buffered for the network task
+#define NETWORK_TASK_STACK_SIZE 8192           // Bytes
+#define NETWORK_TASK_PRIORITY 1
+#define NETWORK_TASK_CORE 0                    // Same core as the WiFi stack
+#define NETWORK_TASK_POLL_MS 10                // Network task loop interval
+
+// Boot Sequence
+#define BOOT_WIFI_TIMEOUT_MS 15000             // Give up on association after this long
+#define BOOT_TIME_SYNC_TIMEOUT_MS 10000        // Give up on SNTP after power-on after this long
+#define BOOT_HELD_READINGS 4                   // Readings held until SNTP sets the clock
+#define BOOT_POLL_MS 50                        // Poll interval when waiting for the boot to finish
+#define DHT22_STABILIZE_MS 2000                // DHT22 warm-up after power-up
+
+// Power Configuration
+#define DEEP_SLEEP_MODE 0                      // 1 = sample on timer wakeups, sleep in between
+#define DEEP_SLEEP_FLUSH_EVERY 4               // Connect and flush every K wakeups
+#define RTC_BUFFER_CAPACITY 16                 // Readings buffered in RTC slow memory
+
 // Data Storage
-#define MAX_OFFLINE_READINGS 100  // Maximum readings to store offline
+#define OFFLINE_SEGMENT_RECORDS 128 // Readings per segment file (4.5 KB)
+#define OFFLINE_STORAGE_RESERVE_BYTES (64 * 1024) // Partition space offline storage leaves free (LittleFS metadata, other files)
+#define OFFLINE_FS_BLOCK_BYTES 4096 // LittleFS block size: files occupy whole blocks
+#define OFFLINE_HOURLY_SEGMENTS 4   // Segments of hourly aggregates, 128 hours each
+#define OFFLINE_DAILY_SEGMENTS 2    // Segments of daily aggregates, 128 days each
+#define SYNC_BATCH_MAX_READINGS 32 // Maximum offline readings per batch publish
+
+// PSRAM Tier (ahead of flash offline storage)
+#define PSRAM_TIER_CAPACITY 4096                      // Readings buffered in PSRAM (0 = flash only)
+#define PSRAM_SPILL_RECORDS OFFLINE_SEGMENT_RECORDS   // Oldest readings moved to flash when the ring fills
+#define PSRAM_SPILL_AGE_MS (4UL * 60 * 60 * 1000)     // Move the ring to flash once it has held readings this long (0 = never)
+#define STORAGE_FLUSH_TIMEOUT_MS 1000                 // Wait for the storage mutex before sleep or restart
+
+// Wire Format
+#define WIRE_FORMAT_JSON 0
+#define WIRE_FORMAT_MSGPACK 1
+#define WIRE_FORMAT WIRE_FORMAT_JSON   // MessagePack publishes to the per-device topic
+
+// Payload Compression
+#define PAYLOAD_COMPRESSION 0         // 1 = publish large payloads heatshrink-compressed
+#define COMPRESSION_MIN_BYTES 512     // Only compress payloads at least this large
+#define HEATSHRINK_WINDOW_BITS 10     // Back-reference window (2^10 = 1024 bytes)
+#define HEATSHRINK_LOOKAHEAD_BITS 5   // Maximum match length (2^5 = 32 bytes)
+
+// Diagnostics
+#define METRICS_ENABLED 1             // Stage timers and periodic health summary
+#define METRICS_INTERVAL_MS (60 * 60 * 1000)  // Publish a metrics summary every hour
+#define HEAP_WATERMARK_TOLERANCE 512  // Allowed free-heap drift between reading cycles
+#define HEAP_WATERMARK_ASSERT 0       // 1 = abort when the heap watermark is exceeded
+#define SOAK_TEST_READINGS 0          // > 0 = bench soak at boot: replay an outage this long, drain it, report and halt
 
 // Sensor Calibration Values (set during calibration)
 #define SOIL_MOISTURE_DRY 3200    // ADC value for dry soil
 #define SOIL_MOISTURE_WET 1200    // ADC value for wet soil
 
+// Soil Moisture Acquisition
+#define SOIL_MOISTURE_SAMPLES 64         // ADC samples per reading (continuous/DMA mode)
+#define SOIL_MOISTURE_TRIM_PERCENT 25    // Samples dropped from each end before averaging
+#define SOIL_MOISTURE_SAMPLE_RATE_HZ 20000
+
 #endif // CONFIG_H
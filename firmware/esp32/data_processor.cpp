@@ -1,115 +1,769 @@
 // CarbonReady Data Processor Implementation
 
 #include "data_processor.h"
-#include <ArduinoJson.h>
-#include <mbedtls/sha256.h>
-#include <time.h>
+#include "config.h"
+#include "metrics.h"
+
+// Appends JSON text to a fixed buffer while optionally feeding a SHA-256
+// hash, so the canonical payload is hashed in the same pass that
+// writes it. Output matches ArduinoJson's compact serialization.
+class MessageWriter {
+public:
+  MessageWriter(char* output, size_t capacity, Sha256Hasher* sha)
+    : output(output), capacity(capacity), length(0), overflow(false), sha(sha), hashTime(0) {}
+  
+  // Append raw bytes
+  void write(const char* data, size_t size) {
+    if (sha) {
+      unsigned long start = micros();
+      sha->update(data, size);
+      hashTime += micros() - start;
+    }
+    if (length + size >= capacity) {
+      overflow = true;
+      return;
+    }
+    memcpy(output + length, data, size);
+    length += size;
+    output[length] = '\0';
+  }
+  
+  void write(const char* text) {
+    write(text, strlen(text));
+  }
+  
+  // Append a decimal integer
+  void writeInt(int32_t value) {
+    if (value < 0) {
+      write("-", 1);
+      writeUint(0U - (uint32_t)value);
+      return;
+    }
+    writeUint((uint32_t)value);
+  }
+  
+  void writeUint(uint32_t value) {
+    char digits[10];
+    char* end = digits + sizeof(digits);
+    char* start = end;
+    do {
+      *--start = '0' + value % 10;
+      value /= 10;
+    } while (value > 0);
+    write(start, end - start);
+  }
+  
+  // Append a quoted, escaped JSON string
+  void writeString(const char* text) {
+    write("\"", 1);
+    const char* run = text;
+    for (const char* c = text; *c; c++) {
+      const char* escape = nullptr;
+      switch (*c) {
+        case '"':  escape = "\\\""; break;
+        case '\\': escape = "\\\\"; break;
+        case '\b': escape = "\\b"; break;
+        case '\f': escape = "\\f"; break;
+        case '\n': escape = "\\n"; break;
+        case '\r': escape = "\\r"; break;
+        case '\t': escape = "\\t"; break;
+      }
+      if (escape) {
+        write(run, c - run);
+        write(escape, 2);
+        run = c + 1;
+      }
+    }
+    write(run, strlen(run));
+    write("\"", 1);
+  }
+  
+  // Start (or stop) feeding later writes to the hash
+  void attachHash(Sha256Hasher* context) {
+    sha = context;
+  }
+  
+  void detachHash() {
+    sha = nullptr;
+  }
+  
+  size_t size() const { return overflow ? 0 : length; }
+  
+  // Microseconds spent in SHA-256 updates
+  unsigned long hashMicros() const { return hashTime; }
+  
+private:
+  char* output;
+  size_t capacity;
+  size_t length;
+  bool overflow;
+  Sha256Hasher* sha;
+  unsigned long hashTime;
+};
+
+// Appends canonical MessagePack (shortest encoding for every value) to a
+// fixed buffer while optionally feeding a SHA-256 hash
+class PackWriter {
+public:
+  PackWriter(uint8_t* output, size_t capacity, Sha256Hasher* sha)
+    : output(output), capacity(capacity), length(0), overflow(false), sha(sha), hashTime(0) {}
+  
+  void write(const uint8_t* data, size_t size) {
+    if (sha) {
+      unsigned long start = micros();
+      sha->update(data, size);
+      hashTime += micros() - start;
+    }
+    if (length + size > capacity) {
+      overflow = true;
+      return;
+    }
+    memcpy(output + length, data, size);
+    length += size;
+  }
+  
+  void writeArray(uint8_t count) {
+    // fixarray (up to 15 elements)
+    uint8_t header = 0x90 | count;
+    write(&header, 1);
+  }
+  
+  void writeInt(int32_t value) {
+    uint8_t buffer[5];
+    size_t size;
+    
+    if (value >= 0 && value <= 0x7f) {
+      buffer[0] = value;                  // positive fixint
+      size = 1;
+    } else if (value < 0 && value >= -32) {
+      buffer[0] = (uint8_t)(int8_t)value; // negative fixint
+      size = 1;
+    } else if (value >= 0) {
+      return writeUint(value);
+    } else if (value >= INT8_MIN) {
+      buffer[0] = 0xd0;
+      buffer[1] = (uint8_t)(int8_t)value;
+      size = 2;
+    } else if (value >= INT16_MIN) {
+      buffer[0] = 0xd1;
+      putBigEndian(buffer + 1, (uint16_t)value, 2);
+      size = 3;
+    } else {
+      buffer[0] = 0xd2;
+      putBigEndian(buffer + 1, (uint32_t)value, 4);
+      size = 5;
+    }
+    write(buffer, size);
+  }
+  
+  void writeUint(uint32_t value) {
+    uint8_t buffer[5];
+    size_t size;
+    
+    if (value <= 0x7f) {
+      buffer[0] = value;
+      size = 1;
+    } else if (value <= 0xff) {
+      buffer[0] = 0xcc;
+      buffer[1] = value;
+      size = 2;
+    } else if (value <= 0xffff) {
+      buffer[0] = 0xcd;
+      putBigEndian(buffer + 1, value, 2);
+      size = 3;
+    } else {
+      buffer[0] = 0xce;
+      putBigEndian(buffer + 1, value, 4);
+      size = 5;
+    }
+    write(buffer, size);
+  }
+  
+  void writeString(const char* text) {
+    size_t textLength = strlen(text);
+    uint8_t header[2];
+    
+    if (textLength <= 31) {
+      header[0] = 0xa0 | textLength;      // fixstr
+      write(header, 1);
+    } else {
+      header[0] = 0xd9;                   // str8 (IDs are short)
+      header[1] = min(textLength, (size_t)0xff);
+      write(header, 2);
+      textLength = header[1];
+    }
+    write((const uint8_t*)text, textLength);
+  }
+  
+  void writeBinary(const uint8_t* data, uint8_t size) {
+    uint8_t header[2] = {0xc4, size};     // bin8
+    write(header, 2);
+    write(data, size);
+  }
+  
+  void attachHash(Sha256Hasher* context) {
+    sha = context;
+  }
+  
+  void detachHash() {
+    sha = nullptr;
+  }
+  
+  size_t size() const { return overflow ? 0 : length; }
+  
+  // Microseconds spent in SHA-256 updates
+  unsigned long hashMicros() const { return hashTime; }
+  
+private:
+  uint8_t* output;
+  size_t capacity;
+  size_t length;
+  bool overflow;
+  Sha256Hasher* sha;
+  unsigned long hashTime;
+  
+  static void putBigEndian(uint8_t* buffer, uint32_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) {
+      buffer[i] = value & 0xff;
+      value >>= 8;
+    }
+  }
+};
+
+// Soil probes after the first, in hundredths (empty array for one probe)
+static void writeSoilProbes(PackWriter& writer, const SensorReadings& readings) {
+  int count = min((int)readings.soilProbeCount, DS18B20_MAX_PROBES);
+  writer.writeArray(count > 1 ? count - 1 : 0);
+  for (int i = 1; i < count; i++) {
+    writer.writeInt(lroundf(readings.soilTemperatures[i] * 100));
+  }
+}
+
+// Aggregate summary: [span, samples, [min x4], [max x4]] in hundredths, or
+// an empty array for a single reading
+static void writePackedSummary(PackWriter& writer, const ReadingSummary* summary) {
+  if (summary == nullptr || summary->samples == 0) {
+    writer.writeArray(0);
+    return;
+  }
+  
+  writer.writeArray(4);
+  writer.writeUint(summary->span);
+  writer.writeUint(summary->samples);
+  writer.writeArray(AGGREGATE_FIELD_COUNT);
+  for (int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+    writer.writeInt(summary->min[i]);
+  }
+  writer.writeArray(AGGREGATE_FIELD_COUNT);
+  for (int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+    writer.writeInt(summary->max[i]);
+  }
+}
+
+// MSB-first bit packer for the compressed stream
+class BitWriter {
+public:
+  BitWriter(uint8_t* output, size_t capacity)
+    : output(output), capacity(capacity), length(0), bits(0), bitCount(0), overflow(false) {}
+  
+  void write(uint16_t value, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+      bits = (bits << 1) | ((value >> i) & 1);
+      if (++bitCount == 8) {
+        if (length < capacity) {
+          output[length++] = bits;
+        } else {
+          overflow = true;
+        }
+        bits = 0;
+        bitCount = 0;
+      }
+    }
+  }
+  
+  // Pad the final partial byte with zero bits
+  void flush() {
+    if (bitCount > 0) {
+      write(0, 8 - bitCount);
+    }
+  }
+  
+  bool overflowed() const { return overflow; }
+  size_t size() const { return length; }
+  
+private:
+  uint8_t* output;
+  size_t capacity;
+  size_t length;
+  uint8_t bits;
+  int bitCount;
+  bool overflow;
+};
 
 DataProcessor::DataProcessor() {
-  // Constructor
 }
 
-String DataProcessor::createPayload(const SensorReadings& readings,
-                                    const String& farmId,
-                                    const String& deviceId) {
-  // Create JSON document
-  StaticJsonDocument<512> doc;
+size_t DataProcessor::createPayload(const SensorReadings& readings,
+                                    const char* farmId,
+                                    const char* deviceId,
+                                    char* output,
+                                    size_t capacity) {
+  MessageWriter writer(output, capacity, nullptr);
   
-  // Add farm and device identifiers
-  doc["farmId"] = farmId;
-  doc["deviceId"] = deviceId;
+  writePayload(writer, readings, farmId, deviceId);
+  writer.write("}", 1);
   
-  // Add timestamp in ISO8601 format
-  doc["timestamp"] = formatISO8601(readings.timestamp);
+  return writer.size();
+}
+
+void DataProcessor::writePayload(MessageWriter& writer,
+                                 const SensorReadings& readings,
+                                 const char* farmId,
+                                 const char* deviceId) {
+  writeHeader(writer, readings, farmId, deviceId);
+  writeReadings(writer, readings);
   
-  // Add sensor readings
-  JsonObject readingsObj = doc.createNestedObject("readings");
-  readingsObj["soilMoisture"] = formatFloat(readings.soilMoisture);
-  readingsObj["soilTemperature"] = formatFloat(readings.soilTemperature);
-  readingsObj["airTemperature"] = formatFloat(readings.airTemperature);
-  readingsObj["humidity"] = formatFloat(readings.humidity);
+  // The payload's closing brace is left to the caller
+}
+
+void DataProcessor::writeHeader(MessageWriter& writer,
+                                const SensorReadings& readings,
+                                const char* farmId,
+                                const char* deviceId) {
+  char buffer[ISO8601_SIZE];
   
-  // Serialize to string
-  String payload;
-  serializeJson(doc, payload);
+  // Farm and device identifiers
+  writer.write("{\"farmId\":");
+  writer.writeString(farmId);
+  writer.write(",\"deviceId\":");
+  writer.writeString(deviceId);
   
-  return payload;
+  // Timestamp in ISO8601 format, formatted only here at send time
+  writer.write(",\"timestamp\":");
+  formatISO8601(readings.timestamp, buffer);
+  writer.writeString(buffer);
 }
 
-String DataProcessor::computeSHA256Hash(const String& payload) {
-  // Prepare hash buffer
-  uint8_t hash[32];
+void DataProcessor::writeReadings(MessageWriter& writer, const SensorReadings& readings) {
+  char buffer[25];
   
-  // Compute SHA-256 hash using mbedtls
-  mbedtls_sha256_context ctx;
-  mbedtls_sha256_init(&ctx);
-  mbedtls_sha256_starts(&ctx, 0); // 0 = SHA-256 (not SHA-224)
-  mbedtls_sha256_update(&ctx, (const unsigned char*)payload.c_str(), payload.length());
-  mbedtls_sha256_finish(&ctx, hash);
-  mbedtls_sha256_free(&ctx);
+  writer.write(",\"readings\":{\"soilMoisture\":");
+  formatFloat(readings.soilMoisture, buffer, sizeof(buffer));
+  writer.writeString(buffer);
+  writer.write(",\"soilTemperature\":");
+  formatFloat(readings.soilTemperature, buffer, sizeof(buffer));
+  writer.writeString(buffer);
+  writer.write(",\"airTemperature\":");
+  formatFloat(readings.airTemperature, buffer, sizeof(buffer));
+  writer.writeString(buffer);
+  writer.write(",\"humidity\":");
+  formatFloat(readings.humidity, buffer, sizeof(buffer));
+  writer.writeString(buffer);
   
-  // Convert hash to hex string
-  String hashString = "";
-  for (int i = 0; i < 32; i++) {
-    char hex[3];
-    sprintf(hex, "%02x", hash[i]);
-    hashString += hex;
+  // Per-probe list only when more than one probe is fitted
+  int probes = min((int)readings.soilProbeCount, DS18B20_MAX_PROBES);
+  if (probes > 1) {
+    writer.write(",\"soilTemperatureProbes\":[");
+    for (int i = 0; i < probes; i++) {
+      if (i > 0) {
+        writer.write(",", 1);
+      }
+      formatFloat(readings.soilTemperatures[i], buffer, sizeof(buffer));
+      writer.writeString(buffer);
+    }
+    writer.write("]", 1);
   }
+  writer.write("}", 1);
+}
+
+void DataProcessor::writeSummary(MessageWriter& writer, const ReadingSummary& summary) {
+  static const char* const FIELD_KEYS[AGGREGATE_FIELD_COUNT] = {
+    "\"soilMoisture\":", "\"soilTemperature\":", "\"airTemperature\":", "\"humidity\":"
+  };
+  char buffer[25];
+  
+  writer.write(",\"summary\":{\"span\":");
+  writer.writeUint(summary.span);
+  writer.write(",\"samples\":");
+  writer.writeUint(summary.samples);
   
-  return hashString;
+  // Same keys and number format as readings
+  for (int bound = 0; bound < 2; bound++) {
+    const int16_t* values = bound == 0 ? summary.min : summary.max;
+    writer.write(bound == 0 ? ",\"min\":{" : "},\"max\":{");
+    for (int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+      if (i > 0) {
+        writer.write(",", 1);
+      }
+      writer.write(FIELD_KEYS[i]);
+      formatFloat(values[i] / 100.0f, buffer, sizeof(buffer));
+      writer.writeString(buffer);
+    }
+  }
+  writer.write("}}", 2);
+}
+
+void DataProcessor::computeSHA256Hash(const uint8_t* data, size_t length, char* hashHex) {
+  uint8_t hash[SHA256_DIGEST_SIZE];
+  messageHash.hash(data, length, hash);
+  Sha256Hasher::toHex(hash, sizeof(hash), hashHex);
+}
+
+// Bucket of the two bytes at data in the compressData() match index
+static inline uint16_t matchHash(const uint8_t* data) {
+  uint16_t pair = (data[0] << 8) | data[1];
+  return (uint16_t)(pair * 40503u) >> (16 - COMPRESS_INDEX_BITS);
 }
 
-bool DataProcessor::compressData(const String& input, uint8_t* output, size_t* outputSize) {
-  // Note: For ESP32 with limited resources, we'll skip compression in this implementation
-  // to keep memory usage low. The design document mentions compression for cost optimization,
-  // but for the pilot phase with small payloads (~200 bytes), the overhead may not be worth it.
-  // This can be added later using libraries like miniz or ESP32's built-in compression.
+bool DataProcessor::compressData(const uint8_t* input, size_t inputSize,
+                                 uint8_t* output, size_t* outputSize) {
+  // heatshrink-compatible LZSS: a 1 bit followed by a literal byte, or a
+  // 0 bit followed by (distance - 1) and (length - 1) of a back-reference
+  // into the last 2^HEATSHRINK_WINDOW_BITS bytes. Matches are searched in
+  // the input buffer itself, so no memory is needed beyond the output and
+  // the match index.
+  const size_t windowSize = 1 << HEATSHRINK_WINDOW_BITS;
+  const size_t maxMatch = 1 << HEATSHRINK_LOOKAHEAD_BITS;
+  BitWriter writer(output, *outputSize);
   
-  // For now, just copy the data
-  memcpy(output, input.c_str(), input.length());
-  *outputSize = input.length();
+  // Index positions are stored plus one in 16 bits
+  if (inputSize > UINT16_MAX) {
+    return false;
+  }
+  
+  // Like heatshrink's search index, each position is chained to the last
+  // one whose first bytes hash the same, so a position is only compared
+  // with earlier positions that can start a match, newest first. A zero
+  // link ends a chain.
+  memset(matchHead, 0, sizeof(matchHead));
+  
+  size_t pos = 0;
+  while (pos < inputSize && !writer.overflowed()) {
+    // Longest match in the window (matches may run into the lookahead)
+    size_t bestLength = 0;
+    size_t bestDistance = 0;
+    size_t limit = min(maxMatch, inputSize - pos);
+    
+    uint16_t link = limit >= 2 ? matchHead[matchHash(input + pos)] : 0;
+    for (int checked = 0; link != 0 && checked < COMPRESS_MAX_CANDIDATES; checked++) {
+      size_t candidate = link - 1;
+      if (pos - candidate > windowSize) {
+        break;
+      }
+      
+      size_t length = 0;
+      while (length < limit && input[candidate + length] == input[pos + length]) {
+        length++;
+      }
+      if (length > bestLength) {
+        bestLength = length;
+        bestDistance = pos - candidate;
+        if (length == limit) {
+          break;
+        }
+      }
+      
+      link = matchPrev[candidate & (windowSize - 1)];
+    }
+    
+    // A back-reference beats literals from two bytes up
+    size_t advance = 1;
+    if (bestLength >= 2) {
+      writer.write(0, 1);
+      writer.write(bestDistance - 1, HEATSHRINK_WINDOW_BITS);
+      writer.write(bestLength - 1, HEATSHRINK_LOOKAHEAD_BITS);
+      advance = bestLength;
+    } else {
+      writer.write(1, 1);
+      writer.write(input[pos], 8);
+    }
+    
+    // Index every position passed, including those inside the match
+    for (size_t end = pos + advance; pos < end; pos++) {
+      if (pos + 1 < inputSize) {
+        uint16_t& head = matchHead[matchHash(input + pos)];
+        matchPrev[pos & (windowSize - 1)] = head;
+        head = pos + 1;
+      }
+    }
+  }
   
+  writer.flush();
+  
+  if (writer.overflowed()) {
+    return false;
+  }
+  
+  *outputSize = writer.size();
   return true;
 }
 
-String DataProcessor::createMessage(const SensorReadings& readings,
-                                    const String& farmId,
-                                    const String& deviceId) {
-  // Create payload without hash
-  String payload = createPayload(readings, farmId, deviceId);
+size_t DataProcessor::createMessage(const SensorReadings& readings,
+                                    const char* farmId,
+                                    const char* deviceId,
+                                    char* output,
+                                    size_t capacity,
+                                    const ReadingSummary* summary) {
+  unsigned long start = micros();
+  
+  messageHash.begin();
+  MessageWriter writer(output, capacity, &messageHash);
+  writePayload(writer, readings, farmId, deviceId);
+  if (summary != nullptr && summary->samples > 0) {
+    writeSummary(writer, *summary);
+  }
+  
+  // The hashed payload ends with '}', but the message continues with the
+  // hash field, so the brace is hashed without being written
+  unsigned long hashStart = micros();
+  messageHash.update("}", 1);
+  writer.detachHash();
   
-  // Compute hash of payload
-  String hash = computeSHA256Hash(payload);
+  uint8_t hash[SHA256_DIGEST_SIZE];
+  messageHash.finish(hash);
+  unsigned long hashTime = writer.hashMicros() + (micros() - hashStart);
   
-  // Parse payload JSON and add hash
-  StaticJsonDocument<512> doc;
-  deserializeJson(doc, payload);
-  doc["hash"] = hash;
+  char base64[HASH_BASE64_SIZE];
+  Sha256Hasher::toBase64(hash, sizeof(hash), base64);
   
-  // Serialize complete message
-  String message;
-  serializeJson(doc, message);
+  writer.write(",\"hash\":\"");
+  writer.write(base64, HASH_BASE64_SIZE - 1);
+  writer.write("\"}");
   
-  Serial.println("Created message with hash:");
-  Serial.println(message);
+  // Hashing is interleaved with writing; report the two shares separately
+  unsigned long total = micros() - start;
+  deviceMetrics.record(STAGE_HASH, hashTime);
+  deviceMetrics.record(STAGE_SERIALIZE, total - hashTime);
   
-  return message;
+  return writer.size();
 }
 
-String DataProcessor::formatISO8601(unsigned long timestamp) {
-  // Convert Unix timestamp to ISO8601 format
-  time_t rawtime = (time_t)timestamp;
-  struct tm* timeinfo = gmtime(&rawtime);
+size_t DataProcessor::createBinaryMessage(const SensorReadings& readings,
+                                          const char* farmId,
+                                          const char* deviceId,
+                                          uint8_t* output,
+                                          size_t capacity,
+                                          const ReadingSummary* summary) {
+  unsigned long start = micros();
   
-  char buffer[25];
-  strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", timeinfo);
+  // Canonical prefix: hashed but not sent (the topic carries the IDs)
+  messageHash.begin();
+  PackWriter canonical(nullptr, 0, &messageHash);
+  canonical.writeArray(10);
+  canonical.writeUint(WIRE_SCHEMA_VERSION);
+  canonical.writeString(farmId);
+  canonical.writeString(deviceId);
+  
+  PackWriter writer(output, capacity, nullptr);
+  writer.writeArray(9);
+  writer.writeUint(WIRE_SCHEMA_VERSION);
   
-  return String(buffer);
+  // Shared tail: written and hashed in the same pass
+  writer.attachHash(&messageHash);
+  writer.writeUint(readings.timestamp);
+  writer.writeInt(lroundf(readings.soilMoisture * 100));
+  writer.writeInt(lroundf(readings.soilTemperature * 100));
+  writer.writeInt(lroundf(readings.airTemperature * 100));
+  writer.writeInt(lroundf(readings.humidity * 100));
+  writeSoilProbes(writer, readings);
+  writePackedSummary(writer, summary);
+  writer.detachHash();
+  
+  unsigned long finishStart = micros();
+  uint8_t hash[SHA256_DIGEST_SIZE];
+  messageHash.finish(hash);
+  unsigned long hashTime = canonical.hashMicros() + writer.hashMicros() + (micros() - finishStart);
+  
+  writer.writeBinary(hash, sizeof(hash));
+  
+  unsigned long total = micros() - start;
+  deviceMetrics.record(STAGE_HASH, hashTime);
+  deviceMetrics.record(STAGE_SERIALIZE, total - hashTime);
+  
+  return writer.size();
+}
+
+size_t DataProcessor::createBatchHeader(const char* farmId,
+                                        const char* deviceId,
+                                        uint32_t baseTimestamp,
+                                        char* output,
+                                        size_t capacity) {
+  batchHash.begin();
+  
+  MessageWriter writer(output, capacity, nullptr);
+  
+  writer.write("{\"farmId\":");
+  writer.writeString(farmId);
+  writer.write(",\"deviceId\":");
+  writer.writeString(deviceId);
+  writer.write(",\"baseTimestamp\":");
+  writer.writeUint(baseTimestamp);
+  writer.write(",\"batch\":[");
+  
+  return writer.size();
+}
+
+size_t DataProcessor::createBinaryBatchHeader(uint32_t baseTimestamp,
+                                              uint8_t* output,
+                                              size_t capacity) {
+  batchHash.begin();
+  
+  PackWriter writer(output, capacity, nullptr);
+  
+  writer.writeArray(4);
+  writer.writeUint(WIRE_SCHEMA_VERSION);
+  writer.writeUint(baseTimestamp);
+  
+  return writer.size();
+}
+
+size_t DataProcessor::createBatchRecord(const SensorReadings& readings,
+                                        const char* farmId,
+                                        const char* deviceId,
+                                        uint32_t previousTimestamp,
+                                        char* output,
+                                        size_t capacity,
+                                        const ReadingSummary* summary) {
+  unsigned long start = micros();
+  
+  MessageWriter writer(output, capacity, nullptr);
+  writer.write("{\"dt\":");
+  writer.writeInt((int32_t)(readings.timestamp - previousTimestamp));
+  size_t readingsStart = writer.size();
+  writeReadings(writer, readings);
+  if (summary != nullptr && summary->samples > 0) {
+    writeSummary(writer, *summary);
+  }
+  writer.write("}", 1);
+  
+  size_t length = writer.size();
+  if (length == 0) {
+    return 0;
+  }
+  
+  // Canonical form is the full message: its header is hashed without being
+  // sent, then the readings and closing brace straight from the record
+  MessageWriter canonical(nullptr, 0, &batchHash);
+  writeHeader(canonical, readings, farmId, deviceId);
+  
+  unsigned long hashStart = micros();
+  batchHash.update(output + readingsStart, length - readingsStart);
+  unsigned long hashTime = canonical.hashMicros() + (micros() - hashStart);
+  
+  unsigned long total = micros() - start;
+  deviceMetrics.record(STAGE_HASH, hashTime);
+  deviceMetrics.record(STAGE_SERIALIZE, total - hashTime);
+  
+  return length;
+}
+
+size_t DataProcessor::createBinaryBatchRecord(const SensorReadings& readings,
+                                              const char* farmId,
+                                              const char* deviceId,
+                                              uint32_t previousTimestamp,
+                                              uint8_t* output,
+                                              size_t capacity,
+                                              const ReadingSummary* summary) {
+  unsigned long start = micros();
+  
+  PackWriter writer(output, capacity, nullptr);
+  writer.writeArray(7);
+  writer.writeInt((int32_t)(readings.timestamp - previousTimestamp));
+  size_t valuesStart = writer.size();
+  writer.writeInt(lroundf(readings.soilMoisture * 100));
+  writer.writeInt(lroundf(readings.soilTemperature * 100));
+  writer.writeInt(lroundf(readings.airTemperature * 100));
+  writer.writeInt(lroundf(readings.humidity * 100));
+  writeSoilProbes(writer, readings);
+  writePackedSummary(writer, summary);
+  
+  size_t length = writer.size();
+  if (length == 0) {
+    return 0;
+  }
+  
+  // Same canonical form as createBinaryMessage(), absolute timestamp included
+  PackWriter canonical(nullptr, 0, &batchHash);
+  canonical.writeArray(10);
+  canonical.writeUint(WIRE_SCHEMA_VERSION);
+  canonical.writeString(farmId);
+  canonical.writeString(deviceId);
+  canonical.writeUint(readings.timestamp);
+  
+  unsigned long hashStart = micros();
+  batchHash.update(output + valuesStart, length - valuesStart);
+  unsigned long hashTime = canonical.hashMicros() + (micros() - hashStart);
+  
+  unsigned long total = micros() - start;
+  deviceMetrics.record(STAGE_HASH, hashTime);
+  deviceMetrics.record(STAGE_SERIALIZE, total - hashTime);
+  
+  return length;
+}
+
+size_t DataProcessor::finishBatch(char* output, size_t capacity) {
+  unsigned long start = micros();
+  uint8_t hash[SHA256_DIGEST_SIZE];
+  batchHash.finish(hash);
+  deviceMetrics.record(STAGE_HASH, micros() - start);
+  
+  char base64[HASH_BASE64_SIZE];
+  Sha256Hasher::toBase64(hash, sizeof(hash), base64);
+  
+  MessageWriter writer(output, capacity, nullptr);
+  writer.write("],\"batchHash\":\"");
+  writer.write(base64, HASH_BASE64_SIZE - 1);
+  writer.write("\"}");
+  
+  return writer.size();
+}
+
+size_t DataProcessor::finishBinaryBatch(uint8_t* output, size_t capacity) {
+  unsigned long start = micros();
+  uint8_t hash[SHA256_DIGEST_SIZE];
+  batchHash.finish(hash);
+  deviceMetrics.record(STAGE_HASH, micros() - start);
+  
+  PackWriter writer(output, capacity, nullptr);
+  writer.writeBinary(hash, sizeof(hash));
+  
+  return writer.size();
+}
+
+void DataProcessor::formatISO8601(uint32_t timestamp, char* buffer) {
+  // Days since 1970-01-01 to a civil date (proleptic Gregorian), using
+  // eras of 400 years; avoids gmtime_r() and strftime() on every message
+  uint32_t days = timestamp / 86400;
+  uint32_t seconds = timestamp % 86400;
+  
+  uint32_t z = days + 719468;                // Days since 0000-03-01
+  uint32_t era = z / 146097;
+  uint32_t dayOfEra = z - era * 146097;
+  uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  uint32_t monthIndex = (5 * dayOfYear + 2) / 153;  // March = 0
+  uint32_t day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+  uint32_t month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+  uint32_t year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+  
+  // YYYY-MM-DDTHH:MM:SSZ
+  uint32_t fields[6] = {year, month, day, seconds / 3600, seconds / 60 % 60, seconds % 60};
+  static const char separators[6] = {'-', '-', 'T', ':', ':', 'Z'};
+  char* out = buffer;
+  
+  for (int i = 0; i < 6; i++) {
+    if (i == 0) {
+      *out++ = '0' + fields[0] / 1000 % 10;
+      *out++ = '0' + fields[0] / 100 % 10;
+    }
+    *out++ = '0' + fields[i] / 10 % 10;
+    *out++ = '0' + fields[i] % 10;
+    *out++ = separators[i];
+  }
+  *out = '\0';
 }
 
-String DataProcessor::formatFloat(float value) {
-  // Format float with 2 decimal places
-  char buffer[10];
-  snprintf(buffer, sizeof(buffer), "%.2f", value);
-  return String(buffer);
+void DataProcessor::formatFloat(float value, char* buffer, size_t size) {
+  // Format float with 2 decimal places (same width limit as before)
+  snprintf(buffer, min(size, (size_t)10), "%.2f", value);
 }
@@ -1,38 +1,189 @@
 // CarbonReady Data Processor
 // Handles JSON payload creation, SHA-256 hashing, and data compression
+//
+// All output goes to caller-provided buffers so the per-reading path
+// performs no heap allocations.
 
 #ifndef DATA_PROCESSOR_H
 #define DATA_PROCESSOR_H
 
 #include <Arduino.h>
+#include "config.h"
 #include "sensor_manager.h"
+#include "sha256_hasher.h"
+
+// Upper bound on a single signed message (a windowed aggregate adds its
+// summary, about 250 bytes of JSON)
+#if EDGE_AGGREGATION
+#define MESSAGE_BUFFER_SIZE 768
+#else
+#define MESSAGE_BUFFER_SIZE 512
+#endif
+
+// Closing `],"batchHash":"<base64>"}` of a JSON batch (see finishBatch)
+#define BATCH_TRAILER_SIZE 62
+
+// "YYYY-MM-DDTHH:MM:SSZ" plus terminator
+#define ISO8601_SIZE 21
+
+// compressData() match index: hash buckets (2^bits) and the most earlier
+// positions compared per input position
+#define COMPRESS_INDEX_BITS 8
+#define COMPRESS_MAX_CANDIDATES 64
+
+// MessagePack message schema (see createBinaryMessage); 2 added the
+// soil probe array, 3 the aggregate summary
+#define WIRE_SCHEMA_VERSION 3
+
+class MessageWriter;
+class PackWriter;
 
 class DataProcessor {
 public:
   DataProcessor();
   
-  // Create JSON payload from sensor readings
-  String createPayload(const SensorReadings& readings, 
-                       const String& farmId, 
-                       const String& deviceId);
+  // Create JSON payload from sensor readings.
+  // Returns the payload length, or 0 if it does not fit.
+  size_t createPayload(const SensorReadings& readings,
+                       const char* farmId,
+                       const char* deviceId,
+                       char* output,
+                       size_t capacity);
+  
+  // Compute hex-encoded SHA-256 hash of data into hashHex (HASH_HEX_SIZE
+  // bytes). Uses the message context, so call it from the message task.
+  void computeSHA256Hash(const uint8_t* data, size_t length, char* hashHex);
+  
+  // Compress data before transmission (heatshrink LZSS stream).
+  // outputSize holds the output capacity on entry and the compressed
+  // size on return; fails if the output does not fit.
+  bool compressData(const uint8_t* input, size_t inputSize,
+                    uint8_t* output, size_t* outputSize);
+  
+  // Create complete message with hash in a single pass, hashing the
+  // canonical payload as it is written. The hash is sent base64-encoded.
+  // An edge aggregation window (summary with samples > 0) adds its spread
+  // after readings, as in a batch record (see createBatchRecord).
+  // Returns the message length, or 0 if it does not fit.
+  size_t createMessage(const SensorReadings& readings,
+                       const char* farmId,
+                       const char* deviceId,
+                       char* output,
+                       size_t capacity,
+                       const ReadingSummary* summary = nullptr);
+  
+  // Create a MessagePack message:
+  //   [schema, timestamp, soilMoisture, soilTemperature, airTemperature,
+  //    humidity, [soil probes 2..N], [summary], hash]
+  // Readings are signed integers in hundredths and the timestamp is Unix
+  // seconds; the probe array is empty with a single soil probe, and the
+  // summary (see createBinaryBatchRecord) is empty unless the reading
+  // aggregates a window. farmId and
+  // deviceId are carried by the topic, but the hash (32-byte bin) covers
+  // the canonical form
+  //   [schema, farmId, deviceId, timestamp, readings...]
+  // so the IDs stay bound to the data.
+  // Returns the message length, or 0 if it does not fit.
+  size_t createBinaryMessage(const SensorReadings& readings,
+                             const char* farmId,
+                             const char* deviceId,
+                             uint8_t* output,
+                             size_t capacity,
+                             const ReadingSummary* summary = nullptr);
+  
+  // Delta-encoded batches are signed once rather than per record: one
+  // SHA-256 runs over the canonical form of every record in order (the
+  // same bytes createMessage() or createBinaryMessage() would hash), so
+  // changing, dropping or reordering any record breaks the batch hash.
+  // A batch is built with a header, its records and a finish call; only
+  // one batch can be open at a time.
+  
+  // Open a delta-encoded JSON batch:
+  //   {"farmId":..,"deviceId":..,"baseTimestamp":<unix seconds>,"batch":[
+  // The caller appends records separated by commas, then finishBatch().
+  size_t createBatchHeader(const char* farmId,
+                           const char* deviceId,
+                           uint32_t baseTimestamp,
+                           char* output,
+                           size_t capacity);
+  
+  // Open a delta-encoded MessagePack batch:
+  //   [schema, baseTimestamp, records, batchHash]
+  // The caller appends an array16 of records, then finishBinaryBatch().
+  size_t createBinaryBatchHeader(uint32_t baseTimestamp,
+                                 uint8_t* output,
+                                 size_t capacity);
+  
+  // Create one record of a delta-encoded JSON batch:
+  //   {"dt":<seconds since previousTimestamp>,"readings":{...}}
+  // The batch header carries farmId, deviceId and baseTimestamp; each
+  // record's time is the previous one plus dt. An offline aggregate (summary
+  // with samples > 0) adds its spread after the means in readings:
+  //   ,"summary":{"span":<seconds>,"samples":<n>,"min":{...},"max":{...}}
+  // The record is added to the batch hash only if it fits.
+  // Returns the record length, or 0 if it does not fit.
+  size_t createBatchRecord(const SensorReadings& readings,
+                           const char* farmId,
+                           const char* deviceId,
+                           uint32_t previousTimestamp,
+                           char* output,
+                           size_t capacity,
+                           const ReadingSummary* summary = nullptr);
+  
+  // MessagePack equivalent:
+  //   [dt, soilMoisture, soilTemperature, airTemperature, humidity,
+  //    [soil probes 2..N], [summary]]
+  // where the summary is [span, samples, [min x4], [max x4]] in hundredths,
+  // or empty for a single reading
+  size_t createBinaryBatchRecord(const SensorReadings& readings,
+                                 const char* farmId,
+                                 const char* deviceId,
+                                 uint32_t previousTimestamp,
+                                 uint8_t* output,
+                                 size_t capacity,
+                                 const ReadingSummary* summary = nullptr);
+  
+  // Close a JSON batch with `],"batchHash":"<base64>"}` (BATCH_TRAILER_SIZE
+  // bytes including the terminator). Returns the length written, or 0.
+  size_t finishBatch(char* output, size_t capacity);
+  
+  // Close a MessagePack batch with the 32-byte bin batch hash
+  size_t finishBinaryBatch(uint8_t* output, size_t capacity);
+  
+  // Format Unix seconds as ISO8601 UTC (ISO8601_SIZE bytes)
+  static void formatISO8601(uint32_t timestamp, char* buffer);
+  
+private:  
+  // Format float with 2 decimal places (buffer of at least 10 bytes)
+  void formatFloat(float value, char* buffer, size_t size);
+  
+  // Hash of the message being built (processing task) and running hash
+  // of the open batch (network task), each reused from one call to the next
+  Sha256Hasher messageHash;
+  Sha256Hasher batchHash;
   
-  // Compute SHA-256 hash of payload
-  String computeSHA256Hash(const String& payload);
+  // Match index of compressData() (network task): newest position per
+  // hash bucket, and each window position's link to the one before it
+  uint16_t matchHead[1 << COMPRESS_INDEX_BITS];
+  uint16_t matchPrev[1 << HEATSHRINK_WINDOW_BITS];
   
-  // Compress data before transmission (gzip)
-  bool compressData(const String& input, uint8_t* output, size_t* outputSize);
+  // Write the canonical payload (without hash) through the writer
+  void writePayload(MessageWriter& writer,
+                    const SensorReadings& readings,
+                    const char* farmId,
+                    const char* deviceId);
   
-  // Create complete message with hash
-  String createMessage(const SensorReadings& readings,
-                       const String& farmId,
-                       const String& deviceId);
+  // Canonical payload, part 1: {"farmId":..,"deviceId":..,"timestamp":..
+  void writeHeader(MessageWriter& writer,
+                   const SensorReadings& readings,
+                   const char* farmId,
+                   const char* deviceId);
   
-private:
-  // Format timestamp as ISO8601
-  String formatISO8601(unsigned long timestamp);
+  // Canonical payload, part 2: ,"readings":{...}
+  void writeReadings(MessageWriter& writer, const SensorReadings& readings);
   
-  // Format float with 2 decimal places
-  String formatFloat(float value);
+  // Canonical payload of an aggregate, part 3: ,"summary":{...}
+  void writeSummary(MessageWriter& writer, const ReadingSummary& summary);
 };
 
 #endif // DATA_PROCESSOR_H
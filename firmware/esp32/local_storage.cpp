@@ -2,68 +2,373 @@
 
 #include "local_storage.h"
 #include "config.h"
+#include <LittleFS.h>
 #include <SPIFFS.h>
+#include <ArduinoJson.h>
+#include "metrics.h"
 
-LocalStorage::LocalStorage() {
-  maxReadings = MAX_OFFLINE_READINGS;
+// Identifies a valid tail file ("CRS1", segmented storage)
+#define TAIL_MAGIC 0x31535243
+
+// Identifies the SPIFFS journal metadata ("CRJ2", binary record slots)
+#define SPIFFS_JOURNAL_MAGIC 0x324A5243
+
+// Bytes in a full segment file
+#define SEGMENT_BYTES (OFFLINE_SEGMENT_RECORDS * sizeof(OfflineRecord))
+
+// Smallest RAM buffer worth staging a SPIFFS migration in
+#define MIGRATION_MIN_RECORDS 32
+
+// Largest backlog the SPIFFS journal held (its MAX_OFFLINE_READINGS)
+#define MIGRATION_MAX_RECORDS 1000
+
+// Bytes a file occupies on the partition
+static size_t blockFootprint(size_t bytes) {
+  return (bytes + OFFLINE_FS_BLOCK_BYTES - 1) / OFFLINE_FS_BLOCK_BYTES * OFFLINE_FS_BLOCK_BYTES;
+}
+
+// Convert an ISO8601 UTC timestamp back to Unix epoch seconds
+static unsigned long parseISO8601(const char* text) {
+  int year, month, day, hour, minute, second;
+  if (sscanf(text, "%d-%d-%dT%d:%d:%dZ",
+             &year, &month, &day, &hour, &minute, &second) != 6) {
+    return 0;
+  }
+  
+  // Days since 1970-01-01 (civil calendar, March-based year)
+  year -= month <= 2;
+  long era = year / 400;
+  long yearOfEra = year - era * 400;
+  long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  long days = era * 146097 + dayOfEra - 719468;
+  
+  return (unsigned long)(days * 86400L + hour * 3600L + minute * 60L + second);
+}
+
+// Add a record to the migration buffer, overwriting the oldest when full
+static void stageRecord(OfflineRecord* staged, int capacity, int& total,
+                        const OfflineRecord& record) {
+  staged[total % capacity] = record;
+  total++;
+}
+
+LocalStorage::LocalStorage(int capacity)
+  : hourly("/offline/hourly", 3600, OFFLINE_HOURLY_SEGMENTS),
+    daily("/offline/daily", 86400, OFFLINE_DAILY_SEGMENTS) {
+  maxReadings = capacity;
+  partitionSized = capacity <= 0;
+  firstSegment = 0;
+  headSegment = 0;
+  headRecords = 0;
+  tailRecord = 0;
+  count = 0;
+  bytesWritten = 0;
+  compactions = 0;
+  readCompactions = 0;
 }
 
 bool LocalStorage::begin() {
-  Serial.println("Initializing SPIFFS...");
+  StageTimer timer(STAGE_STORAGE_MOUNT);
   
-  if (!SPIFFS.begin(true)) {
-    Serial.println("Error: Failed to mount SPIFFS");
+  Serial.println("Mounting LittleFS...");
+  
+  // Never format on a failed mount: the partition may still hold SPIFFS data
+  if (!LittleFS.begin(false) && !migrateFromSpiffs()) {
+    Serial.println("Error: Failed to mount LittleFS");
     return false;
   }
   
-  Serial.println("SPIFFS initialized");
+  Serial.println("LittleFS mounted");
   
   // Print storage info
-  size_t totalBytes = SPIFFS.totalBytes();
-  size_t usedBytes = SPIFFS.usedBytes();
-  Serial.printf("SPIFFS: %d/%d bytes used\n", usedBytes, totalBytes);
+  size_t totalBytes = LittleFS.totalBytes();
+  size_t usedBytes = LittleFS.usedBytes();
+  Serial.printf("LittleFS: %u/%u bytes used\n", (unsigned)usedBytes, (unsigned)totalBytes);
+  
+  if (!LittleFS.exists(SEGMENT_DIR) && !LittleFS.mkdir(SEGMENT_DIR)) {
+    Serial.println("Error: Failed to create segment directory");
+    return false;
+  }
+  
+  if (!scanSegments()) {
+    return false;
+  }
+  
+  // Records grew with per-probe soil temperatures; older segments are
+  // rewritten once so every slot has the same size
+  int upgraded = upgradeSegments();
+  if (upgraded < 0) {
+    Serial.println("Error: Failed to upgrade offline segments, their readings will be dropped");
+  }
+  if (upgraded != 0 && !scanSegments()) {
+    return false;
+  }
+  
+  if (!hourly.begin() || !daily.begin()) {
+    return false;
+  }
+  
+  if (partitionSized) {
+    sizeFromPartition();
+  }
+  
+  Serial.printf("Offline storage: %d/%d readings stored in %d segment(s)\n",
+                count, maxReadings, headRecords > 0 ? headSegment - firstSegment + 1 : 0);
+  if (hourly.getCount() > 0 || daily.getCount() > 0) {
+    Serial.printf("Offline storage: %d hourly and %d daily aggregates\n",
+                  hourly.getCount(), daily.getCount());
+  }
   
   return true;
 }
 
-bool LocalStorage::storeReading(const String& message) {
-  if (isFull()) {
+bool LocalStorage::storeReading(const SensorReadings& readings) {
+  StageTimer timer(STAGE_STORAGE_WRITE);
+  
+  if (count >= (uint32_t)maxReadings && !compactOldest()) {
     Serial.println("Warning: Offline storage is full");
     return false;
   }
   
-  // Read existing readings
-  std::vector<String> readings = readLines();
+  // Pack readings into a fixed-width record
+  OfflineRecord record;
+  packRecord(readings, record);
   
-  // Add new reading
-  readings.push_back(message);
+  if (!appendRecord(record)) {
+    Serial.println("Error: Failed to store reading");
+    return false;
+  }
   
-  // Write back to file
-  bool success = writeLines(readings);
+  Serial.printf("Stored reading offline (%d/%d)\n", 
+                count, maxReadings);
   
-  if (success) {
-    Serial.printf("Stored reading offline (%d/%d)\n", 
-                  readings.size(), maxReadings);
-  } else {
-    Serial.println("Error: Failed to store reading");
+  return true;
+}
+
+int LocalStorage::storeReadings(const SensorReadings* readings, int storeCount) {
+  StageTimer timer(STAGE_STORAGE_WRITE);
+  
+  int stored = 0;
+  bool full = false;
+  while (stored < storeCount) {
+    if (count >= (uint32_t)maxReadings && !compactOldest()) {
+      full = true;
+      break;
+    }
+    
+    OfflineRecord record;
+    packRecord(readings[stored], record);
+    
+    if (!appendRecord(record, false)) {
+      Serial.println("Error: Failed to store reading");
+      break;
+    }
+    stored++;
   }
   
-  return success;
+  if (headFile) {
+    headFile.flush();
+  }
+  
+  if (full) {
+    Serial.println("Warning: Offline storage is full");
+  }
+  
+  Serial.printf("Stored %d readings offline (%d/%d)\n",
+                stored, count, maxReadings);
+  
+  return stored;
 }
 
 int LocalStorage::getStoredCount() {
-  std::vector<String> readings = readLines();
-  return readings.size();
+  return count + hourly.getCount() + daily.getCount();
+}
+
+int LocalStorage::getRawCount() {
+  return count;
+}
+
+int LocalStorage::getHourlyCount() {
+  return hourly.getCount();
+}
+
+int LocalStorage::getDailyCount() {
+  return daily.getCount();
+}
+
+int LocalStorage::getCapacity() {
+  return maxReadings;
+}
+
+size_t LocalStorage::getStoredBytes() {
+  return count * sizeof(OfflineRecord) +
+         (hourly.getCount() + daily.getCount()) * sizeof(AggregateRecord);
+}
+
+size_t LocalStorage::getHeadOffset() {
+  return headSegment * SEGMENT_BYTES + headRecords * sizeof(OfflineRecord);
+}
+
+size_t LocalStorage::getTailOffset() {
+  return firstSegment * SEGMENT_BYTES + tailRecord * sizeof(OfflineRecord);
+}
+
+int LocalStorage::readOldest(SensorReadings* readings, int maxCount, ReadingSummary* summaries) {
+  StageTimer timer(STAGE_STORAGE_READ);
+  
+  readCompactions = compactions;
+  
+  // Oldest first; a tier that is not read to the end hides the later ones
+  // so removeOldest() takes records in the same order
+  int read = daily.readOldest(readings, summaries, maxCount);
+  if (read < daily.getCount()) {
+    return read;
+  }
+  
+  int hourlyRead = hourly.readOldest(readings + read, summaries != nullptr ? summaries + read : nullptr,
+                                     maxCount - read);
+  read += hourlyRead;
+  if (hourlyRead < hourly.getCount()) {
+    return read;
+  }
+  
+  int rawRead = readRaw(readings + read, maxCount - read);
+  if (summaries != nullptr) {
+    for (int i = read; i < read + rawRead; i++) {
+      summaries[i].samples = 0;
+    }
+  }
+  
+  return read + rawRead;
 }
 
-std::vector<String> LocalStorage::getAllReadings() {
-  return readLines();
+int LocalStorage::readRaw(SensorReadings* readings, int maxCount) {
+  int wanted = min((int)count, maxCount);
+  int read = 0;
+  uint32_t segment = firstSegment;
+  uint32_t slot = tailRecord;
+  
+  while (read < wanted) {
+    char path[24];
+    segmentPath(segment, path, sizeof(path));
+    
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+      Serial.println("Error: Failed to open segment for reading");
+      break;
+    }
+    
+    if (!file.seek(slot * sizeof(OfflineRecord), SeekSet)) {
+      file.close();
+      break;
+    }
+    
+    for (; read < wanted && slot < OFFLINE_SEGMENT_RECORDS; read++, slot++) {
+      OfflineRecord record;
+      SensorReadings& out = readings[read];
+      
+      if (file.read((uint8_t*)&record, sizeof(record)) != sizeof(record)) {
+        file.close();
+        return read;
+      }
+      
+      if (!validRecord(record)) {
+        Serial.println("Error: Corrupt segment slot");
+        out.valid = false;
+        out.soilProbeCount = 0;
+      } else {
+        unpackRecord(record, out);
+      }
+    }
+    
+    file.close();
+    segment++;
+    slot = 0;
+  }
+  
+  return read;
+}
+
+bool LocalStorage::removeOldest(int removeCount) {
+  StageTimer timer(STAGE_STORAGE_REMOVE);
+  
+  if (removeCount <= 0) {
+    return true;
+  }
+  
+  // Compaction has merged or moved what was read
+  if (compactions != readCompactions) {
+    Serial.println("Offline backlog was compacted during sync, sending it again");
+    return true;
+  }
+  
+  int fromDaily = min(removeCount, daily.getCount());
+  int fromHourly = min(removeCount - fromDaily, hourly.getCount());
+  bool success = daily.removeOldest(fromDaily) && hourly.removeOldest(fromHourly);
+  removeCount -= fromDaily + fromHourly;
+  if (removeCount <= 0) {
+    return success;
+  }
+  
+  if ((uint32_t)removeCount > count) {
+    removeCount = count;
+  }
+  
+  tailRecord += removeCount;
+  count -= removeCount;
+  
+  // Delete segments once every reading in them has been synced
+  char path[24];
+  while (firstSegment < headSegment && tailRecord >= OFFLINE_SEGMENT_RECORDS) {
+    segmentPath(firstSegment, path, sizeof(path));
+    if (!LittleFS.remove(path)) {
+      Serial.println("Warning: Failed to delete synced segment");
+    }
+    firstSegment++;
+    tailRecord -= OFFLINE_SEGMENT_RECORDS;
+  }
+  
+  // A drained head segment goes too; the next reading starts a new one
+  if (count == 0 && headRecords > 0) {
+    headFile.close();
+    segmentPath(headSegment, path, sizeof(path));
+    if (!LittleFS.remove(path)) {
+      Serial.println("Warning: Failed to delete synced segment");
+    }
+    headSegment++;
+    firstSegment = headSegment;
+    headRecords = 0;
+    tailRecord = 0;
+  }
+  
+  return saveTail() && success;
 }
 
 bool LocalStorage::clearReadings() {
   Serial.println("Clearing offline storage...");
   
-  if (SPIFFS.remove(STORAGE_FILE)) {
+  headFile.close();
+  
+  bool success = true;
+  for (uint32_t segment = firstSegment; segment <= headSegment; segment++) {
+    char path[24];
+    segmentPath(segment, path, sizeof(path));
+    if (LittleFS.exists(path) && !LittleFS.remove(path)) {
+      success = false;
+    }
+  }
+  
+  headSegment++;
+  firstSegment = headSegment;
+  headRecords = 0;
+  tailRecord = 0;
+  count = 0;
+  
+  success = hourly.clear() && success;
+  success = daily.clear() && success;
+  
+  if (saveTail() && success) {
     Serial.println("Offline storage cleared");
     return true;
   } else {
@@ -73,45 +378,527 @@ bool LocalStorage::clearReadings() {
 }
 
 bool LocalStorage::isFull() {
-  return getStoredCount() >= maxReadings;
+  return count >= (uint32_t)maxReadings && firstSegment >= headSegment;
 }
 
-std::vector<String> LocalStorage::readLines() {
-  std::vector<String> lines;
+uint32_t LocalStorage::getBytesWritten() {
+  return bytesWritten;
+}
+
+bool LocalStorage::scanSegments() {
+  headFile.close();
   
-  if (!SPIFFS.exists(STORAGE_FILE)) {
-    return lines; // Empty vector
+  File dir = LittleFS.open(SEGMENT_DIR);
+  if (!dir || !dir.isDirectory()) {
+    Serial.println("Error: Failed to open segment directory");
+    return false;
   }
   
-  File file = SPIFFS.open(STORAGE_FILE, "r");
-  if (!file) {
-    Serial.println("Error: Failed to open storage file for reading");
-    return lines;
+  // Segment files are named by number; only the oldest and newest matter
+  bool found = false;
+  uint32_t lowest = 0;
+  uint32_t highest = 0;
+  size_t highestSize = 0;
+  
+  File entry = dir.openNextFile();
+  while (entry) {
+    // Older cores return the full path from name()
+    const char* name = strrchr(entry.name(), '/');
+    name = name ? name + 1 : entry.name();
+    
+    char* end;
+    uint32_t segment = strtoul(name, &end, 16);
+    if (end == name + 8 && strcmp(end, ".seg") == 0) {
+      if (!found || segment < lowest) {
+        lowest = segment;
+      }
+      if (!found || segment > highest) {
+        highest = segment;
+        highestSize = entry.size();
+      }
+      found = true;
+    }
+    
+    entry.close();
+    entry = dir.openNextFile();
   }
+  dir.close();
   
-  while (file.available()) {
-    String line = file.readStringUntil('\n');
-    line.trim();
-    if (line.length() > 0) {
-      lines.push_back(line);
+  TailMeta tail = {TAIL_MAGIC, lowest, 0};
+  File file = LittleFS.open(TAIL_FILE, "r");
+  if (file) {
+    TailMeta stored;
+    if (file.read((uint8_t*)&stored, sizeof(stored)) == sizeof(stored) &&
+        stored.magic == TAIL_MAGIC) {
+      tail = stored;
+    } else {
+      Serial.println("Warning: Invalid tail file, resending oldest segment");
     }
+    file.close();
   }
   
-  file.close();
-  return lines;
+  // Segments before the tail were synced; a reset interrupted their deletion
+  char path[24];
+  while (found && lowest < tail.segment) {
+    segmentPath(lowest, path, sizeof(path));
+    LittleFS.remove(path);
+    found = lowest < highest;
+    lowest++;
+  }
+  
+  if (!found) {
+    // Nothing stored: the next reading starts segment tail.segment
+    firstSegment = tail.segment;
+    headSegment = tail.segment;
+    headRecords = 0;
+    tailRecord = 0;
+    count = 0;
+    return true;
+  }
+  
+  // Middle segments are always full; a torn record at the end of the head
+  // segment is ignored and overwritten by the next append
+  firstSegment = lowest;
+  headSegment = highest;
+  headRecords = min(highestSize / sizeof(OfflineRecord), (size_t)OFFLINE_SEGMENT_RECORDS);
+  tailRecord = tail.segment == firstSegment ? tail.record : 0;
+  tailRecord = min(tailRecord, firstSegment == headSegment ? headRecords : (uint32_t)OFFLINE_SEGMENT_RECORDS);
+  count = (headSegment - firstSegment) * OFFLINE_SEGMENT_RECORDS + headRecords - tailRecord;
+  
+  return true;
+}
+
+int LocalStorage::upgradeSegments() {
+  if (LittleFS.exists(UPGRADE_FILE)) {
+    LittleFS.remove(UPGRADE_FILE);
+  }
+  
+  int upgraded = 0;
+  for (uint32_t segment = firstSegment; segment <= headSegment; segment++) {
+    char path[24];
+    segmentPath(segment, path, sizeof(path));
+    
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+      continue;
+    }
+    
+    // Segments are written by one firmware version, so the first slot tells
+    uint8_t version = 0;
+    if (file.read(&version, 1) != 1 || version != 1 || !file.seek(0, SeekSet)) {
+      file.close();
+      continue;
+    }
+    
+    File output = LittleFS.open(UPGRADE_FILE, "w");
+    if (!output) {
+      file.close();
+      return -1;
+    }
+    
+    // Streamed one record at a time; a torn last record is dropped
+    OfflineRecordV1 old;
+    OfflineRecord record;
+    bool success = true;
+    while (success && file.read((uint8_t*)&old, sizeof(old)) == sizeof(old)) {
+      upgradeRecord(old, record);
+      success = output.write((const uint8_t*)&record, sizeof(record)) == sizeof(record);
+      bytesWritten += sizeof(record);
+    }
+    file.close();
+    output.close();
+    
+    // LittleFS replaces the old segment atomically
+    if (!success || !LittleFS.rename(UPGRADE_FILE, path)) {
+      LittleFS.remove(UPGRADE_FILE);
+      return -1;
+    }
+    upgraded++;
+  }
+  
+  if (upgraded > 0) {
+    Serial.printf("Upgraded %d offline segment(s) to record version %d\n",
+                  upgraded, OFFLINE_RECORD_VERSION);
+  }
+  
+  return upgraded;
 }
 
-bool LocalStorage::writeLines(const std::vector<String>& lines) {
-  File file = SPIFFS.open(STORAGE_FILE, "w");
+bool LocalStorage::saveTail() {
+  File file = LittleFS.open(TAIL_FILE, "w");
   if (!file) {
-    Serial.println("Error: Failed to open storage file for writing");
+    Serial.println("Error: Failed to open tail file for writing");
     return false;
   }
   
-  for (const String& line : lines) {
-    file.println(line);
+  TailMeta tail = {TAIL_MAGIC, firstSegment, tailRecord};
+  bool success = file.write((const uint8_t*)&tail, sizeof(tail)) == sizeof(tail);
+  file.close();
+  bytesWritten += sizeof(tail);
+  
+  return success;
+}
+
+void LocalStorage::sizeFromPartition() {
+  size_t rawFootprint = blockFootprint(SEGMENT_BYTES);
+  size_t aggregateFootprint = blockFootprint(AggregateLog::segmentBytes());
+  
+  // Space the backlog already occupies is available to it
+  int rawSegments = headRecords > 0 ? headSegment - firstSegment + 1 : 0;
+  size_t occupied = rawSegments * rawFootprint +
+                    (hourly.getSegmentCount() + daily.getSegmentCount()) * aggregateFootprint;
+  size_t used = LittleFS.usedBytes();
+  size_t others = used > occupied ? used - occupied : 0;
+  
+  // The aggregate tiers are set aside at their full size
+  size_t reserved = OFFLINE_STORAGE_RESERVE_BYTES + others +
+                    (OFFLINE_HOURLY_SEGMENTS + OFFLINE_DAILY_SEGMENTS) * aggregateFootprint;
+  size_t total = LittleFS.totalBytes();
+  size_t segments = total > reserved ? (total - reserved) / rawFootprint : 0;
+  
+  maxReadings = max(segments, (size_t)1) * OFFLINE_SEGMENT_RECORDS;
+  Serial.printf("Offline storage sized to %d readings (%d segments of %d bytes)\n",
+                maxReadings, maxReadings / OFFLINE_SEGMENT_RECORDS, (int)rawFootprint);
+}
+
+bool LocalStorage::compactOldest() {
+  // Whole segments only, and never the one being appended to
+  if (firstSegment >= headSegment) {
+    return false;
+  }
+  
+  compactions++;
+  
+  // Worst case, every reading of the segment is in an hour of its own
+  if (hourly.getFreeSlots() < OFFLINE_SEGMENT_RECORDS) {
+    if (daily.getFreeSlots() < OFFLINE_SEGMENT_RECORDS) {
+      int dropped = daily.dropOldestSegment();
+      Serial.printf("Warning: Daily aggregates full, dropped the oldest %d\n", dropped);
+    }
+    
+    int merged = hourly.compactInto(daily);
+    if (merged < 0) {
+      Serial.println("Error: Failed to compact hourly aggregates");
+      return false;
+    }
+    Serial.printf("Compacted %d hourly aggregates into daily ones\n", merged);
+  }
+  
+  return compactRawSegment();
+}
+
+bool LocalStorage::compactRawSegment() {
+  char path[24];
+  segmentPath(firstSegment, path, sizeof(path));
+  
+  File file = LittleFS.open(path, "r");
+  if (!file || !file.seek(tailRecord * sizeof(OfflineRecord), SeekSet)) {
+    Serial.println("Error: Failed to open segment for compaction");
+    return false;
   }
   
+  // Streamed one record at a time; invalid and corrupt slots are left out
+  int merged = 0;
+  bool success = true;
+  for (uint32_t slot = tailRecord; success && slot < OFFLINE_SEGMENT_RECORDS; slot++) {
+    OfflineRecord record;
+    if (file.read((uint8_t*)&record, sizeof(record)) != sizeof(record)) {
+      break;
+    }
+    
+    SensorReadings readings;
+    AggregateRecord sample;
+    if (!validRecord(record)) {
+      continue;
+    }
+    unpackRecord(record, readings);
+    if (AggregateLog::packReadings(readings, sample)) {
+      success = hourly.add(sample);
+      merged++;
+    }
+  }
   file.close();
+  
+  // The aggregates reach flash before the segment goes; a reset in between
+  // leaves both, and that span is synced twice
+  if (!hourly.finish() || !success) {
+    Serial.println("Error: Failed to write hourly aggregates");
+    return false;
+  }
+  
+  if (!LittleFS.remove(path)) {
+    Serial.println("Warning: Failed to delete compacted segment");
+  }
+  count -= OFFLINE_SEGMENT_RECORDS - tailRecord;
+  firstSegment++;
+  tailRecord = 0;
+  
+  Serial.printf("Compacted %d offline readings into hourly aggregates\n", merged);
+  
+  return saveTail();
+}
+
+bool LocalStorage::appendRecord(const OfflineRecord& record, bool flush) {
+  // Start the next segment once the head is full
+  if (headRecords >= OFFLINE_SEGMENT_RECORDS) {
+    headFile.close();
+    headSegment++;
+    headRecords = 0;
+  }
+  
+  if (!headFile) {
+    char path[24];
+    segmentPath(headSegment, path, sizeof(path));
+    
+    // A partly written segment (after a reboot) is reopened for update
+    headFile = LittleFS.open(path, headRecords > 0 ? "r+" : "w");
+    if (!headFile) {
+      Serial.println("Error: Failed to open segment for writing");
+      return false;
+    }
+  }
+  
+  // Seek rather than append so a torn record is overwritten in place
+  bool success = headFile.seek(headRecords * sizeof(OfflineRecord), SeekSet) &&
+                 headFile.write((const uint8_t*)&record, sizeof(record)) == sizeof(record);
+  bytesWritten += sizeof(record);
+  if (flush) {
+    headFile.flush();
+  }
+  
+  if (!success) {
+    headFile.close();
+    return false;
+  }
+  
+  headRecords++;
+  count++;
   return true;
 }
+
+void LocalStorage::segmentPath(uint32_t segment, char* path, size_t size) {
+  snprintf(path, size, "%s/%08lx.seg", SEGMENT_DIR, (unsigned long)segment);
+}
+
+bool LocalStorage::migrateFromSpiffs() {
+  OfflineRecord* staged = nullptr;
+  int capacity = maxReadings > 0 ? maxReadings : MIGRATION_MAX_RECORDS;
+  int total = 0;
+  bool fromSpiffs = SPIFFS.begin(false);
+  
+  if (fromSpiffs) {
+    Serial.println("Migrating offline storage from SPIFFS...");
+    
+    // Both filesystems live on the same partition, so the backlog is held
+    // in RAM while it is reformatted (newest readings win if RAM is short)
+    while (!staged && capacity >= MIGRATION_MIN_RECORDS) {
+      staged = (OfflineRecord*)malloc(capacity * sizeof(OfflineRecord));
+      if (!staged) {
+        capacity /= 2;
+      }
+    }
+    
+    if (!staged) {
+      Serial.println("Error: Not enough memory to migrate SPIFFS storage");
+      SPIFFS.end();
+      return false;
+    }
+    
+    // The line-based file predates the journal, so it holds older readings
+    stageLegacyStorage(staged, capacity, total);
+    stageSpiffsJournal(staged, capacity, total);
+    SPIFFS.end();
+  } else {
+    Serial.println("Warning: No filesystem found, formatting LittleFS");
+  }
+  
+  bool success = LittleFS.format() && LittleFS.begin(false) && LittleFS.mkdir(SEGMENT_DIR);
+  
+  // Replay the staged readings oldest first
+  int migrated = min(total, capacity);
+  int first = total > capacity ? total % capacity : 0;
+  for (int i = 0; success && i < migrated; i++) {
+    success = appendRecord(staged[(first + i) % capacity]);
+  }
+  headFile.close();
+  free(staged);
+  
+  if (total > migrated) {
+    Serial.printf("Warning: Dropped %d oldest readings during migration\n", total - migrated);
+  }
+  if (fromSpiffs) {
+    Serial.printf("Migrated %d readings from SPIFFS\n", migrated);
+  }
+  
+  return success;
+}
+
+void LocalStorage::stageSpiffsJournal(OfflineRecord* staged, int capacity, int& total) {
+  File file = SPIFFS.open(SPIFFS_JOURNAL_FILE, "r");
+  if (!file) {
+    return;
+  }
+  
+  uint32_t slots = file.size() / sizeof(OfflineRecordV1);
+  if (slots == 0) {
+    file.close();
+    return;
+  }
+  
+  // Ring pointers as written by the SPIFFS journal
+  struct {
+    uint32_t magic;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t count;
+  } meta = {0, 0, 0, 0};
+  
+  File metaFile = SPIFFS.open(SPIFFS_META_FILE, "r");
+  bool metaValid = metaFile &&
+                   metaFile.read((uint8_t*)&meta, sizeof(meta)) == sizeof(meta) &&
+                   meta.magic == SPIFFS_JOURNAL_MAGIC &&
+                   meta.tail < slots && meta.count <= slots;
+  if (metaFile) {
+    metaFile.close();
+  }
+  
+  OfflineRecordV1 record;
+  OfflineRecord upgraded;
+  uint32_t start = meta.tail;
+  uint32_t length = meta.count;
+  
+  if (!metaValid) {
+    // Without pointers, walk the whole ring starting after the newest record
+    uint32_t newest = 0;
+    uint32_t newestTimestamp = 0;
+    for (uint32_t slot = 0; slot < slots; slot++) {
+      if (file.seek(slot * sizeof(record), SeekSet) &&
+          file.read((uint8_t*)&record, sizeof(record)) == sizeof(record) &&
+          validRecord(record) && record.timestamp >= newestTimestamp) {
+        newest = slot;
+        newestTimestamp = record.timestamp;
+      }
+    }
+    start = (newest + 1) % slots;
+    length = slots;
+  }
+  
+  for (uint32_t i = 0; i < length; i++) {
+    uint32_t slot = (start + i) % slots;
+    if (file.seek(slot * sizeof(record), SeekSet) &&
+        file.read((uint8_t*)&record, sizeof(record)) == sizeof(record) &&
+        validRecord(record)) {
+      upgradeRecord(record, upgraded);
+      stageRecord(staged, capacity, total, upgraded);
+    }
+  }
+  file.close();
+}
+
+void LocalStorage::stageLegacyStorage(OfflineRecord* staged, int capacity, int& total) {
+  File file = SPIFFS.open(LEGACY_STORAGE_FILE, "r");
+  if (!file) {
+    return;
+  }
+  
+  // Legacy lines are complete JSON messages; keep only the readings
+  StaticJsonDocument<512> doc;
+  while (file.available()) {
+    String line = file.readStringUntil('\n');
+    line.trim();
+    if (line.length() == 0 || deserializeJson(doc, line)) {
+      continue;
+    }
+    
+    SensorReadings readings;
+    readings.soilMoisture = String(doc["readings"]["soilMoisture"].as<const char*>()).toFloat();
+    readings.soilTemperature = String(doc["readings"]["soilTemperature"].as<const char*>()).toFloat();
+    readings.airTemperature = String(doc["readings"]["airTemperature"].as<const char*>()).toFloat();
+    readings.humidity = String(doc["readings"]["humidity"].as<const char*>()).toFloat();
+    readings.timestamp = parseISO8601(doc["timestamp"] | "");
+    readings.valid = true;
+    readings.soilProbeCount = 1;
+    readings.soilTemperatures[0] = readings.soilTemperature;
+    
+    OfflineRecord record;
+    packRecord(readings, record);
+    stageRecord(staged, capacity, total, record);
+  }
+  file.close();
+}
+
+void LocalStorage::packRecord(const SensorReadings& readings, OfflineRecord& record) {
+  record.version = OFFLINE_RECORD_VERSION;
+  record.flags = readings.valid ? OFFLINE_RECORD_VALID : 0;
+  record.soilProbeCount = min(readings.soilProbeCount, (uint8_t)OFFLINE_RECORD_PROBES);
+  record.reserved = 0;
+  record.timestamp = (uint32_t)readings.timestamp;
+  record.soilMoisture = readings.soilMoisture;
+  record.soilTemperature = readings.soilTemperature;
+  record.airTemperature = readings.airTemperature;
+  record.humidity = readings.humidity;
+  
+  // Later probes in hundredths, as on the wire
+  for (int i = 1; i < OFFLINE_RECORD_PROBES; i++) {
+    long value = i < record.soilProbeCount ? lroundf(readings.soilTemperatures[i] * 100) : 0;
+    record.soilProbeTemperatures[i - 1] = (int16_t)constrain(value, INT16_MIN, INT16_MAX);
+  }
+  record.reserved2 = 0;
+  record.crc = crc32((const uint8_t*)&record, offsetof(OfflineRecord, crc));
+}
+
+void LocalStorage::unpackRecord(const OfflineRecord& record, SensorReadings& readings) {
+  readings.soilMoisture = record.soilMoisture;
+  readings.soilTemperature = record.soilTemperature;
+  readings.airTemperature = record.airTemperature;
+  readings.humidity = record.humidity;
+  readings.timestamp = record.timestamp;
+  readings.valid = (record.flags & OFFLINE_RECORD_VALID) != 0;
+  
+  readings.soilProbeCount = min(record.soilProbeCount, (uint8_t)DS18B20_MAX_PROBES);
+  readings.soilTemperatures[0] = record.soilTemperature;
+  for (int i = 1; i < readings.soilProbeCount; i++) {
+    readings.soilTemperatures[i] = record.soilProbeTemperatures[i - 1] / 100.0f;
+  }
+}
+
+bool LocalStorage::validRecord(const OfflineRecord& record) {
+  return record.version == OFFLINE_RECORD_VERSION &&
+         record.crc == crc32((const uint8_t*)&record, offsetof(OfflineRecord, crc));
+}
+
+bool LocalStorage::validRecord(const OfflineRecordV1& record) {
+  return record.version == 1 &&
+         record.crc == crc32((const uint8_t*)&record, offsetof(OfflineRecordV1, crc));
+}
+
+void LocalStorage::upgradeRecord(const OfflineRecordV1& old, OfflineRecord& record) {
+  if (!validRecord(old)) {
+    // Keeps the slot so later indices do not move; fails validRecord()
+    memset(&record, 0, sizeof(record));
+    return;
+  }
+  
+  SensorReadings readings;
+  readings.soilMoisture = old.soilMoisture;
+  readings.soilTemperature = old.soilTemperature;
+  readings.airTemperature = old.airTemperature;
+  readings.humidity = old.humidity;
+  readings.timestamp = old.timestamp;
+  readings.valid = (old.flags & OFFLINE_RECORD_VALID) != 0;
+  readings.soilProbeCount = 1;
+  readings.soilTemperatures[0] = old.soilTemperature;
+  packRecord(readings, record);
+}
+
+uint32_t LocalStorage::crc32(const uint8_t* data, size_t length) {
+  // Standard reflected CRC-32 (polynomial 0xEDB88320)
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
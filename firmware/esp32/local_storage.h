@@ -1,43 +1,237 @@
 // CarbonReady Local Storage
-// Handles offline data storage using SPIFFS
+// Handles offline data storage using LittleFS
+//
+// Readings are appended to fixed-size segment files under /offline, each
+// holding OFFLINE_SEGMENT_RECORDS slots. The writer fills the newest
+// segment and then starts the next one; syncing advances a tail pointer
+// and deletes a segment as soon as all of its readings are acknowledged,
+// so flash is never rewritten in place and LittleFS spreads the erases.
+//
+// Each slot holds a packed binary OfflineRecord rather than the JSON
+// message; the message and its hash are rebuilt when the record is sent.
+//
+// Segment numbers, the head position and the count live in RAM after
+// begin(), which rebuilds them from the directory listing. Only the tail
+// position is persisted, in a small file rewritten on sync.
+//
+// The raw segments get the partition's free space at mount, less
+// OFFLINE_STORAGE_RESERVE_BYTES and room for the aggregate tiers. When they
+// fill, the oldest raw segment is merged into hourly aggregates
+// (min/max/mean, see aggregate_log.h) and deleted; when the hourly tier is
+// full its oldest segment is merged into daily aggregates the same way, and
+// only a full daily tier loses its oldest segment. A long outage costs the
+// oldest readings their resolution, recent readings stay as they were, and
+// each step rewrites one segment's worth of data at most. Sync sends the
+// daily, then hourly, then raw backlog, oldest first.
+//
+// A partition that still holds the old SPIFFS journal (or the older
+// /offline_readings.txt) is migrated on first boot. The partition is only
+// formatted after its backlog has been staged in RAM, or when neither
+// filesystem can be mounted. Segments written with the single-probe
+// version 1 record are rewritten to the current layout at mount.
 
 #ifndef LOCAL_STORAGE_H
 #define LOCAL_STORAGE_H
 
 #include <Arduino.h>
-#include <vector>
+#include <FS.h>
+#include "config.h"
+#include "sensor_manager.h"
+#include "aggregate_log.h"
+
+// Current OfflineRecord layout version
+#define OFFLINE_RECORD_VERSION 2
+
+// Flags stored in OfflineRecord::flags
+#define OFFLINE_RECORD_VALID 0x01
+
+// Soil temperature probes a record holds (part of the on-flash layout)
+#define OFFLINE_RECORD_PROBES 4
+
+static_assert(DS18B20_MAX_PROBES <= OFFLINE_RECORD_PROBES,
+              "DS18B20_MAX_PROBES exceeds the probes an OfflineRecord holds");
+
+// Fixed-width binary form of SensorReadings (one journal slot)
+struct __attribute__((packed)) OfflineRecord {
+  uint8_t version;         // OFFLINE_RECORD_VERSION
+  uint8_t flags;           // OFFLINE_RECORD_* flags
+  uint8_t soilProbeCount;  // Probes read, including soilTemperature
+  uint8_t reserved;
+  uint32_t timestamp;      // Unix epoch timestamp
+  float soilMoisture;
+  float soilTemperature;   // First probe
+  float airTemperature;
+  float humidity;
+  int16_t soilProbeTemperatures[OFFLINE_RECORD_PROBES - 1]; // Later probes, 0.01 C
+  uint16_t reserved2;
+  uint32_t crc;            // CRC-32 of all preceding bytes
+};
+
+// Version 1 record: single probe, written by earlier firmware and by the
+// SPIFFS journal
+struct __attribute__((packed)) OfflineRecordV1 {
+  uint8_t version;         // 1
+  uint8_t flags;
+  uint16_t reserved;
+  uint32_t timestamp;
+  float soilMoisture;
+  float soilTemperature;
+  float airTemperature;
+  float humidity;
+  uint32_t crc;
+};
 
 class LocalStorage {
 public:
-  LocalStorage();
+  // Capacity is in raw segment slots; 0 sizes the raw tier from the
+  // partition's free space in begin() (tests use fixed capacities)
+  LocalStorage(int capacity = 0);
   
-  // Initialize SPIFFS
+  // Mount LittleFS (migrating SPIFFS storage), scan the segments of every
+  // tier and size the raw tier
   bool begin();
   
-  // Store reading offline
-  bool storeReading(const String& message);
+  // Store reading offline (appends one segment slot, compacting the oldest
+  // segment when the raw tier is full)
+  bool storeReading(const SensorReadings& readings);
+  
+  // Store several readings with one flush at the end rather than one per
+  // slot. Returns how many were stored (fewer when storage fills).
+  int storeReadings(const SensorReadings* readings, int storeCount);
   
-  // Get count of stored readings
+  // Get count of stored records (an aggregate counts as one)
   int getStoredCount();
   
-  // Get all stored readings
-  std::vector<String> getAllReadings();
+  // Raw readings and aggregates held in each tier
+  int getRawCount();
+  int getHourlyCount();
+  int getDailyCount();
+  
+  // Raw slots the tier was sized to
+  int getCapacity();
+  
+  // Bytes of segment data occupied by stored records
+  size_t getStoredBytes();
+  
+  // Offsets of the next write (head) and oldest reading (tail) in the
+  // logical append stream (segment number * segment size + slot offset)
+  size_t getHeadOffset();
+  size_t getTailOffset();
+  
+  // Read up to maxCount of the oldest stored records without removing them,
+  // daily aggregates first, then hourly, then raw readings. Aggregates come
+  // back as their means, with their spread in summaries if given (samples 0
+  // for raw readings). Returns the number of slots read; corrupt slots come
+  // back with valid=false.
+  int readOldest(SensorReadings* readings, int maxCount, ReadingSummary* summaries = nullptr);
+  
+  // Remove the oldest stored records (advances the tails and deletes fully
+  // synced segments). Nothing is removed if the backlog was compacted since
+  // the last readOldest(); those records go out again as aggregates.
+  bool removeOldest(int removeCount);
   
   // Clear stored readings
   bool clearReadings();
   
-  // Check if storage is full
+  // Check if storage is full (raw tier full with no segment to compact)
   bool isFull();
   
+  // Record and tail bytes written to flash since construction (the data
+  // handed to LittleFS, not counting its own metadata and erases)
+  uint32_t getBytesWritten();
+  
+  // CRC-32 used to detect torn or corrupt records (raw and aggregate)
+  static uint32_t crc32(const uint8_t* data, size_t length);
+  
 private:
-  const char* STORAGE_FILE = "/offline_readings.txt";
+  const char* SEGMENT_DIR = "/offline";
+  const char* TAIL_FILE = "/offline/tail.bin";
+  
+  // Files left by the SPIFFS implementation
+  const char* SPIFFS_JOURNAL_FILE = "/offline_journal.bin";
+  const char* SPIFFS_META_FILE = "/offline_meta.bin";
+  const char* LEGACY_STORAGE_FILE = "/offline_readings.txt";
+  
+  // Tail position, persisted in TAIL_FILE
+  struct TailMeta {
+    uint32_t magic;
+    uint32_t segment;  // Oldest unsynced segment
+    uint32_t record;   // Synced slots at the start of that segment
+  };
+  
+  uint32_t firstSegment;  // Oldest segment on flash
+  uint32_t headSegment;   // Segment being appended to
+  uint32_t headRecords;   // Slots written in the head segment
+  uint32_t tailRecord;    // Synced slots at the start of firstSegment
+  uint32_t count;         // Number of stored readings
   int maxReadings;
+  bool partitionSized;    // maxReadings is set from the partition in begin()
+  uint32_t bytesWritten;  // See getBytesWritten()
+  
+  // Downsampled tiers, under SEGMENT_DIR
+  AggregateLog hourly;
+  AggregateLog daily;
+  
+  // Compactions since boot, and the count at the last readOldest()
+  uint32_t compactions;
+  uint32_t readCompactions;
+  
+  // Head segment, kept open between appends
+  File headFile;
+  
+  // Scratch file for rewriting a segment
+  const char* UPGRADE_FILE = "/offline/upgrade.tmp";
+  
+  // Rebuild segment pointers from the directory and TAIL_FILE
+  bool scanSegments();
+  
+  // Read up to maxCount of the oldest raw readings
+  int readRaw(SensorReadings* readings, int maxCount);
+  
+  // Rewrite version 1 segments in the current record layout. Slot indices
+  // are kept, so the tail position stays valid. Returns the number of
+  // segments rewritten, or -1 on failure.
+  int upgradeSegments();
+  
+  // Persist the tail position to TAIL_FILE
+  bool saveTail();
+  
+  // Size the raw tier from the partition's free space
+  void sizeFromPartition();
+  
+  // Free raw slots by merging the oldest raw segment into the hourly tier,
+  // making room there first. False if there is no full segment to merge.
+  bool compactOldest();
+  
+  // Merge the oldest raw segment into the hourly tier and delete it
+  bool compactRawSegment();
+  
+  // Append one packed record to the head segment, flushing it unless the
+  // caller flushes after a run of appends
+  bool appendRecord(const OfflineRecord& record, bool flush = true);
+  
+  // Path of a segment file (buffer of at least 24 bytes)
+  void segmentPath(uint32_t segment, char* path, size_t size);
+  
+  // Mount LittleFS when it fails, migrating a SPIFFS image if present
+  bool migrateFromSpiffs();
+  
+  // Stage SPIFFS journal and legacy readings for migration
+  void stageSpiffsJournal(OfflineRecord* staged, int capacity, int& total);
+  void stageLegacyStorage(OfflineRecord* staged, int capacity, int& total);
+  
+  // Pack readings into a record (with CRC)
+  static void packRecord(const SensorReadings& readings, OfflineRecord& record);
+  
+  // Check a record's version and CRC
+  static bool validRecord(const OfflineRecord& record);
+  static bool validRecord(const OfflineRecordV1& record);
   
-  // Read all lines from file
-  std::vector<String> readLines();
+  // Convert a version 1 record (an invalid one stays invalid)
+  static void upgradeRecord(const OfflineRecordV1& old, OfflineRecord& record);
   
-  // Write lines to file
-  bool writeLines(const std::vector<String>& lines);
+  // Copy a record's fields into readings
+  static void unpackRecord(const OfflineRecord& record, SensorReadings& readings);
 };
 
 #endif // LOCAL_STORAGE_H
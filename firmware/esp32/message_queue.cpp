@@ -0,0 +1,44 @@
+// CarbonReady Message Queue Implementation
+
+#include "message_queue.h"
+
+MessageQueue::MessageQueue() : head(0), tail(0) {
+  // Slots are filled through reserve()
+}
+
+PublishMessage* MessageQueue::reserve() {
+  uint32_t currentHead = head.load(std::memory_order_relaxed);
+  
+  if (currentHead - tail.load(std::memory_order_acquire) >= PUBLISH_QUEUE_LENGTH) {
+    return nullptr;
+  }
+  
+  return &slots[currentHead % PUBLISH_QUEUE_LENGTH];
+}
+
+void MessageQueue::commit() {
+  // Publish the slot contents before the new head becomes visible
+  head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+PublishMessage* MessageQueue::front() {
+  uint32_t currentTail = tail.load(std::memory_order_relaxed);
+  
+  if (currentTail == head.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  
+  return &slots[currentTail % PUBLISH_QUEUE_LENGTH];
+}
+
+void MessageQueue::pop() {
+  uint32_t currentTail = tail.load(std::memory_order_relaxed);
+  
+  if (currentTail != head.load(std::memory_order_acquire)) {
+    tail.store(currentTail + 1, std::memory_order_release);
+  }
+}
+
+int MessageQueue::size() {
+  return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
@@ -0,0 +1,58 @@
+// CarbonReady Message Queue
+// Bounded lock-free queue of signed messages from processing to the network task
+//
+// Messages are large, so slots are filled and drained in place: the
+// producer writes into reserve() and makes the slot visible with commit(),
+// and the consumer publishes straight out of front() before pop(). Each
+// message keeps the readings it was built from, so a message that cannot
+// be sent goes to offline storage as a reading.
+
+#ifndef MESSAGE_QUEUE_H
+#define MESSAGE_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+#include "sensor_manager.h"
+#include "data_processor.h"
+
+// Counters wrap at 2^32, which keeps slot indices continuous only for
+// power-of-two capacities
+static_assert((PUBLISH_QUEUE_LENGTH & (PUBLISH_QUEUE_LENGTH - 1)) == 0,
+              "PUBLISH_QUEUE_LENGTH must be a power of two");
+
+struct PublishMessage {
+  SensorReadings readings;               // Source of the message
+  size_t length;                         // Payload bytes
+  uint16_t packetId;                     // QoS 1 publish awaiting its PUBACK (0: not in flight)
+  unsigned long pubackDeadline;          // millis() by which packetId should be acknowledged
+  uint8_t payload[MESSAGE_BUFFER_SIZE];  // Signed message in the wire format
+};
+
+// Single-producer/single-consumer ring, like ReadingQueue
+class MessageQueue {
+public:
+  MessageQueue();
+  
+  // Producer: the next free slot, or nullptr when the queue is full
+  PublishMessage* reserve();
+  
+  // Producer: make the slot from reserve() visible to the consumer
+  void commit();
+  
+  // Consumer: the oldest message without removing it, or nullptr
+  PublishMessage* front();
+  
+  // Consumer: remove the oldest message
+  void pop();
+  
+  // Number of queued messages
+  int size();
+  
+private:
+  PublishMessage slots[PUBLISH_QUEUE_LENGTH];
+  std::atomic<uint32_t> head;  // Total messages committed
+  std::atomic<uint32_t> tail;  // Total messages popped
+};
+
+#endif // MESSAGE_QUEUE_H
@@ -0,0 +1,158 @@
+// CarbonReady Device Metrics Implementation
+
+#include "metrics.h"
+#include <WiFi.h>
+
+DeviceMetrics deviceMetrics;
+
+const char* const DeviceMetrics::STAGE_NAMES[STAGE_COUNT] = {
+  "readAll",
+  "soilMoisture",
+  "soilTemperature",
+  "airTemperature",
+  "humidity",
+  "serialize",
+  "hash",
+  "tcpConnect",
+  "tlsHandshake",
+  "mqttConnect",
+  "publish",
+  "storageWrite",
+  "storageRead",
+  "storageRemove",
+  "storageMount",
+  "wifiConnect",
+  "syncBatch"
+};
+
+DeviceMetrics::DeviceMetrics() {
+  lock = portMUX_INITIALIZER_UNLOCKED;
+  memset(stages, 0, sizeof(stages));
+  taskCount = 0;
+}
+
+void DeviceMetrics::record(MetricStage stage, uint32_t micros) {
+#if METRICS_ENABLED
+  // log2 bucket: 0 for < 16 us, then one per doubling
+  int bucket = micros < 16 ? 0 : (31 - __builtin_clz(micros)) - 3;
+  if (bucket >= METRICS_HISTOGRAM_BUCKETS) {
+    bucket = METRICS_HISTOGRAM_BUCKETS - 1;
+  }
+  
+  portENTER_CRITICAL(&lock);
+  StageHistogram& histogram = stages[stage];
+  histogram.count++;
+  histogram.totalMicros += micros;
+  if (micros > histogram.maxMicros) {
+    histogram.maxMicros = micros;
+  }
+  if (histogram.buckets[bucket] < UINT16_MAX) {
+    histogram.buckets[bucket]++;
+  }
+  portEXIT_CRITICAL(&lock);
+#endif
+}
+
+size_t DeviceMetrics::writeSummary(const char* deviceId, const ConnectionStats& connection,
+                                   const WifiStats& wifi, char* output, size_t capacity) {
+  // Snapshot under the lock, format outside it
+  StageHistogram snapshot[STAGE_COUNT];
+  WatchedTask watched[METRICS_MAX_TASKS];
+  portENTER_CRITICAL(&lock);
+  memcpy(snapshot, stages, sizeof(snapshot));
+  memcpy(watched, tasks, sizeof(watched));
+  int watchedCount = taskCount;
+  portEXIT_CRITICAL(&lock);
+  
+  int length = snprintf(output, capacity,
+                        "{\"deviceId\":\"%s\",\"uptime\":%lu,"
+                        "\"heap\":{\"free\":%lu,\"minFree\":%lu,\"maxBlock\":%lu},"
+                        "\"rssi\":%d,"
+                        "\"connect\":{\"attempts\":%lu,\"failures\":%lu,\"resumed\":%lu,\"lastMs\":%lu},"
+                        "\"wifi\":{\"connects\":%lu,\"cached\":%lu,\"fallbacks\":%lu,\"lastMs\":%lu},"
+                        "\"stacks\":{",
+                        deviceId, millis() / 1000,
+                        (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap(),
+                        (unsigned long)ESP.getMaxAllocHeap(),
+                        (int)WiFi.RSSI(),
+                        (unsigned long)connection.attempts, (unsigned long)connection.failures,
+                        (unsigned long)connection.resumedHandshakes,
+                        (unsigned long)connection.lastConnectMs,
+                        (unsigned long)wifi.connects, (unsigned long)wifi.cachedConnects,
+                        (unsigned long)wifi.scanFallbacks, (unsigned long)wifi.lastConnectMs);
+  
+  // Least free stack of each task, in bytes
+  for (int i = 0; i < watchedCount && length > 0 && (size_t)length < capacity; i++) {
+    length += snprintf(output + length, capacity - length, "%s\"%s\":%lu",
+                       i == 0 ? "" : ",", watched[i].name,
+                       (unsigned long)uxTaskGetStackHighWaterMark(watched[i].handle));
+  }
+  
+  if (length > 0 && (size_t)length < capacity) {
+    length += snprintf(output + length, capacity - length, "},\"stages\":{");
+  }
+  
+  // Each stage: [count, mean, p50, p95, max] in microseconds
+  bool first = true;
+  for (int i = 0; i < STAGE_COUNT && length > 0 && (size_t)length < capacity; i++) {
+    const StageHistogram& histogram = snapshot[i];
+    if (histogram.count == 0) {
+      continue;
+    }
+    
+    length += snprintf(output + length, capacity - length,
+                       "%s\"%s\":[%lu,%lu,%lu,%lu,%lu]",
+                       first ? "" : ",", STAGE_NAMES[i],
+                       (unsigned long)histogram.count,
+                       (unsigned long)(histogram.totalMicros / histogram.count),
+                       (unsigned long)percentile(histogram, 50),
+                       (unsigned long)percentile(histogram, 95),
+                       (unsigned long)histogram.maxMicros);
+    first = false;
+  }
+  
+  if (length > 0 && (size_t)length < capacity) {
+    length += snprintf(output + length, capacity - length, "}}");
+  }
+  
+  return length > 0 && (size_t)length < capacity ? length : 0;
+}
+
+void DeviceMetrics::reset() {
+  portENTER_CRITICAL(&lock);
+  memset(stages, 0, sizeof(stages));
+  portEXIT_CRITICAL(&lock);
+}
+
+StageHistogram DeviceMetrics::getStage(MetricStage stage) {
+  portENTER_CRITICAL(&lock);
+  StageHistogram histogram = stages[stage];
+  portEXIT_CRITICAL(&lock);
+  
+  return histogram;
+}
+
+void DeviceMetrics::watchTask(const char* name, TaskHandle_t task) {
+  portENTER_CRITICAL(&lock);
+  if (taskCount < METRICS_MAX_TASKS && task != nullptr) {
+    tasks[taskCount].name = name;
+    tasks[taskCount].handle = task;
+    taskCount++;
+  }
+  portEXIT_CRITICAL(&lock);
+}
+
+uint32_t DeviceMetrics::percentile(const StageHistogram& histogram, int percent) {
+  uint32_t target = (histogram.count * percent + 99) / 100;
+  uint32_t seen = 0;
+  
+  for (int bucket = 0; bucket < METRICS_HISTOGRAM_BUCKETS; bucket++) {
+    seen += histogram.buckets[bucket];
+    if (seen >= target) {
+      // Never report more than the slowest sample actually seen
+      return min((uint32_t)1 << (bucket + 4), histogram.maxMicros);
+    }
+  }
+  
+  return histogram.maxMicros;
+}
@@ -0,0 +1,132 @@
+// CarbonReady Device Metrics
+// Always-on stage timers with log2 histograms, plus heap and WiFi health,
+// summarized periodically on the device metrics topic
+//
+// Histograms cover the window since the last published summary. Stack
+// high-water marks (the least free stack each watched task has had since it
+// started) are read when the summary is written.
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+
+// Connect latency counters (since boot)
+struct ConnectionStats {
+  uint32_t attempts;
+  uint32_t failures;
+  uint32_t resumedHandshakes;
+  uint32_t fullHandshakes;
+  uint32_t resumedHandshakeMsTotal;
+  uint32_t fullHandshakeMsTotal;
+  uint32_t lastHandshakeMs;
+  uint32_t lastConnectMs;     // TCP + TLS + MQTT CONNECT
+};
+
+// WiFi association counters (since power-on, kept across deep sleep)
+struct WifiStats {
+  uint32_t connects;
+  uint32_t cachedConnects;    // Direct association to the cached BSSID/channel
+  uint32_t scanFallbacks;     // Cached AP failed, fell back to a full scan
+  uint32_t lastConnectMs;     // WiFi.begin() to connected
+};
+
+// Timed stages on the awake path
+enum MetricStage {
+  STAGE_READ_ALL,
+  STAGE_SOIL_MOISTURE,
+  STAGE_SOIL_TEMPERATURE,
+  STAGE_AIR_TEMPERATURE,
+  STAGE_HUMIDITY,
+  STAGE_SERIALIZE,
+  STAGE_HASH,
+  STAGE_TCP_CONNECT,
+  STAGE_TLS_HANDSHAKE,
+  STAGE_MQTT_CONNECT,
+  STAGE_PUBLISH,
+  STAGE_STORAGE_WRITE,
+  STAGE_STORAGE_READ,
+  STAGE_STORAGE_REMOVE,
+  STAGE_STORAGE_MOUNT,
+  STAGE_WIFI_CONNECT,
+  STAGE_SYNC_BATCH,
+  STAGE_COUNT
+};
+
+// Bucket 0 counts durations under 16 us; bucket i under 2^(i+4) us.
+// The last bucket also takes everything slower.
+#define METRICS_HISTOGRAM_BUCKETS 20
+
+// Tasks whose stack high-water marks the summary reports
+#define METRICS_MAX_TASKS 4
+
+struct StageHistogram {
+  uint32_t count;
+  uint32_t maxMicros;
+  uint64_t totalMicros;
+  uint16_t buckets[METRICS_HISTOGRAM_BUCKETS];
+};
+
+class DeviceMetrics {
+public:
+  DeviceMetrics();
+  
+  // Record one duration for a stage (safe to call from any task)
+  void record(MetricStage stage, uint32_t micros);
+  
+  // Write the JSON summary of the current window into output.
+  // Returns the length, or 0 if it does not fit.
+  size_t writeSummary(const char* deviceId, const ConnectionStats& connection,
+                      const WifiStats& wifi, char* output, size_t capacity);
+  
+  // Start a new window (after the summary was published)
+  void reset();
+  
+  // Copy of one stage's histogram for the current window
+  StageHistogram getStage(MetricStage stage);
+  
+  // Report a task's stack high-water mark in the summary (call once per
+  // task when it starts; name must outlive the task)
+  void watchTask(const char* name, TaskHandle_t task);
+  
+private:
+  StageHistogram stages[STAGE_COUNT];
+  portMUX_TYPE lock;
+  
+  struct WatchedTask {
+    const char* name;
+    TaskHandle_t handle;
+  };
+  
+  WatchedTask tasks[METRICS_MAX_TASKS];
+  int taskCount;
+  
+  // Upper bound of the bucket holding the given percentile
+  static uint32_t percentile(const StageHistogram& histogram, int percent);
+  
+  static const char* const STAGE_NAMES[STAGE_COUNT];
+};
+
+extern DeviceMetrics deviceMetrics;
+
+// Records the lifetime of the enclosing scope against a stage
+class StageTimer {
+public:
+#if METRICS_ENABLED
+  explicit StageTimer(MetricStage stage) : stage(stage), start(micros()) {}
+  ~StageTimer() { deviceMetrics.record(stage, micros() - start); }
+#else
+  explicit StageTimer(MetricStage stage) {}
+#endif
+  
+private:
+#if METRICS_ENABLED
+  MetricStage stage;
+  unsigned long start;
+#endif
+};
+
+#endif // METRICS_H
@@ -2,9 +2,30 @@
 
 #include "mqtt_client.h"
 #include "config.h"
+#include "metrics.h"
+#include "runtime_config.h"
 
-MQTTClientManager::MQTTClientManager() : mqttClient(wifiClient) {
+int AckTrackingClient::read() {
+  int b = transport.read();
+  if (b >= 0) {
+    uint8_t byte = b;
+    tracker.received(&byte, 1);
+  }
+  return b;
+}
+
+int AckTrackingClient::read(uint8_t* buf, size_t size) {
+  int read = transport.read(buf, size);
+  if (read > 0) {
+    tracker.received(buf, read);
+  }
+  return read;
+}
+
+MQTTClientManager::MQTTClientManager()
+  : ackClient(tlsClient, pubacks), mqttClient(ackClient) {
   lastRetryCount = 0;
+  memset(&stats, 0, sizeof(stats));
 }
 
 bool MQTTClientManager::begin(const String& endpoint,
@@ -19,21 +40,31 @@ bool MQTTClientManager::begin(const String& endpoint,
   
   // Construct MQTT topics
   this->publishTopic = "carbonready/farm/" + farmId + "/sensor/data";
+  this->compressedTopic = publishTopic + "/heatshrink";
+  this->binaryTopic = "carbonready/farm/" + farmId + "/device/" + deviceId + "/sensor/msgpack";
+  this->metricsTopic = "carbonready/farm/" + farmId + "/device/" + deviceId + "/metrics";
   this->subscribeTopic = "carbonready/farm/" + farmId + "/commands";
   
   Serial.println("Initializing MQTT client...");
   Serial.printf("Endpoint: %s\n", endpoint.c_str());
   Serial.printf("Publish topic: %s\n", publishTopic.c_str());
   
-  // Configure WiFiClientSecure with certificates
-  wifiClient.setCACert(rootCA);
-  wifiClient.setCertificate(deviceCert);
-  wifiClient.setPrivateKey(deviceKey);
+  // Parse certificates once; later begin() calls reuse the parsed contexts
+  if (!tlsClient.begin(rootCA, deviceCert, deviceKey)) {
+    Serial.println("Error: Failed to load TLS credentials");
+    return false;
+  }
   
   // Configure MQTT client
   mqttClient.setServer(endpoint.c_str(), MQTT_PORT);
   mqttClient.setCallback(messageCallback);
-  mqttClient.setBufferSize(1024); // Increase buffer for larger messages
+  
+  // Increase buffer for batched messages, falling back if allocation fails
+  if (!mqttClient.setBufferSize(MQTT_BUFFER_SIZE)) {
+    Serial.printf("Warning: Failed to allocate %d byte MQTT buffer\n", MQTT_BUFFER_SIZE);
+    mqttClient.setBufferSize(1024);
+  }
+  Serial.printf("MQTT buffer: %d bytes\n", mqttClient.getBufferSize());
   
   Serial.println("MQTT client initialized");
   return true;
@@ -46,12 +77,24 @@ bool MQTTClientManager::connect() {
   
   Serial.println("Connecting to AWS IoT Core...");
   
+  // Nothing sent on an earlier connection will be acknowledged on this one
+  pubacks.reset();
+  
+  unsigned long start = millis();
+  
   // Attempt to connect with device ID as client ID
-  if (mqttClient.connect(deviceId.c_str())) {
-    Serial.println("Connected to AWS IoT Core");
+  bool success;
+  {
+    StageTimer timer(STAGE_MQTT_CONNECT);
+    success = mqttClient.connect(deviceId.c_str());
+  }
+  recordConnect(success, millis() - start);
+  
+  if (success) {
+    Serial.printf("Connected to AWS IoT Core in %lu ms\n", (unsigned long)stats.lastConnectMs);
     
     // Subscribe to command topic
-    if (mqttClient.subscribe(subscribeTopic.c_str())) {
+    if (mqttClient.subscribe(subscribeTopic.c_str(), runtimeConfig.get().qos)) {
       Serial.printf("Subscribed to: %s\n", subscribeTopic.c_str());
     } else {
       Serial.println("Warning: Failed to subscribe to command topic");
@@ -64,21 +107,104 @@ bool MQTTClientManager::connect() {
   }
 }
 
-bool MQTTClientManager::publish(const String& message) {
-  // Ensure connected
-  if (!isConnected()) {
-    Serial.println("Not connected, attempting to connect...");
-    if (!connect()) {
-      Serial.println("Failed to connect for publish");
-      return false;
-    }
+bool MQTTClientManager::ensureConnected() {
+  if (isConnected()) {
+    return true;
+  }
+  
+  Serial.println("Not connected, attempting to connect...");
+  if (!connect()) {
+    Serial.println("Failed to connect for publish");
+    return false;
+  }
+  return true;
+}
+
+const String& MQTTClientManager::topicFor(MqttTopic topic) {
+  switch (topic) {
+    case TOPIC_COMPRESSED:
+      return compressedTopic;
+    case TOPIC_BINARY:
+      return binaryTopic;
+    default:
+      return publishTopic;
+  }
+}
+
+bool MQTTClientManager::publish(const uint8_t* payload, size_t length, int maxRetries) {
+  if (!ensureConnected()) {
+    return false;
+  }
+  
+  // Publish with retry logic
+  return publishWithRetry(publishTopic, payload, length, maxRetries);
+}
+
+bool MQTTClientManager::publishCompressed(const uint8_t* payload, size_t length, int maxRetries) {
+  if (!ensureConnected()) {
+    return false;
+  }
+  
+  // Publish with retry logic
+  return publishWithRetry(compressedTopic, payload, length, maxRetries);
+}
+
+bool MQTTClientManager::publishBinary(const uint8_t* payload, size_t length, int maxRetries) {
+  if (!ensureConnected()) {
+    return false;
   }
   
   // Publish with retry logic
-  return publishWithRetry(message, MAX_RETRIES);
+  return publishWithRetry(binaryTopic, payload, length, maxRetries);
+}
+
+bool MQTTClientManager::publishMetrics(const uint8_t* payload, size_t length) {
+  // Metrics are best effort: one attempt, no reconnect
+  if (!isConnected()) {
+    return false;
+  }
+  
+  return publishWithRetry(metricsTopic, payload, length, 0, 0);
+}
+
+uint16_t MQTTClientManager::publishNoWait(MqttTopic topic, const uint8_t* payload, size_t length) {
+  if (!ensureConnected()) {
+    return 0;
+  }
+  
+  uint16_t packetId = pubacks.track();
+  if (packetId == 0) {
+    Serial.println("Error: QoS 1 in-flight window is full");
+    return 0;
+  }
+  
+  unsigned long publishStart = micros();
+  bool written = writePublish(topicFor(topic), payload, length, packetId);
+  deviceMetrics.record(STAGE_PUBLISH, micros() - publishStart);
+  
+  if (!written) {
+    Serial.println("Publish failed, connection lost");
+    pubacks.release(packetId);
+    return 0;
+  }
+  
+  return packetId;
 }
 
-bool MQTTClientManager::publishWithRetry(const String& message, int maxRetries) {
+PubackStatus MQTTClientManager::getPubackStatus(uint16_t packetId) {
+  // PubSubClient has closed the socket; the broker drops the session with it
+  if (!mqttClient.connected()) {
+    pubacks.reset();
+  }
+  return pubacks.status(packetId);
+}
+
+void MQTTClientManager::releasePacket(uint16_t packetId) {
+  pubacks.release(packetId);
+}
+
+bool MQTTClientManager::publishWithRetry(const String& topic, const uint8_t* payload,
+                                         size_t length, int maxRetries, int qos) {
   lastRetryCount = 0;
   
   for (int attempt = 0; attempt <= maxRetries; attempt++) {
@@ -97,9 +223,26 @@ bool MQTTClientManager::publishWithRetry(const String& message, int maxRetries)
     
     // Attempt to publish
     Serial.printf("Publishing to %s (attempt %d/%d)...\n", 
-                  publishTopic.c_str(), attempt + 1, maxRetries + 1);
+                  topic.c_str(), attempt + 1, maxRetries + 1);
     
-    if (mqttClient.publish(publishTopic.c_str(), message.c_str())) {
+    unsigned long publishStart = micros();
+    bool published;
+    uint16_t packetId = 0;
+    if (qos == 1) {
+      packetId = pubacks.track();
+      published = packetId != 0 && writePublish(topic, payload, length, packetId);
+    } else {
+      published = mqttClient.publish(topic.c_str(), payload, length);
+    }
+    deviceMetrics.record(STAGE_PUBLISH, micros() - publishStart);
+    
+    // At QoS 1 the publish only counts once the broker has acknowledged it
+    if (published && packetId != 0) {
+      published = waitForPuback(packetId);
+    }
+    pubacks.release(packetId);
+    
+    if (published) {
       Serial.println("Publish successful");
       return true;
     } else {
@@ -111,12 +254,61 @@ bool MQTTClientManager::publishWithRetry(const String& message, int maxRetries)
   return false;
 }
 
+bool MQTTClientManager::writePublish(const String& topic, const uint8_t* payload,
+                                     size_t length, uint16_t packetId) {
+  // Fixed header, remaining length, topic and packet ID, then the payload
+  uint8_t header[MQTT_MAX_HEADER_SIZE + 2];
+  size_t topicLength = topic.length();
+  uint32_t remaining = 2 + topicLength + 2 + length;
+  size_t headerLength = 0;
+  
+  header[headerLength++] = 0x32; // PUBLISH, QoS 1
+  do {
+    uint8_t digit = remaining & 0x7f;
+    remaining >>= 7;
+    header[headerLength++] = remaining > 0 ? (digit | 0x80) : digit;
+  } while (remaining > 0);
+  header[headerLength++] = topicLength >> 8;
+  header[headerLength++] = topicLength & 0xff;
+  
+  uint8_t packetIdBytes[2] = { (uint8_t)(packetId >> 8), (uint8_t)(packetId & 0xff) };
+  
+  return ackClient.write(header, headerLength) == headerLength &&
+         ackClient.write((const uint8_t*)topic.c_str(), topicLength) == topicLength &&
+         ackClient.write(packetIdBytes, 2) == 2 &&
+         ackClient.write(payload, length) == length;
+}
+
+bool MQTTClientManager::waitForPuback(uint16_t packetId) {
+  unsigned long start = millis();
+  
+  while (millis() - start < MQTT_PUBACK_TIMEOUT_MS) {
+    // loop() reads incoming packets, which passes PUBACKs to the tracker
+    mqttClient.loop();
+    
+    PubackStatus status = getPubackStatus(packetId);
+    if (status == PUBACK_RECEIVED) {
+      return true;
+    }
+    if (status == PUBACK_LOST) {
+      Serial.println("Connection lost before PUBACK");
+      return false;
+    }
+    
+    ::delay(NETWORK_TASK_POLL_MS);
+  }
+  
+  Serial.printf("No PUBACK for packet %u after %d ms\n", (unsigned)packetId, MQTT_PUBACK_TIMEOUT_MS);
+  return false;
+}
+
 unsigned long MQTTClientManager::getBackoffDelay(int retryCount) {
   // Exponential backoff: 2^retryCount * base delay
   // Retry 1: 2 seconds
   // Retry 2: 4 seconds
   // Retry 3: 8 seconds
-  return RETRY_DELAY_BASE_MS * (1 << retryCount);
+  // (base tunable at runtime, RETRY_DELAY_BASE_MS by default)
+  return runtimeConfig.get().retryDelayBaseMs * (1UL << retryCount);
 }
 
 bool MQTTClientManager::isConnected() {
@@ -133,14 +325,49 @@ int MQTTClientManager::getLastRetryCount() {
   return lastRetryCount;
 }
 
-void MQTTClientManager::messageCallback(char* topic, byte* payload, unsigned int length) {
-  Serial.printf("Message received on topic: %s\n", topic);
-  Serial.print("Payload: ");
-  for (unsigned int i = 0; i < length; i++) {
-    Serial.print((char)payload[i]);
+size_t MQTTClientManager::getMaxPayloadSize() {
+  // PubSubClient needs room for the fixed header, topic length and topic
+  // (sized for the longest topic so any of them can be used)
+  size_t topicLength = max(compressedTopic.length(), binaryTopic.length());
+  size_t overhead = MQTT_MAX_HEADER_SIZE + 2 + topicLength + 2;
+  size_t bufferSize = mqttClient.getBufferSize();
+  
+  return bufferSize > overhead ? bufferSize - overhead : 0;
+}
+
+const ConnectionStats& MQTTClientManager::getConnectionStats() {
+  return stats;
+}
+
+void MQTTClientManager::recordConnect(bool success, unsigned long elapsedMs) {
+  stats.attempts++;
+  stats.lastConnectMs = elapsedMs;
+  
+  if (!success) {
+    stats.failures++;
+    return;
+  }
+  
+  stats.lastHandshakeMs = tlsClient.lastHandshakeMs();
+  if (tlsClient.lastHandshakeResumed()) {
+    stats.resumedHandshakes++;
+    stats.resumedHandshakeMsTotal += stats.lastHandshakeMs;
+  } else {
+    stats.fullHandshakes++;
+    stats.fullHandshakeMsTotal += stats.lastHandshakeMs;
   }
-  Serial.println();
   
-  // Handle commands here (future enhancement)
-  // For now, just log the message
+  Serial.printf("Connects: %lu ok, %lu failed, %lu resumed\n",
+                (unsigned long)(stats.attempts - stats.failures),
+                (unsigned long)stats.failures,
+                (unsigned long)stats.resumedHandshakes);
+}
+
+void MQTTClientManager::messageCallback(char* topic, byte* payload, unsigned int length) {
+  // handleCommand() logs what it applied or rejected; the payload itself is
+  // broker-supplied and not echoed
+  Serial.printf("Message received on topic: %s (%u bytes)\n", topic, length);
+  
+  // Runtime tuning (called from inside mqttClient.loop())
+  runtimeConfig.handleCommand(payload, length);
 }
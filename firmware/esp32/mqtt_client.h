@@ -5,8 +5,43 @@
 #define MQTT_CLIENT_H
 
 #include <Arduino.h>
-#include <WiFiClientSecure.h>
 #include <PubSubClient.h>
+#include "config.h"
+#include "tls_client.h"
+#include "puback_tracker.h"
+#include "metrics.h"
+
+// Data topics a payload can be published to
+enum MqttTopic {
+  TOPIC_DATA,        // JSON messages and batches
+  TOPIC_COMPRESSED,  // heatshrink-compressed JSON
+  TOPIC_BINARY       // MessagePack, per-device topic
+};
+
+// Transport between PubSubClient and the TLS connection that lets the
+// PUBACK tracker see every byte read from the broker
+class AckTrackingClient : public Client {
+public:
+  AckTrackingClient(Client& transport, PubackTracker& tracker)
+    : transport(transport), tracker(tracker) {}
+  
+  int connect(IPAddress ip, uint16_t port) override { return transport.connect(ip, port); }
+  int connect(const char* host, uint16_t port) override { return transport.connect(host, port); }
+  size_t write(uint8_t b) override { return transport.write(b); }
+  size_t write(const uint8_t* buf, size_t size) override { return transport.write(buf, size); }
+  int available() override { return transport.available(); }
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override { return transport.peek(); }
+  void flush() override { transport.flush(); }
+  void stop() override { transport.stop(); }
+  uint8_t connected() override { return transport.connected(); }
+  operator bool() override { return connected(); }
+  
+private:
+  Client& transport;
+  PubackTracker& tracker;
+};
 
 class MQTTClientManager {
 public:
@@ -23,8 +58,31 @@ public:
   // Connect to AWS IoT Core
   bool connect();
   
-  // Publish message to topic with retry logic
-  bool publish(const String& message);
+  // Publish message to topic with retry logic. At QoS 1 each attempt
+  // waits for its PUBACK, so this is for inline use; the network task
+  // uses publishNoWait().
+  bool publish(const uint8_t* payload, size_t length, int maxRetries = MAX_RETRIES);
+  
+  // Publish a heatshrink-compressed message to the compressed data topic
+  bool publishCompressed(const uint8_t* payload, size_t length, int maxRetries = MAX_RETRIES);
+  
+  // Publish a MessagePack message to the per-device binary topic
+  bool publishBinary(const uint8_t* payload, size_t length, int maxRetries = MAX_RETRIES);
+  
+  // Publish a health summary to the device metrics topic (single attempt, QoS 0)
+  bool publishMetrics(const uint8_t* payload, size_t length);
+  
+  // Send a QoS 1 PUBLISH without waiting for its PUBACK. Returns the packet
+  // ID to poll with getPubackStatus(), or 0 if the in-flight window is
+  // full, the client is not connected or the write failed.
+  uint16_t publishNoWait(MqttTopic topic, const uint8_t* payload, size_t length);
+  
+  // Whether a publishNoWait() packet was acknowledged (call loop() to read
+  // PUBACKs). PUBACK_LOST once the connection has dropped.
+  PubackStatus getPubackStatus(uint16_t packetId);
+  
+  // Stop tracking a publishNoWait() packet, acknowledged or not
+  void releasePacket(uint16_t packetId);
   
   // Check if connected
   bool isConnected();
@@ -35,23 +93,54 @@ public:
   // Get retry count for last publish attempt
   int getLastRetryCount();
   
+  // Largest payload that fits the negotiated MQTT buffer for the publish topic
+  // (with room for a QoS 1 packet ID)
+  size_t getMaxPayloadSize();
+  
+  // Calculate exponential backoff delay
+  unsigned long getBackoffDelay(int retryCount);
+  
+  // Connect latency counters
+  const ConnectionStats& getConnectionStats();
+  
 private:
-  WiFiClientSecure wifiClient;
+  TlsClient tlsClient;
+  PubackTracker pubacks;
+  AckTrackingClient ackClient;
   PubSubClient mqttClient;
   
   String endpoint;
   String farmId;
   String deviceId;
   String publishTopic;
+  String compressedTopic;
+  String binaryTopic;
+  String metricsTopic;
   String subscribeTopic;
   
   int lastRetryCount;
+  ConnectionStats stats;
   
-  // Retry with exponential backoff
-  bool publishWithRetry(const String& message, int maxRetries);
+  // Update connect counters after a connect attempt
+  void recordConnect(bool success, unsigned long elapsedMs);
   
-  // Calculate exponential backoff delay
-  unsigned long getBackoffDelay(int retryCount);
+  // Connect if needed before a publish
+  bool ensureConnected();
+  
+  // Topic string for a data topic
+  const String& topicFor(MqttTopic topic);
+  
+  // Retry with exponential backoff (at MQTT_PUBLISH_QOS; qos 0 for metrics)
+  bool publishWithRetry(const String& topic, const uint8_t* payload, size_t length,
+                        int maxRetries, int qos = MQTT_PUBLISH_QOS);
+  
+  // Write a QoS 1 PUBLISH packet straight to the connection (PubSubClient
+  // only writes QoS 0)
+  bool writePublish(const String& topic, const uint8_t* payload, size_t length, uint16_t packetId);
+  
+  // Poll the connection until packetId is acknowledged or the timeout
+  // passes (blocking; publishWithRetry() only)
+  bool waitForPuback(uint16_t packetId);
   
   // MQTT callback for subscribed messages
   static void messageCallback(char* topic, byte* payload, unsigned int length);
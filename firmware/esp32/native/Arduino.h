@@ -0,0 +1,177 @@
+// CarbonReady native shim: Arduino core
+// Just enough of the Arduino/ESP32 API to build the firmware core on a
+// host for tests and benchmarks ([env:native])
+
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define ADC_11db 3
+
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define IRAM_ATTR
+#define EXT_RAM_ATTR
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char* destination, const char* source, size_t size);
+#endif
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// Heap allocations made through operator new or String since start
+uint32_t nativeAllocationCount();
+
+// Simulated heap size; ESP.getFreeHeap() and getMinFreeHeap() subtract the
+// live and peak operator new bytes from it
+#define NATIVE_HEAP_SIZE (320 * 1024)
+
+// Serial output goes to stdout unless silenced (benchmarks)
+void nativeSetSerialOutput(bool enabled);
+
+// Heap-backed string (allocations are counted)
+class String {
+public:
+  String(const char* text = "");
+  String(const String& other);
+  ~String();
+  
+  String& operator=(const String& other);
+  String& operator+=(const String& other);
+  String& operator+=(const char* text);
+  String& operator+=(char c);
+  bool concat(const char* text) { *this += text; return true; }
+  bool concat(char c) { *this += c; return true; }
+  friend String operator+(const String& a, const String& b);
+  friend String operator+(const String& a, const char* b);
+  friend String operator+(const char* a, const String& b);
+  bool operator==(const String& other) const { return strcmp(buffer, other.buffer) == 0; }
+  bool operator==(const char* text) const { return strcmp(buffer, text) == 0; }
+  char operator[](size_t index) const { return buffer[index]; }
+  
+  const char* c_str() const { return buffer; }
+  size_t length() const { return len; }
+  bool reserve(size_t size);
+  void trim();
+  int toInt() const { return atoi(buffer); }
+  float toFloat() const { return atof(buffer); }
+  
+private:
+  char* buffer;
+  size_t len;
+  size_t capacity;
+  
+  void append(const char* text, size_t size);
+};
+
+// Result type of String concatenation (ArduinoJson's String adapter expects it)
+class StringSumHelper : public String {
+public:
+  StringSumHelper(const char* text = "") : String(text) {}
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) { return write(&b, 1); }
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  
+  size_t print(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+  size_t print(const String& text) { return print(text.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value) { return printf("%d", value); }
+  size_t println(const char* text = "") { return print(text) + print('\n'); }
+  size_t println(const String& text) { return println(text.c_str()); }
+  size_t println(int value) { return print(value) + print('\n'); }
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  String readStringUntil(char terminator);
+};
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud) {}
+  void flush() { fflush(stdout); }
+  size_t write(const uint8_t* buffer, size_t size) override;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+  uint32_t getHeapSize() { return NATIVE_HEAP_SIZE; }
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap() { return 110000; }
+};
+
+extern EspClass ESP;
+
+// PSRAM allocation; plain (uncounted) heap while nativePsramAvailable is set
+extern bool nativePsramAvailable;
+bool psramFound();
+void* ps_malloc(size_t size);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+int analogRead(uint8_t pin);
+int8_t digitalPinToAnalogChannel(uint8_t pin);
+
+// Values returned by the sensor shims
+struct NativeSensorValues {
+  float airTemperature;
+  float humidity;
+  float soilTemperature;         // First DS18B20 probe
+  int soilMoistureRaw;
+  
+  // Probes on the DS18B20 bus; probe n > 0 reads soilProbeTemperatures[n]
+  int soilProbeCount;
+  float soilProbeTemperatures[8];
+  
+  // DS18B20 bus operations, for tests that count them
+  uint32_t oneWireSearches;
+  uint32_t oneWireConversions;
+};
+
+extern NativeSensorValues nativeSensors;
+
+// The in-process MQTT broker TlsClient connects to (native_broker.cpp)
+struct NativeBrokerState {
+  bool online;               // Connects fail and open connections drop while false
+  uint32_t pubackDelayMs;    // Round trip before a QoS 1 PUBACK can be read
+  
+  // Counters since start
+  uint32_t connects;
+  uint32_t publishes;        // PUBLISH packets received
+  uint32_t publishedBytes;   // Their application payload bytes
+};
+
+extern NativeBrokerState nativeBroker;
+
+#endif // NATIVE_ARDUINO_H
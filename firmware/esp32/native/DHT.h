@@ -0,0 +1,18 @@
+// CarbonReady native shim: DHT sensor library
+
+#ifndef NATIVE_DHT_H
+#define NATIVE_DHT_H
+
+#include <Arduino.h>
+
+#define DHT22 22
+
+class DHT {
+public:
+  DHT(uint8_t pin, uint8_t type) {}
+  void begin() {}
+  float readTemperature(bool fahrenheit = false, bool force = false) { return nativeSensors.airTemperature; }
+  float readHumidity(bool force = false) { return nativeSensors.humidity; }
+};
+
+#endif // NATIVE_DHT_H
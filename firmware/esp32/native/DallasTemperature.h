@@ -0,0 +1,50 @@
+// CarbonReady native shim: DallasTemperature (nativeSensors.soilProbeCount
+// probes, instant conversion). Searches and conversions are counted.
+
+#ifndef NATIVE_DALLAS_TEMPERATURE_H
+#define NATIVE_DALLAS_TEMPERATURE_H
+
+#include <OneWire.h>
+
+typedef uint8_t DeviceAddress[8];
+
+#define DEVICE_DISCONNECTED_C -127
+
+class DallasTemperature {
+public:
+  DallasTemperature(OneWire* wire) {}
+  void begin() { nativeSensors.oneWireSearches++; }
+  uint8_t getDeviceCount() { return nativeSensors.soilProbeCount; }
+  uint8_t getResolution() { return 12; }
+  void setWaitForConversion(bool wait) {}
+  int16_t millisToWaitForConversion(uint8_t resolution) { return 0; }
+  bool isConversionComplete() { return true; }
+  void requestTemperatures() { nativeSensors.oneWireConversions++; }
+  
+  // Family code 0x28, probe index in the serial number
+  bool getAddress(uint8_t* address, uint8_t index) {
+    nativeSensors.oneWireSearches++;
+    if (index >= nativeSensors.soilProbeCount) {
+      return false;
+    }
+    memset(address, 0, 8);
+    address[0] = 0x28;
+    address[1] = index;
+    return true;
+  }
+  
+  float getTempC(const uint8_t* address) {
+    if (address[0] != 0x28 || address[1] >= nativeSensors.soilProbeCount) {
+      return DEVICE_DISCONNECTED_C;
+    }
+    return address[1] == 0 ? nativeSensors.soilTemperature :
+                             nativeSensors.soilProbeTemperatures[address[1]];
+  }
+  
+  float getTempCByIndex(uint8_t index) {
+    DeviceAddress address;
+    return getAddress(address, index) ? getTempC(address) : DEVICE_DISCONNECTED_C;
+  }
+};
+
+#endif // NATIVE_DALLAS_TEMPERATURE_H
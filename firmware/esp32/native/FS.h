@@ -0,0 +1,94 @@
+// CarbonReady native shim: Arduino filesystem API
+// Files live under a host directory (see nativeSetFilesystemRoot)
+
+#ifndef NATIVE_FS_H
+#define NATIVE_FS_H
+
+#include <Arduino.h>
+#include <dirent.h>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+// Host directory holding the emulated partitions
+void nativeSetFilesystemRoot(const char* path);
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+// Move-only handle around a host FILE or directory (no heap use of its own)
+class File : public Stream {
+public:
+  File(FILE* handle = nullptr) : handle(handle), dir(nullptr) { entryName[0] = '\0'; }
+  File(DIR* dir, const char* path);
+  File(File&& other);
+  File& operator=(File&& other);
+  File(const File&) = delete;
+  File& operator=(const File&) = delete;
+  ~File() { close(); }
+  
+  operator bool() const { return handle != nullptr || dir != nullptr; }
+  
+  // Directory iteration (name() is the entry's base name)
+  bool isDirectory() const { return dir != nullptr; }
+  File openNextFile();
+  const char* name() const { return entryName; }
+  
+  size_t write(const uint8_t* buffer, size_t size) override;
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t read(uint8_t* buffer, size_t size);
+  int read() override;
+  int available() override;
+  bool seek(uint32_t position, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  void flush();
+  void close();
+  
+private:
+  FILE* handle;
+  DIR* dir;
+  char entryName[64];
+  char dirPath[256];
+};
+
+class FS {
+public:
+  explicit FS(const char* partition) : partition(partition) {}
+  
+  // Mount fails until the partition has been formatted (its directory exists)
+  bool begin(bool formatOnFail = false);
+  File open(const char* path, const char* mode = FILE_READ);
+  File open(const String& path, const char* mode = FILE_READ) { return open(path.c_str(), mode); }
+  bool exists(const char* path);
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool remove(const char* path);
+  bool remove(const String& path) { return remove(path.c_str()); }
+  bool rename(const char* from, const char* to);
+  bool mkdir(const char* path);
+  bool format();
+  size_t totalBytes() { return 1441792; }  // default.csv SPIFFS partition
+  size_t usedBytes();
+  void end() {}
+  
+  // Erase the partition so the next begin() fails (blank or foreign image)
+  bool erase();
+  
+private:
+  const char* partition;
+  
+  // Host path for a partition path
+  void hostPath(const char* path, char* output, size_t size);
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif // NATIVE_FS_H
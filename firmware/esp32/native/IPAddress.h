@@ -0,0 +1,17 @@
+// CarbonReady native shim: IPAddress (IPv4, network byte order)
+
+#ifndef NATIVE_IPADDRESS_H
+#define NATIVE_IPADDRESS_H
+
+#include <stdint.h>
+
+class IPAddress {
+public:
+  IPAddress(uint32_t address = 0) : address(address) {}
+  operator uint32_t() const { return address; }
+  
+private:
+  uint32_t address;
+};
+
+#endif // NATIVE_IPADDRESS_H
@@ -0,0 +1,10 @@
+// CarbonReady native shim: LittleFS
+
+#ifndef NATIVE_LITTLEFS_H
+#define NATIVE_LITTLEFS_H
+
+#include <FS.h>
+
+extern fs::FS LittleFS;
+
+#endif // NATIVE_LITTLEFS_H
@@ -0,0 +1,13 @@
+// CarbonReady native shim: OneWire
+
+#ifndef NATIVE_ONEWIRE_H
+#define NATIVE_ONEWIRE_H
+
+#include <Arduino.h>
+
+class OneWire {
+public:
+  OneWire(uint8_t pin) {}
+};
+
+#endif // NATIVE_ONEWIRE_H
@@ -0,0 +1,30 @@
+// CarbonReady native shim: Preferences (NVS)
+// Each key is a file under <filesystem root>/nvs/<namespace>/
+
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+#include <Arduino.h>
+
+class Preferences {
+public:
+  Preferences() : readOnly(true) { name[0] = '\0'; }
+  
+  // Read-only opens fail until the namespace has been written once
+  bool begin(const char* name, bool readOnly = false);
+  void end() { name[0] = '\0'; }
+  
+  size_t putBytes(const char* key, const void* value, size_t length);
+  size_t getBytes(const char* key, void* buffer, size_t maxLength);
+  bool remove(const char* key);
+  bool clear();
+  
+private:
+  char name[16];
+  bool readOnly;
+  
+  // Host path for a key (or the namespace when key is empty)
+  void keyPath(const char* key, char* output, size_t size);
+};
+
+#endif // NATIVE_PREFERENCES_H
@@ -0,0 +1,116 @@
+// CarbonReady native shim: PubSubClient
+// CONNECT is implied by the transport connecting (the in-process broker
+// behind TlsClient, see native_broker.cpp); QoS 0 PUBLISH packets are
+// written to the transport and loop() reads whatever the broker sent back,
+// a byte at a time like the library.
+
+#ifndef NATIVE_PUBSUBCLIENT_H
+#define NATIVE_PUBSUBCLIENT_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+#define MQTT_MAX_HEADER_SIZE 5
+
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+#define MQTT_CALLBACK_SIGNATURE void (*callback)(char*, uint8_t*, unsigned int)
+
+class PubSubClient {
+public:
+  explicit PubSubClient(Client& client)
+    : client(client), host(""), port(0), bufferSize(256), connectState(MQTT_DISCONNECTED) {}
+  
+  PubSubClient& setServer(const char* host, uint16_t port) {
+    this->host = host;
+    this->port = port;
+    return *this;
+  }
+  
+  PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE) { return *this; }
+  
+  bool setBufferSize(uint16_t size) {
+    bufferSize = size;
+    return true;
+  }
+  
+  uint16_t getBufferSize() { return bufferSize; }
+  
+  bool connect(const char* id) {
+    if (!client.connect(host, port)) {
+      connectState = MQTT_CONNECT_FAILED;
+      return false;
+    }
+    connectState = MQTT_CONNECTED;
+    return true;
+  }
+  
+  bool connected() {
+    if (!client.connected()) {
+      if (connectState == MQTT_CONNECTED) {
+        connectState = MQTT_CONNECTION_LOST;
+        client.stop();
+      }
+      return false;
+    }
+    return true;
+  }
+  
+  bool subscribe(const char* topic, uint8_t qos) { return connected(); }
+  
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length) {
+    if (!connected()) {
+      return false;
+    }
+    
+    size_t topicLength = strlen(topic);
+    uint32_t remaining = 2 + topicLength + length;
+    if (MQTT_MAX_HEADER_SIZE + remaining > bufferSize) {
+      return false;
+    }
+    
+    uint8_t header[MQTT_MAX_HEADER_SIZE + 2];
+    size_t headerLength = 0;
+    header[headerLength++] = 0x30;
+    do {
+      uint8_t digit = remaining & 0x7f;
+      remaining >>= 7;
+      header[headerLength++] = remaining > 0 ? (digit | 0x80) : digit;
+    } while (remaining > 0);
+    header[headerLength++] = topicLength >> 8;
+    header[headerLength++] = topicLength & 0xff;
+    
+    return client.write(header, headerLength) == headerLength &&
+           client.write((const uint8_t*)topic, topicLength) == topicLength &&
+           client.write(payload, length) == length;
+  }
+  
+  bool loop() {
+    if (!connected()) {
+      return false;
+    }
+    while (client.available() > 0) {
+      client.read();
+    }
+    return true;
+  }
+  
+  int state() { return connectState; }
+  
+  void disconnect() {
+    client.stop();
+    connectState = MQTT_DISCONNECTED;
+  }
+  
+private:
+  Client& client;
+  const char* host;
+  uint16_t port;
+  uint16_t bufferSize;
+  int connectState;
+};
+
+#endif // NATIVE_PUBSUBCLIENT_H
@@ -0,0 +1,10 @@
+// CarbonReady native shim: SPIFFS
+
+#ifndef NATIVE_SPIFFS_H
+#define NATIVE_SPIFFS_H
+
+#include <FS.h>
+
+extern fs::FS SPIFFS;
+
+#endif // NATIVE_SPIFFS_H
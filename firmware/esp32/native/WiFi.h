@@ -0,0 +1,28 @@
+// CarbonReady native shim: WiFi (station always connected)
+
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+typedef enum { WL_IDLE_STATUS = 0, WL_CONNECTED = 3, WL_DISCONNECTED = 6 } wl_status_t;
+
+class WiFiClass {
+public:
+  wl_status_t status() { return WL_CONNECTED; }
+  int8_t RSSI() { return -60; }
+  uint8_t* BSSID() { return bssid; }
+  int32_t channel() { return 6; }
+  IPAddress localIP() { return IPAddress(0x6401a8c0); }
+  IPAddress gatewayIP() { return IPAddress(0x0101a8c0); }
+  IPAddress subnetMask() { return IPAddress(0x00ffffff); }
+  IPAddress dnsIP() { return IPAddress(0x0101a8c0); }
+  
+private:
+  uint8_t bssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+};
+
+extern WiFiClass WiFi;
+
+#endif // NATIVE_WIFI_H
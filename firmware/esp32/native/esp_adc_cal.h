@@ -0,0 +1,27 @@
+// CarbonReady native shim: ADC calibration (ideal linear response)
+
+#ifndef NATIVE_ESP_ADC_CAL_H
+#define NATIVE_ESP_ADC_CAL_H
+
+#include <driver/adc.h>
+
+typedef enum {
+  ESP_ADC_CAL_VAL_EFUSE_VREF = 0,
+  ESP_ADC_CAL_VAL_EFUSE_TP = 1,
+  ESP_ADC_CAL_VAL_DEFAULT_VREF = 2
+} esp_adc_cal_value_t;
+
+typedef struct { uint32_t vref; } esp_adc_cal_characteristics_t;
+
+inline esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t unit, adc_atten_t atten,
+                                                    adc_bits_width_t width, uint32_t vref,
+                                                    esp_adc_cal_characteristics_t* chars) {
+  chars->vref = vref;
+  return ESP_ADC_CAL_VAL_DEFAULT_VREF;
+}
+
+inline uint32_t esp_adc_cal_raw_to_voltage(uint32_t raw, const esp_adc_cal_characteristics_t* chars) {
+  return raw * 3300 / 4095;
+}
+
+#endif // NATIVE_ESP_ADC_CAL_H
@@ -0,0 +1,25 @@
+// CarbonReady native shim: FreeRTOS critical sections and ticks
+// (single-threaded host, one tick per millisecond)
+
+#ifndef NATIVE_FREERTOS_H
+#define NATIVE_FREERTOS_H
+
+#include <stdint.h>
+
+typedef struct { uint32_t owner; } portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY 0xffffffffUL
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#endif // NATIVE_FREERTOS_H
@@ -0,0 +1,16 @@
+// CarbonReady native shim: FreeRTOS semaphores (single-threaded host:
+// takes always succeed)
+
+#ifndef NATIVE_FREERTOS_SEMPHR_H
+#define NATIVE_FREERTOS_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+typedef void* SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+
+#define xSemaphoreTake(semaphore, ticks) ((void)(semaphore), (void)(ticks), pdTRUE)
+#define xSemaphoreGive(semaphore) ((void)(semaphore), pdTRUE)
+
+#endif // NATIVE_FREERTOS_SEMPHR_H
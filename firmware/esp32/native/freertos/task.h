@@ -0,0 +1,22 @@
+// CarbonReady native shim: FreeRTOS tasks (single-threaded host: task
+// creation fails, so the firmware modules run inline)
+
+#ifndef NATIVE_FREERTOS_TASK_H
+#define NATIVE_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+// Always pdFAIL
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackSize,
+                                   void* parameter, uint32_t priority, TaskHandle_t* handle,
+                                   BaseType_t core);
+
+void vTaskDelay(TickType_t ticks);
+
+// Minimum free stack a task has had, in bytes (fixed on the host)
+uint32_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+#endif // NATIVE_FREERTOS_TASK_H
@@ -0,0 +1,9 @@
+// CarbonReady native shim: mbedtls ctr_drbg (types only; TlsClient is replaced by
+// the in-process broker in native_broker.cpp)
+
+#ifndef NATIVE_MBEDTLS_CTR_DRBG_H
+#define NATIVE_MBEDTLS_CTR_DRBG_H
+
+typedef struct { int unused; } mbedtls_ctr_drbg_context;
+
+#endif // NATIVE_MBEDTLS_CTR_DRBG_H
@@ -0,0 +1,9 @@
+// CarbonReady native shim: mbedtls entropy (types only; TlsClient is replaced by
+// the in-process broker in native_broker.cpp)
+
+#ifndef NATIVE_MBEDTLS_ENTROPY_H
+#define NATIVE_MBEDTLS_ENTROPY_H
+
+typedef struct { int unused; } mbedtls_entropy_context;
+
+#endif // NATIVE_MBEDTLS_ENTROPY_H
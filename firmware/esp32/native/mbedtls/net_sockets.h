@@ -0,0 +1,9 @@
+// CarbonReady native shim: mbedtls net_sockets (types only; TlsClient is replaced by
+// the in-process broker in native_broker.cpp)
+
+#ifndef NATIVE_MBEDTLS_NET_SOCKETS_H
+#define NATIVE_MBEDTLS_NET_SOCKETS_H
+
+typedef struct { int unused; } mbedtls_net_context;
+
+#endif // NATIVE_MBEDTLS_NET_SOCKETS_H
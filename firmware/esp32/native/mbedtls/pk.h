@@ -0,0 +1,9 @@
+// CarbonReady native shim: mbedtls pk (types only; TlsClient is replaced by
+// the in-process broker in native_broker.cpp)
+
+#ifndef NATIVE_MBEDTLS_PK_H
+#define NATIVE_MBEDTLS_PK_H
+
+typedef struct { int unused; } mbedtls_pk_context;
+
+#endif // NATIVE_MBEDTLS_PK_H
@@ -0,0 +1,21 @@
+// CarbonReady native shim: mbedtls SHA-256 (portable implementation)
+
+#ifndef NATIVE_MBEDTLS_SHA256_H
+#define NATIVE_MBEDTLS_SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct {
+  uint32_t total[2];
+  uint32_t state[8];
+  unsigned char buffer[64];
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx);
+int mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t length);
+int mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char output[32]);
+
+#endif // NATIVE_MBEDTLS_SHA256_H
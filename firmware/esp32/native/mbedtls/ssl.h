@@ -0,0 +1,10 @@
+// CarbonReady native shim: mbedtls ssl (types only; TlsClient is replaced by
+// the in-process broker in native_broker.cpp)
+
+#ifndef NATIVE_MBEDTLS_SSL_H
+#define NATIVE_MBEDTLS_SSL_H
+
+typedef struct { int unused; } mbedtls_ssl_context;
+typedef struct { int unused; } mbedtls_ssl_config;
+
+#endif // NATIVE_MBEDTLS_SSL_H
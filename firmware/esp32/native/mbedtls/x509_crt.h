@@ -0,0 +1,9 @@
+// CarbonReady native shim: mbedtls x509_crt (types only; TlsClient is replaced by
+// the in-process broker in native_broker.cpp)
+
+#ifndef NATIVE_MBEDTLS_X509_CRT_H
+#define NATIVE_MBEDTLS_X509_CRT_H
+
+typedef struct { int unused; } mbedtls_x509_crt;
+
+#endif // NATIVE_MBEDTLS_X509_CRT_H
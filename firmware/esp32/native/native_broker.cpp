@@ -0,0 +1,239 @@
+// CarbonReady native shims: in-process MQTT broker
+// Stands in for TlsClient on the host, so MQTTClientManager and
+// PublishPipeline run unchanged: PUBLISH packets written to the connection
+// are counted, and QoS 1 ones are answered with a PUBACK that can be read
+// back nativeBroker.pubackDelayMs later
+
+#include <Arduino.h>
+#include "tls_client.h"
+
+NativeBrokerState nativeBroker = {true, 0, 0, 0, 0};
+
+// MQTT control packet types (upper nibble of the fixed header)
+#define BROKER_PACKET_PUBLISH 0x30
+#define BROKER_PACKET_PUBACK 0x40
+
+// PUBACKs the broker can hold for the client
+#define BROKER_PUBACK_QUEUE 16
+
+class InProcessBroker {
+public:
+  void open() {
+    frameState = FRAME_HEADER;
+    pubackHead = 0;
+    pubackCount = 0;
+    pubackOffset = 0;
+  }
+  
+  // Bytes written by the client
+  void receive(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      receive(data[i]);
+    }
+  }
+  
+  // Bytes of PUBACKs whose round trip has passed
+  int available() {
+    int bytes = 0;
+    for (int i = 0; i < pubackCount && due(i); i++) {
+      bytes += 4;
+    }
+    return bytes > 0 ? bytes - pubackOffset : 0;
+  }
+  
+  int read() {
+    if (pubackCount == 0 || !due(0)) {
+      return -1;
+    }
+    
+    const Puback& puback = pubacks[pubackHead];
+    uint8_t packet[4] = {BROKER_PACKET_PUBACK, 0x02,
+                         (uint8_t)(puback.packetId >> 8), (uint8_t)(puback.packetId & 0xff)};
+    int b = packet[pubackOffset++];
+    if (pubackOffset == sizeof(packet)) {
+      pubackHead = (pubackHead + 1) % BROKER_PUBACK_QUEUE;
+      pubackCount--;
+      pubackOffset = 0;
+    }
+    return b;
+  }
+  
+private:
+  enum FrameState { FRAME_HEADER, FRAME_LENGTH, FRAME_BODY };
+  
+  FrameState frameState;
+  uint8_t frameType;
+  uint8_t frameQos;
+  uint32_t frameRemaining;
+  uint32_t lengthMultiplier;
+  uint32_t frameOffset;
+  uint16_t topicLength;
+  uint16_t packetId;
+  
+  struct Puback {
+    uint16_t packetId;
+    unsigned long dueAt;
+  };
+  
+  Puback pubacks[BROKER_PUBACK_QUEUE];
+  int pubackHead;
+  int pubackCount;
+  int pubackOffset;  // Bytes of the front PUBACK already read
+  
+  bool due(int index) {
+    const Puback& puback = pubacks[(pubackHead + index) % BROKER_PUBACK_QUEUE];
+    return (long)(millis() - puback.dueAt) >= 0;
+  }
+  
+  void receive(uint8_t b) {
+    switch (frameState) {
+      case FRAME_HEADER:
+        frameType = b & 0xf0;
+        frameQos = (b >> 1) & 0x03;
+        frameRemaining = 0;
+        lengthMultiplier = 1;
+        frameState = FRAME_LENGTH;
+        break;
+      
+      case FRAME_LENGTH:
+        frameRemaining += (b & 0x7f) * lengthMultiplier;
+        lengthMultiplier <<= 7;
+        if (b & 0x80) {
+          break;
+        }
+        frameOffset = 0;
+        topicLength = 0;
+        packetId = 0;
+        frameState = FRAME_BODY;
+        if (frameRemaining == 0) {
+          completeFrame();
+        }
+        break;
+      
+      case FRAME_BODY:
+        // PUBLISH variable header: topic length, topic, packet ID (QoS > 0)
+        if (frameOffset < 2) {
+          topicLength = (topicLength << 8) | b;
+        } else if (frameQos > 0 && frameOffset >= 2u + topicLength && frameOffset < 4u + topicLength) {
+          packetId = (packetId << 8) | b;
+        }
+        frameOffset++;
+        if (frameOffset == frameRemaining) {
+          completeFrame();
+        }
+        break;
+    }
+  }
+  
+  void completeFrame() {
+    frameState = FRAME_HEADER;
+    if (frameType != BROKER_PACKET_PUBLISH) {
+      return;
+    }
+    
+    uint32_t headerLength = 2 + topicLength + (frameQos > 0 ? 2 : 0);
+    nativeBroker.publishes++;
+    nativeBroker.publishedBytes += frameRemaining > headerLength ? frameRemaining - headerLength : 0;
+    
+    if (frameQos == 1 && pubackCount < BROKER_PUBACK_QUEUE) {
+      Puback& puback = pubacks[(pubackHead + pubackCount) % BROKER_PUBACK_QUEUE];
+      puback.packetId = packetId;
+      puback.dueAt = millis() + nativeBroker.pubackDelayMs;
+      pubackCount++;
+    }
+  }
+};
+
+// One connection at a time on the host
+static InProcessBroker broker;
+
+TlsClient::TlsClient() {
+  configured = false;
+  sessionOpen = false;
+  resumed = false;
+  handshakeMs = 0;
+  peekByte = -1;
+}
+
+TlsClient::~TlsClient() {
+}
+
+bool TlsClient::begin(const char* rootCA, const char* deviceCert, const char* deviceKey) {
+  configured = true;
+  return true;
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port) {
+  return connect("broker", port);
+}
+
+int TlsClient::connect(const char* host, uint16_t port) {
+  if (!nativeBroker.online) {
+    return 0;
+  }
+  
+  broker.open();
+  sessionOpen = true;
+  nativeBroker.connects++;
+  return 1;
+}
+
+size_t TlsClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t TlsClient::write(const uint8_t* buf, size_t size) {
+  if (!connected()) {
+    return 0;
+  }
+  
+  broker.receive(buf, size);
+  return size;
+}
+
+int TlsClient::available() {
+  return connected() ? broker.available() : 0;
+}
+
+int TlsClient::read() {
+  return connected() ? broker.read() : -1;
+}
+
+int TlsClient::read(uint8_t* buf, size_t size) {
+  size_t count = 0;
+  int b;
+  while (count < size && (b = read()) >= 0) {
+    buf[count++] = b;
+  }
+  return count > 0 ? (int)count : -1;
+}
+
+int TlsClient::peek() {
+  return -1;
+}
+
+void TlsClient::flush() {
+}
+
+void TlsClient::stop() {
+  sessionOpen = false;
+}
+
+uint8_t TlsClient::connected() {
+  // Taking the broker offline drops the open connection
+  if (sessionOpen && !nativeBroker.online) {
+    stop();
+  }
+  return sessionOpen;
+}
+
+bool TlsClient::lastHandshakeResumed() {
+  return resumed;
+}
+
+unsigned long TlsClient::lastHandshakeMs() {
+  return handshakeMs;
+}
+
+void TlsClient::clearSession() {
+}
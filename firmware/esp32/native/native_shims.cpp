@@ -0,0 +1,769 @@
+// CarbonReady native shims
+// Host implementations behind the headers in this directory
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SPIFFS.h>
+#include <LittleFS.h>
+#include <WiFi.h>
+#include <Preferences.h>
+#include <mbedtls/sha256.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <cstddef>
+#include <chrono>
+#include <thread>
+#include <new>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+WiFiClass WiFi;
+fs::FS SPIFFS("spiffs");
+fs::FS LittleFS("littlefs");
+NativeSensorValues nativeSensors = {22.5, 65.0, 18.25, 2200, 1, {}, 0, 0};
+
+static bool serialOutput = true;
+static uint32_t allocationCount = 0;
+static char filesystemRoot[256] = ".pio/native_fs";
+
+// ============================================================================
+// Allocation counting
+// ============================================================================
+
+// Live and peak heap bytes for ESP.getFreeHeap() and ESP.getMinFreeHeap().
+// Each operator new block is prefixed with its size; String buffers are
+// counted by capacity.
+static const size_t ALLOCATION_HEADER = alignof(std::max_align_t);
+static size_t liveHeapBytes = 0;
+static size_t peakHeapBytes = 0;
+
+static void heapAllocated(size_t size) {
+  liveHeapBytes += size;
+  peakHeapBytes = max(peakHeapBytes, liveHeapBytes);
+}
+
+void* operator new(size_t size) {
+  allocationCount++;
+  uint8_t* block = (uint8_t*)malloc(ALLOCATION_HEADER + size);
+  if (!block) {
+    throw std::bad_alloc();
+  }
+  
+  *(size_t*)block = size;
+  heapAllocated(size);
+  return block + ALLOCATION_HEADER;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+  if (!pointer) {
+    return;
+  }
+  
+  uint8_t* block = (uint8_t*)pointer - ALLOCATION_HEADER;
+  liveHeapBytes -= *(size_t*)block;
+  free(block);
+}
+
+void operator delete[](void* pointer) noexcept {
+  operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t size) noexcept {
+  operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t size) noexcept {
+  operator delete(pointer);
+}
+
+uint32_t nativeAllocationCount() {
+  return allocationCount;
+}
+
+bool nativePsramAvailable = true;
+
+bool psramFound() {
+  return nativePsramAvailable;
+}
+
+void* ps_malloc(size_t size) {
+  return nativePsramAvailable ? malloc(size) : nullptr;
+}
+
+uint32_t EspClass::getFreeHeap() {
+  return NATIVE_HEAP_SIZE - min(liveHeapBytes, (size_t)NATIVE_HEAP_SIZE);
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  return NATIVE_HEAP_SIZE - min(peakHeapBytes, (size_t)NATIVE_HEAP_SIZE);
+}
+
+uint32_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  return 2048;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackSize,
+                                   void* parameter, uint32_t priority, TaskHandle_t* handle,
+                                   BaseType_t core) {
+  return pdFAIL;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  delay(ticks);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  static int mutex;
+  return &mutex;
+}
+
+// ============================================================================
+// String
+// ============================================================================
+
+String::String(const char* text) : buffer(nullptr), len(0), capacity(0) {
+  append(text ? text : "", text ? strlen(text) : 0);
+}
+
+String::String(const String& other) : buffer(nullptr), len(0), capacity(0) {
+  append(other.buffer, other.len);
+}
+
+String::~String() {
+  liveHeapBytes -= capacity;
+  free(buffer);
+}
+
+String& String::operator=(const String& other) {
+  if (this != &other) {
+    len = 0;
+    append(other.buffer, other.len);
+  }
+  return *this;
+}
+
+String& String::operator+=(const String& other) {
+  append(other.buffer, other.len);
+  return *this;
+}
+
+String& String::operator+=(const char* text) {
+  append(text, strlen(text));
+  return *this;
+}
+
+String& String::operator+=(char c) {
+  append(&c, 1);
+  return *this;
+}
+
+String operator+(const String& a, const String& b) {
+  String result(a);
+  result += b;
+  return result;
+}
+
+String operator+(const String& a, const char* b) {
+  String result(a);
+  result += b;
+  return result;
+}
+
+String operator+(const char* a, const String& b) {
+  String result(a);
+  result += b;
+  return result;
+}
+
+bool String::reserve(size_t size) {
+  if (size + 1 <= capacity) {
+    return true;
+  }
+  
+  char* grown = (char*)realloc(buffer, size + 1);
+  if (!grown) {
+    return false;
+  }
+  
+  allocationCount++;
+  if (!buffer) {
+    grown[0] = '\0';
+  }
+  liveHeapBytes -= capacity;
+  heapAllocated(size + 1);
+  buffer = grown;
+  capacity = size + 1;
+  return true;
+}
+
+void String::trim() {
+  size_t start = 0;
+  while (start < len && isspace((unsigned char)buffer[start])) {
+    start++;
+  }
+  
+  size_t end = len;
+  while (end > start && isspace((unsigned char)buffer[end - 1])) {
+    end--;
+  }
+  
+  memmove(buffer, buffer + start, end - start);
+  len = end - start;
+  buffer[len] = '\0';
+}
+
+void String::append(const char* text, size_t size) {
+  if (!reserve(max(len + size, (size_t)15))) {
+    return;
+  }
+  
+  memcpy(buffer + len, text, size);
+  len += size;
+  buffer[len] = '\0';
+}
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char* destination, const char* source, size_t size) {
+  size_t length = strlen(source);
+  if (size > 0) {
+    size_t copied = min(length, size - 1);
+    memcpy(destination, source, copied);
+    destination[copied] = '\0';
+  }
+  return length;
+}
+#endif
+
+// ============================================================================
+// Serial
+// ============================================================================
+
+void nativeSetSerialOutput(bool enabled) {
+  serialOutput = enabled;
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  return size;
+}
+
+size_t Print::printf(const char* format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  
+  if (length < 0) {
+    return 0;
+  }
+  return write((const uint8_t*)buffer, min((size_t)length, sizeof(buffer) - 1));
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  if (serialOutput) {
+    fwrite(buffer, 1, size, stdout);
+  }
+  return size;
+}
+
+String Stream::readStringUntil(char terminator) {
+  String result;
+  int c;
+  while ((c = read()) >= 0 && c != terminator) {
+    result += (char)c;
+  }
+  return result;
+}
+
+// ============================================================================
+// Timing and GPIO
+// ============================================================================
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long micros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+int analogRead(uint8_t pin) {
+  return nativeSensors.soilMoistureRaw;
+}
+
+int8_t digitalPinToAnalogChannel(uint8_t pin) {
+  return pin == 34 ? 6 : -1;
+}
+
+// ============================================================================
+// Filesystem
+// ============================================================================
+
+void nativeSetFilesystemRoot(const char* path) {
+  snprintf(filesystemRoot, sizeof(filesystemRoot), "%s", path);
+}
+
+namespace fs {
+
+File::File(DIR* dir, const char* path) : handle(nullptr), dir(dir) {
+  entryName[0] = '\0';
+  snprintf(dirPath, sizeof(dirPath), "%s", path);
+}
+
+File::File(File&& other) : handle(nullptr), dir(nullptr) {
+  *this = static_cast<File&&>(other);
+}
+
+File& File::operator=(File&& other) {
+  if (this != &other) {
+    close();
+    handle = other.handle;
+    dir = other.dir;
+    memcpy(entryName, other.entryName, sizeof(entryName));
+    memcpy(dirPath, other.dirPath, sizeof(dirPath));
+    other.handle = nullptr;
+    other.dir = nullptr;
+  }
+  return *this;
+}
+
+File File::openNextFile() {
+  struct dirent* entry;
+  while (dir && (entry = readdir(dir)) != nullptr) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    
+    char path[600];
+    snprintf(path, sizeof(path), "%s/%s", dirPath, entry->d_name);
+    
+    DIR* child = opendir(path);
+    File file = child ? File(child, path) : File(fopen(path, "r"));
+    snprintf(file.entryName, sizeof(file.entryName), "%s", entry->d_name);
+    return file;
+  }
+  return File();
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+  return handle ? fwrite(buffer, 1, size, handle) : 0;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+  return handle ? fread(buffer, 1, size, handle) : 0;
+}
+
+int File::read() {
+  return handle ? fgetc(handle) : -1;
+}
+
+int File::available() {
+  return handle ? (int)(size() - position()) : 0;
+}
+
+bool File::seek(uint32_t position, SeekMode mode) {
+  static const int whence[] = {SEEK_SET, SEEK_CUR, SEEK_END};
+  return handle && fseek(handle, position, whence[mode]) == 0;
+}
+
+size_t File::position() const {
+  return handle ? ftell(handle) : 0;
+}
+
+size_t File::size() const {
+  struct stat info;
+  if (!handle) {
+    return 0;
+  }
+  fflush(handle);
+  return fstat(fileno(handle), &info) == 0 ? info.st_size : 0;
+}
+
+void File::flush() {
+  if (handle) {
+    fflush(handle);
+  }
+}
+
+void File::close() {
+  if (handle) {
+    fclose(handle);
+    handle = nullptr;
+  }
+  if (dir) {
+    closedir(dir);
+    dir = nullptr;
+  }
+}
+
+void FS::hostPath(const char* path, char* output, size_t size) {
+  snprintf(output, size, "%s/%s%s", filesystemRoot, partition, path);
+}
+
+bool FS::begin(bool formatOnFail) {
+  char path[320];
+  hostPath("", path, sizeof(path));
+  
+  if (access(path, W_OK) == 0) {
+    return true;
+  }
+  return formatOnFail && format();
+}
+
+File FS::open(const char* path, const char* mode) {
+  char host[320];
+  hostPath(path, host, sizeof(host));
+  
+  DIR* dir = opendir(host);
+  if (dir) {
+    return File(dir, host);
+  }
+  
+  // Arduino "r+" opens for update; "w" and "a" create
+  return File(fopen(host, mode));
+}
+
+bool FS::exists(const char* path) {
+  char host[320];
+  hostPath(path, host, sizeof(host));
+  return access(host, F_OK) == 0;
+}
+
+bool FS::remove(const char* path) {
+  char host[320];
+  hostPath(path, host, sizeof(host));
+  return ::remove(host) == 0;
+}
+
+bool FS::rename(const char* from, const char* to) {
+  char hostFrom[320];
+  char hostTo[320];
+  hostPath(from, hostFrom, sizeof(hostFrom));
+  hostPath(to, hostTo, sizeof(hostTo));
+  return ::rename(hostFrom, hostTo) == 0;
+}
+
+bool FS::mkdir(const char* path) {
+  char host[320];
+  hostPath(path, host, sizeof(host));
+  return ::mkdir(host, 0755) == 0;
+}
+
+// Remove everything under a host directory (the tiers nest one level deeper)
+static void removeTree(const char* host) {
+  DIR* dir = opendir(host);
+  if (!dir) {
+    return;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    char file[600];
+    snprintf(file, sizeof(file), "%s/%s", host, entry->d_name);
+    removeTree(file);
+    ::remove(file);
+  }
+  closedir(dir);
+}
+
+bool FS::format() {
+  char host[320];
+  hostPath("", host, sizeof(host));
+  
+  // Remove the partition tree
+  if (access(host, F_OK) == 0) {
+    removeTree(host);
+    return true;
+  }
+  
+  // Create the partition directory and any missing parents
+  for (char* slash = strchr(host + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    ::mkdir(host, 0755);
+    *slash = '/';
+  }
+  return ::mkdir(host, 0755) == 0;
+}
+
+bool FS::erase() {
+  char host[320];
+  hostPath("", host, sizeof(host));
+  
+  if (access(host, F_OK) != 0) {
+    return true;
+  }
+  return format() && ::remove(host) == 0;
+}
+
+size_t FS::usedBytes() {
+  char host[320];
+  hostPath("", host, sizeof(host));
+  
+  DIR* dir = opendir(host);
+  if (!dir) {
+    return 0;
+  }
+  
+  size_t used = 0;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    char file[600];
+    struct stat info;
+    snprintf(file, sizeof(file), "%s/%s", host, entry->d_name);
+    if (entry->d_name[0] != '.' && stat(file, &info) == 0) {
+      used += info.st_size;
+    }
+  }
+  closedir(dir);
+  return used;
+}
+
+} // namespace fs
+
+// ============================================================================
+// Preferences
+// ============================================================================
+
+void Preferences::keyPath(const char* key, char* output, size_t size) {
+  snprintf(output, size, "%s/nvs/%s%s%s", filesystemRoot, name, key[0] ? "/" : "", key);
+}
+
+bool Preferences::begin(const char* name, bool readOnly) {
+  snprintf(this->name, sizeof(this->name), "%s", name);
+  this->readOnly = readOnly;
+  
+  char path[320];
+  keyPath("", path, sizeof(path));
+  if (access(path, F_OK) == 0) {
+    return true;
+  }
+  if (readOnly) {
+    this->name[0] = '\0';
+    return false;
+  }
+  
+  // Create <root>/nvs/<name> and any missing parents
+  for (char* slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    ::mkdir(path, 0755);
+    *slash = '/';
+  }
+  return ::mkdir(path, 0755) == 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) {
+  char path[320];
+  if (readOnly || !name[0]) {
+    return 0;
+  }
+  keyPath(key, path, sizeof(path));
+  
+  FILE* file = fopen(path, "wb");
+  if (!file) {
+    return 0;
+  }
+  size_t written = fwrite(value, 1, length, file);
+  fclose(file);
+  return written;
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t maxLength) {
+  char path[320];
+  if (!name[0]) {
+    return 0;
+  }
+  keyPath(key, path, sizeof(path));
+  
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    return 0;
+  }
+  
+  // Like NVS, a blob longer than the buffer is not read at all
+  fseek(file, 0, SEEK_END);
+  size_t length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  size_t read = length <= maxLength ? fread(buffer, 1, length, file) : 0;
+  fclose(file);
+  return read;
+}
+
+bool Preferences::remove(const char* key) {
+  char path[320];
+  if (readOnly || !name[0]) {
+    return false;
+  }
+  keyPath(key, path, sizeof(path));
+  return ::remove(path) == 0;
+}
+
+bool Preferences::clear() {
+  char path[320];
+  if (readOnly || !name[0]) {
+    return false;
+  }
+  keyPath("", path, sizeof(path));
+  
+  DIR* dir = opendir(path);
+  if (!dir) {
+    return false;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    char file[600];
+    snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+    if (entry->d_name[0] != '.') {
+      ::remove(file);
+    }
+  }
+  closedir(dir);
+  return true;
+}
+
+// ============================================================================
+// SHA-256 (FIPS 180-4)
+// ============================================================================
+
+static const uint32_t SHA256_K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256Block(mbedtls_sha256_context* ctx, const unsigned char* block) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++) {
+    w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+           ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+  }
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  
+  uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+  uint32_t e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+  
+  for (int i = 0; i < 64; i++) {
+    uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+    uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  
+  ctx->state[0] += a;
+  ctx->state[1] += b;
+  ctx->state[2] += c;
+  ctx->state[3] += d;
+  ctx->state[4] += e;
+  ctx->state[5] += f;
+  ctx->state[6] += g;
+  ctx->state[7] += h;
+}
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx) {
+  memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx) {
+  memset(ctx, 0, sizeof(*ctx));
+}
+
+int mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224) {
+  static const uint32_t initial[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  memcpy(ctx->state, initial, sizeof(initial));
+  ctx->total[0] = 0;
+  ctx->total[1] = 0;
+  return 0;
+}
+
+int mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t length) {
+  size_t fill = ctx->total[0] & 63;
+  
+  ctx->total[0] += length;
+  if (ctx->total[0] < length) {
+    ctx->total[1]++;
+  }
+  
+  if (fill && fill + length >= 64) {
+    memcpy(ctx->buffer + fill, input, 64 - fill);
+    sha256Block(ctx, ctx->buffer);
+    input += 64 - fill;
+    length -= 64 - fill;
+    fill = 0;
+  }
+  
+  while (length >= 64) {
+    sha256Block(ctx, input);
+    input += 64;
+    length -= 64;
+  }
+  
+  memcpy(ctx->buffer + fill, input, length);
+  return 0;
+}
+
+int mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char output[32]) {
+  uint64_t bits = ((uint64_t)ctx->total[1] << 32 | ctx->total[0]) << 3;
+  size_t fill = ctx->total[0] & 63;
+  
+  ctx->buffer[fill++] = 0x80;
+  if (fill > 56) {
+    memset(ctx->buffer + fill, 0, 64 - fill);
+    sha256Block(ctx, ctx->buffer);
+    fill = 0;
+  }
+  memset(ctx->buffer + fill, 0, 56 - fill);
+  for (int i = 0; i < 8; i++) {
+    ctx->buffer[56 + i] = (unsigned char)(bits >> (56 - i * 8));
+  }
+  sha256Block(ctx, ctx->buffer);
+  
+  for (int i = 0; i < 8; i++) {
+    output[i * 4] = (unsigned char)(ctx->state[i] >> 24);
+    output[i * 4 + 1] = (unsigned char)(ctx->state[i] >> 16);
+    output[i * 4 + 2] = (unsigned char)(ctx->state[i] >> 8);
+    output[i * 4 + 3] = (unsigned char)ctx->state[i];
+  }
+  return 0;
+}
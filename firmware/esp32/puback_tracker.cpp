@@ -0,0 +1,146 @@
+// CarbonReady PUBACK Tracker Implementation
+
+#include "puback_tracker.h"
+
+// MQTT control packet type of PUBACK (upper nibble of the fixed header)
+#define MQTT_PACKET_PUBACK 0x40
+
+PubackTracker::PubackTracker(int window) {
+  this->window = constrain(window, 1, MQTT_INFLIGHT_WINDOW);
+  nextPacketId = 1;
+  
+  for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+    slots[i].packetId = 0;
+    slots[i].status = PUBACK_LOST;
+  }
+  
+  reset();
+}
+
+uint16_t PubackTracker::track() {
+  Slot* slot = find(0);
+  if (slot == nullptr) {
+    return 0;
+  }
+  
+  // Packet ID 0 is reserved; skip IDs that are still tracked after a wrap
+  uint16_t packetId;
+  do {
+    packetId = nextPacketId++;
+    if (nextPacketId == 0) {
+      nextPacketId = 1;
+    }
+  } while (find(packetId) != nullptr);
+  
+  slot->packetId = packetId;
+  slot->status = PUBACK_PENDING;
+  return packetId;
+}
+
+PubackStatus PubackTracker::status(uint16_t packetId) {
+  Slot* slot = packetId != 0 ? find(packetId) : nullptr;
+  return slot != nullptr ? slot->status : PUBACK_LOST;
+}
+
+void PubackTracker::release(uint16_t packetId) {
+  Slot* slot = packetId != 0 ? find(packetId) : nullptr;
+  if (slot != nullptr) {
+    slot->packetId = 0;
+    slot->status = PUBACK_LOST;
+  }
+}
+
+int PubackTracker::pendingCount() {
+  int pending = 0;
+  for (int i = 0; i < window; i++) {
+    if (slots[i].packetId != 0 && slots[i].status == PUBACK_PENDING) {
+      pending++;
+    }
+  }
+  return pending;
+}
+
+int PubackTracker::freeCount() {
+  int free = 0;
+  for (int i = 0; i < window; i++) {
+    if (slots[i].packetId == 0) {
+      free++;
+    }
+  }
+  return free;
+}
+
+void PubackTracker::received(const uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    receive(data[i]);
+  }
+}
+
+void PubackTracker::reset() {
+  frameState = FRAME_HEADER;
+  frameType = 0;
+  frameRemaining = 0;
+  lengthMultiplier = 1;
+  frameOffset = 0;
+  frameValue = 0;
+  
+  for (int i = 0; i < window; i++) {
+    if (slots[i].status == PUBACK_PENDING) {
+      slots[i].status = PUBACK_LOST;
+    }
+  }
+}
+
+PubackTracker::Slot* PubackTracker::find(uint16_t packetId) {
+  for (int i = 0; i < window; i++) {
+    if (slots[i].packetId == packetId) {
+      return &slots[i];
+    }
+  }
+  return nullptr;
+}
+
+void PubackTracker::receive(uint8_t b) {
+  switch (frameState) {
+    case FRAME_HEADER:
+      frameType = b & 0xf0;
+      frameRemaining = 0;
+      lengthMultiplier = 1;
+      frameState = FRAME_LENGTH;
+      break;
+    
+    case FRAME_LENGTH:
+      // Remaining length: 7 bits per byte, least significant first
+      frameRemaining += (b & 0x7f) * lengthMultiplier;
+      lengthMultiplier <<= 7;
+      if (b & 0x80) {
+        break;
+      }
+      frameOffset = 0;
+      frameValue = 0;
+      frameState = frameRemaining > 0 ? FRAME_BODY : FRAME_HEADER;
+      break;
+    
+    case FRAME_BODY:
+      // A PUBACK body is the packet ID, most significant byte first
+      if (frameType == MQTT_PACKET_PUBACK && frameOffset < 2) {
+        frameValue = (frameValue << 8) | b;
+      }
+      frameOffset++;
+      
+      if (frameOffset == frameRemaining) {
+        if (frameType == MQTT_PACKET_PUBACK && frameRemaining == 2) {
+          acknowledge(frameValue);
+        }
+        frameState = FRAME_HEADER;
+      }
+      break;
+  }
+}
+
+void PubackTracker::acknowledge(uint16_t packetId) {
+  Slot* slot = packetId != 0 ? find(packetId) : nullptr;
+  if (slot != nullptr && slot->status == PUBACK_PENDING) {
+    slot->status = PUBACK_RECEIVED;
+  }
+}
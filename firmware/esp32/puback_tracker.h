@@ -0,0 +1,90 @@
+// CarbonReady PUBACK Tracker
+// Packet IDs of QoS 1 publishes and the PUBACKs that confirm them
+//
+// PubSubClient only publishes at QoS 0 and drops PUBACK packets in loop(),
+// so MQTTClientManager writes QoS 1 PUBLISH packets itself and feeds every
+// byte PubSubClient reads from the socket through received(). The tracker
+// frames the inbound stream (fixed header, remaining length, body) and
+// marks the packet ID of each PUBACK as acknowledged; everything else is
+// skipped without buffering.
+//
+// Up to `window` publishes are tracked at once. A slot stays in use until
+// the caller release()s it, so an acknowledgement is never missed between
+// polls. The session is clean, so after a reconnect the broker will not
+// acknowledge anything sent before it: reset() marks those publishes lost.
+
+#ifndef PUBACK_TRACKER_H
+#define PUBACK_TRACKER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+static_assert(MQTT_INFLIGHT_WINDOW >= 1, "MQTT_INFLIGHT_WINDOW must be at least 1");
+
+enum PubackStatus {
+  PUBACK_PENDING,   // Sent, not acknowledged yet
+  PUBACK_RECEIVED,  // Broker acknowledged it
+  PUBACK_LOST       // Connection reset first, or not a tracked packet ID
+};
+
+class PubackTracker {
+public:
+  PubackTracker(int window = MQTT_INFLIGHT_WINDOW);
+  
+  // Allocate the next packet ID (never 0) and track it. Returns 0 if the
+  // window is full.
+  uint16_t track();
+  
+  // Acknowledgement state of a tracked packet ID
+  PubackStatus status(uint16_t packetId);
+  
+  // Stop tracking a packet ID (frees its slot; a late PUBACK is ignored)
+  void release(uint16_t packetId);
+  
+  // Packet IDs waiting for a PUBACK
+  int pendingCount();
+  
+  // Slots free for track()
+  int freeCount();
+  
+  // Feed bytes read from the connection
+  void received(const uint8_t* data, size_t length);
+  
+  // New connection: restart framing and mark pending publishes lost
+  void reset();
+  
+private:
+  struct Slot {
+    uint16_t packetId;  // 0: free
+    PubackStatus status;
+  };
+  
+  Slot slots[MQTT_INFLIGHT_WINDOW];
+  int window;
+  uint16_t nextPacketId;
+  
+  // Inbound framing state
+  enum FrameState {
+    FRAME_HEADER,   // Waiting for a fixed header byte
+    FRAME_LENGTH,   // Reading the remaining length varint
+    FRAME_BODY      // Skipping (or, for PUBACK, reading) the body
+  };
+  
+  FrameState frameState;
+  uint8_t frameType;
+  uint32_t frameRemaining;
+  uint32_t lengthMultiplier;
+  uint32_t frameOffset;
+  uint16_t frameValue;
+  
+  // Find the slot tracking packetId (nullptr if none)
+  Slot* find(uint16_t packetId);
+  
+  // Feed one byte through the framing state machine
+  void receive(uint8_t b);
+  
+  // Mark a packet ID acknowledged (ignored unless pending)
+  void acknowledge(uint16_t packetId);
+};
+
+#endif // PUBACK_TRACKER_H
@@ -0,0 +1,560 @@
+// CarbonReady Publish Pipeline Implementation
+
+#include "publish_pipeline.h"
+#include "runtime_config.h"
+#include "wifi_cache.h"
+
+PublishPipeline::PublishPipeline(MQTTClientManager& mqttClient,
+                                 TieredStorage& storage,
+                                 DataProcessor& dataProcessor)
+  : mqttClient(mqttClient), storage(storage), dataProcessor(dataProcessor) {
+  farmId[0] = '\0';
+  deviceId[0] = '\0';
+  taskHandle = nullptr;
+  storageMutex = nullptr;
+  attempt = 0;
+  nextAttemptAt = 0;
+  windowSent = 0;
+  windowAcked = 0;
+  windowRemoved = 0;
+  windowDeadline = 0;
+  lastMetricsAt = 0;
+}
+
+void PublishPipeline::begin(const String& farmId, const String& deviceId) {
+  strlcpy(this->farmId, farmId.c_str(), sizeof(this->farmId));
+  strlcpy(this->deviceId, deviceId.c_str(), sizeof(this->deviceId));
+  
+  if (storageMutex == nullptr) {
+    storageMutex = xSemaphoreCreateMutex();
+  }
+}
+
+bool PublishPipeline::startTask() {
+  if (taskHandle != nullptr) {
+    return true;
+  }
+  
+  // Run next to the WiFi stack so the sampler's core stays free
+  BaseType_t created = xTaskCreatePinnedToCore(taskEntry, "network",
+                                               NETWORK_TASK_STACK_SIZE, this,
+                                               NETWORK_TASK_PRIORITY, &taskHandle,
+                                               NETWORK_TASK_CORE);
+  if (created != pdPASS) {
+    Serial.println("Error: Failed to start network task");
+    taskHandle = nullptr;
+    return false;
+  }
+  
+  deviceMetrics.watchTask("network", taskHandle);
+  Serial.println("Network task started");
+  return true;
+}
+
+void PublishPipeline::submit(const SensorReadings& readings, const ReadingSummary* summary) {
+  PublishMessage* message = queue.reserve();
+  
+  if (message != nullptr) {
+    message->readings = readings;
+    message->packetId = 0;
+    message->length = createMessage(readings, summary, message->payload, sizeof(message->payload));
+    if (message->length > 0) {
+      queue.commit();
+      return;
+    }
+    Serial.println("Error: Message does not fit buffer, storing reading offline");
+  } else {
+    Serial.println("Publish queue full, storing reading offline");
+  }
+  
+  if (!storeOffline(readings)) {
+    Serial.println("Error: Failed to store data offline");
+  }
+}
+
+bool PublishPipeline::storeOffline(const SensorReadings& readings) {
+  xSemaphoreTake(storageMutex, portMAX_DELAY);
+  bool stored = storage.storeReading(readings);
+  xSemaphoreGive(storageMutex);
+  
+  return stored;
+}
+
+int PublishPipeline::getStoredCount() {
+  xSemaphoreTake(storageMutex, portMAX_DELAY);
+  int count = storage.getStoredCount();
+  xSemaphoreGive(storageMutex);
+  
+  return count;
+}
+
+bool PublishPipeline::flushStorage() {
+  // Bounded wait: a restart may come from a task that holds the mutex
+  if (xSemaphoreTake(storageMutex, pdMS_TO_TICKS(STORAGE_FLUSH_TIMEOUT_MS)) != pdTRUE) {
+    Serial.println("Error: Offline storage busy, PSRAM readings not flushed");
+    return false;
+  }
+  bool flushed = storage.flush();
+  xSemaphoreGive(storageMutex);
+  
+  return flushed;
+}
+
+int PublishPipeline::getQueuedCount() {
+  return queue.size();
+}
+
+void PublishPipeline::taskEntry(void* parameter) {
+  static_cast<PublishPipeline*>(parameter)->runTask();
+}
+
+void PublishPipeline::runTask() {
+  for (;;) {
+    // Keepalives, incoming commands and PUBACKs
+    mqttClient.loop();
+    
+    PublishMessage* message = queue.front();
+    
+    if (message != nullptr && message->packetId != 0) {
+      checkMessage(message);
+    } else if (windowSent > 0) {
+      // A window with nothing acknowledged counts as a failed attempt
+      int removed = checkSyncWindow();
+      if (removed == 0) {
+        scheduleRetry();
+        attempt = min(attempt, MAX_RETRIES);
+      } else if (removed > 0) {
+        attempt = 0;
+      }
+    } else if ((long)(millis() - nextAttemptAt) >= 0) {
+      if (message != nullptr) {
+        sendMessage(message);
+      } else if (mqttClient.isConnected() && getStoredCount() > 0) {
+        // Queue is drained; work through the backlog one window per pass
+        if (syncBatch() < 0) {
+          scheduleRetry();
+          attempt = min(attempt, MAX_RETRIES);
+        } else if (windowSent == 0) {
+          // Nothing to acknowledge (QoS 0): the batch is already removed
+          attempt = 0;
+        }
+      }
+    }
+    
+#if METRICS_ENABLED
+    if (mqttClient.isConnected() && millis() - lastMetricsAt >= METRICS_INTERVAL_MS) {
+      publishMetrics();
+    }
+#endif
+    
+    vTaskDelay(pdMS_TO_TICKS(NETWORK_TASK_POLL_MS));
+  }
+}
+
+void PublishPipeline::sendMessage(PublishMessage* message) {
+#if MQTT_PUBLISH_QOS == 1
+  // Stays at the front of the queue until checkMessage() sees its PUBACK
+  if (publishPayload(message->payload, message->length, &message->packetId)) {
+    message->pubackDeadline = millis() + MQTT_PUBACK_TIMEOUT_MS;
+    return;
+  }
+#else
+  if (publishPayload(message->payload, message->length)) {
+    Serial.println("Data transmitted successfully");
+    queue.pop();
+    attempt = 0;
+    return;
+  }
+#endif
+  
+  retryMessage(message);
+}
+
+void PublishPipeline::checkMessage(PublishMessage* message) {
+  uint16_t packetId = message->packetId;
+  PubackStatus status = mqttClient.getPubackStatus(packetId);
+  
+  if (status == PUBACK_PENDING && (long)(millis() - message->pubackDeadline) < 0) {
+    return;
+  }
+  
+  // A late PUBACK is ignored; the message goes out again with a new ID
+  mqttClient.releasePacket(packetId);
+  message->packetId = 0;
+  
+  if (status == PUBACK_RECEIVED) {
+    Serial.println("Data transmitted successfully");
+    queue.pop();
+    attempt = 0;
+    return;
+  }
+  
+  if (status == PUBACK_LOST) {
+    Serial.println("Connection lost before PUBACK");
+  } else {
+    Serial.printf("No PUBACK for packet %u after %d ms\n", (unsigned)packetId, MQTT_PUBACK_TIMEOUT_MS);
+  }
+  retryMessage(message);
+}
+
+void PublishPipeline::retryMessage(PublishMessage* message) {
+  scheduleRetry();
+  
+  // Out of retries: keep the reading and free the queue slot
+  if (attempt > MAX_RETRIES) {
+    Serial.println("Failed to transmit data after retries");
+    if (storeOffline(message->readings)) {
+      Serial.println("Data stored offline for later transmission");
+    } else {
+      Serial.println("Error: Failed to store data offline");
+    }
+    queue.pop();
+    attempt = 0;
+  }
+}
+
+void PublishPipeline::scheduleRetry() {
+  attempt++;
+  unsigned long backoff = mqttClient.getBackoffDelay(min(attempt, MAX_RETRIES));
+  nextAttemptAt = millis() + backoff;
+  
+  Serial.printf("Publish attempt %d failed, next attempt in %lu ms\n", attempt, backoff);
+}
+
+int PublishPipeline::syncBatch() {
+  StageTimer timer(STAGE_SYNC_BATCH);
+  
+  int batchSize = min((int)runtimeConfig.get().syncBatchSize, SYNC_BATCH_MAX_READINGS);
+  
+  xSemaphoreTake(storageMutex, portMAX_DELAY);
+  int available = storage.readOldest(syncReadings, batchSize * SYNC_WINDOW_BATCHES, syncSummaries);
+  xSemaphoreGive(storageMutex);
+  
+  if (available == 0) {
+    Serial.println("Failed to read offline readings");
+    return -1;
+  }
+  
+#if MQTT_PUBLISH_QOS == 1
+  // Send the whole window before checking for PUBACKs, so the broker
+  // round trips overlap
+  int offset = 0;
+  windowSent = 0;
+  windowAcked = 0;
+  windowRemoved = 0;
+  
+  while (windowSent < SYNC_WINDOW_BATCHES && offset < available) {
+    InFlightBatch& batch = windowBatches[windowSent];
+    int consumed = publishBatch(syncReadings + offset, min(batchSize, available - offset),
+                                &batch.packetId, syncSummaries + offset);
+    if (consumed < 0) {
+      break;
+    }
+    
+    batch.consumed = consumed;
+    offset += consumed;
+    windowSent++;
+  }
+  
+  windowDeadline = millis() + MQTT_PUBACK_TIMEOUT_MS;
+  return windowSent > 0 ? offset : -1;
+#else
+  int consumed = publishBatch(syncReadings, available, nullptr, syncSummaries);
+  if (consumed < 0) {
+    return -1;
+  }
+  
+  // Only the readings that were sent are removed; the sampler may have
+  // appended more at the head in the meantime
+  xSemaphoreTake(storageMutex, portMAX_DELAY);
+  storage.removeOldest(consumed);
+  xSemaphoreGive(storageMutex);
+  
+  return consumed;
+#endif
+}
+
+int PublishPipeline::checkSyncWindow() {
+  while (windowAcked < windowSent) {
+    InFlightBatch& batch = windowBatches[windowAcked];
+    PubackStatus status = batch.packetId != 0 ?
+      mqttClient.getPubackStatus(batch.packetId) : PUBACK_RECEIVED;
+    
+    if (status != PUBACK_RECEIVED) {
+      if (status == PUBACK_PENDING && (long)(millis() - windowDeadline) < 0) {
+        return -1;
+      }
+      
+      Serial.printf("%d of %d batches not acknowledged, keeping them offline\n",
+                    windowSent - windowAcked, windowSent);
+      break;
+    }
+    
+    // Storage removes from the tail, so batches leave in the order sent
+    xSemaphoreTake(storageMutex, portMAX_DELAY);
+    storage.removeOldest(batch.consumed);
+    xSemaphoreGive(storageMutex);
+    
+    mqttClient.releasePacket(batch.packetId);
+    windowRemoved += batch.consumed;
+    windowAcked++;
+  }
+  
+  // A late PUBACK for the rest is ignored; they are sent again next sync
+  for (int i = windowAcked; i < windowSent; i++) {
+    mqttClient.releasePacket(windowBatches[i].packetId);
+  }
+  windowSent = 0;
+  
+  return windowRemoved;
+}
+
+int PublishPipeline::awaitSyncWindow() {
+  for (;;) {
+    int removed = checkSyncWindow();
+    if (removed >= 0) {
+      return removed > 0 ? removed : -1;
+    }
+    
+    // loop() reads incoming packets, which passes PUBACKs to the tracker
+    mqttClient.loop();
+    delay(NETWORK_TASK_POLL_MS);
+  }
+}
+
+void PublishPipeline::syncOfflineReadings() {
+  int storedCount = getStoredCount();
+  
+  if (storedCount == 0) {
+    return;
+  }
+  
+  Serial.printf("Syncing %d offline readings...\n", storedCount);
+  
+  int syncedCount = 0;
+  
+  // Each successful batch advances the journal tail
+  while (getStoredCount() > 0) {
+    int consumed = syncBatch();
+#if MQTT_PUBLISH_QOS == 1
+    if (consumed >= 0) {
+      consumed = awaitSyncWindow();
+    }
+#endif
+    if (consumed < 0) {
+      Serial.println("Failed to sync offline batch, stopping sync");
+      break;
+    }
+    
+    syncedCount += consumed;
+    
+    // Service keepalives between batches
+    mqttClient.loop();
+  }
+  
+  if (syncedCount == storedCount) {
+    Serial.printf("Successfully synced all %d offline readings\n", syncedCount);
+  } else {
+    Serial.printf("Synced %d/%d offline readings\n", syncedCount, storedCount);
+  }
+}
+
+void PublishPipeline::publishMetrics() {
+  lastMetricsAt = millis();
+  
+  size_t length = deviceMetrics.writeSummary(deviceId, mqttClient.getConnectionStats(),
+                                            wifiCache.getStats(), batchBuffer, sizeof(batchBuffer));
+  if (length == 0) {
+    Serial.println("Error: Metrics summary does not fit buffer");
+    return;
+  }
+  
+  // Keep accumulating into the same window if the summary did not go out
+  if (mqttClient.publishMetrics((const uint8_t*)batchBuffer, length)) {
+    deviceMetrics.reset();
+  }
+}
+
+size_t PublishPipeline::createMessage(const SensorReadings& readings, const ReadingSummary* summary,
+                                     uint8_t* output, size_t capacity) {
+#if WIRE_FORMAT == WIRE_FORMAT_MSGPACK
+  return dataProcessor.createBinaryMessage(readings, farmId, deviceId, output, capacity, summary);
+#else
+  return dataProcessor.createMessage(readings, farmId, deviceId, (char*)output, capacity, summary);
+#endif
+}
+
+// First valid reading, or count if there is none
+static int firstValid(const SensorReadings* readings, int count) {
+  int i = 0;
+  while (i < count && !readings[i].valid) {
+    Serial.println("Skipping invalid reading");
+    i++;
+  }
+  return i;
+}
+
+int PublishPipeline::publishBatch(const SensorReadings* readings, int count, uint16_t* packetId,
+                                  const ReadingSummary* summaries) {
+  if (packetId != nullptr) {
+    *packetId = 0;
+  }
+  
+#if WIRE_FORMAT == WIRE_FORMAT_MSGPACK
+  return publishBinaryBatch(readings, count, packetId, summaries);
+#endif
+  
+  int consumed = firstValid(readings, count);
+  if (consumed == count) {
+    return consumed;
+  }
+  
+  // Leave room for the closing batch hash
+  size_t capacity = min(mqttClient.getMaxPayloadSize(), sizeof(batchBuffer)) - (BATCH_TRAILER_SIZE - 1);
+  int packed = 0;
+  
+  // The header carries the IDs and the first timestamp; records only a delta
+  uint32_t previous = readings[consumed].timestamp;
+  size_t length = dataProcessor.createBatchHeader(farmId, deviceId, previous,
+                                                  batchBuffer, capacity);
+  if (length == 0) {
+    Serial.println("Error: Batch header does not fit MQTT buffer");
+    return -1;
+  }
+  
+  for (; consumed < count; consumed++) {
+    if (!readings[consumed].valid) {
+      Serial.println("Skipping invalid reading");
+      continue;
+    }
+    
+    // Records are written straight into the batch after the separator
+    size_t offset = length + (packed > 0 ? 1 : 0);
+    size_t recordLength = offset < capacity ?
+      dataProcessor.createBatchRecord(readings[consumed], farmId, deviceId, previous,
+                                      batchBuffer + offset, capacity - offset,
+                                      summaries != nullptr ? &summaries[consumed] : nullptr) : 0;
+    if (recordLength == 0) {
+      if (packed == 0) {
+        Serial.println("Error: Reading does not fit MQTT buffer");
+        return -1;
+      }
+      break;
+    }
+    
+    if (packed > 0) {
+      batchBuffer[length] = ',';
+    }
+    length = offset + recordLength;
+    previous = readings[consumed].timestamp;
+    packed++;
+  }
+  
+  length += dataProcessor.finishBatch(batchBuffer + length, BATCH_TRAILER_SIZE);
+  
+  Serial.printf("Publishing batch of %d readings (%u bytes)\n", packed, (unsigned)length);
+  
+  if (!publishPayload((const uint8_t*)batchBuffer, length, packetId)) {
+    return -1;
+  }
+  
+  return consumed;
+}
+
+#if WIRE_FORMAT == WIRE_FORMAT_MSGPACK
+int PublishPipeline::publishBinaryBatch(const SensorReadings* readings, int count,
+                                        uint16_t* packetId, const ReadingSummary* summaries) {
+  int consumed = firstValid(readings, count);
+  if (consumed == count) {
+    return consumed;
+  }
+  
+  // Leave room for the closing bin8(32) batch hash
+  size_t capacity = min(mqttClient.getMaxPayloadSize(), sizeof(batchBuffer)) - 34;
+  uint8_t* buffer = (uint8_t*)batchBuffer;
+  int packed = 0;
+  
+  uint32_t previous = readings[consumed].timestamp;
+  size_t header = dataProcessor.createBinaryBatchHeader(previous, buffer, capacity);
+  if (header == 0 || header + 3 > capacity) {
+    Serial.println("Error: Batch header does not fit MQTT buffer");
+    return -1;
+  }
+  size_t length = header + 3; // array16 of records, count filled in below
+  
+  for (; consumed < count; consumed++) {
+    if (!readings[consumed].valid) {
+      Serial.println("Skipping invalid reading");
+      continue;
+    }
+    
+    size_t recordLength = dataProcessor.createBinaryBatchRecord(readings[consumed], farmId, deviceId,
+                                                                previous, buffer + length,
+                                                                capacity - length,
+                                                                summaries != nullptr ? &summaries[consumed] : nullptr);
+    if (recordLength == 0) {
+      if (packed == 0) {
+        Serial.println("Error: Reading does not fit MQTT buffer");
+        return -1;
+      }
+      break;
+    }
+    
+    length += recordLength;
+    previous = readings[consumed].timestamp;
+    packed++;
+  }
+  
+  buffer[header] = 0xdc;
+  buffer[header + 1] = packed >> 8;
+  buffer[header + 2] = packed & 0xff;
+  length += dataProcessor.finishBinaryBatch(buffer + length, 34);
+  
+  Serial.printf("Publishing binary batch of %d readings (%u bytes)\n", packed, (unsigned)length);
+  
+  if (!publishPayload(buffer, length, packetId)) {
+    return -1;
+  }
+  
+  return consumed;
+}
+#endif
+
+bool PublishPipeline::publishPayload(const uint8_t* payload, size_t length, uint16_t* packetId) {
+  MqttTopic topic = TOPIC_DATA;
+  
+#if WIRE_FORMAT == WIRE_FORMAT_MSGPACK
+  // Binary messages are already compact; compression is for JSON only
+  topic = TOPIC_BINARY;
+#elif PAYLOAD_COMPRESSION
+  if (runtimeConfig.get().compression && length >= COMPRESSION_MIN_BYTES) {
+    size_t compressedLength = min(sizeof(compressionBuffer), mqttClient.getMaxPayloadSize());
+    
+    if (dataProcessor.compressData(payload, length, compressionBuffer, &compressedLength) &&
+        compressedLength < length) {
+      Serial.printf("Compressed payload %u -> %u bytes\n", (unsigned)length,
+                    (unsigned)compressedLength);
+      payload = compressionBuffer;
+      length = compressedLength;
+      topic = TOPIC_COMPRESSED;
+    }
+  }
+#endif
+  
+  if (packetId != nullptr) {
+    *packetId = mqttClient.publishNoWait(topic, payload, length);
+    return *packetId != 0;
+  }
+  
+  // Inline callers have nothing else to service, so they retry in place
+  int maxRetries = taskHandle != nullptr ? 0 : MAX_RETRIES;
+  
+  switch (topic) {
+    case TOPIC_BINARY:
+      return mqttClient.publishBinary(payload, length, maxRetries);
+    case TOPIC_COMPRESSED:
+      return mqttClient.publishCompressed(payload, length, maxRetries);
+    default:
+      return mqttClient.publish(payload, length, maxRetries);
+  }
+}
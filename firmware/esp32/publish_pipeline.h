@@ -0,0 +1,184 @@
+// CarbonReady Publish Pipeline
+// Moves publishing, retries and offline sync onto a dedicated network task
+//
+// The processing task (loop()) hands readings over with submit(), which
+// never blocks: it builds the signed message straight into a slot of the
+// queue for the network task or, if the queue is full, spills the reading
+// to offline storage (TieredStorage: PSRAM, then flash). The network task
+// publishes messages one attempt at a time and schedules exponential
+// backoff on its own timer instead of delaying, so mqttClient.loop()
+// keepalives keep running. Messages are built on the processing task and
+// batches on the network task; DataProcessor hashes the two with separate
+// contexts and keeps no other state between messages, so they can run at
+// once.
+//
+// At MQTT_PUBLISH_QOS 1 the network task never waits for a PUBACK: it
+// sends a live message and checks for its acknowledgement on later passes
+// of its loop, popping it once acknowledged. A drain likewise reads up to
+// MQTT_INFLIGHT_WINDOW batches from the backlog and sends them back to
+// back, then removes each batch from storage as its PUBACK arrives (oldest
+// first). Batches that are not acknowledged stay in storage and go out
+// again. Only inline callers (before the task starts) wait in place.
+
+#ifndef PUBLISH_PIPELINE_H
+#define PUBLISH_PIPELINE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "config.h"
+#include "sensor_manager.h"
+#include "data_processor.h"
+#include "mqtt_client.h"
+#include "tiered_storage.h"
+#include "message_queue.h"
+#include "metrics.h"
+
+// Batches a single offline drain keeps in flight
+#if MQTT_PUBLISH_QOS == 1
+#define SYNC_WINDOW_BATCHES MQTT_INFLIGHT_WINDOW
+#else
+#define SYNC_WINDOW_BATCHES 1
+#endif
+
+class PublishPipeline {
+public:
+  PublishPipeline(MQTTClientManager& mqttClient,
+                  TieredStorage& storage,
+                  DataProcessor& dataProcessor);
+  
+  // Set identifiers used when building messages
+  void begin(const String& farmId, const String& deviceId);
+  
+  // Start the network task; publishing is inline (blocking) until then
+  bool startTask();
+  
+  // Build the signed message for a reading and queue it for the network
+  // task (spills the reading to storage if the queue is full). A summary
+  // with samples > 0 (an edge aggregation window) goes out with it; offline
+  // storage keeps only the reading. Call from one task only.
+  void submit(const SensorReadings& readings, const ReadingSummary* summary = nullptr);
+  
+  // Publish as many of the given readings as fit one MQTT message.
+  // Returns how many readings were consumed (sent or skipped as invalid),
+  // or -1 if the publish failed. Inline use only (task not running).
+  // With packetId the batch is sent at QoS 1 without waiting for its
+  // PUBACK, and the packet ID is stored there (0 if nothing was sent).
+  // summaries (one per reading) carries the spread of offline aggregates.
+  int publishBatch(const SensorReadings* readings, int count, uint16_t* packetId = nullptr,
+                   const ReadingSummary* summaries = nullptr);
+  
+  // Publish the offline backlog in batches until empty or a publish fails,
+  // waiting for each window's PUBACKs. Inline use only (task not running).
+  void syncOfflineReadings();
+  
+  // Store a reading offline (safe to call from any task)
+  bool storeOffline(const SensorReadings& readings);
+  
+  // Number of readings in offline storage (safe to call from any task)
+  int getStoredCount();
+  
+  // Move readings buffered in PSRAM to flash before deep sleep or a
+  // restart (safe to call from any task)
+  bool flushStorage();
+  
+  // Number of messages waiting for the network task
+  int getQueuedCount();
+  
+  // Publish the metrics summary (reuses the batch buffer). Called by the
+  // network task every METRICS_INTERVAL_MS; inline use otherwise.
+  void publishMetrics();
+  
+private:
+  MQTTClientManager& mqttClient;
+  TieredStorage& storage;
+  DataProcessor& dataProcessor;
+  
+  char farmId[64];
+  char deviceId[64];
+  
+  MessageQueue queue;
+  TaskHandle_t taskHandle;
+  SemaphoreHandle_t storageMutex;
+  
+  // Backoff state for the network task
+  int attempt;
+  unsigned long nextAttemptAt;
+  
+  // A batch sent by syncBatch() and the readings it consumed
+  struct InFlightBatch {
+    uint16_t packetId;  // 0: nothing to acknowledge (all readings invalid)
+    int consumed;
+  };
+  
+  // Sync window awaiting PUBACKs (QoS 1): the batches sent, oldest first,
+  // how many have been acknowledged and removed, and when the rest time out
+  InFlightBatch windowBatches[SYNC_WINDOW_BATCHES];
+  int windowSent;
+  int windowAcked;
+  int windowRemoved;
+  unsigned long windowDeadline;
+  
+  // Last metrics summary attempt
+  unsigned long lastMetricsAt;
+  
+  // Message buffers (static storage so publishing never touches the heap)
+  char batchBuffer[MQTT_BUFFER_SIZE];
+  SensorReadings syncReadings[SYNC_BATCH_MAX_READINGS * SYNC_WINDOW_BATCHES];
+  ReadingSummary syncSummaries[SYNC_BATCH_MAX_READINGS * SYNC_WINDOW_BATCHES];
+#if PAYLOAD_COMPRESSION
+  uint8_t compressionBuffer[MQTT_BUFFER_SIZE];
+#endif
+  
+  // Network task body
+  static void taskEntry(void* parameter);
+  void runTask();
+  
+  // Send the front message; at QoS 1 it stays queued until its PUBACK
+  void sendMessage(PublishMessage* message);
+  
+  // Pop the front message once its PUBACK has arrived, or retry it if the
+  // PUBACK was lost or timed out
+  void checkMessage(PublishMessage* message);
+  
+  // Schedule a retry of the front message, storing it offline once it is
+  // out of retries
+  void retryMessage(PublishMessage* message);
+  
+  // Publish one window of batches from the offline backlog without
+  // waiting. Returns the readings sent, or -1 if nothing was. At QoS 0
+  // they are removed from storage straight away; at QoS 1 they wait in
+  // the sync window for checkSyncWindow().
+  int syncBatch();
+  
+  // Remove the sync window's batches from storage as their PUBACKs arrive
+  // (oldest first), and close the window once all are acknowledged, one is
+  // lost or MQTT_PUBACK_TIMEOUT_MS passes. Returns -1 while the window is
+  // open, else the readings it removed.
+  int checkSyncWindow();
+  
+  // Service the connection until the sync window closes (inline use
+  // only); returns the readings removed, or -1 if none were
+  int awaitSyncWindow();
+  
+  // Build a signed message in the configured wire format (0 if it does not fit)
+  size_t createMessage(const SensorReadings& readings, const ReadingSummary* summary,
+                       uint8_t* output, size_t capacity);
+  
+#if WIRE_FORMAT == WIRE_FORMAT_MSGPACK
+  // MessagePack batch: [schema, baseTimestamp, array16 of delta records, batchHash]
+  int publishBinaryBatch(const SensorReadings* readings, int count, uint16_t* packetId,
+                         const ReadingSummary* summaries);
+#endif
+  
+  // Publish a payload, compressing it when enabled and worthwhile.
+  // The network task makes a single attempt; inline callers retry. With
+  // packetId the payload is sent at QoS 1 without waiting (see publishBatch).
+  bool publishPayload(const uint8_t* payload, size_t length, uint16_t* packetId = nullptr);
+  
+  // Record a failed attempt and schedule the next one
+  void scheduleRetry();
+};
+
+#endif // PUBLISH_PIPELINE_H
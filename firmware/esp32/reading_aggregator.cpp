@@ -0,0 +1,139 @@
+// CarbonReady Reading Aggregator Implementation
+
+#include "reading_aggregator.h"
+
+float SensorReadings::* const ReadingAggregator::FIELDS[AGGREGATE_FIELD_COUNT] = {
+  &SensorReadings::soilMoisture,
+  &SensorReadings::soilTemperature,
+  &SensorReadings::airTemperature,
+  &SensorReadings::humidity
+};
+
+const float ReadingAggregator::DEADBANDS[AGGREGATE_FIELD_COUNT] = {
+  DEADBAND_SOIL_MOISTURE,
+  DEADBAND_SOIL_TEMPERATURE,
+  DEADBAND_AIR_TEMPERATURE,
+  DEADBAND_HUMIDITY
+};
+
+ReadingAggregator::ReadingAggregator() {
+  hasReported = false;
+  exception = false;
+  windowMs = AGGREGATION_WINDOW_MS;
+  firstTimestamp = 0;
+  lastTimestamp = 0;
+  lastSampleMs = 0;
+  resetWindow(0);
+}
+
+void ReadingAggregator::begin(unsigned long windowMs) {
+  this->windowMs = windowMs;
+  hasReported = false;
+  resetWindow(millis());
+}
+
+bool ReadingAggregator::add(const SensorReadings& readings, unsigned long nowMs) {
+  for (int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+    float value = readings.*FIELDS[i];
+    FieldAggregate& field = fields[i];
+    
+    if (samples == 0) {
+      field.min = value;
+      field.max = value;
+      field.sum = 0;
+    } else {
+      field.min = min(field.min, value);
+      field.max = max(field.max, value);
+    }
+    field.sum += value;
+    field.last = value;
+    
+    // Report by exception once a baseline has been published
+    if (hasReported && DEADBANDS[i] > 0 && fabsf(value - reported[i]) > DEADBANDS[i]) {
+      exception = true;
+    }
+  }
+  
+  // The probe set only changes across a reboot; the window's first sample sets it
+  if (samples == 0) {
+    probeCount = min(readings.soilProbeCount, (uint8_t)DS18B20_MAX_PROBES);
+    firstTimestamp = readings.timestamp;
+  }
+  for (int i = 0; i < probeCount; i++) {
+    float value = i < readings.soilProbeCount ? readings.soilTemperatures[i] : probeLast[i];
+    probeSums[i] += value;
+    probeLast[i] = value;
+  }
+  
+  samples++;
+  lastTimestamp = readings.timestamp;
+  lastSampleMs = nowMs;
+  
+  // The first sample after boot is reported straight away as the baseline
+  return !hasReported || exception || nowMs - windowStart >= windowMs;
+}
+
+SensorReadings ReadingAggregator::takeReport(ReadingSummary* summary) {
+  SensorReadings report;
+  report.timestamp = lastTimestamp;
+  report.valid = samples > 0;
+  
+  for (int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+    const FieldAggregate& field = fields[i];
+    float value = exception ? field.last : (samples > 0 ? field.sum / samples : 0);
+    
+    report.*FIELDS[i] = value;
+    reported[i] = value;
+  }
+  
+  report.soilProbeCount = probeCount;
+  for (int i = 0; i < probeCount; i++) {
+    report.soilTemperatures[i] = exception ? probeLast[i] : probeSums[i] / samples;
+  }
+  
+  // The window's spread goes out with the report (see ReadingSummary)
+  if (summary != nullptr) {
+    summary->span = lastTimestamp - firstTimestamp;
+    summary->samples = samples > 1 ? samples : 0;
+    for (int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+      summary->min[i] = toHundredths(fields[i].min);
+      summary->max[i] = toHundredths(fields[i].max);
+    }
+  }
+  
+  Serial.printf("Aggregate of %d samples%s\n", samples, exception ? " (exception)" : "");
+  
+  hasReported = report.valid;
+  
+  // The next window is measured from the sample that closed this one
+  resetWindow(lastSampleMs);
+  
+  return report;
+}
+
+int ReadingAggregator::sampleCount() {
+  return samples;
+}
+
+const FieldAggregate& ReadingAggregator::field(int index) {
+  return fields[index];
+}
+
+void ReadingAggregator::resetWindow(unsigned long nowMs) {
+  samples = 0;
+  exception = false;
+  windowStart = nowMs;
+  probeCount = 0;
+  
+  for (int i = 0; i < DS18B20_MAX_PROBES; i++) {
+    probeSums[i] = 0;
+    probeLast[i] = 0;
+  }
+  
+  for (int i = 0; i < AGGREGATE_FIELD_COUNT; i++) {
+    fields[i].min = 0;
+    fields[i].max = 0;
+    fields[i].sum = 0;
+    fields[i].last = 0;
+  }
+}
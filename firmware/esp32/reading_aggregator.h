@@ -0,0 +1,74 @@
+// CarbonReady Reading Aggregator
+// Windowed min/max/mean/last aggregation with deadband report-by-exception
+//
+// Samples are added as they are taken; a report is due when the window
+// elapses or when any field's latest sample moves beyond its deadband
+// from the last reported value.
+
+#ifndef READING_AGGREGATOR_H
+#define READING_AGGREGATOR_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "sensor_manager.h"
+
+// Statistics for one field over the current window
+struct FieldAggregate {
+  float min;
+  float max;
+  float sum;
+  float last;
+};
+
+class ReadingAggregator {
+public:
+  ReadingAggregator();
+  
+  // Start aggregating with the given window length
+  void begin(unsigned long windowMs);
+  
+  // Change the window length; applies to the window in progress
+  void setWindow(unsigned long windowMs) { this->windowMs = windowMs; }
+  
+  // Add a valid sample taken at nowMs; returns true when a report is due
+  bool add(const SensorReadings& readings, unsigned long nowMs);
+  
+  // Build the reading to publish and start the next window. Carries the
+  // window means, or the latest sample when reporting by exception. With
+  // summary, also fills in the window's span and min/max (samples 0 when
+  // the window held a single sample).
+  SensorReadings takeReport(ReadingSummary* summary = nullptr);
+  
+  // Samples in the current window
+  int sampleCount();
+  
+  // Statistics for field index (soil moisture, soil temperature, air
+  // temperature, humidity) over the current window
+  const FieldAggregate& field(int index);
+  
+private:
+  FieldAggregate fields[AGGREGATE_FIELD_COUNT];
+  float reported[AGGREGATE_FIELD_COUNT];
+  
+  // Per-probe soil temperature sums and latest values (the deadband is
+  // applied to the first probe, as the soil temperature field)
+  float probeSums[DS18B20_MAX_PROBES];
+  float probeLast[DS18B20_MAX_PROBES];
+  uint8_t probeCount;
+  bool hasReported;
+  bool exception;
+  int samples;
+  unsigned long windowMs;
+  unsigned long windowStart;
+  unsigned long firstTimestamp;
+  unsigned long lastTimestamp;
+  unsigned long lastSampleMs;
+  
+  // Clear statistics for a new window starting at nowMs
+  void resetWindow(unsigned long nowMs);
+  
+  static float SensorReadings::* const FIELDS[AGGREGATE_FIELD_COUNT];
+  static const float DEADBANDS[AGGREGATE_FIELD_COUNT];
+};
+
+#endif // READING_AGGREGATOR_H
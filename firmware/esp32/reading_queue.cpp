@@ -0,0 +1,54 @@
+// CarbonReady Reading Queue Implementation
+
+#include "reading_queue.h"
+
+ReadingQueue::ReadingQueue() : head(0), tail(0) {
+  // Slots are filled by push()
+}
+
+bool ReadingQueue::push(const SensorReadings& readings, const ReadingSummary* summary) {
+  uint32_t currentHead = head.load(std::memory_order_relaxed);
+  
+  if (currentHead - tail.load(std::memory_order_acquire) >= SENSOR_QUEUE_LENGTH) {
+    return false;
+  }
+  
+  uint32_t slot = currentHead % SENSOR_QUEUE_LENGTH;
+  slots[slot] = readings;
+  if (summary != nullptr) {
+    summaries[slot] = *summary;
+  } else {
+    summaries[slot].samples = 0;
+  }
+  
+  // Publish the slot contents before the new head becomes visible
+  head.store(currentHead + 1, std::memory_order_release);
+  return true;
+}
+
+bool ReadingQueue::peek(SensorReadings& readings, ReadingSummary* summary) {
+  uint32_t currentTail = tail.load(std::memory_order_relaxed);
+  
+  if (currentTail == head.load(std::memory_order_acquire)) {
+    return false;
+  }
+  
+  uint32_t slot = currentTail % SENSOR_QUEUE_LENGTH;
+  readings = slots[slot];
+  if (summary != nullptr) {
+    *summary = summaries[slot];
+  }
+  return true;
+}
+
+void ReadingQueue::pop() {
+  uint32_t currentTail = tail.load(std::memory_order_relaxed);
+  
+  if (currentTail != head.load(std::memory_order_acquire)) {
+    tail.store(currentTail + 1, std::memory_order_release);
+  }
+}
+
+int ReadingQueue::size() {
+  return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
@@ -0,0 +1,45 @@
+// CarbonReady Reading Queue
+// Bounded lock-free queue handing readings (with the summary of the window
+// they aggregate, if any) from the sensor task to processing
+
+#ifndef READING_QUEUE_H
+#define READING_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+#include "sensor_manager.h"
+
+// Counters wrap at 2^32, which keeps slot indices continuous only for
+// power-of-two capacities
+static_assert((SENSOR_QUEUE_LENGTH & (SENSOR_QUEUE_LENGTH - 1)) == 0,
+              "SENSOR_QUEUE_LENGTH must be a power of two");
+
+// Single-producer/single-consumer ring. The producer only advances head and
+// the consumer only advances tail, so no lock is needed between the two tasks.
+class ReadingQueue {
+public:
+  ReadingQueue();
+  
+  // Producer: add a reading and its window summary (none: samples 0);
+  // fails when the queue is full
+  bool push(const SensorReadings& readings, const ReadingSummary* summary = nullptr);
+  
+  // Consumer: copy the oldest reading (and its summary, if asked for)
+  // without removing it
+  bool peek(SensorReadings& readings, ReadingSummary* summary = nullptr);
+  
+  // Consumer: remove the oldest reading
+  void pop();
+  
+  // Number of queued readings
+  int size();
+  
+private:
+  SensorReadings slots[SENSOR_QUEUE_LENGTH];
+  ReadingSummary summaries[SENSOR_QUEUE_LENGTH];
+  std::atomic<uint32_t> head;  // Total readings pushed
+  std::atomic<uint32_t> tail;  // Total readings popped
+};
+
+#endif // READING_QUEUE_H
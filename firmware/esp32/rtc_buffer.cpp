@@ -0,0 +1,71 @@
+// CarbonReady RTC Reading Buffer Implementation
+
+#include "rtc_buffer.h"
+
+// Identifies initialized RTC memory ("CRR2"); changes with the
+// SensorReadings layout, since RTC memory survives a firmware update
+#define RTC_BUFFER_MAGIC 0x32525243
+
+// Lives in RTC slow memory, which survives deep sleep but not power loss
+struct RtcBufferState {
+  uint32_t magic;
+  uint32_t wakeCount;
+  uint32_t count;
+  SensorReadings readings[RTC_BUFFER_CAPACITY];
+};
+
+RTC_DATA_ATTR static RtcBufferState rtcState;
+
+RtcReadingBuffer::RtcReadingBuffer() {
+  // State lives in RTC memory; see begin()
+}
+
+void RtcReadingBuffer::begin() {
+  if (rtcState.magic != RTC_BUFFER_MAGIC || rtcState.count > RTC_BUFFER_CAPACITY) {
+    Serial.println("Initializing RTC reading buffer");
+    rtcState.magic = RTC_BUFFER_MAGIC;
+    rtcState.wakeCount = 0;
+    rtcState.count = 0;
+  }
+}
+
+bool RtcReadingBuffer::append(const SensorReadings& readings) {
+  if (isFull()) {
+    return false;
+  }
+  
+  rtcState.readings[rtcState.count++] = readings;
+  return true;
+}
+
+int RtcReadingBuffer::count() {
+  return rtcState.count;
+}
+
+bool RtcReadingBuffer::isFull() {
+  return rtcState.count >= RTC_BUFFER_CAPACITY;
+}
+
+const SensorReadings* RtcReadingBuffer::readings() {
+  return rtcState.readings;
+}
+
+void RtcReadingBuffer::removeOldest(int count) {
+  if (count <= 0) {
+    return;
+  }
+  
+  if ((uint32_t)count >= rtcState.count) {
+    rtcState.count = 0;
+    return;
+  }
+  
+  // Buffer is small, so shifting is cheaper than tracking a ring
+  memmove(rtcState.readings, rtcState.readings + count,
+          (rtcState.count - count) * sizeof(SensorReadings));
+  rtcState.count -= count;
+}
+
+uint32_t RtcReadingBuffer::recordWakeup() {
+  return ++rtcState.wakeCount;
+}
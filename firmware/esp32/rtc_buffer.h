@@ -0,0 +1,37 @@
+// CarbonReady RTC Reading Buffer
+// Buffers sensor readings in RTC slow memory across deep sleep cycles
+
+#ifndef RTC_BUFFER_H
+#define RTC_BUFFER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "sensor_manager.h"
+
+class RtcReadingBuffer {
+public:
+  RtcReadingBuffer();
+  
+  // Validate RTC memory contents (reset after a cold boot)
+  void begin();
+  
+  // Append a reading; fails when the buffer is full
+  bool append(const SensorReadings& readings);
+  
+  // Number of buffered readings
+  int count();
+  
+  // Check if buffer is full
+  bool isFull();
+  
+  // Access buffered readings (oldest first)
+  const SensorReadings* readings();
+  
+  // Drop the oldest buffered readings
+  void removeOldest(int count);
+  
+  // Count a timer wakeup and return the total since cold boot
+  uint32_t recordWakeup();
+};
+
+#endif // RTC_BUFFER_H
@@ -0,0 +1,200 @@
+// CarbonReady Runtime Configuration Implementation
+
+#include "runtime_config.h"
+#include <ArduinoJson.h>
+#include <Preferences.h>
+
+// NVS namespace and key holding TunableSettings
+#define RUNTIME_CONFIG_NAMESPACE "carbonready"
+#define RUNTIME_CONFIG_KEY "tunables"
+
+RuntimeConfig runtimeConfig;
+
+RuntimeConfig::RuntimeConfig() {
+  lock = portMUX_INITIALIZER_UNLOCKED;
+  settings = defaults();
+  deviceId[0] = '\0';
+}
+
+TunableSettings RuntimeConfig::defaults() {
+  TunableSettings defaults;
+  defaults.version = TUNABLE_SETTINGS_VERSION;
+  defaults.syncBatchSize = SYNC_BATCH_MAX_READINGS;
+  defaults.readingIntervalMs = READING_INTERVAL_MS;
+  defaults.sampleIntervalMs = SAMPLE_INTERVAL_MS;
+  defaults.aggregationWindowMs = AGGREGATION_WINDOW_MS;
+  defaults.retryDelayBaseMs = RETRY_DELAY_BASE_MS;
+  defaults.sleepFlushEvery = DEEP_SLEEP_FLUSH_EVERY;
+  defaults.qos = MQTT_QOS;
+  defaults.compression = PAYLOAD_COMPRESSION;
+  return defaults;
+}
+
+bool RuntimeConfig::begin(const char* deviceId) {
+  snprintf(this->deviceId, sizeof(this->deviceId), "%s", deviceId);
+  
+  Preferences preferences;
+  if (!preferences.begin(RUNTIME_CONFIG_NAMESPACE, true)) {
+    // Namespace does not exist until the first command is saved
+    return true;
+  }
+  
+  TunableSettings stored;
+  size_t length = preferences.getBytes(RUNTIME_CONFIG_KEY, &stored, sizeof(stored));
+  preferences.end();
+  
+  if (length == 0) {
+    return true;
+  }
+  
+  // Layout changes fall back to defaults until the next command
+  if (length != sizeof(stored) || stored.version != TUNABLE_SETTINGS_VERSION ||
+      !validate(stored)) {
+    Serial.println("Warning: Ignoring invalid runtime settings in NVS");
+    return false;
+  }
+  
+  portENTER_CRITICAL(&lock);
+  settings = stored;
+  portEXIT_CRITICAL(&lock);
+  
+  Serial.printf("Runtime settings: reading %lu s, batch %d, qos %d\n",
+                (unsigned long)(stored.readingIntervalMs / 1000), stored.syncBatchSize, stored.qos);
+  return true;
+}
+
+bool RuntimeConfig::handleCommand(const uint8_t* payload, size_t length) {
+  // Static pool on the caller's stack; string values are copied into it
+  StaticJsonDocument<512> doc;
+  DeserializationError error = deserializeJson(doc, (const char*)payload, length);
+  if (error) {
+    Serial.printf("Error: Malformed command (%s)\n", error.c_str());
+    return false;
+  }
+  
+  // Farm-wide unless addressed to a single device
+  const char* target = doc["deviceId"] | "";
+  if (target[0] != '\0' && strcmp(target, deviceId) != 0) {
+    return false;
+  }
+  
+  const char* action = doc["action"] | "";
+  
+  if (strcmp(action, "reset") == 0) {
+    Serial.println("Restoring default runtime settings");
+    return apply(defaults());
+  }
+  
+  if (strcmp(action, "configure") != 0) {
+    Serial.printf("Warning: Unknown command action '%s'\n", action);
+    return false;
+  }
+  
+  JsonObjectConst values = doc["settings"];
+  if (values.isNull()) {
+    Serial.println("Error: Configure command without settings");
+    return false;
+  }
+  
+  // Start from the current settings; absent keys keep their value. A key
+  // with the wrong type or beyond maxValue rejects the whole command.
+  bool wellFormed = true;
+  auto readUint = [&](const char* key, uint32_t current, uint32_t maxValue) -> uint32_t {
+    JsonVariantConst value = values[key];
+    if (value.isNull()) {
+      return current;
+    }
+    if (!value.is<uint32_t>() || value.as<uint32_t>() > maxValue) {
+      Serial.printf("Error: Invalid value for %s\n", key);
+      wellFormed = false;
+      return current;
+    }
+    return value.as<uint32_t>();
+  };
+  
+  const uint32_t maxSeconds = 24UL * 3600;
+  TunableSettings updated = get();
+  updated.readingIntervalMs = readUint("readingIntervalSec", updated.readingIntervalMs / 1000, maxSeconds) * 1000;
+  updated.sampleIntervalMs = readUint("sampleIntervalSec", updated.sampleIntervalMs / 1000, maxSeconds) * 1000;
+  updated.aggregationWindowMs = readUint("aggregationWindowSec", updated.aggregationWindowMs / 1000, maxSeconds) * 1000;
+  updated.retryDelayBaseMs = readUint("retryBaseMs", updated.retryDelayBaseMs, 60UL * 1000);
+  updated.syncBatchSize = readUint("batchSize", updated.syncBatchSize, SYNC_BATCH_MAX_READINGS);
+  updated.sleepFlushEvery = readUint("sleepFlushEvery", updated.sleepFlushEvery, RTC_BUFFER_CAPACITY);
+  updated.qos = readUint("qos", updated.qos, 1);
+  
+  JsonVariantConst compression = values["compression"];
+  if (!compression.isNull()) {
+    if (compression.is<bool>()) {
+      updated.compression = compression.as<bool>();
+    } else {
+      Serial.println("Error: Invalid value for compression");
+      wellFormed = false;
+    }
+  }
+  
+  if (!wellFormed) {
+    return false;
+  }
+  
+  if (!validate(updated)) {
+    Serial.println("Error: Rejected out-of-range runtime settings");
+    return false;
+  }
+  
+  return apply(updated);
+}
+
+TunableSettings RuntimeConfig::get() {
+  portENTER_CRITICAL(&lock);
+  TunableSettings snapshot = settings;
+  portEXIT_CRITICAL(&lock);
+  return snapshot;
+}
+
+bool RuntimeConfig::apply(const TunableSettings& updated) {
+  TunableSettings current = get();
+  if (memcmp(&current, &updated, sizeof(updated)) == 0) {
+    return false;
+  }
+  
+  portENTER_CRITICAL(&lock);
+  settings = updated;
+  portEXIT_CRITICAL(&lock);
+  
+  Serial.printf("Runtime settings updated: reading %lu s, sample %lu s, window %lu s, "
+                "retry %lu ms, batch %d, flush every %d, qos %d, compression %d\n",
+                (unsigned long)(updated.readingIntervalMs / 1000),
+                (unsigned long)(updated.sampleIntervalMs / 1000),
+                (unsigned long)(updated.aggregationWindowMs / 1000),
+                (unsigned long)updated.retryDelayBaseMs, updated.syncBatchSize,
+                updated.sleepFlushEvery, updated.qos, updated.compression);
+  
+  // Applied settings stay in effect even if NVS is unavailable
+  if (!save(updated)) {
+    Serial.println("Warning: Failed to persist runtime settings");
+  }
+  return true;
+}
+
+bool RuntimeConfig::save(const TunableSettings& updated) {
+  Preferences preferences;
+  if (!preferences.begin(RUNTIME_CONFIG_NAMESPACE, false)) {
+    return false;
+  }
+  
+  bool success = preferences.putBytes(RUNTIME_CONFIG_KEY, &updated, sizeof(updated)) == sizeof(updated);
+  preferences.end();
+  
+  return success;
+}
+
+bool RuntimeConfig::validate(const TunableSettings& candidate) {
+  return candidate.readingIntervalMs >= 60UL * 1000 && candidate.readingIntervalMs <= 24UL * 3600 * 1000 &&
+         candidate.sampleIntervalMs >= 5UL * 1000 && candidate.sampleIntervalMs <= candidate.readingIntervalMs &&
+         candidate.aggregationWindowMs >= candidate.sampleIntervalMs &&
+         candidate.aggregationWindowMs <= 24UL * 3600 * 1000 &&
+         candidate.retryDelayBaseMs >= 100 && candidate.retryDelayBaseMs <= 60UL * 1000 &&
+         candidate.syncBatchSize >= 1 && candidate.syncBatchSize <= SYNC_BATCH_MAX_READINGS &&
+         candidate.sleepFlushEvery >= 1 && candidate.sleepFlushEvery <= RTC_BUFFER_CAPACITY &&
+         candidate.qos <= 1;
+}
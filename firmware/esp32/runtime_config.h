@@ -0,0 +1,74 @@
+// CarbonReady Runtime Configuration
+// Fleet-tunable settings applied from the MQTT commands topic
+//
+// The config.h macros are the defaults. A "configure" command on
+// carbonready/farm/<farmId>/commands overrides any subset of the settings
+// below; the new values are validated as a whole, applied immediately and
+// persisted to NVS so they survive reboots and deep sleep:
+//
+//   {"action": "configure",
+//    "deviceId": "A1B2C3D4E5F6",          (optional, else the whole farm)
+//    "settings": {"readingIntervalSec": 900, "sampleIntervalSec": 60,
+//                 "aggregationWindowSec": 900, "retryBaseMs": 2000,
+//                 "batchSize": 32, "sleepFlushEvery": 4, "qos": 1,
+//                 "compression": true}}
+//
+// {"action": "reset"} restores the compile-time defaults. Commands are parsed
+// into a stack StaticJsonDocument, so handling one never touches the heap.
+
+#ifndef RUNTIME_CONFIG_H
+#define RUNTIME_CONFIG_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+
+// Current TunableSettings layout version (stored alongside it in NVS)
+#define TUNABLE_SETTINGS_VERSION 1
+
+struct TunableSettings {
+  uint16_t version;              // TUNABLE_SETTINGS_VERSION
+  uint16_t syncBatchSize;        // Offline readings per batch (<= SYNC_BATCH_MAX_READINGS)
+  uint32_t readingIntervalMs;    // Reading (or deep-sleep wakeup) interval
+  uint32_t sampleIntervalMs;     // Sampling interval when aggregating
+  uint32_t aggregationWindowMs;  // Aggregation report window
+  uint32_t retryDelayBaseMs;     // Publish backoff base
+  uint16_t sleepFlushEvery;      // Deep-sleep wakeups per flush
+  uint8_t qos;                   // Commands subscription QoS (0 or 1)
+  uint8_t compression;           // Compress large payloads (needs PAYLOAD_COMPRESSION)
+};
+
+class RuntimeConfig {
+public:
+  RuntimeConfig();
+  
+  // Load persisted settings (defaults if none); deviceId targets commands
+  bool begin(const char* deviceId);
+  
+  // Apply a commands-topic message. Returns true if settings changed.
+  bool handleCommand(const uint8_t* payload, size_t length);
+  
+  // Snapshot of the current settings (safe to call from any task)
+  TunableSettings get();
+  
+  // Compile-time defaults from config.h
+  static TunableSettings defaults();
+  
+private:
+  TunableSettings settings;
+  portMUX_TYPE lock;
+  char deviceId[24];
+  
+  // Replace the settings and persist them if they changed
+  bool apply(const TunableSettings& updated);
+  
+  // Write settings to NVS
+  bool save(const TunableSettings& updated);
+  
+  // Range-check every field
+  static bool validate(const TunableSettings& candidate);
+};
+
+extern RuntimeConfig runtimeConfig;
+
+#endif // RUNTIME_CONFIG_H
@@ -0,0 +1,293 @@
+// CarbonReady Sensor Drivers Implementation
+
+#include "sensor_drivers.h"
+#include <driver/adc.h>
+#include "metrics.h"
+
+// Extra time allowed beyond the nominal DS18B20 conversion time
+#define DS18B20_CONVERSION_MARGIN_MS 50
+
+// The continuous (DMA) ADC driver is per chip, not per probe
+static bool adcContinuousReady = false;
+
+// ============================================================================
+// DHT22
+// ============================================================================
+
+Dht22Sensor::Dht22Sensor(uint8_t pin) : dht(pin, DHT22) {
+  startedAt = 0;
+}
+
+void Dht22Sensor::begin() {
+  dht.begin();
+  startedAt = millis();
+  Serial.println("DHT22 initialized (stabilizing)");
+}
+
+void Dht22Sensor::waitUntilStable() {
+  unsigned long elapsed = millis() - startedAt;
+  if (elapsed < DHT22_STABILIZE_MS) {
+    delay(DHT22_STABILIZE_MS - elapsed);
+  }
+}
+
+float Dht22Sensor::readTemperature() {
+  StageTimer timer(STAGE_AIR_TEMPERATURE);
+  
+  float temp = dht.readTemperature();
+  
+  if (isnan(temp)) {
+    Serial.println("Error: Failed to read from DHT22");
+    return SENSOR_READ_FAILED;
+  }
+  
+  return temp;
+}
+
+float Dht22Sensor::readHumidity() {
+  StageTimer timer(STAGE_HUMIDITY);
+  
+  float humidity = dht.readHumidity();
+  
+  if (isnan(humidity)) {
+    Serial.println("Error: Failed to read humidity from DHT22");
+    return SENSOR_READ_FAILED;
+  }
+  
+  return humidity;
+}
+
+// ============================================================================
+// DS18B20
+// ============================================================================
+
+Ds18b20Bus::Ds18b20Bus(uint8_t pin, uint8_t (*addresses)[8], uint8_t maxProbes)
+  : oneWire(pin), sensors(&oneWire), addresses(addresses), maxProbes(maxProbes) {
+  probeCount = 0;
+  conversionPending = false;
+  conversionStartedAt = 0;
+  conversionTimeMs = 750;
+}
+
+bool Ds18b20Bus::begin() {
+  // The only bus searches happen here
+  sensors.begin();
+  int deviceCount = sensors.getDeviceCount();
+  probeCount = 0;
+  for (int i = 0; i < deviceCount && probeCount < maxProbes; i++) {
+    if (sensors.getAddress(addresses[probeCount], i)) {
+      const uint8_t* rom = addresses[probeCount];
+      Serial.printf("  Soil probe %d: %02X%02X%02X%02X%02X%02X%02X%02X\n", probeCount,
+                    rom[0], rom[1], rom[2], rom[3], rom[4], rom[5], rom[6], rom[7]);
+      probeCount++;
+    }
+  }
+  if (deviceCount > maxProbes) {
+    Serial.printf("Warning: %d DS18B20 devices found, reading the first %d\n",
+                  deviceCount, maxProbes);
+  }
+  
+  if (probeCount == 0) {
+    Serial.println("Warning: No DS18B20 devices found");
+    return false;
+  }
+  
+  // Conversions run in the background while other sensors are read;
+  // getResolution() is the highest of all probes, so one wait covers them
+  sensors.setWaitForConversion(false);
+  conversionTimeMs = sensors.millisToWaitForConversion(sensors.getResolution());
+  
+  Serial.printf("DS18B20 initialized (%d probe(s))\n", probeCount);
+  return true;
+}
+
+void Ds18b20Bus::startConversion() {
+  if (probeCount == 0) {
+    return;
+  }
+  
+  // Skip ROM broadcast: every probe converts in the same window.
+  // Returns immediately (setWaitForConversion(false))
+  sensors.requestTemperatures();
+  conversionStartedAt = millis();
+  conversionPending = true;
+}
+
+int Ds18b20Bus::collect(float* temperatures) {
+  StageTimer timer(STAGE_SOIL_TEMPERATURE);
+  
+  if (probeCount == 0) {
+    Serial.println("Error: DS18B20 not initialized");
+    return 0;
+  }
+  
+  if (!conversionPending) {
+    startConversion();
+  }
+  
+  // Wait out whatever is left of the conversion window
+  unsigned long timeout = conversionTimeMs + DS18B20_CONVERSION_MARGIN_MS;
+  while (!sensors.isConversionComplete() && millis() - conversionStartedAt < timeout) {
+    delay(5);
+  }
+  conversionPending = false;
+  
+  // Read each scratchpad by cached address (match ROM, no search)
+  for (int i = 0; i < probeCount; i++) {
+    float temp = sensors.getTempC(addresses[i]);
+    
+    // Check for sensor error
+    if (temp == DEVICE_DISCONNECTED_C) {
+      Serial.printf("Error: DS18B20 probe %d disconnected\n", i);
+      temp = SENSOR_READ_FAILED;
+    }
+    temperatures[i] = temp;
+  }
+  
+  return probeCount;
+}
+
+// ============================================================================
+// Capacitive soil moisture
+// ============================================================================
+
+SoilMoistureProbe::SoilMoistureProbe(uint8_t pin, uint16_t dryRaw, uint16_t wetRaw)
+  : pin(pin), dryRaw(dryRaw), wetRaw(wetRaw) {
+  memset(&characteristics, 0, sizeof(characteristics));
+  wetMillivolts = 0;
+  percentPerMillivolt = 0;
+}
+
+void SoilMoistureProbe::begin() {
+  pinMode(pin, INPUT);
+  
+  esp_adc_cal_value_t source = esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11,
+                                                       ADC_WIDTH_BIT_12, 1100,
+                                                       &characteristics);
+  Serial.printf("ADC characterized from %s\n",
+                source == ESP_ADC_CAL_VAL_EFUSE_TP ? "eFuse two-point" :
+                source == ESP_ADC_CAL_VAL_EFUSE_VREF ? "eFuse Vref" : "default Vref");
+  
+  // The end points are raw counts, linearized like every sample; the
+  // characterization is per chip, so this is the only runtime division
+  int32_t dryMillivolts = esp_adc_cal_raw_to_voltage(dryRaw, &characteristics);
+  wetMillivolts = esp_adc_cal_raw_to_voltage(wetRaw, &characteristics);
+  percentPerMillivolt = dryMillivolts > wetMillivolts ?
+    100.0 / (float)(dryMillivolts - wetMillivolts) : 0;
+  
+  Serial.println("Soil moisture sensor initialized");
+  
+  if (adcContinuousReady) {
+    return;
+  }
+  
+  // Continuous mode samples into DMA buffers without per-sample CPU work
+  adc1_channel_t channel = (adc1_channel_t)digitalPinToAnalogChannel(pin);
+  
+  adc_digi_init_config_t initConfig = {};
+  initConfig.max_store_buf_size = SOIL_MOISTURE_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES * 2;
+  initConfig.conv_num_each_intr = SOIL_MOISTURE_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES;
+  initConfig.adc1_chan_mask = BIT(channel);
+  initConfig.adc2_chan_mask = 0;
+  
+  adc_digi_pattern_config_t pattern = {};
+  pattern.atten = ADC_ATTEN_DB_11;
+  pattern.channel = channel;
+  pattern.unit = 0; // ADC1
+  pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  
+  adc_digi_configuration_t digiConfig = {};
+  digiConfig.conv_limit_en = true;
+  digiConfig.conv_limit_num = 250;
+  digiConfig.pattern_num = 1;
+  digiConfig.adc_pattern = &pattern;
+  digiConfig.sample_freq_hz = SOIL_MOISTURE_SAMPLE_RATE_HZ;
+  digiConfig.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  digiConfig.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+  
+  if (adc_digi_initialize(&initConfig) == ESP_OK &&
+      adc_digi_controller_configure(&digiConfig) == ESP_OK) {
+    adcContinuousReady = true;
+  } else {
+    Serial.println("Warning: ADC continuous mode unavailable, using analogRead");
+    adc_digi_deinitialize();
+  }
+}
+
+float SoilMoistureProbe::read() {
+  StageTimer timer(STAGE_SOIL_MOISTURE);
+  
+  // Oversample and reject outliers so one reading is as good as many
+  uint16_t samples[SOIL_MOISTURE_SAMPLES];
+  int count = sample(samples, SOIL_MOISTURE_SAMPLES);
+  if (count == 0) {
+    Serial.println("Error: Failed to sample soil moisture");
+    return SENSOR_READ_FAILED;
+  }
+  
+  // Linearize through the eFuse characterization
+  int32_t millivolts = esp_adc_cal_raw_to_voltage(trimmedMean(samples, count),
+                                                  &characteristics);
+  
+  // Lower voltage = more moisture
+  float moisture = 100.0 - (float)(millivolts - wetMillivolts) * percentPerMillivolt;
+  
+  // Constrain to valid range
+  return constrain(moisture, 0.0, 100.0);
+}
+
+int SoilMoistureProbe::sample(uint16_t* samples, int count) {
+  if (!adcContinuousReady) {
+    // Fallback: one-shot reads
+    for (int i = 0; i < count; i++) {
+      samples[i] = analogRead(pin);
+    }
+    return count;
+  }
+  
+  uint8_t buffer[SOIL_MOISTURE_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES];
+  int collected = 0;
+  unsigned long start = millis();
+  
+  adc_digi_start();
+  
+  // A full set takes ~3 ms at 20 kHz; give up after 50 ms
+  while (collected < count && millis() - start < 50) {
+    uint32_t length = 0;
+    size_t wanted = (count - collected) * SOC_ADC_DIGI_RESULT_BYTES;
+    if (adc_digi_read_bytes(buffer, min(wanted, sizeof(buffer)), &length, 10) != ESP_OK) {
+      continue;
+    }
+    
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length && collected < count;
+         i += SOC_ADC_DIGI_RESULT_BYTES) {
+      const adc_digi_output_data_t* result = (const adc_digi_output_data_t*)&buffer[i];
+      samples[collected++] = result->type1.data;
+    }
+  }
+  
+  adc_digi_stop();
+  
+  return collected;
+}
+
+uint16_t SoilMoistureProbe::trimmedMean(uint16_t* samples, int count) {
+  // Insertion sort: sample counts are small
+  for (int i = 1; i < count; i++) {
+    uint16_t value = samples[i];
+    int j = i - 1;
+    while (j >= 0 && samples[j] > value) {
+      samples[j + 1] = samples[j];
+      j--;
+    }
+    samples[j + 1] = value;
+  }
+  
+  int trim = count * SOIL_MOISTURE_TRIM_PERCENT / 100;
+  uint32_t sum = 0;
+  for (int i = trim; i < count - trim; i++) {
+    sum += samples[i];
+  }
+  
+  return sum / (count - 2 * trim);
+}
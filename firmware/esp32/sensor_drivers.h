@@ -0,0 +1,163 @@
+// CarbonReady Sensor Drivers
+// One class per sensor part, fixed at compile time by pin, probe count and
+// calibration, so a board variant is a SensorSet type alias (see
+// sensor_manager.h) rather than a fork
+//
+// The templates only bind the parameters; the driver code is in the
+// non-template base classes (sensor_drivers.cpp), so each variant adds no
+// code beyond its constants. Validation ranges and calibration points are
+// constexpr and checked with static_assert.
+
+#ifndef SENSOR_DRIVERS_H
+#define SENSOR_DRIVERS_H
+
+#include <Arduino.h>
+#include <DHT.h>
+#include <OneWire.h>
+#include <DallasTemperature.h>
+#include <esp_adc_cal.h>
+#include "config.h"
+
+// Value a driver returns when the sensor could not be read
+#define SENSOR_READ_FAILED -999.0
+
+// Inclusive range a measurement must fall in to be valid
+struct ValidRange {
+  float min;
+  float max;
+};
+
+// --- DHT22 (air temperature and humidity) -----------------------------------
+
+class Dht22Sensor {
+public:
+  static constexpr ValidRange temperatureRange() { return {-10.0, 60.0}; }
+  static constexpr ValidRange humidityRange() { return {0.0, 100.0}; }
+  
+  explicit Dht22Sensor(uint8_t pin);
+  
+  // Start the sensor; its DHT22_STABILIZE_MS warm-up runs in the background
+  void begin();
+  
+  // Wait out whatever is left of the warm-up
+  void waitUntilStable();
+  
+  // Celsius and percent, SENSOR_READ_FAILED when the read fails
+  float readTemperature();
+  float readHumidity();
+  
+private:
+  DHT dht;
+  unsigned long startedAt;
+};
+
+template <uint8_t Pin>
+class Dht22 : public Dht22Sensor {
+public:
+  Dht22() : Dht22Sensor(Pin) {}
+};
+
+// --- DS18B20 (soil temperature, one or more probes on one bus) --------------
+
+class Ds18b20Bus {
+public:
+  static constexpr ValidRange temperatureRange() { return {-10.0, 60.0}; }
+  
+  // addresses holds maxProbes ROM codes
+  Ds18b20Bus(uint8_t pin, uint8_t (*addresses)[8], uint8_t maxProbes);
+  
+  // Enumerate and cache the probe addresses (the only bus searches).
+  // Returns false if no probe answered.
+  bool begin();
+  
+  // Probes found by begin()
+  uint8_t getProbeCount() { return probeCount; }
+  
+  // Start a conversion on every probe at once and return immediately
+  void startConversion();
+  
+  // Wait for the pending conversion (if still running) and read each probe
+  // by address into temperatures (SENSOR_READ_FAILED for a probe that does
+  // not answer). Returns the number of probes read.
+  int collect(float* temperatures);
+  
+private:
+  OneWire oneWire;
+  DallasTemperature sensors;
+  
+  // ROM codes enumerated in begin(), so reads address each probe directly
+  // instead of searching the bus again
+  uint8_t (*addresses)[8];
+  uint8_t maxProbes;
+  uint8_t probeCount;
+  
+  bool conversionPending;
+  unsigned long conversionStartedAt;
+  uint16_t conversionTimeMs;
+};
+
+template <uint8_t Pin, uint8_t MaxProbes>
+class Ds18b20 : public Ds18b20Bus {
+  static_assert(MaxProbes >= 1, "A DS18B20 bus needs at least one probe");
+  static_assert(MaxProbes <= DS18B20_MAX_PROBES,
+                "MaxProbes exceeds the probes SensorReadings holds (DS18B20_MAX_PROBES)");
+  
+public:
+  Ds18b20() : Ds18b20Bus(Pin, probeAddresses, MaxProbes) {}
+  
+private:
+  uint8_t probeAddresses[MaxProbes][8];
+};
+
+// --- Capacitive soil moisture probe ------------------------------------------
+
+// Two-point calibration: raw 12-bit ADC counts in dry and saturated soil.
+// The probe reads lower the wetter the soil.
+template <uint16_t Dry, uint16_t Wet>
+struct SoilCalibration {
+  static_assert(Dry <= 4095 && Wet <= 4095, "Calibration points are 12-bit ADC counts");
+  static_assert(Dry > Wet, "Dry soil must read higher than wet soil");
+  
+  static constexpr uint16_t DRY = Dry;
+  static constexpr uint16_t WET = Wet;
+};
+
+class SoilMoistureProbe {
+public:
+  static constexpr ValidRange moistureRange() { return {0.0, 100.0}; }
+  
+  SoilMoistureProbe(uint8_t pin, uint16_t dryRaw, uint16_t wetRaw);
+  
+  // Characterize the ADC from eFuse and start the continuous (DMA) driver.
+  // The calibration points are converted to millivolts here, once, so a
+  // read maps to percent with one multiply.
+  void begin();
+  
+  // Oversampled, outlier-trimmed moisture in percent (0-100), or
+  // SENSOR_READ_FAILED when no samples were collected
+  float read();
+  
+private:
+  uint8_t pin;
+  uint16_t dryRaw;
+  uint16_t wetRaw;
+  
+  esp_adc_cal_characteristics_t characteristics;
+  int32_t wetMillivolts;
+  float percentPerMillivolt;  // 100 / (dry - wet), in millivolts
+  
+  // Collect raw samples; returns the number collected
+  int sample(uint16_t* samples, int count);
+  
+  // Mean of the samples left after dropping the lowest and highest
+  // SOIL_MOISTURE_TRIM_PERCENT (sorts samples in place)
+  static uint16_t trimmedMean(uint16_t* samples, int count);
+};
+
+template <uint8_t Pin, class Calibration>
+class CapacitiveSoil : public SoilMoistureProbe {
+public:
+  CapacitiveSoil() : SoilMoistureProbe(Pin, Calibration::DRY, Calibration::WET) {}
+};
+
+#endif // SENSOR_DRIVERS_H
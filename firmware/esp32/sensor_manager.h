@@ -1,46 +1,143 @@
 // CarbonReady Sensor Manager
 // Handles reading from DHT22, DS18B20, and capacitive soil moisture sensors
+//
+// The sensors of a board are a SensorSet of three drivers from
+// sensor_drivers.h (air, soil temperature, soil moisture), with pins, probe
+// count and calibration as template parameters. SensorManager is the
+// standard board; a hardware variant is another alias, e.g.
+//
+//   typedef SensorSet<Dht22<15>, Ds18b20<16, 2>,
+//                     CapacitiveSoil<35, SoilCalibration<3000, 1400>>> OrchardSensors;
+//
+// Every field of SensorReadings is part of the wire format, so each slot
+// needs a driver; what differs between variants is fixed at compile time.
 
 #ifndef SENSOR_MANAGER_H
 #define SENSOR_MANAGER_H
 
 #include <Arduino.h>
+#include "config.h"
+#include "sensor_drivers.h"
+#include "metrics.h"
 
 // Sensor reading structure
 struct SensorReadings {
   float soilMoisture;      // Percentage (0-100%)
-  float soilTemperature;   // Celsius
+  float soilTemperature;   // Celsius (first probe)
   float airTemperature;    // Celsius
   float humidity;          // Percentage (0-100%)
   unsigned long timestamp; // Unix epoch timestamp
   bool valid;              // Indicates if readings are valid
+  
+  // Every DS18B20 probe on the bus, in the order begin() enumerated them;
+  // soilTemperatures[0] equals soilTemperature. Messages only carry the
+  // per-probe list when there is more than one probe.
+  uint8_t soilProbeCount;
+  float soilTemperatures[DS18B20_MAX_PROBES];
+};
+
+// Measurement fields of SensorReadings (soil moisture, soil temperature,
+// air temperature, humidity), in that order wherever they are indexed
+#define AGGREGATE_FIELD_COUNT 4
+
+// Spread of the readings an offline aggregate merged (see aggregate_log.h).
+// The SensorReadings it comes with hold their means; samples is 0 for a
+// single reading.
+struct ReadingSummary {
+  uint32_t span;      // Seconds from the first to the last reading merged
+  uint32_t samples;   // Readings merged
+  int16_t min[AGGREGATE_FIELD_COUNT];  // Hundredths
+  int16_t max[AGGREGATE_FIELD_COUNT];
 };
 
-class SensorManager {
+// Value in hundredths, clamped to what a summary or aggregate holds
+inline int16_t toHundredths(float value) {
+  long hundredths = lroundf(value * 100);
+  return (int16_t)constrain(hundredths, INT16_MIN, INT16_MAX);
+}
+
+// Reading, validation and logging shared by every SensorSet
+class SensorSetBase {
 public:
-  SensorManager();
+  // Get UTC timestamp
+  static unsigned long getUTCTimestamp();
   
-  // Initialize all sensors
-  bool begin();
+protected:
+  // Validate sensor readings
+  static bool validateReading(float value, ValidRange range);
   
-  // Read all sensors and return readings
-  SensorReadings readAllSensors();
+  // Log a finished reading
+  static void logReadings(const SensorReadings& readings);
+};
+
+template <class AirSensor, class SoilTemperatureSensor, class SoilMoistureSensor>
+class SensorSet : public SensorSetBase {
+public:
+  // Initialize all sensors. Returns without waiting for the DHT22 to
+  // stabilize; the first read waits for the rest of the warm-up.
+  bool begin() {
+    Serial.println("Initializing sensors...");
+    
+    // DS18B20 discovery runs now; the DHT22 stabilizes until the first read
+    air.begin();
+    bool soilTemperatureReady = soilTemperature.begin();
+    soilMoisture.begin();
+    
+    return soilTemperatureReady;
+  }
   
-  // Individual sensor reading functions
-  float readSoilMoisture();
-  float readSoilTemperature();
-  float readAirTemperature();
-  float readHumidity();
+  // Read all sensors and return readings
+  SensorReadings readAllSensors() {
+    StageTimer timer(STAGE_READ_ALL);
+    
+    SensorReadings readings;
+    
+    Serial.println("Reading sensors...");
+    
+    // Start the DS18B20 conversion first and read the DHT22 and soil
+    // moisture sensor inside its conversion window
+    soilTemperature.startConversion();
+    readings.soilMoisture = soilMoisture.read();
+    air.waitUntilStable();
+    readings.airTemperature = air.readTemperature();
+    readings.humidity = air.readHumidity();
+    readings.soilProbeCount = soilTemperature.collect(readings.soilTemperatures);
+    readings.soilTemperature = readings.soilProbeCount > 0 ?
+      readings.soilTemperatures[0] : SENSOR_READ_FAILED;
+    readings.timestamp = getUTCTimestamp();
+    
+    // Validate all readings against the drivers' constant ranges
+    bool allValid = true;
+    allValid &= validateReading(readings.soilMoisture, SoilMoistureSensor::moistureRange());
+    allValid &= validateReading(readings.soilTemperature, SoilTemperatureSensor::temperatureRange());
+    for (int i = 1; i < readings.soilProbeCount; i++) {
+      allValid &= validateReading(readings.soilTemperatures[i],
+                                  SoilTemperatureSensor::temperatureRange());
+    }
+    allValid &= validateReading(readings.airTemperature, AirSensor::temperatureRange());
+    allValid &= validateReading(readings.humidity, AirSensor::humidityRange());
+    
+    readings.valid = allValid;
+    logReadings(readings);
+    
+    return readings;
+  }
   
-  // Get UTC timestamp
-  unsigned long getUTCTimestamp();
+  // DS18B20 probes found (and addresses cached) by begin()
+  uint8_t getSoilProbeCount() {
+    return soilTemperature.getProbeCount();
+  }
   
 private:
-  bool dht22Initialized;
-  bool ds18b20Initialized;
-  
-  // Validate sensor readings
-  bool validateReading(float value, float min, float max);
+  AirSensor air;
+  SoilTemperatureSensor soilTemperature;
+  SoilMoistureSensor soilMoisture;
 };
 
+// The CarbonReady board: pins and calibration from config.h
+typedef SensorSet<Dht22<DHT22_PIN>,
+                  Ds18b20<DS18B20_PIN, DS18B20_MAX_PROBES>,
+                  CapacitiveSoil<SOIL_MOISTURE_PIN,
+                                 SoilCalibration<SOIL_MOISTURE_DRY, SOIL_MOISTURE_WET>>> SensorManager;
+
 #endif // SENSOR_MANAGER_H
@@ -0,0 +1,118 @@
+// CarbonReady Sensor Task Implementation
+
+#include "sensor_task.h"
+#include "runtime_config.h"
+#include "metrics.h"
+
+// Longest single wait, so interval changes from the commands topic apply
+// without waiting out the previous interval
+#define SENSOR_TASK_MAX_WAIT_MS 1000
+
+SensorTask::SensorTask(SensorManager& sensorManager,
+                       ReadingAggregator& readingAggregator,
+                       PublishPipeline& publishPipeline)
+  : sensorManager(sensorManager),
+    readingAggregator(readingAggregator),
+    publishPipeline(publishPipeline) {
+  taskHandle = nullptr;
+  consumer = nullptr;
+}
+
+bool SensorTask::startTask(TaskHandle_t consumer) {
+  if (taskHandle != nullptr) {
+    return true;
+  }
+  
+  this->consumer = consumer;
+  
+  BaseType_t created = xTaskCreatePinnedToCore(taskEntry, "sensors",
+                                               SENSOR_TASK_STACK_SIZE, this,
+                                               SENSOR_TASK_PRIORITY, &taskHandle,
+                                               SENSOR_TASK_CORE);
+  if (created != pdPASS) {
+    Serial.println("Error: Failed to start sensor task");
+    taskHandle = nullptr;
+    return false;
+  }
+  
+  deviceMetrics.watchTask("sensors", taskHandle);
+  Serial.println("Sensor task started");
+  return true;
+}
+
+bool SensorTask::take(SensorReadings& readings, ReadingSummary* summary) {
+  if (!queue.peek(readings, summary)) {
+    return false;
+  }
+  queue.pop();
+  return true;
+}
+
+int SensorTask::getQueuedCount() {
+  return queue.size();
+}
+
+void SensorTask::taskEntry(void* parameter) {
+  static_cast<SensorTask*>(parameter)->runTask();
+}
+
+void SensorTask::runTask() {
+  unsigned long lastReadingTime = millis();
+  sample();
+  
+  for (;;) {
+    // Re-read every pass so commands take effect without a reboot
+    TunableSettings settings = runtimeConfig.get();
+#if EDGE_AGGREGATION
+    unsigned long interval = settings.sampleIntervalMs;
+    readingAggregator.setWindow(settings.aggregationWindowMs);
+#else
+    unsigned long interval = settings.readingIntervalMs;
+#endif
+    
+    unsigned long currentTime = millis();
+    unsigned long elapsed = currentTime - lastReadingTime;
+    if (elapsed >= interval) {
+      lastReadingTime = currentTime;
+      sample();
+      continue;
+    }
+    
+    vTaskDelay(pdMS_TO_TICKS(min(interval - elapsed, (unsigned long)SENSOR_TASK_MAX_WAIT_MS)));
+  }
+}
+
+void SensorTask::sample() {
+  Serial.println("\n--- Taking sensor reading ---");
+  
+  SensorReadings readings = sensorManager.readAllSensors();
+  
+  if (!readings.valid) {
+    Serial.println("Error: Invalid sensor readings, skipping transmission");
+    return;
+  }
+  
+  // A single reading has no spread
+  ReadingSummary summary;
+  summary.samples = 0;
+  
+#if EDGE_AGGREGATION
+  // Only report at the end of a window or when a field jumps
+  if (!readingAggregator.add(readings, millis())) {
+    return;
+  }
+  readings = readingAggregator.takeReport(&summary);
+#endif
+  
+  if (!queue.push(readings, &summary)) {
+    Serial.println("Sensor queue full, storing reading offline");
+    if (!publishPipeline.storeOffline(readings)) {
+      Serial.println("Error: Failed to store data offline");
+    }
+    return;
+  }
+  
+  if (consumer != nullptr) {
+    xTaskNotifyGive(consumer);
+  }
+}
@@ -0,0 +1,59 @@
+// CarbonReady Sensor Task
+// Samples the sensors on a pinned high-priority task
+//
+// Sampling runs on SENSOR_TASK_CORE, away from the WiFi stack on the other
+// core, at SENSOR_TASK_PRIORITY, above the processing task (loop()) on the
+// same core. The bit-banged DHT22 read is timing-sensitive, so nothing on
+// its core preempts it. Valid readings (or aggregate reports with
+// EDGE_AGGREGATION) go onto a fixed-size ReadingQueue and the consumer
+// task is notified; message building, hashing and storage stay off this
+// task. If processing falls so far behind that the queue is full, the
+// reading is stored offline instead.
+
+#ifndef SENSOR_TASK_H
+#define SENSOR_TASK_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+#include "sensor_manager.h"
+#include "reading_aggregator.h"
+#include "reading_queue.h"
+#include "publish_pipeline.h"
+
+class SensorTask {
+public:
+  SensorTask(SensorManager& sensorManager,
+             ReadingAggregator& readingAggregator,
+             PublishPipeline& publishPipeline);
+  
+  // Start sampling (the first reading is taken right away); consumer is
+  // notified after each reading is queued
+  bool startTask(TaskHandle_t consumer);
+  
+  // Consumer: take the oldest queued reading and, if asked for, the summary
+  // of the window it aggregates (samples 0 for a single reading)
+  bool take(SensorReadings& readings, ReadingSummary* summary = nullptr);
+  
+  // Readings waiting for the consumer
+  int getQueuedCount();
+  
+private:
+  SensorManager& sensorManager;
+  ReadingAggregator& readingAggregator;
+  PublishPipeline& publishPipeline;
+  
+  ReadingQueue queue;
+  TaskHandle_t taskHandle;
+  TaskHandle_t consumer;
+  
+  // Task body
+  static void taskEntry(void* parameter);
+  void runTask();
+  
+  // Read the sensors and queue the result if there is one to report
+  void sample();
+};
+
+#endif // SENSOR_TASK_H
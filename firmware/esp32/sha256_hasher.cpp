@@ -0,0 +1,70 @@
+// CarbonReady SHA-256 Hasher Implementation
+
+#include "sha256_hasher.h"
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static const char BASE64_ALPHABET[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+Sha256Hasher::Sha256Hasher() {
+  mbedtls_sha256_init(&context);
+}
+
+Sha256Hasher::~Sha256Hasher() {
+  mbedtls_sha256_free(&context);
+}
+
+void Sha256Hasher::begin() {
+  mbedtls_sha256_starts(&context, 0); // 0 = SHA-256 (not SHA-224)
+}
+
+void Sha256Hasher::update(const void* data, size_t length) {
+  mbedtls_sha256_update(&context, (const unsigned char*)data, length);
+}
+
+void Sha256Hasher::finish(uint8_t* digest) {
+  mbedtls_sha256_finish(&context, digest);
+}
+
+void Sha256Hasher::hash(const void* data, size_t length, uint8_t* digest) {
+  begin();
+  update(data, length);
+  finish(digest);
+}
+
+void Sha256Hasher::toHex(const uint8_t* data, size_t length, char* hex) {
+  for (size_t i = 0; i < length; i++) {
+    *hex++ = HEX_DIGITS[data[i] >> 4];
+    *hex++ = HEX_DIGITS[data[i] & 0x0f];
+  }
+  *hex = '\0';
+}
+
+void Sha256Hasher::toBase64(const uint8_t* data, size_t length, char* base64) {
+  char* out = base64;
+  
+  // Whole groups: three bytes to four characters
+  size_t whole = length - length % 3;
+  for (size_t i = 0; i < whole; i += 3) {
+    uint32_t group = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+    *out++ = BASE64_ALPHABET[group >> 18];
+    *out++ = BASE64_ALPHABET[(group >> 12) & 0x3f];
+    *out++ = BASE64_ALPHABET[(group >> 6) & 0x3f];
+    *out++ = BASE64_ALPHABET[group & 0x3f];
+  }
+  
+  // Last one or two bytes, padded (a digest ends with two)
+  size_t remaining = length - whole;
+  if (remaining > 0) {
+    uint32_t group = (uint32_t)data[whole] << 16;
+    if (remaining == 2) {
+      group |= (uint32_t)data[whole + 1] << 8;
+    }
+    *out++ = BASE64_ALPHABET[group >> 18];
+    *out++ = BASE64_ALPHABET[(group >> 12) & 0x3f];
+    *out++ = remaining == 2 ? BASE64_ALPHABET[(group >> 6) & 0x3f] : '=';
+    *out++ = '=';
+  }
+  *out = '\0';
+}
@@ -0,0 +1,58 @@
+// CarbonReady SHA-256 Hasher
+// One reusable SHA-256 context and the digest encoders
+//
+// Wraps an mbedtls_sha256_context that is initialised once and restarted
+// for every hash, so the message and batch paths never set up or tear down
+// a context per message. The ESP32 Arduino core builds mbedtls with the
+// hardware SHA accelerator (CONFIG_MBEDTLS_HARDWARE_SHA): each hash takes
+// the SHA engine on its first block and releases it in finish(), and a hash
+// started while the engine is busy (for example during a TLS handshake) runs
+// in software instead. update() reads straight from the caller's buffer.
+//
+// A hasher is not shared between tasks; each path that hashes owns one.
+// The encoders are table-driven and write into fixed buffers.
+
+#ifndef SHA256_HASHER_H
+#define SHA256_HASHER_H
+
+#include <Arduino.h>
+#include <mbedtls/sha256.h>
+
+// Bytes in a SHA-256 digest
+#define SHA256_DIGEST_SIZE 32
+
+// Hex-encoded SHA-256 digest plus terminator
+#define HASH_HEX_SIZE 65
+
+// Base64-encoded SHA-256 digest plus terminator
+#define HASH_BASE64_SIZE 45
+
+class Sha256Hasher {
+public:
+  Sha256Hasher();
+  ~Sha256Hasher();
+  
+  // Start a new hash (discards any hash in progress)
+  void begin();
+  
+  // Add bytes to the hash in progress
+  void update(const void* data, size_t length);
+  
+  // Finish the hash into digest (SHA256_DIGEST_SIZE bytes)
+  void finish(uint8_t* digest);
+  
+  // Hash one buffer: begin(), update() and finish()
+  void hash(const void* data, size_t length, uint8_t* digest);
+  
+  // Encode binary data as lowercase hex (2 * length + 1 bytes)
+  static void toHex(const uint8_t* data, size_t length, char* hex);
+  
+  // Encode binary data as standard padded base64 (4 * ceil(length / 3) + 1
+  // bytes)
+  static void toBase64(const uint8_t* data, size_t length, char* base64);
+  
+private:
+  mbedtls_sha256_context context;
+};
+
+#endif // SHA256_HASHER_H
@@ -0,0 +1,113 @@
+// CarbonReady Outage Soak Harness Implementation
+
+#include "soak_harness.h"
+#include "runtime_config.h"
+#include "metrics.h"
+
+SoakHarness::SoakHarness(PublishPipeline& pipeline, LocalStorage& flash)
+  : pipeline(pipeline), flash(flash) {
+}
+
+SoakReport SoakHarness::run(int outageReadings, uint32_t intervalMs) {
+  SoakReport report;
+  memset(&report, 0, sizeof(report));
+  report.outageReadings = outageReadings;
+  
+  deviceMetrics.reset();
+  uint32_t flashBytesBefore = flash.getBytesWritten();
+  report.freeHeapBefore = ESP.getFreeHeap();
+  
+  Serial.printf("Soak: simulating %d failed publishes (%lu min apart)\n",
+                outageReadings, (unsigned long)(intervalMs / 60000));
+  
+  // The outage ends now; its first reading is the oldest
+  unsigned long end = SensorSetBase::getUTCTimestamp();
+  unsigned long start = end - (unsigned long)((uint64_t)outageReadings * intervalMs / 1000);
+  
+  unsigned long outageStart = millis();
+  for (int i = 0; i < outageReadings; i++) {
+    SensorReadings readings = outageReading(i, start + (unsigned long)((uint64_t)i * intervalMs / 1000));
+    
+    unsigned long storeStart = micros();
+    bool stored = pipeline.storeOffline(readings);
+    uint32_t storeMicros = micros() - storeStart;
+    
+    report.maxStoreMicros = max(report.maxStoreMicros, storeMicros);
+    if (!stored) {
+      report.droppedReadings++;
+    }
+  }
+  
+  // A ring that held readings this long would have spilled to flash
+  uint64_t outageSpanMs = (uint64_t)outageReadings * intervalMs;
+  if (PSRAM_SPILL_AGE_MS > 0 && outageSpanMs >= PSRAM_SPILL_AGE_MS) {
+    pipeline.flushStorage();
+  }
+  report.outageMs = millis() - outageStart;
+  report.storedReadings = pipeline.getStoredCount();
+  report.hourlyAggregates = flash.getHourlyCount();
+  report.dailyAggregates = flash.getDailyCount();
+  
+  // Reconnect: the first publish of the drain connects
+  Serial.printf("Soak: reconnecting with %d readings stored\n", report.storedReadings);
+  unsigned long drainStart = millis();
+  pipeline.syncOfflineReadings();
+  report.drainMs = millis() - drainStart;
+  
+  report.remainingReadings = pipeline.getStoredCount();
+  report.flashBytesWritten = flash.getBytesWritten() - flashBytesBefore;
+  report.freeHeapAfter = ESP.getFreeHeap();
+  report.minFreeHeap = ESP.getMinFreeHeap();
+  report.peakHeapUsed = ESP.getHeapSize() - report.minFreeHeap;
+  
+  StageHistogram sync = deviceMetrics.getStage(STAGE_SYNC_BATCH);
+  report.maxSyncMicros = sync.maxMicros;
+  report.syncWindows = sync.count;
+  
+  return report;
+}
+
+size_t SoakHarness::writeReport(const SoakReport& report, char* output, size_t capacity) {
+  TunableSettings settings = runtimeConfig.get();
+  int drained = report.storedReadings - report.remainingReadings;
+  unsigned long perSecond = report.drainMs > 0 ?
+    (unsigned long)((uint64_t)drained * 1000 / report.drainMs) : 0;
+  
+  int length = snprintf(output, capacity,
+                        "{\"soak\":{"
+                        "\"config\":{\"qos\":%d,\"window\":%d,\"batchSize\":%u,"
+                        "\"wireFormat\":%d,\"compression\":%d,\"psramCapacity\":%d},"
+                        "\"readings\":{\"outage\":%d,\"stored\":%d,\"dropped\":%d,\"remaining\":%d,"
+                        "\"hourly\":%d,\"daily\":%d},"
+                        "\"outageMs\":%lu,\"drainMs\":%lu,\"drainPerSecond\":%lu,"
+                        "\"flashBytesWritten\":%lu,"
+                        "\"heap\":{\"freeBefore\":%lu,\"freeAfter\":%lu,\"minFree\":%lu,\"peakUsed\":%lu},"
+                        "\"stallMicros\":{\"store\":%lu,\"syncWindow\":%lu},"
+                        "\"syncWindows\":%lu}}",
+                        MQTT_PUBLISH_QOS, SYNC_WINDOW_BATCHES, (unsigned)settings.syncBatchSize,
+                        WIRE_FORMAT, PAYLOAD_COMPRESSION, PSRAM_TIER_CAPACITY,
+                        report.outageReadings, report.storedReadings,
+                        report.droppedReadings, report.remainingReadings,
+                        report.hourlyAggregates, report.dailyAggregates,
+                        (unsigned long)report.outageMs, (unsigned long)report.drainMs, perSecond,
+                        (unsigned long)report.flashBytesWritten,
+                        (unsigned long)report.freeHeapBefore, (unsigned long)report.freeHeapAfter,
+                        (unsigned long)report.minFreeHeap, (unsigned long)report.peakHeapUsed,
+                        (unsigned long)report.maxStoreMicros, (unsigned long)report.maxSyncMicros,
+                        (unsigned long)report.syncWindows);
+  
+  return length > 0 && (size_t)length < capacity ? length : 0;
+}
+
+SensorReadings SoakHarness::outageReading(int i, unsigned long timestamp) {
+  SensorReadings readings;
+  readings.soilMoisture = 30.0 + (i % 97) * 0.31;
+  readings.soilTemperature = 18.0 + (i % 13) * 0.25;
+  readings.airTemperature = 21.0 + (i % 29) * 0.4;
+  readings.humidity = 55.0 + (i % 41) * 0.5;
+  readings.timestamp = timestamp;
+  readings.valid = true;
+  readings.soilProbeCount = 1;
+  readings.soilTemperatures[0] = readings.soilTemperature;
+  return readings;
+}
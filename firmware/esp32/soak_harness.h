@@ -0,0 +1,71 @@
+// CarbonReady Outage Soak Harness
+// Reproduces a long outage followed by a reconnect and reports how the
+// backlog drains, so storage and sync changes can be compared on numbers
+//
+// The outage stores readings the way a failed publish does
+// (PublishPipeline::storeOffline()), with timestamps spaced like real
+// readings. Once it has lasted past PSRAM_SPILL_AGE_MS of simulated time the
+// PSRAM tier is flushed, as its age spill would have done. The reconnect
+// is one PublishPipeline::syncOfflineReadings() call on the caller's task
+// (the network task must not be running).
+//
+// Reported:
+//   - drain time and readings per second through syncOfflineReadings()
+//   - bytes LocalStorage wrote to flash during the run
+//   - free heap before and after, and the lowest free heap since boot
+//   - loop stalls: the longest single store during the outage (what the
+//     processing task waits when the queue spills) and the longest sync
+//     window (how long the drain goes without servicing the connection)
+//
+// Resets the device metrics window. Run from a test (native) or the
+// SOAK_TEST_READINGS boot mode (on device).
+
+#ifndef SOAK_HARNESS_H
+#define SOAK_HARNESS_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "local_storage.h"
+#include "publish_pipeline.h"
+
+struct SoakReport {
+  int outageReadings;          // Failed publishes simulated
+  int storedReadings;          // Backlog at reconnect (an aggregate counts once)
+  int hourlyAggregates;        // Of which hourly and daily aggregates
+  int dailyAggregates;
+  int droppedReadings;         // Rejected because storage was full
+  int remainingReadings;       // Still stored after the drain
+  uint32_t outageMs;           // Time to store the backlog
+  uint32_t drainMs;            // syncOfflineReadings() wall time
+  uint32_t flashBytesWritten;  // LocalStorage::getBytesWritten() over the run
+  uint32_t freeHeapBefore;
+  uint32_t freeHeapAfter;
+  uint32_t minFreeHeap;        // Low-water mark since boot
+  uint32_t peakHeapUsed;       // Heap size minus minFreeHeap
+  uint32_t maxStoreMicros;     // Longest store during the outage
+  uint32_t maxSyncMicros;      // Longest syncBatch() window of the drain
+  uint32_t syncWindows;        // syncBatch() calls made by the drain
+};
+
+class SoakHarness {
+public:
+  SoakHarness(PublishPipeline& pipeline, LocalStorage& flash);
+  
+  // Simulate outageReadings failed publishes intervalMs apart, then
+  // reconnect and drain the backlog
+  SoakReport run(int outageReadings, uint32_t intervalMs);
+  
+  // Write a report as one line of JSON (with the sync settings it ran
+  // under). Returns the length, or 0 if it does not fit.
+  static size_t writeReport(const SoakReport& report, char* output, size_t capacity);
+  
+private:
+  PublishPipeline& pipeline;
+  LocalStorage& flash;
+  
+  // Reading number i of the outage (varied so batches do not compress
+  // better than real data)
+  static SensorReadings outageReading(int i, unsigned long timestamp);
+};
+
+#endif // SOAK_HARNESS_H
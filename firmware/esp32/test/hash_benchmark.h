@@ -0,0 +1,62 @@
+// CarbonReady SHA-256 benchmark loops
+// Shared by the host benchmark (test_native_benchmark) and the on-device
+// one (test_sha256): the per-call context and sprintf path Sha256Hasher
+// replaced, and timed loops over both. Each suite reports its own results
+// and heap check.
+
+#ifndef HASH_BENCHMARK_H
+#define HASH_BENCHMARK_H
+
+#include <Arduino.h>
+#include <mbedtls/sha256.h>
+#include "sha256_hasher.h"
+
+// Hash and hex-encode the way computeSHA256Hash() did before Sha256Hasher:
+// a context set up and torn down per call, one sprintf per byte
+static inline void legacyHashHex(const uint8_t* data, size_t length, char* hashHex) {
+  unsigned char hash[32];
+  mbedtls_sha256_context ctx;
+  mbedtls_sha256_init(&ctx);
+  mbedtls_sha256_starts(&ctx, 0);
+  mbedtls_sha256_update(&ctx, data, length);
+  mbedtls_sha256_finish(&ctx, hash);
+  mbedtls_sha256_free(&ctx);
+  for (size_t i = 0; i < sizeof(hash); i++) {
+    sprintf(hashHex + i * 2, "%02x", hash[i]);
+  }
+}
+
+// Fill length bytes of payload with a fixed pattern
+static inline void fillHashPayload(uint8_t* payload, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    payload[i] = (uint8_t)(i * 31);
+  }
+}
+
+// Microseconds for iterations legacy hashes of payload (its first byte
+// changing each time); the last digest is left in hashHex
+static inline unsigned long timeLegacyHash(uint8_t* payload, size_t length, int iterations,
+                                           char* hashHex) {
+  unsigned long start = micros();
+  for (int i = 0; i < iterations; i++) {
+    payload[0] = (uint8_t)i;
+    legacyHashHex(payload, length, hashHex);
+  }
+  return micros() - start;
+}
+
+// The same loop through one reused Sha256Hasher and the table-driven hex
+// encoder
+static inline unsigned long timeHasher(Sha256Hasher& hasher, uint8_t* payload, size_t length,
+                                       int iterations, char* hashHex) {
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  unsigned long start = micros();
+  for (int i = 0; i < iterations; i++) {
+    payload[0] = (uint8_t)i;
+    hasher.hash(payload, length, digest);
+    Sha256Hasher::toHex(digest, sizeof(digest), hashHex);
+  }
+  return micros() - start;
+}
+
+#endif // HASH_BENCHMARK_H
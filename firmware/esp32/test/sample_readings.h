@@ -0,0 +1,38 @@
+// CarbonReady test readings
+// Shared by the host and on-device suites: one valid single-probe reading
+// at a given time, and a series of them for the storage tests and benchmarks.
+
+#ifndef SAMPLE_READINGS_H
+#define SAMPLE_READINGS_H
+
+#include <Arduino.h>
+#include "sensor_manager.h"
+
+// First reading of every series (2025-01-15 10:30:00 UTC)
+#define SAMPLE_READINGS_START 1736937000UL
+
+// A valid reading at timestamp; the soil temperature is negative so the
+// formatters see a sign
+static inline SensorReadings readingsAt(uint32_t timestamp) {
+  SensorReadings readings;
+  readings.soilMoisture = 45.5;
+  readings.soilTemperature = -2.15;
+  readings.airTemperature = 28.5;
+  readings.humidity = 65.8;
+  readings.timestamp = timestamp;
+  readings.valid = true;
+  readings.soilProbeCount = 1;
+  readings.soilTemperatures[0] = readings.soilTemperature;
+  return readings;
+}
+
+// The i-th reading of a series interval seconds apart; soil moisture steps
+// up by 0.01 % per reading (from 40.00 %, wrapping every 1000) so readings
+// can be told apart
+static inline SensorReadings sampleReadings(int i, uint32_t interval = 900) {
+  SensorReadings readings = readingsAt(SAMPLE_READINGS_START + i * interval);
+  readings.soilMoisture = 40.0 + (i % 1000) * 0.01;
+  return readings;
+}
+
+#endif // SAMPLE_READINGS_H
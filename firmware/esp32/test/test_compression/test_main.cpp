@@ -0,0 +1,136 @@
+// CarbonReady compression tests and benchmark
+// Round-trips representative batches through DataProcessor::compressData
+// and reports compression ratio and time per batch size.
+//
+// Run on device: pio test -e esp32dev_test -f test_compression
+
+#include <Arduino.h>
+#include <unity.h>
+#include "config.h"
+#include "data_processor.h"
+
+static DataProcessor dataProcessor;
+static char batch[MQTT_BUFFER_SIZE];
+static uint8_t compressed[MQTT_BUFFER_SIZE];
+static uint8_t decompressed[MQTT_BUFFER_SIZE];
+
+// Reference heatshrink decoder (mirrors the ingestion Lambda)
+static size_t decompress(const uint8_t* input, size_t inputSize,
+                         uint8_t* output, size_t capacity) {
+  size_t totalBits = inputSize * 8;
+  size_t position = 0;
+  size_t length = 0;
+  
+  auto readBits = [&](int count) {
+    uint16_t value = 0;
+    for (int i = 0; i < count; i++, position++) {
+      value = (value << 1) | ((input[position >> 3] >> (7 - (position & 7))) & 1);
+    }
+    return value;
+  };
+  
+  while (position < totalBits) {
+    size_t remaining = totalBits - position;
+    if (readBits(1)) {
+      if (remaining < 9 || length >= capacity) {
+        break;
+      }
+      output[length++] = readBits(8);
+    } else {
+      if (remaining < 1 + HEATSHRINK_WINDOW_BITS + HEATSHRINK_LOOKAHEAD_BITS) {
+        break;
+      }
+      size_t distance = readBits(HEATSHRINK_WINDOW_BITS) + 1;
+      size_t count = readBits(HEATSHRINK_LOOKAHEAD_BITS) + 1;
+      for (size_t i = 0; i < count && length < capacity; i++, length++) {
+        output[length] = output[length - distance];
+      }
+    }
+  }
+  
+  return length;
+}
+
+// Build a batch message like syncOfflineReadings() does
+static size_t buildBatch(int readingCount) {
+  size_t length = sprintf(batch, "{\"batch\":[");
+  
+  for (int i = 0; i < readingCount; i++) {
+    SensorReadings readings;
+    readings.soilMoisture = 42.0 + i * 0.25;
+    readings.soilTemperature = 24.5 - i * 0.05;
+    readings.airTemperature = 29.0 + i * 0.1;
+    readings.humidity = 63.0 + i * 0.5;
+    readings.timestamp = 1736937000UL + i * 900;
+    readings.valid = true;
+    readings.soilProbeCount = 1;
+    readings.soilTemperatures[0] = readings.soilTemperature;
+    
+    if (i > 0) {
+      batch[length++] = ',';
+    }
+    size_t messageLength = dataProcessor.createMessage(readings, "farm-001", "A1B2C3D4E5F6",
+                                                       batch + length, sizeof(batch) - length - 2);
+    TEST_ASSERT_GREATER_THAN(0, messageLength);
+    length += messageLength;
+  }
+  
+  batch[length++] = ']';
+  batch[length++] = '}';
+  return length;
+}
+
+static void benchmarkBatch(int readingCount) {
+  size_t length = buildBatch(readingCount);
+  size_t compressedLength = sizeof(compressed);
+  
+  unsigned long start = micros();
+  TEST_ASSERT_TRUE(dataProcessor.compressData((const uint8_t*)batch, length,
+                                              compressed, &compressedLength));
+  unsigned long elapsed = micros() - start;
+  
+  size_t decompressedLength = decompress(compressed, compressedLength,
+                                         decompressed, sizeof(decompressed));
+  TEST_ASSERT_EQUAL(length, decompressedLength);
+  TEST_ASSERT_EQUAL_MEMORY(batch, decompressed, length);
+  
+  char report[96];
+  snprintf(report, sizeof(report), "%2d readings: %4u -> %4u bytes (%.1f%%) in %lu us",
+           readingCount, (unsigned)length, (unsigned)compressedLength,
+           100.0 * compressedLength / length, elapsed);
+  TEST_MESSAGE(report);
+}
+
+void test_compress_single_message() {
+  benchmarkBatch(1);
+}
+
+void test_compress_small_batch() {
+  benchmarkBatch(4);
+}
+
+void test_compress_full_batch() {
+  benchmarkBatch(14);
+}
+
+void test_compress_output_overflow() {
+  size_t length = buildBatch(4);
+  size_t compressedLength = 64;
+  
+  TEST_ASSERT_FALSE(dataProcessor.compressData((const uint8_t*)batch, length,
+                                               compressed, &compressedLength));
+}
+
+void setup() {
+  delay(2000); // Allow the serial monitor to attach
+  
+  UNITY_BEGIN();
+  RUN_TEST(test_compress_single_message);
+  RUN_TEST(test_compress_small_batch);
+  RUN_TEST(test_compress_full_batch);
+  RUN_TEST(test_compress_output_overflow);
+  UNITY_END();
+}
+
+void loop() {
+}
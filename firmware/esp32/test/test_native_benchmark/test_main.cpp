@@ -0,0 +1,184 @@
+// CarbonReady host benchmarks
+// Runs the hot paths (message creation, hashing, offline store and sync)
+// on the build machine against the shims in native/, so regressions show
+// up without flashing a board. Absolute numbers are host numbers; compare
+// runs on the same machine only.
+//
+// Each result is printed on its own line for scripts to pick up:
+//   BENCH <name> <value> <unit>
+//
+// Run on host: pio test -e native
+
+#include <Arduino.h>
+#include <unity.h>
+#include "config.h"
+#include "data_processor.h"
+#include "local_storage.h"
+#include "sha256_hasher.h"
+#include "../hash_benchmark.h"
+#include "../sample_readings.h"
+
+#define MESSAGE_ITERATIONS 20000
+#define HASH_ITERATIONS 2000
+#define STORAGE_CYCLES 200
+
+static DataProcessor dataProcessor;
+static char message[512];
+static uint8_t binaryMessage[128];
+static SensorReadings batch[SYNC_BATCH_MAX_READINGS];
+
+static void report(const char* name, double value, const char* unit) {
+  printf("BENCH %s %.2f %s\n", name, value, unit);
+}
+
+void test_sha256_known_answer() {
+  // FIPS 180-2 "abc" vector; guards the host SHA-256 shim
+  char hashHex[65];
+  dataProcessor.computeSHA256Hash((const uint8_t*)"abc", 3, hashHex);
+  TEST_ASSERT_EQUAL_STRING("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+                           hashHex);
+}
+
+void test_bench_create_message_json() {
+  SensorReadings readings = sampleReadings(0);
+  uint32_t allocations = nativeAllocationCount();
+  
+  unsigned long start = micros();
+  for (int i = 0; i < MESSAGE_ITERATIONS; i++) {
+    readings.timestamp++;
+    TEST_ASSERT_GREATER_THAN(0, dataProcessor.createMessage(readings, "farm-001", "A1B2C3D4E5F6",
+                                                            message, sizeof(message)));
+  }
+  unsigned long elapsed = micros() - start;
+  
+  report("create_message_json", MESSAGE_ITERATIONS * 1e6 / max(elapsed, 1UL), "msgs/s");
+  TEST_ASSERT_EQUAL_UINT32(allocations, nativeAllocationCount());
+}
+
+void test_bench_create_message_msgpack() {
+  SensorReadings readings = sampleReadings(0);
+  uint32_t allocations = nativeAllocationCount();
+  
+  unsigned long start = micros();
+  for (int i = 0; i < MESSAGE_ITERATIONS; i++) {
+    readings.timestamp++;
+    TEST_ASSERT_GREATER_THAN(0, dataProcessor.createBinaryMessage(readings, "farm-001", "A1B2C3D4E5F6",
+                                                                  binaryMessage, sizeof(binaryMessage)));
+  }
+  unsigned long elapsed = micros() - start;
+  
+  report("create_message_msgpack", MESSAGE_ITERATIONS * 1e6 / max(elapsed, 1UL), "msgs/s");
+  TEST_ASSERT_EQUAL_UINT32(allocations, nativeAllocationCount());
+}
+
+// Hash a payload of `length` bytes (a single message or a full batch) with
+// the legacy path and with one reused Sha256Hasher, and report both
+static void benchmarkHash(size_t length) {
+  static uint8_t data[4096];
+  fillHashPayload(data, length);
+  
+  char legacyHex[HASH_HEX_SIZE];
+  char hashHex[HASH_HEX_SIZE];
+  unsigned long legacyElapsed = timeLegacyHash(data, length, HASH_ITERATIONS, legacyHex);
+  
+  Sha256Hasher hasher;
+  uint32_t allocations = nativeAllocationCount();
+  unsigned long elapsed = timeHasher(hasher, data, length, HASH_ITERATIONS, hashHex);
+  
+  // Same digest for the last payload, without touching the heap
+  TEST_ASSERT_EQUAL_STRING(legacyHex, hashHex);
+  TEST_ASSERT_EQUAL_UINT32(allocations, nativeAllocationCount());
+  
+  char name[48];
+  snprintf(name, sizeof(name), "sha256_hex_%u_legacy", (unsigned)length);
+  report(name, (double)legacyElapsed / HASH_ITERATIONS, "us");
+  snprintf(name, sizeof(name), "sha256_hex_%u", (unsigned)length);
+  report(name, (double)elapsed / HASH_ITERATIONS, "us");
+  snprintf(name, sizeof(name), "sha256_%u", (unsigned)length);
+  report(name, (double)HASH_ITERATIONS * length / max(elapsed, 1UL), "MB/s");
+}
+
+void test_bench_sha256_message() {
+  benchmarkHash(200);
+}
+
+void test_bench_sha256_batch() {
+  benchmarkHash(4096);
+}
+
+// Store one reading and sync one batch per cycle with `backlog` readings
+// already queued, so the cost can be compared across backlog depths.
+static void benchmarkStorage(int backlog) {
+  LocalStorage storage(backlog + SYNC_BATCH_MAX_READINGS);
+  TEST_ASSERT_TRUE(storage.begin());
+  TEST_ASSERT_TRUE(storage.clearReadings());
+  
+  for (int i = 0; i < backlog; i++) {
+    TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i)));
+  }
+  TEST_ASSERT_EQUAL(backlog, storage.getStoredCount());
+  
+  unsigned long storeMicros = 0;
+  unsigned long syncMicros = 0;
+  uint32_t allocations = nativeAllocationCount();
+  
+  for (int cycle = 0; cycle < STORAGE_CYCLES; cycle++) {
+    unsigned long start = micros();
+    TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(backlog + cycle)));
+    storeMicros += micros() - start;
+    
+    // Drain one reading per cycle so the backlog stays at its depth
+    start = micros();
+    int count = storage.readOldest(batch, 1);
+    TEST_ASSERT_EQUAL(1, count);
+    TEST_ASSERT_TRUE(storage.removeOldest(count));
+    syncMicros += micros() - start;
+  }
+  
+  uint32_t allocated = nativeAllocationCount() - allocations;
+  
+  char name[48];
+  snprintf(name, sizeof(name), "store_backlog_%d", backlog);
+  report(name, (double)storeMicros / STORAGE_CYCLES, "us");
+  snprintf(name, sizeof(name), "sync_backlog_%d", backlog);
+  report(name, (double)syncMicros / STORAGE_CYCLES, "us");
+  
+  // Full-batch read at this depth
+  unsigned long start = micros();
+  int count = storage.readOldest(batch, SYNC_BATCH_MAX_READINGS);
+  unsigned long batchMicros = micros() - start;
+  TEST_ASSERT_EQUAL(min(backlog, SYNC_BATCH_MAX_READINGS), count);
+  snprintf(name, sizeof(name), "read_batch_backlog_%d", backlog);
+  report(name, batchMicros, "us");
+  
+  // The store/sync cycle must not touch the heap
+  TEST_ASSERT_EQUAL_UINT32(0, allocated);
+}
+
+void test_bench_storage_backlog_10() {
+  benchmarkStorage(10);
+}
+
+void test_bench_storage_backlog_100() {
+  benchmarkStorage(100);
+}
+
+void test_bench_storage_backlog_10000() {
+  benchmarkStorage(10000);
+}
+
+int main(int argc, char** argv) {
+  // Firmware logging would swamp the results
+  nativeSetSerialOutput(false);
+  
+  UNITY_BEGIN();
+  RUN_TEST(test_sha256_known_answer);
+  RUN_TEST(test_bench_create_message_json);
+  RUN_TEST(test_bench_create_message_msgpack);
+  RUN_TEST(test_bench_sha256_message);
+  RUN_TEST(test_bench_sha256_batch);
+  RUN_TEST(test_bench_storage_backlog_10);
+  RUN_TEST(test_bench_storage_backlog_100);
+  RUN_TEST(test_bench_storage_backlog_10000);
+  return UNITY_END();
+}
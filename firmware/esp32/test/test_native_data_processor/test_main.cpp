@@ -0,0 +1,502 @@
+// CarbonReady data processor tests (host)
+// Checks the allocation-free ISO 8601 formatter against the C library and
+// that a delta-encoded batch hash covers the same canonical bytes as the
+// full messages it replaces, and the hasher and digest encoders.
+//
+// Run on host: pio test -e native -f test_native_data_processor
+
+#include <Arduino.h>
+#include <unity.h>
+#include <time.h>
+#include <mbedtls/sha256.h>
+#include "config.h"
+#include "data_processor.h"
+#include "../sample_readings.h"
+
+static DataProcessor dataProcessor;
+
+static void expectGmtime(uint32_t timestamp) {
+  time_t t = timestamp;
+  struct tm timeinfo;
+  gmtime_r(&t, &timeinfo);
+  char expected[ISO8601_SIZE];
+  strftime(expected, sizeof(expected), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
+  
+  char actual[ISO8601_SIZE];
+  DataProcessor::formatISO8601(timestamp, actual);
+  TEST_ASSERT_EQUAL_STRING(expected, actual);
+}
+
+// Bit-at-a-time base64, independent of the firmware's encoder
+static void expectBase64(const uint8_t* data, size_t length, char* output) {
+  static const char alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t bits = length * 8;
+  size_t chars = 0;
+  for (size_t bit = 0; bit < bits; bit += 6) {
+    int value = 0;
+    for (size_t i = bit; i < bit + 6; i++) {
+      int set = i < bits ? (data[i / 8] >> (7 - i % 8)) & 1 : 0;
+      value = (value << 1) | set;
+    }
+    output[chars++] = alphabet[value];
+  }
+  while (chars % 4 != 0) {
+    output[chars++] = '=';
+  }
+  output[chars] = '\0';
+}
+
+// Base64 SHA-256 over one or two canonical forms, in order
+static void expectHash(const uint8_t* first, size_t firstLength,
+                       const uint8_t* second, size_t secondLength, char* output) {
+  uint8_t hash[32];
+  mbedtls_sha256_context ctx;
+  mbedtls_sha256_init(&ctx);
+  mbedtls_sha256_starts(&ctx, 0);
+  mbedtls_sha256_update(&ctx, first, firstLength);
+  mbedtls_sha256_update(&ctx, second, secondLength);
+  mbedtls_sha256_finish(&ctx, hash);
+  mbedtls_sha256_free(&ctx);
+  expectBase64(hash, sizeof(hash), output);
+}
+
+// Canonical MessagePack form of a binary message: the IDs replace the
+// message's array header and hash
+static size_t binaryCanonical(const uint8_t* message, size_t length, uint8_t* output) {
+  const uint8_t prefix[] = {0x9a, WIRE_SCHEMA_VERSION,
+                            0xa8, 'f', 'a', 'r', 'm', '-', '0', '0', '1',
+                            0xac, 'A', '1', 'B', '2', 'C', '3', 'D', '4', 'E', '5', 'F', '6'};
+  memcpy(output, prefix, sizeof(prefix));
+  memcpy(output + sizeof(prefix), message + 2, length - 2 - 34);
+  return sizeof(prefix) + length - 2 - 34;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_format_iso8601_known_dates() {
+  char buffer[ISO8601_SIZE];
+  
+  DataProcessor::formatISO8601(0, buffer);
+  TEST_ASSERT_EQUAL_STRING("1970-01-01T00:00:00Z", buffer);
+  
+  DataProcessor::formatISO8601(1736937000UL, buffer);
+  TEST_ASSERT_EQUAL_STRING("2025-01-15T10:30:00Z", buffer);
+  
+  // Leap days, including the century rule
+  DataProcessor::formatISO8601(951782400UL, buffer);
+  TEST_ASSERT_EQUAL_STRING("2000-02-29T00:00:00Z", buffer);
+  DataProcessor::formatISO8601(1709251199UL, buffer);
+  TEST_ASSERT_EQUAL_STRING("2024-02-29T23:59:59Z", buffer);
+  
+  DataProcessor::formatISO8601(0xffffffffUL, buffer);
+  TEST_ASSERT_EQUAL_STRING("2106-02-07T06:28:15Z", buffer);
+}
+
+void test_format_iso8601_matches_gmtime() {
+  // Odd stride walks through every month, hour and second over the range
+  for (uint64_t t = 0; t <= 0xffffffffULL; t += 86399ULL * 7 + 13) {
+    expectGmtime((uint32_t)t);
+  }
+  
+  // Either side of every year boundary from the epoch to 2105
+  time_t year = 0;
+  for (int y = 1970; y < 2106; y++) {
+    struct tm timeinfo = {};
+    timeinfo.tm_year = y - 1900;
+    timeinfo.tm_mday = 1;
+    year = timegm(&timeinfo);
+    if (year > 0) {
+      expectGmtime((uint32_t)(year - 1));
+    }
+    expectGmtime((uint32_t)year);
+  }
+}
+
+void test_message_hash_is_base64() {
+  char payload[MESSAGE_BUFFER_SIZE];
+  char message[MESSAGE_BUFFER_SIZE];
+  SensorReadings readings = readingsAt(1736937000UL);
+  
+  size_t payloadLength = dataProcessor.createPayload(readings, "farm-001", "A1B2C3D4E5F6",
+                                                     payload, sizeof(payload));
+  dataProcessor.createMessage(readings, "farm-001", "A1B2C3D4E5F6", message, sizeof(message));
+  
+  char expected[HASH_BASE64_SIZE];
+  expectHash((const uint8_t*)payload, payloadLength, nullptr, 0, expected);
+  
+  const char* hash = strstr(message, ",\"hash\":\"");
+  TEST_ASSERT_NOT_NULL(hash);
+  TEST_ASSERT_EQUAL_STRING_LEN(payload, message, payloadLength - 1);
+  TEST_ASSERT_EQUAL_STRING_LEN(expected, hash + 9, HASH_BASE64_SIZE - 1);
+  TEST_ASSERT_EQUAL_STRING("\"}", hash + 9 + HASH_BASE64_SIZE - 1);
+}
+
+void test_batch_hash_covers_canonical_records() {
+  char batch[MQTT_BUFFER_SIZE];
+  char first[MESSAGE_BUFFER_SIZE];
+  char second[MESSAGE_BUFFER_SIZE];
+  SensorReadings early = readingsAt(1736937000UL);
+  SensorReadings late = readingsAt(1736937900UL);
+  late.humidity = 70.25;
+  
+  size_t firstLength = dataProcessor.createPayload(early, "farm-001", "A1B2C3D4E5F6",
+                                                   first, sizeof(first));
+  size_t secondLength = dataProcessor.createPayload(late, "farm-001", "A1B2C3D4E5F6",
+                                                    second, sizeof(second));
+  
+  size_t length = dataProcessor.createBatchHeader("farm-001", "A1B2C3D4E5F6", early.timestamp,
+                                                  batch, sizeof(batch));
+  length += dataProcessor.createBatchRecord(early, "farm-001", "A1B2C3D4E5F6", early.timestamp,
+                                            batch + length, sizeof(batch) - length);
+  batch[length++] = ',';
+  size_t record = length;
+  length += dataProcessor.createBatchRecord(late, "farm-001", "A1B2C3D4E5F6", early.timestamp,
+                                            batch + length, sizeof(batch) - length);
+  TEST_ASSERT_EQUAL_STRING_LEN("{\"dt\":900,\"readings\":{", batch + record, 22);
+  
+  size_t trailer = dataProcessor.finishBatch(batch + length, BATCH_TRAILER_SIZE);
+  TEST_ASSERT_EQUAL(BATCH_TRAILER_SIZE - 1, trailer);
+  TEST_ASSERT_EQUAL(length + trailer, strlen(batch));
+  
+  // Records carry no hash or timestamp of their own
+  TEST_ASSERT_NULL(strstr(batch, "\"hash\""));
+  TEST_ASSERT_NULL(strstr(batch, "timestamp\":\""));
+  
+  char expected[HASH_BASE64_SIZE];
+  expectHash((const uint8_t*)first, firstLength, (const uint8_t*)second, secondLength, expected);
+  TEST_ASSERT_EQUAL_STRING_LEN("],\"batchHash\":\"", batch + length, 15);
+  TEST_ASSERT_EQUAL_STRING_LEN(expected, batch + length + 15, HASH_BASE64_SIZE - 1);
+  
+  // Order matters
+  expectHash((const uint8_t*)second, secondLength, (const uint8_t*)first, firstLength, expected);
+  TEST_ASSERT_FALSE(strncmp(expected, batch + length + 15, HASH_BASE64_SIZE - 1) == 0);
+}
+
+void test_batch_record_that_does_not_fit_is_not_hashed() {
+  char batch[MQTT_BUFFER_SIZE];
+  char first[MESSAGE_BUFFER_SIZE];
+  SensorReadings readings = readingsAt(1736937000UL);
+  
+  size_t firstLength = dataProcessor.createPayload(readings, "farm-001", "A1B2C3D4E5F6",
+                                                   first, sizeof(first));
+  
+  size_t length = dataProcessor.createBatchHeader("farm-001", "A1B2C3D4E5F6", readings.timestamp,
+                                                  batch, sizeof(batch));
+  length += dataProcessor.createBatchRecord(readings, "farm-001", "A1B2C3D4E5F6", readings.timestamp,
+                                            batch + length, sizeof(batch) - length);
+  
+  // Too small a buffer fails instead of truncating, and leaves the hash alone
+  readings.timestamp += 900;
+  TEST_ASSERT_EQUAL(0, dataProcessor.createBatchRecord(readings, "farm-001", "A1B2C3D4E5F6",
+                                                       readings.timestamp - 900, batch + length, 40));
+  
+  dataProcessor.finishBatch(batch + length, BATCH_TRAILER_SIZE);
+  
+  char expected[HASH_BASE64_SIZE];
+  expectHash((const uint8_t*)first, firstLength, nullptr, 0, expected);
+  TEST_ASSERT_EQUAL_STRING_LEN(expected, batch + length + 15, HASH_BASE64_SIZE - 1);
+  
+  // Readings may arrive out of order after a clock correction
+  char record[MESSAGE_BUFFER_SIZE];
+  dataProcessor.createBatchHeader("farm-001", "A1B2C3D4E5F6", 0, record, sizeof(record));
+  dataProcessor.createBatchRecord(readings, "farm-001", "A1B2C3D4E5F6",
+                                  readings.timestamp + 100, record, sizeof(record));
+  TEST_ASSERT_EQUAL_STRING_LEN("{\"dt\":-100,", record, 11);
+}
+
+void test_binary_batch_hash_covers_canonical_records() {
+  uint8_t batch[256];
+  uint8_t message[128];
+  uint8_t first[128];
+  uint8_t second[128];
+  SensorReadings early = readingsAt(1736937000UL);
+  SensorReadings late = readingsAt(1736937900UL);
+  late.soilProbeCount = 2;
+  late.soilTemperatures[1] = 18.0;
+  
+  size_t messageLength = dataProcessor.createBinaryMessage(early, "farm-001", "A1B2C3D4E5F6",
+                                                           message, sizeof(message));
+  size_t firstLength = binaryCanonical(message, messageLength, first);
+  messageLength = dataProcessor.createBinaryMessage(late, "farm-001", "A1B2C3D4E5F6",
+                                                    message, sizeof(message));
+  size_t secondLength = binaryCanonical(message, messageLength, second);
+  
+  size_t length = dataProcessor.createBinaryBatchHeader(early.timestamp, batch, sizeof(batch));
+  length += dataProcessor.createBinaryBatchRecord(early, "farm-001", "A1B2C3D4E5F6", early.timestamp,
+                                                  batch + length, sizeof(batch) - length);
+  size_t record = length;
+  size_t recordLength = dataProcessor.createBinaryBatchRecord(late, "farm-001", "A1B2C3D4E5F6",
+                                                              early.timestamp, batch + length,
+                                                              sizeof(batch) - length);
+  length += recordLength;
+  
+  // fixarray(7), dt = 900 as uint16, probes then an empty summary last
+  TEST_ASSERT_EQUAL_HEX8(0x97, batch[record]);
+  TEST_ASSERT_EQUAL_HEX8(0xcd, batch[record + 1]);
+  TEST_ASSERT_EQUAL(900, (batch[record + 2] << 8) | batch[record + 3]);
+  const uint8_t probes[] = {0x91, 0xcd, 0x07, 0x08, 0x90};
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(probes, batch + length - sizeof(probes), sizeof(probes));
+  
+  // The base timestamp and the hash are dropped from every record
+  TEST_ASSERT_LESS_THAN(messageLength - 34, recordLength);
+  
+  TEST_ASSERT_EQUAL(34, dataProcessor.finishBinaryBatch(batch + length, 34));
+  TEST_ASSERT_EQUAL_HEX8(0xc4, batch[length]);
+  TEST_ASSERT_EQUAL_HEX8(32, batch[length + 1]);
+  
+  char actual[HASH_BASE64_SIZE];
+  char expected[HASH_BASE64_SIZE];
+  expectBase64(batch + length + 2, 32, actual);
+  expectHash(first, firstLength, second, secondLength, expected);
+  TEST_ASSERT_EQUAL_STRING(expected, actual);
+}
+
+void test_soil_probes_in_json() {
+  char message[MESSAGE_BUFFER_SIZE];
+  SensorReadings readings = readingsAt(1736937000UL);
+  
+  // One probe: no per-probe list
+  dataProcessor.createMessage(readings, "farm-001", "A1B2C3D4E5F6", message, sizeof(message));
+  TEST_ASSERT_NULL(strstr(message, "soilTemperatureProbes"));
+  
+  readings.soilProbeCount = 3;
+  readings.soilTemperatures[1] = 18.0;
+  readings.soilTemperatures[2] = 16.5;
+  dataProcessor.createMessage(readings, "farm-001", "A1B2C3D4E5F6", message, sizeof(message));
+  TEST_ASSERT_NOT_NULL(strstr(message, "\"humidity\":\"65.80\","
+                                       "\"soilTemperatureProbes\":[\"-2.15\",\"18.00\",\"16.50\"]},"));
+}
+
+void test_soil_probes_in_msgpack() {
+  uint8_t message[128];
+  SensorReadings readings = readingsAt(1736937000UL);
+  readings.soilProbeCount = 3;
+  readings.soilTemperatures[1] = 18.0;
+  readings.soilTemperatures[2] = -1.0;
+  
+  size_t length = dataProcessor.createBinaryMessage(readings, "farm-001", "A1B2C3D4E5F6",
+                                                    message, sizeof(message));
+  TEST_ASSERT_EQUAL_HEX8(0x99, message[0]);
+  TEST_ASSERT_EQUAL_HEX8(WIRE_SCHEMA_VERSION, message[1]);
+  
+  // [..., humidity 6580, [1800, -100], [], bin8(32)]
+  const uint8_t probes[] = {0xcd, 0x19, 0xb4, 0x92, 0xcd, 0x07, 0x08, 0xd0, 0x9c, 0x90, 0xc4, 0x20};
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(probes, message + length - 34 - 10, sizeof(probes));
+}
+
+void test_summary_in_batch_records() {
+  char json[MESSAGE_BUFFER_SIZE];
+  uint8_t packed[128];
+  SensorReadings readings = readingsAt(1736935200UL);
+  ReadingSummary summary = {3540, 12, {4025, -300, 2000, 5000}, {5100, 150, 3100, 7000}};
+  
+  size_t length = dataProcessor.createBatchHeader("farm-001", "A1B2C3D4E5F6", readings.timestamp,
+                                                  json, sizeof(json));
+  length += dataProcessor.createBatchRecord(readings, "farm-001", "A1B2C3D4E5F6", readings.timestamp,
+                                            json + length, sizeof(json) - length, &summary);
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"humidity\":\"65.80\"},\"summary\":{\"span\":3540,\"samples\":12,"
+                                    "\"min\":{\"soilMoisture\":\"40.25\",\"soilTemperature\":\"-3.00\","
+                                    "\"airTemperature\":\"20.00\",\"humidity\":\"50.00\"},"
+                                    "\"max\":{\"soilMoisture\":\"51.00\",\"soilTemperature\":\"1.50\","
+                                    "\"airTemperature\":\"31.00\",\"humidity\":\"70.00\"}}}"));
+  
+  // A single reading (samples 0) has no summary
+  summary.samples = 0;
+  length = dataProcessor.createBatchRecord(readings, "farm-001", "A1B2C3D4E5F6", readings.timestamp,
+                                           json, sizeof(json), &summary);
+  TEST_ASSERT_NULL(strstr(json, "summary"));
+  
+  // [span, samples, [min...], [max...]] closes the binary record
+  summary.samples = 12;
+  length = dataProcessor.createBinaryBatchRecord(readings, "farm-001", "A1B2C3D4E5F6",
+                                                 readings.timestamp, packed, sizeof(packed), &summary);
+  const uint8_t expected[] = {0x94, 0xcd, 0x0d, 0xd4, 0x0c,
+                              0x94, 0xcd, 0x0f, 0xb9, 0xd1, 0xfe, 0xd4, 0xcd, 0x07, 0xd0, 0xcd, 0x13, 0x88,
+                              0x94, 0xcd, 0x13, 0xec, 0xcc, 0x96, 0xcd, 0x0c, 0x1c, 0xcd, 0x1b, 0x58};
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, packed + length - sizeof(expected), sizeof(expected));
+}
+
+void test_summary_in_window_message() {
+  char payload[MESSAGE_BUFFER_SIZE];
+  char message[768];
+  uint8_t packed[128];
+  SensorReadings readings = readingsAt(1736937000UL);
+  ReadingSummary summary = {840, 15, {4025, -300, 2000, 5000}, {5100, 150, 3100, 7000}};
+  
+  // Canonical form: the payload with the summary after readings
+  const char* spread = ",\"summary\":{\"span\":840,\"samples\":15,"
+                       "\"min\":{\"soilMoisture\":\"40.25\",\"soilTemperature\":\"-3.00\","
+                       "\"airTemperature\":\"20.00\",\"humidity\":\"50.00\"},"
+                       "\"max\":{\"soilMoisture\":\"51.00\",\"soilTemperature\":\"1.50\","
+                       "\"airTemperature\":\"31.00\",\"humidity\":\"70.00\"}}";
+  size_t payloadLength = dataProcessor.createPayload(readings, "farm-001", "A1B2C3D4E5F6",
+                                                     payload, sizeof(payload));
+  char canonical[768];
+  int canonicalLength = snprintf(canonical, sizeof(canonical), "%.*s%s}",
+                                 (int)payloadLength - 1, payload, spread);
+  
+  size_t length = dataProcessor.createMessage(readings, "farm-001", "A1B2C3D4E5F6",
+                                              message, sizeof(message), &summary);
+  TEST_ASSERT_GREATER_THAN(0, length);
+  TEST_ASSERT_EQUAL_STRING_LEN(canonical, message, canonicalLength - 1);
+  
+  char expected[HASH_BASE64_SIZE];
+  expectHash((const uint8_t*)canonical, canonicalLength, nullptr, 0, expected);
+  TEST_ASSERT_EQUAL_STRING_LEN(",\"hash\":\"", message + canonicalLength - 1, 9);
+  TEST_ASSERT_EQUAL_STRING_LEN(expected, message + canonicalLength + 8, HASH_BASE64_SIZE - 1);
+  
+  // A window of one sample is sent as a plain reading
+  summary.samples = 0;
+  dataProcessor.createMessage(readings, "farm-001", "A1B2C3D4E5F6", message, sizeof(message),
+                              &summary);
+  TEST_ASSERT_NULL(strstr(message, "summary"));
+  
+  // The binary message fills its summary slot: [span, samples, [min], [max]]
+  summary.samples = 15;
+  length = dataProcessor.createBinaryMessage(readings, "farm-001", "A1B2C3D4E5F6",
+                                             packed, sizeof(packed), &summary);
+  const uint8_t spreadPacked[] = {0x94, 0xcd, 0x03, 0x48, 0x0f,
+                                  0x94, 0xcd, 0x0f, 0xb9, 0xd1, 0xfe, 0xd4,
+                                  0xcd, 0x07, 0xd0, 0xcd, 0x13, 0x88,
+                                  0x94, 0xcd, 0x13, 0xec, 0xcc, 0x96,
+                                  0xcd, 0x0c, 0x1c, 0xcd, 0x1b, 0x58,
+                                  0xc4, 0x20};
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(spreadPacked, packed + length - 34 - 30, sizeof(spreadPacked));
+  
+  uint8_t binary[160];
+  size_t binaryLength = binaryCanonical(packed, length, binary);
+  expectHash(binary, binaryLength, nullptr, 0, expected);
+  uint8_t hash[SHA256_DIGEST_SIZE];
+  memcpy(hash, packed + length - 32, sizeof(hash));
+  char actual[HASH_BASE64_SIZE];
+  Sha256Hasher::toBase64(hash, sizeof(hash), actual);
+  TEST_ASSERT_EQUAL_STRING(expected, actual);
+}
+
+void test_window_message_fits_aggregation_buffer() {
+  // Longest IDs, every probe and the widest values still fit the buffer
+  // MESSAGE_BUFFER_SIZE takes with EDGE_AGGREGATION
+  char farmId[64];
+  char deviceId[64];
+  memset(farmId, 'f', sizeof(farmId) - 1);
+  farmId[sizeof(farmId) - 1] = '\0';
+  memset(deviceId, 'd', sizeof(deviceId) - 1);
+  deviceId[sizeof(deviceId) - 1] = '\0';
+  
+  SensorReadings readings = readingsAt(0xffffffffUL);
+  readings.soilMoisture = -100.0;
+  readings.airTemperature = -40.0;
+  readings.humidity = -100.0;
+  readings.soilProbeCount = DS18B20_MAX_PROBES;
+  for (int i = 0; i < DS18B20_MAX_PROBES; i++) {
+    readings.soilTemperatures[i] = -55.0;
+  }
+  ReadingSummary summary = {0xffffffffUL, 0xffffffffUL,
+                            {INT16_MIN, INT16_MIN, INT16_MIN, INT16_MIN},
+                            {INT16_MIN, INT16_MIN, INT16_MIN, INT16_MIN}};
+  
+  char message[768];
+  TEST_ASSERT_GREATER_THAN(0, dataProcessor.createMessage(readings, farmId, deviceId,
+                                                          message, sizeof(message), &summary));
+}
+
+void test_encoders_match_reference() {
+  uint8_t data[8];
+  char expected[32];
+  char actual[32];
+  for (size_t i = 0; i < sizeof(data); i++) {
+    data[i] = (uint8_t)(0xf7 - i * 37);
+  }
+  
+  // Every tail length (0, 1 or 2 bytes past whole groups)
+  for (size_t length = 0; length <= sizeof(data); length++) {
+    expectBase64(data, length, expected);
+    Sha256Hasher::toBase64(data, length, actual);
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    
+    for (size_t i = 0; i < length; i++) {
+      sprintf(expected + i * 2, "%02x", data[i]);
+    }
+    expected[length * 2] = '\0';
+    Sha256Hasher::toHex(data, length, actual);
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+  }
+}
+
+void test_hasher_is_reusable() {
+  Sha256Hasher hasher;
+  uint8_t first[SHA256_DIGEST_SIZE];
+  uint8_t second[SHA256_DIGEST_SIZE];
+  
+  // An abandoned hash does not leak into the next one
+  hasher.begin();
+  hasher.update("abandoned", 9);
+  hasher.hash("abc", 3, first);
+  
+  hasher.begin();
+  hasher.update("a", 1);
+  hasher.update("bc", 2);
+  hasher.finish(second);
+  
+  char hex[HASH_HEX_SIZE];
+  Sha256Hasher::toHex(first, sizeof(first), hex);
+  TEST_ASSERT_EQUAL_STRING("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", hex);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(first, second, sizeof(first));
+}
+
+void test_delta_batch_header() {
+  char header[128];
+  size_t length = dataProcessor.createBatchHeader("farm-001", "A1B2C3D4E5F6", 1736937000UL,
+                                                  header, sizeof(header));
+  TEST_ASSERT_EQUAL_STRING("{\"farmId\":\"farm-001\",\"deviceId\":\"A1B2C3D4E5F6\","
+                           "\"baseTimestamp\":1736937000,\"batch\":[", header);
+  TEST_ASSERT_EQUAL(strlen(header), length);
+  
+  uint8_t binary[16];
+  length = dataProcessor.createBinaryBatchHeader(1736937000UL, binary, sizeof(binary));
+  const uint8_t expected[] = {0x94, WIRE_SCHEMA_VERSION, 0xce, 0x67, 0x87, 0x8e, 0x28};
+  TEST_ASSERT_EQUAL(sizeof(expected), length);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, binary, sizeof(expected));
+}
+
+void test_batch_records_do_not_allocate() {
+  char record[MESSAGE_BUFFER_SIZE];
+  char iso[ISO8601_SIZE];
+  SensorReadings readings = readingsAt(1736937900UL);
+  
+  uint32_t before = nativeAllocationCount();
+  DataProcessor::formatISO8601(readings.timestamp, iso);
+  size_t length = dataProcessor.createBatchHeader("farm-001", "A1B2C3D4E5F6", 1736937000UL,
+                                                  record, sizeof(record));
+  length += dataProcessor.createBatchRecord(readings, "farm-001", "A1B2C3D4E5F6",
+                                            1736937000UL, record + length, sizeof(record) - length);
+  dataProcessor.finishBatch(record + length, BATCH_TRAILER_SIZE);
+  TEST_ASSERT_EQUAL(before, nativeAllocationCount());
+}
+
+int main(int argc, char** argv) {
+  nativeSetSerialOutput(false);
+  
+  UNITY_BEGIN();
+  RUN_TEST(test_format_iso8601_known_dates);
+  RUN_TEST(test_format_iso8601_matches_gmtime);
+  RUN_TEST(test_message_hash_is_base64);
+  RUN_TEST(test_batch_hash_covers_canonical_records);
+  RUN_TEST(test_batch_record_that_does_not_fit_is_not_hashed);
+  RUN_TEST(test_binary_batch_hash_covers_canonical_records);
+  RUN_TEST(test_soil_probes_in_json);
+  RUN_TEST(test_soil_probes_in_msgpack);
+  RUN_TEST(test_summary_in_batch_records);
+  RUN_TEST(test_summary_in_window_message);
+  RUN_TEST(test_window_message_fits_aggregation_buffer);
+  RUN_TEST(test_encoders_match_reference);
+  RUN_TEST(test_hasher_is_reusable);
+  RUN_TEST(test_delta_batch_header);
+  RUN_TEST(test_batch_records_do_not_allocate);
+  return UNITY_END();
+}
@@ -0,0 +1,161 @@
+// CarbonReady PUBACK tracker tests (host)
+// Checks that PUBACKs are picked out of the inbound MQTT stream however it
+// is split across reads, that other packets are skipped, and that the
+// in-flight window and reconnects are accounted for.
+//
+// Run on host: pio test -e native -f test_native_puback_tracker
+
+#include <Arduino.h>
+#include <unity.h>
+#include "config.h"
+#include "puback_tracker.h"
+
+// PUBACK for packetId
+static void puback(uint16_t packetId, uint8_t* packet) {
+  packet[0] = 0x40;
+  packet[1] = 0x02;
+  packet[2] = packetId >> 8;
+  packet[3] = packetId & 0xff;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_puback_acknowledges_packet() {
+  PubackTracker tracker(4);
+  uint16_t first = tracker.track();
+  uint16_t second = tracker.track();
+  TEST_ASSERT_NOT_EQUAL(0, first);
+  TEST_ASSERT_NOT_EQUAL(first, second);
+  
+  uint8_t packet[4];
+  puback(second, packet);
+  tracker.received(packet, sizeof(packet));
+  
+  TEST_ASSERT_EQUAL(PUBACK_PENDING, tracker.status(first));
+  TEST_ASSERT_EQUAL(PUBACK_RECEIVED, tracker.status(second));
+  TEST_ASSERT_EQUAL(1, tracker.pendingCount());
+}
+
+void test_puback_split_across_reads() {
+  PubackTracker tracker(4);
+  uint16_t packetId = tracker.track();
+  
+  // PubSubClient reads a byte at a time
+  uint8_t packet[4];
+  puback(packetId, packet);
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_EQUAL(PUBACK_PENDING, tracker.status(packetId));
+    tracker.received(packet + i, 1);
+  }
+  TEST_ASSERT_EQUAL(PUBACK_RECEIVED, tracker.status(packetId));
+}
+
+void test_other_packets_are_skipped() {
+  PubackTracker tracker(4);
+  uint16_t packetId = tracker.track();
+  
+  // CONNACK, then a 200-byte command PUBLISH (two-byte remaining length)
+  // whose body looks like a PUBACK for packetId, then PINGRESP
+  uint8_t stream[4 + 3 + 200 + 2 + 4];
+  size_t length = 0;
+  stream[length++] = 0x20;
+  stream[length++] = 0x02;
+  stream[length++] = 0x00;
+  stream[length++] = 0x00;
+  stream[length++] = 0x30;
+  stream[length++] = 200 | 0x80;
+  stream[length++] = 0x01;
+  for (int i = 0; i < 200; i += 4) {
+    puback(packetId, stream + length + i);
+  }
+  length += 200;
+  stream[length++] = 0xd0;
+  stream[length++] = 0x00;
+  TEST_ASSERT_EQUAL(sizeof(stream) - 4, length);
+  
+  tracker.received(stream, length);
+  TEST_ASSERT_EQUAL(PUBACK_PENDING, tracker.status(packetId));
+  
+  // Framing is still in step for the real PUBACK
+  puback(packetId, stream + length);
+  tracker.received(stream + length, 4);
+  TEST_ASSERT_EQUAL(PUBACK_RECEIVED, tracker.status(packetId));
+}
+
+void test_window_limits_in_flight() {
+  PubackTracker tracker(2);
+  uint16_t first = tracker.track();
+  TEST_ASSERT_NOT_EQUAL(0, tracker.track());
+  TEST_ASSERT_EQUAL(0, tracker.track());
+  TEST_ASSERT_EQUAL(0, tracker.freeCount());
+  
+  // An acknowledged slot stays in use until it is released
+  uint8_t packet[4];
+  puback(first, packet);
+  tracker.received(packet, sizeof(packet));
+  TEST_ASSERT_EQUAL(0, tracker.track());
+  
+  tracker.release(first);
+  TEST_ASSERT_EQUAL(PUBACK_LOST, tracker.status(first));
+  TEST_ASSERT_NOT_EQUAL(0, tracker.track());
+}
+
+void test_reset_loses_pending() {
+  PubackTracker tracker(4);
+  uint16_t acked = tracker.track();
+  uint16_t pending = tracker.track();
+  
+  uint8_t packet[4];
+  puback(acked, packet);
+  tracker.received(packet, sizeof(packet));
+  
+  // Half a PUBACK, then the connection drops
+  puback(pending, packet);
+  tracker.received(packet, 2);
+  tracker.reset();
+  
+  TEST_ASSERT_EQUAL(PUBACK_RECEIVED, tracker.status(acked));
+  TEST_ASSERT_EQUAL(PUBACK_LOST, tracker.status(pending));
+  TEST_ASSERT_EQUAL(0, tracker.pendingCount());
+  
+  // A PUBACK on the new connection does not revive it
+  puback(pending, packet);
+  tracker.received(packet, sizeof(packet));
+  TEST_ASSERT_EQUAL(PUBACK_LOST, tracker.status(pending));
+}
+
+void test_packet_ids_skip_zero_and_tracked() {
+  PubackTracker tracker(2);
+  
+  // Walk the counter up to the wrap with one ID held throughout
+  uint16_t held = tracker.track();
+  for (uint32_t i = 0; i < 65533; i++) {
+    tracker.release(tracker.track());
+  }
+  
+  uint16_t last = tracker.track();
+  TEST_ASSERT_EQUAL(65535, last);
+  tracker.release(last);
+  
+  // Wraps past 0 and past the ID still in flight
+  uint16_t next = tracker.track();
+  TEST_ASSERT_EQUAL(1, held);
+  TEST_ASSERT_EQUAL(2, next);
+}
+
+int main(int argc, char** argv) {
+  nativeSetSerialOutput(false);
+  
+  UNITY_BEGIN();
+  RUN_TEST(test_puback_acknowledges_packet);
+  RUN_TEST(test_puback_split_across_reads);
+  RUN_TEST(test_other_packets_are_skipped);
+  RUN_TEST(test_window_limits_in_flight);
+  RUN_TEST(test_reset_loses_pending);
+  RUN_TEST(test_packet_ids_skip_zero_and_tracked);
+  return UNITY_END();
+}
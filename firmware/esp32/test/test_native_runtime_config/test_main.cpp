@@ -0,0 +1,133 @@
+// CarbonReady runtime configuration tests (host)
+// Applies commands-topic messages and checks validation, device targeting
+// and persistence through the Preferences shim in native/.
+//
+// Run on host: pio test -e native -f test_native_runtime_config
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <unity.h>
+#include "config.h"
+#include "runtime_config.h"
+
+static bool send(RuntimeConfig& config, const char* command) {
+  return config.handleCommand((const uint8_t*)command, strlen(command));
+}
+
+void setUp() {
+  Preferences preferences;
+  if (preferences.begin("carbonready", false)) {
+    preferences.clear();
+    preferences.end();
+  }
+}
+
+void tearDown() {
+}
+
+void test_defaults_without_stored_settings() {
+  RuntimeConfig config;
+  TEST_ASSERT_TRUE(config.begin("DEVICE000001"));
+  
+  TunableSettings settings = config.get();
+  TEST_ASSERT_EQUAL(READING_INTERVAL_MS, settings.readingIntervalMs);
+  TEST_ASSERT_EQUAL(SYNC_BATCH_MAX_READINGS, settings.syncBatchSize);
+  TEST_ASSERT_EQUAL(MQTT_QOS, settings.qos);
+}
+
+void test_configure_applies_subset() {
+  RuntimeConfig config;
+  config.begin("DEVICE000001");
+  
+  TEST_ASSERT_TRUE(send(config, "{\"action\":\"configure\",\"settings\":"
+                                "{\"readingIntervalSec\":600,\"batchSize\":8,\"qos\":1}}"));
+  
+  TunableSettings settings = config.get();
+  TEST_ASSERT_EQUAL(600000, settings.readingIntervalMs);
+  TEST_ASSERT_EQUAL(8, settings.syncBatchSize);
+  TEST_ASSERT_EQUAL(1, settings.qos);
+  TEST_ASSERT_EQUAL(RETRY_DELAY_BASE_MS, settings.retryDelayBaseMs);
+  
+  // Sending the same values again is not a change
+  TEST_ASSERT_FALSE(send(config, "{\"action\":\"configure\",\"settings\":{\"batchSize\":8}}"));
+}
+
+void test_invalid_commands_are_rejected() {
+  RuntimeConfig config;
+  config.begin("DEVICE000001");
+  TunableSettings before = config.get();
+  
+  // Out of range, inconsistent, wrong type, malformed, unknown action
+  TEST_ASSERT_FALSE(send(config, "{\"action\":\"configure\",\"settings\":{\"batchSize\":0}}"));
+  TEST_ASSERT_FALSE(send(config, "{\"action\":\"configure\",\"settings\":"
+                                 "{\"batchSize\":8,\"qos\":2}}"));
+  TEST_ASSERT_FALSE(send(config, "{\"action\":\"configure\",\"settings\":"
+                                 "{\"readingIntervalSec\":60,\"sampleIntervalSec\":120}}"));
+  TEST_ASSERT_FALSE(send(config, "{\"action\":\"configure\",\"settings\":{\"compression\":3}}"));
+  TEST_ASSERT_FALSE(send(config, "{\"action\":\"configure\",\"settings\":"));
+  TEST_ASSERT_FALSE(send(config, "{\"action\":\"reboot\"}"));
+  
+  TunableSettings after = config.get();
+  TEST_ASSERT_EQUAL_MEMORY(&before, &after, sizeof(before));
+}
+
+void test_commands_for_other_devices_are_ignored() {
+  RuntimeConfig config;
+  config.begin("DEVICE000001");
+  
+  TEST_ASSERT_FALSE(send(config, "{\"action\":\"configure\",\"deviceId\":\"DEVICE000002\","
+                                 "\"settings\":{\"batchSize\":4}}"));
+  TEST_ASSERT_EQUAL(SYNC_BATCH_MAX_READINGS, config.get().syncBatchSize);
+  
+  TEST_ASSERT_TRUE(send(config, "{\"action\":\"configure\",\"deviceId\":\"DEVICE000001\","
+                                "\"settings\":{\"batchSize\":4}}"));
+  TEST_ASSERT_EQUAL(4, config.get().syncBatchSize);
+}
+
+void test_settings_persist_and_reset() {
+  {
+    RuntimeConfig config;
+    config.begin("DEVICE000001");
+    TEST_ASSERT_TRUE(send(config, "{\"action\":\"configure\",\"settings\":"
+                                  "{\"retryBaseMs\":500,\"sleepFlushEvery\":2}}"));
+  }
+  
+  // A reboot loads the stored settings
+  RuntimeConfig rebooted;
+  TEST_ASSERT_TRUE(rebooted.begin("DEVICE000001"));
+  TEST_ASSERT_EQUAL(500, rebooted.get().retryDelayBaseMs);
+  TEST_ASSERT_EQUAL(2, rebooted.get().sleepFlushEvery);
+  
+  TEST_ASSERT_TRUE(send(rebooted, "{\"action\":\"reset\"}"));
+  TunableSettings defaults = RuntimeConfig::defaults();
+  TunableSettings settings = rebooted.get();
+  TEST_ASSERT_EQUAL_MEMORY(&defaults, &settings, sizeof(defaults));
+  
+  RuntimeConfig afterReset;
+  afterReset.begin("DEVICE000001");
+  TEST_ASSERT_EQUAL(RETRY_DELAY_BASE_MS, afterReset.get().retryDelayBaseMs);
+}
+
+void test_command_handling_does_not_allocate() {
+  RuntimeConfig config;
+  config.begin("DEVICE000001");
+  const char* command = "{\"action\":\"configure\",\"settings\":{\"batchSize\":16}}";
+  
+  uint32_t before = nativeAllocationCount();
+  send(config, command);
+  send(config, "{\"action\":\"configure\",\"deviceId\":\"DEVICE000002\",\"settings\":{}}");
+  TEST_ASSERT_EQUAL(before, nativeAllocationCount());
+}
+
+int main(int argc, char** argv) {
+  nativeSetSerialOutput(false);
+  
+  UNITY_BEGIN();
+  RUN_TEST(test_defaults_without_stored_settings);
+  RUN_TEST(test_configure_applies_subset);
+  RUN_TEST(test_invalid_commands_are_rejected);
+  RUN_TEST(test_commands_for_other_devices_are_ignored);
+  RUN_TEST(test_settings_persist_and_reset);
+  RUN_TEST(test_command_handling_does_not_allocate);
+  return UNITY_END();
+}
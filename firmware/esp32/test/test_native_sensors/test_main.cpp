@@ -0,0 +1,118 @@
+// CarbonReady sensor manager tests (host)
+// Reads several DS18B20 probes through the DallasTemperature shim in
+// native/ and checks that the bus is only searched in begin(), with one
+// conversion per reading whatever the number of probes, and that a board
+// variant alias gets its own probe limit and calibration.
+//
+// Run on host: pio test -e native -f test_native_sensors
+
+#include <Arduino.h>
+#include <unity.h>
+#include "config.h"
+#include "sensor_manager.h"
+
+// A variant board: two soil probes and its own moisture calibration
+typedef SensorSet<Dht22<DHT22_PIN>,
+                  Ds18b20<DS18B20_PIN, 2>,
+                  CapacitiveSoil<SOIL_MOISTURE_PIN, SoilCalibration<3000, 1000>>> TwoProbeBoard;
+
+void setUp() {
+  nativeSensors.soilMoistureRaw = 2200;
+  nativeSensors.soilProbeCount = 1;
+  nativeSensors.oneWireSearches = 0;
+  nativeSensors.oneWireConversions = 0;
+}
+
+void tearDown() {
+}
+
+void test_single_probe() {
+  SensorManager sensors;
+  TEST_ASSERT_TRUE(sensors.begin());
+  TEST_ASSERT_EQUAL(1, sensors.getSoilProbeCount());
+  
+  SensorReadings readings = sensors.readAllSensors();
+  TEST_ASSERT_TRUE(readings.valid);
+  TEST_ASSERT_EQUAL(1, readings.soilProbeCount);
+  TEST_ASSERT_FLOAT_WITHIN(0.001, nativeSensors.soilTemperature, readings.soilTemperature);
+}
+
+void test_probes_are_read_by_cached_address() {
+  nativeSensors.soilProbeCount = 3;
+  nativeSensors.soilProbeTemperatures[1] = 16.5;
+  nativeSensors.soilProbeTemperatures[2] = 14.0;
+  
+  SensorManager sensors;
+  TEST_ASSERT_TRUE(sensors.begin());
+  TEST_ASSERT_EQUAL(3, sensors.getSoilProbeCount());
+  uint32_t searches = nativeSensors.oneWireSearches;
+  
+  for (int cycle = 0; cycle < 3; cycle++) {
+    SensorReadings readings = sensors.readAllSensors();
+    TEST_ASSERT_TRUE(readings.valid);
+    TEST_ASSERT_EQUAL(3, readings.soilProbeCount);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, nativeSensors.soilTemperature, readings.soilTemperatures[0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 16.5, readings.soilTemperatures[1]);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 14.0, readings.soilTemperatures[2]);
+  }
+  
+  // One broadcast conversion per reading and no further searches
+  TEST_ASSERT_EQUAL(searches, nativeSensors.oneWireSearches);
+  TEST_ASSERT_EQUAL(3, nativeSensors.oneWireConversions);
+}
+
+void test_probes_beyond_limit_are_ignored() {
+  nativeSensors.soilProbeCount = DS18B20_MAX_PROBES + 2;
+  
+  SensorManager sensors;
+  TEST_ASSERT_TRUE(sensors.begin());
+  TEST_ASSERT_EQUAL(DS18B20_MAX_PROBES, sensors.getSoilProbeCount());
+}
+
+void test_missing_probe_invalidates_reading() {
+  nativeSensors.soilProbeCount = 2;
+  nativeSensors.soilProbeTemperatures[1] = 16.5;
+  
+  SensorManager sensors;
+  TEST_ASSERT_TRUE(sensors.begin());
+  
+  // Second probe unplugged after begin()
+  nativeSensors.soilProbeCount = 1;
+  SensorReadings readings = sensors.readAllSensors();
+  TEST_ASSERT_FALSE(readings.valid);
+  TEST_ASSERT_EQUAL(2, readings.soilProbeCount);
+}
+
+void test_variant_probe_limit_and_calibration() {
+  nativeSensors.soilProbeCount = 3;
+  nativeSensors.soilProbeTemperatures[1] = 16.5;
+  nativeSensors.soilProbeTemperatures[2] = 14.0;
+  
+  TwoProbeBoard sensors;
+  TEST_ASSERT_TRUE(sensors.begin());
+  TEST_ASSERT_EQUAL(2, sensors.getSoilProbeCount());
+  
+  // Raw 2000 sits halfway between the variant's wet and dry points
+  nativeSensors.soilMoistureRaw = 2000;
+  SensorReadings readings = sensors.readAllSensors();
+  TEST_ASSERT_TRUE(readings.valid);
+  TEST_ASSERT_EQUAL(2, readings.soilProbeCount);
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 50.0, readings.soilMoisture);
+  
+  // Saturated beyond the wet point clamps to 100%
+  nativeSensors.soilMoistureRaw = 900;
+  readings = sensors.readAllSensors();
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 100.0, readings.soilMoisture);
+}
+
+int main(int argc, char** argv) {
+  nativeSetSerialOutput(false);
+  
+  UNITY_BEGIN();
+  RUN_TEST(test_single_probe);
+  RUN_TEST(test_probes_are_read_by_cached_address);
+  RUN_TEST(test_probes_beyond_limit_are_ignored);
+  RUN_TEST(test_missing_probe_invalidates_reading);
+  RUN_TEST(test_variant_probe_limit_and_calibration);
+  return UNITY_END();
+}
@@ -0,0 +1,144 @@
+// CarbonReady outage soak tests (host)
+// Runs the soak harness through the real PublishPipeline and
+// MQTTClientManager against the in-process broker in native/, and prints
+// each run's report as one line for comparing storage and sync changes:
+//   SOAK <name> <report JSON>
+//
+// Run on host: pio test -e native -f test_native_soak -v
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <unity.h>
+#include "config.h"
+#include "local_storage.h"
+#include "tiered_storage.h"
+#include "data_processor.h"
+#include "mqtt_client.h"
+#include "publish_pipeline.h"
+#include "soak_harness.h"
+
+// Readings a multi-day outage leaves behind (52 days at 15 minutes)
+#define SOAK_OUTAGE_READINGS 5000
+
+// Everything a device builds for offline sync
+struct SoakRig {
+  LocalStorage flash;
+  TieredStorage storage;
+  DataProcessor dataProcessor;
+  MQTTClientManager mqttClient;
+  PublishPipeline pipeline;
+  
+  SoakRig()
+    : flash(SOAK_OUTAGE_READINGS + OFFLINE_SEGMENT_RECORDS),
+      storage(flash),
+      pipeline(mqttClient, storage, dataProcessor) {
+    TEST_ASSERT_TRUE(flash.begin());
+    TEST_ASSERT_TRUE(storage.begin());
+    TEST_ASSERT_TRUE(mqttClient.begin("broker.local", "farm-001", "A1B2C3D4E5F6", "", "", ""));
+    pipeline.begin("farm-001", "A1B2C3D4E5F6");
+  }
+};
+
+static char report[512];
+
+static void printReport(const char* name, const SoakReport& soak) {
+  TEST_ASSERT_NOT_EQUAL(0, SoakHarness::writeReport(soak, report, sizeof(report)));
+  printf("SOAK %s %s\n", name, report);
+}
+
+void setUp() {
+  LittleFS.erase();
+  nativePsramAvailable = true;
+  nativeBroker.online = true;
+  nativeBroker.pubackDelayMs = 0;
+}
+
+void tearDown() {
+}
+
+void test_long_outage_drains_completely() {
+  SoakRig rig;
+  SoakHarness harness(rig.pipeline, rig.flash);
+  uint32_t publishes = nativeBroker.publishes;
+  
+  SoakReport soak = harness.run(SOAK_OUTAGE_READINGS, READING_INTERVAL_MS);
+  printReport("long_outage", soak);
+  
+  TEST_ASSERT_EQUAL(SOAK_OUTAGE_READINGS, soak.storedReadings);
+  TEST_ASSERT_EQUAL(0, soak.droppedReadings);
+  TEST_ASSERT_EQUAL(0, soak.remainingReadings);
+  
+  // Past the spill age every reading went to flash once
+  TEST_ASSERT_TRUE(soak.flashBytesWritten >= SOAK_OUTAGE_READINGS * sizeof(OfflineRecord));
+  
+  // Full batches, a window per syncBatch()
+  uint32_t batches = nativeBroker.publishes - publishes;
+  TEST_ASSERT_EQUAL((SOAK_OUTAGE_READINGS + SYNC_BATCH_MAX_READINGS - 1) / SYNC_BATCH_MAX_READINGS,
+                    batches);
+  TEST_ASSERT_EQUAL((batches + SYNC_WINDOW_BATCHES - 1) / SYNC_WINDOW_BATCHES, soak.syncWindows);
+  
+  // The drain allocates nothing
+  TEST_ASSERT_EQUAL(soak.freeHeapBefore, soak.freeHeapAfter);
+}
+
+void test_puback_round_trips_overlap() {
+  SoakRig rig;
+  SoakHarness harness(rig.pipeline, rig.flash);
+  nativeBroker.pubackDelayMs = 20;
+  
+  SoakReport soak = harness.run(1000, READING_INTERVAL_MS);
+  printReport("puback_20ms", soak);
+  
+  TEST_ASSERT_EQUAL(0, soak.remainingReadings);
+  
+  // Each window waits about one round trip, not one per batch (QoS 0
+  // waits for none)
+#if MQTT_PUBLISH_QOS == 1
+  TEST_ASSERT_TRUE(soak.drainMs >= soak.syncWindows * nativeBroker.pubackDelayMs);
+  TEST_ASSERT_TRUE(soak.drainMs < soak.syncWindows * SYNC_WINDOW_BATCHES * nativeBroker.pubackDelayMs);
+#endif
+}
+
+void test_failed_reconnect_keeps_backlog() {
+  SoakRig rig;
+  SoakHarness harness(rig.pipeline, rig.flash);
+  nativeBroker.online = false;
+  
+  SoakReport soak = harness.run(500, READING_INTERVAL_MS);
+  printReport("broker_down", soak);
+  
+  TEST_ASSERT_EQUAL(500, soak.storedReadings);
+  TEST_ASSERT_EQUAL(500, soak.remainingReadings);
+  
+  // Back online: the next drain takes all of it
+  nativeBroker.online = true;
+  rig.pipeline.syncOfflineReadings();
+  TEST_ASSERT_EQUAL(0, rig.pipeline.getStoredCount());
+}
+
+void test_full_storage_downsamples_oldest() {
+  SoakRig rig;
+  SoakHarness harness(rig.pipeline, rig.flash);
+  
+  // More than the raw segments and the PSRAM ring hold together
+  int capacity = SOAK_OUTAGE_READINGS + OFFLINE_SEGMENT_RECORDS + PSRAM_TIER_CAPACITY;
+  SoakReport soak = harness.run(capacity + 300, READING_INTERVAL_MS);
+  printReport("overflow", soak);
+  
+  // The oldest readings went into hourly aggregates instead of being dropped
+  TEST_ASSERT_EQUAL(0, soak.droppedReadings);
+  TEST_ASSERT_TRUE(soak.hourlyAggregates > 0);
+  TEST_ASSERT_TRUE(soak.storedReadings < capacity + 300);
+  TEST_ASSERT_EQUAL(0, soak.remainingReadings);
+}
+
+int main(int argc, char** argv) {
+  nativeSetSerialOutput(false);
+  
+  UNITY_BEGIN();
+  RUN_TEST(test_long_outage_drains_completely);
+  RUN_TEST(test_puback_round_trips_overlap);
+  RUN_TEST(test_failed_reconnect_keeps_backlog);
+  RUN_TEST(test_full_storage_downsamples_oldest);
+  return UNITY_END();
+}
@@ -0,0 +1,417 @@
+// CarbonReady offline storage tests (host)
+// Exercises segment rotation and deletion, recovery after a reboot, the
+// SPIFFS-to-LittleFS migration and compaction into the aggregate tiers
+// against the filesystem shims in native/, and reports mount time with a
+// backlog.
+//
+// Run on host: pio test -e native -f test_native_storage
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SPIFFS.h>
+#include <LittleFS.h>
+#include <unity.h>
+#include "config.h"
+#include "local_storage.h"
+#include "../sample_readings.h"
+
+// Backlog the mount benchmark starts from
+#define BENCH_BACKLOG_READINGS 1000
+
+// Raw tier capacity for the compaction tests
+#define COMPACTION_TEST_CAPACITY (2 * OFFLINE_SEGMENT_RECORDS)
+
+static SensorReadings batch[SYNC_BATCH_MAX_READINGS];
+static ReadingSummary summaries[SYNC_BATCH_MAX_READINGS];
+
+static int countSegments() {
+  File dir = LittleFS.open("/offline");
+  int segments = 0;
+  File entry = dir.openNextFile();
+  while (entry) {
+    if (strstr(entry.name(), ".seg")) {
+      segments++;
+    }
+    entry = dir.openNextFile();
+  }
+  return segments;
+}
+
+// Drain the backlog, checking it comes out oldest first. Returns the
+// readings it covers (an aggregate counts its samples).
+static int drainSamples(LocalStorage& storage) {
+  int samples = 0;
+  uint32_t previous = 0;
+  int count;
+  while ((count = storage.readOldest(batch, SYNC_BATCH_MAX_READINGS, summaries)) > 0) {
+    for (int i = 0; i < count; i++) {
+      TEST_ASSERT_TRUE(batch[i].valid);
+      TEST_ASSERT_TRUE(batch[i].timestamp >= previous);
+      previous = batch[i].timestamp;
+      samples += summaries[i].samples > 0 ? summaries[i].samples : 1;
+    }
+    TEST_ASSERT_TRUE(storage.removeOldest(count));
+  }
+  TEST_ASSERT_EQUAL(0, storage.getStoredCount());
+  return samples;
+}
+
+// Pack a record the way the SPIFFS journal did
+static OfflineRecordV1 journalRecord(int i) {
+  SensorReadings readings = sampleReadings(i);
+  OfflineRecordV1 record = {};
+  record.version = 1;
+  record.flags = OFFLINE_RECORD_VALID;
+  record.timestamp = readings.timestamp;
+  record.soilMoisture = readings.soilMoisture;
+  record.soilTemperature = readings.soilTemperature;
+  record.airTemperature = readings.airTemperature;
+  record.humidity = readings.humidity;
+  
+  // Reflected CRC-32 (polynomial 0xEDB88320)
+  uint32_t crc = 0xFFFFFFFF;
+  const uint8_t* data = (const uint8_t*)&record;
+  for (size_t n = 0; n < offsetof(OfflineRecordV1, crc); n++) {
+    crc ^= data[n];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  record.crc = ~crc;
+  return record;
+}
+
+void setUp() {
+  SPIFFS.erase();
+  LittleFS.erase();
+}
+
+void tearDown() {
+}
+
+void test_blank_partition_is_formatted() {
+  LocalStorage storage;
+  TEST_ASSERT_TRUE(storage.begin());
+  TEST_ASSERT_EQUAL(0, storage.getStoredCount());
+}
+
+void test_segments_rotate_and_are_deleted() {
+  LocalStorage storage;
+  TEST_ASSERT_TRUE(storage.begin());
+  
+  int total = OFFLINE_SEGMENT_RECORDS * 2 + 10;
+  for (int i = 0; i < total; i++) {
+    TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i)));
+  }
+  TEST_ASSERT_EQUAL(3, countSegments());
+  
+  // Syncing past the first segment deletes it
+  int synced = 0;
+  while (synced < OFFLINE_SEGMENT_RECORDS + 5) {
+    int count = storage.readOldest(batch, SYNC_BATCH_MAX_READINGS);
+    TEST_ASSERT_EQUAL(1736937000UL + synced * 900, batch[0].timestamp);
+    TEST_ASSERT_TRUE(storage.removeOldest(count));
+    synced += count;
+  }
+  TEST_ASSERT_EQUAL(2, countSegments());
+  TEST_ASSERT_EQUAL(total - synced, storage.getStoredCount());
+  
+  // Draining everything removes the head segment as well
+  TEST_ASSERT_TRUE(storage.removeOldest(storage.getStoredCount()));
+  TEST_ASSERT_EQUAL(0, countSegments());
+  TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(total)));
+  TEST_ASSERT_EQUAL(1, storage.getStoredCount());
+}
+
+void test_state_survives_reboot() {
+  {
+    LocalStorage storage;
+    TEST_ASSERT_TRUE(storage.begin());
+    for (int i = 0; i < OFFLINE_SEGMENT_RECORDS + 20; i++) {
+      TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i)));
+    }
+    TEST_ASSERT_TRUE(storage.removeOldest(7));
+  }
+  
+  LocalStorage storage;
+  TEST_ASSERT_TRUE(storage.begin());
+  TEST_ASSERT_EQUAL(OFFLINE_SEGMENT_RECORDS + 13, storage.getStoredCount());
+  TEST_ASSERT_EQUAL(1, storage.readOldest(batch, 1));
+  TEST_ASSERT_EQUAL(1736937000UL + 7 * 900, batch[0].timestamp);
+  
+  // Appends continue the partly written head segment
+  TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(500)));
+  TEST_ASSERT_EQUAL(2, countSegments());
+}
+
+void test_torn_record_is_overwritten() {
+  {
+    LocalStorage storage;
+    TEST_ASSERT_TRUE(storage.begin());
+    for (int i = 0; i < 3; i++) {
+      TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i)));
+    }
+  }
+  
+  // Power cut mid-append: half a record at the end of the head segment
+  File file = LittleFS.open("/offline/00000000.seg", "a");
+  uint8_t partial[sizeof(OfflineRecord) / 2] = {0xAA};
+  file.write(partial, sizeof(partial));
+  file.close();
+  
+  LocalStorage storage;
+  TEST_ASSERT_TRUE(storage.begin());
+  TEST_ASSERT_EQUAL(3, storage.getStoredCount());
+  TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(3)));
+  TEST_ASSERT_EQUAL(4, storage.readOldest(batch, 4));
+  TEST_ASSERT_TRUE(batch[3].valid);
+  TEST_ASSERT_EQUAL(1736937000UL + 3 * 900, batch[3].timestamp);
+}
+
+void test_migrates_spiffs_journal_and_legacy_file() {
+  TEST_ASSERT_TRUE(SPIFFS.format());
+  
+  // Legacy line-based file (oldest readings)
+  File legacy = SPIFFS.open("/offline_readings.txt", "w");
+  legacy.print("{\"farmId\":\"farm-001\",\"timestamp\":\"2025-01-15T10:00:00Z\","
+               "\"readings\":{\"soilMoisture\":\"41.50\",\"soilTemperature\":\"20.00\","
+               "\"airTemperature\":\"25.00\",\"humidity\":\"60.00\"}}\n");
+  legacy.close();
+  
+  // Ring journal of 8 slots with 3 readings wrapping past the end
+  File journal = SPIFFS.open("/offline_journal.bin", "w");
+  OfflineRecordV1 empty = {};
+  for (int slot = 0; slot < 8; slot++) {
+    OfflineRecordV1 record = slot == 6 ? journalRecord(10) :
+                           slot == 7 ? journalRecord(11) :
+                           slot == 0 ? journalRecord(12) : empty;
+    journal.write((const uint8_t*)&record, sizeof(record));
+  }
+  journal.close();
+  
+  uint32_t meta[4] = {0x324A5243, 1, 6, 3};  // magic, head, tail, count
+  File metaFile = SPIFFS.open("/offline_meta.bin", "w");
+  metaFile.write((const uint8_t*)meta, sizeof(meta));
+  metaFile.close();
+  
+  LocalStorage storage;
+  TEST_ASSERT_TRUE(storage.begin());
+  TEST_ASSERT_EQUAL(4, storage.getStoredCount());
+  TEST_ASSERT_EQUAL(4, storage.readOldest(batch, 4));
+  TEST_ASSERT_EQUAL(1736935200UL, batch[0].timestamp);
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 41.5, batch[0].soilMoisture);
+  TEST_ASSERT_EQUAL(1736937000UL + 10 * 900, batch[1].timestamp);
+  TEST_ASSERT_EQUAL(1736937000UL + 12 * 900, batch[3].timestamp);
+  
+  // The next boot mounts LittleFS directly
+  LocalStorage rebooted;
+  TEST_ASSERT_TRUE(rebooted.begin());
+  TEST_ASSERT_EQUAL(4, rebooted.getStoredCount());
+}
+
+void test_soil_probes_round_trip() {
+  LocalStorage storage;
+  TEST_ASSERT_TRUE(storage.begin());
+  
+  SensorReadings readings = sampleReadings(0);
+  readings.soilProbeCount = 3;
+  readings.soilTemperatures[1] = 18.0625;
+  readings.soilTemperatures[2] = -4.5;
+  TEST_ASSERT_TRUE(storage.storeReading(readings));
+  
+  TEST_ASSERT_EQUAL(1, storage.readOldest(batch, 1));
+  TEST_ASSERT_EQUAL(3, batch[0].soilProbeCount);
+  TEST_ASSERT_FLOAT_WITHIN(0.0001, -2.15, batch[0].soilTemperatures[0]);
+  TEST_ASSERT_FLOAT_WITHIN(0.005, 18.06, batch[0].soilTemperatures[1]);
+  TEST_ASSERT_FLOAT_WITHIN(0.005, -4.5, batch[0].soilTemperatures[2]);
+}
+
+void test_upgrades_version1_segments() {
+  // Segment and tail written by single-probe firmware, two readings synced
+  TEST_ASSERT_TRUE(LittleFS.format());
+  TEST_ASSERT_TRUE(LittleFS.begin(false));
+  TEST_ASSERT_TRUE(LittleFS.mkdir("/offline"));
+  File segment = LittleFS.open("/offline/00000000.seg", "w");
+  for (int i = 0; i < 5; i++) {
+    OfflineRecordV1 record = journalRecord(i);
+    segment.write((const uint8_t*)&record, sizeof(record));
+  }
+  segment.close();
+  
+  uint32_t tail[3] = {0x31535243, 0, 2};  // magic, segment, synced records
+  File tailFile = LittleFS.open("/offline/tail.bin", "w");
+  tailFile.write((const uint8_t*)tail, sizeof(tail));
+  tailFile.close();
+  
+  LocalStorage storage;
+  TEST_ASSERT_TRUE(storage.begin());
+  TEST_ASSERT_EQUAL(3, storage.getStoredCount());
+  TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(5)));
+  
+  TEST_ASSERT_EQUAL(4, storage.readOldest(batch, 4));
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(batch[i].valid);
+    TEST_ASSERT_EQUAL(1736937000UL + (i + 2) * 900, batch[i].timestamp);
+    TEST_ASSERT_EQUAL(1, batch[i].soilProbeCount);
+  }
+  
+  File upgraded = LittleFS.open("/offline/00000000.seg", "r");
+  TEST_ASSERT_EQUAL(6 * sizeof(OfflineRecord), upgraded.size());
+  upgraded.close();
+}
+
+void test_full_raw_tier_compacts_into_hourly() {
+  LocalStorage storage(COMPACTION_TEST_CAPACITY);
+  TEST_ASSERT_TRUE(storage.begin());
+  
+  int total = COMPACTION_TEST_CAPACITY + OFFLINE_SEGMENT_RECORDS;
+  for (int i = 0; i < total; i++) {
+    TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i)));
+  }
+  TEST_ASSERT_FALSE(storage.isFull());
+  TEST_ASSERT_TRUE(storage.getRawCount() <= COMPACTION_TEST_CAPACITY);
+  TEST_ASSERT_TRUE(storage.getHourlyCount() > 0);
+  TEST_ASSERT_EQUAL(0, storage.getDailyCount());
+  
+  // The first hour (UTC) held the first two readings
+  TEST_ASSERT_EQUAL(1, storage.readOldest(batch, 1, summaries));
+  TEST_ASSERT_EQUAL(1736937000UL, batch[0].timestamp);
+  TEST_ASSERT_EQUAL(2, summaries[0].samples);
+  TEST_ASSERT_EQUAL(900, summaries[0].span);
+  TEST_ASSERT_FLOAT_WITHIN(0.006, 40.005, batch[0].soilMoisture);
+  TEST_ASSERT_EQUAL(4000, summaries[0].min[0]);
+  TEST_ASSERT_EQUAL(4001, summaries[0].max[0]);
+  
+  // Every reading is still accounted for
+  TEST_ASSERT_EQUAL(total, drainSamples(storage));
+}
+
+void test_bucket_split_across_compactions_is_one_aggregate() {
+  LocalStorage storage(COMPACTION_TEST_CAPACITY);
+  TEST_ASSERT_TRUE(storage.begin());
+  
+  // Every raw segment ends half way through an hour (UTC), over three passes
+  int total = COMPACTION_TEST_CAPACITY + 3 * OFFLINE_SEGMENT_RECORDS;
+  for (int i = 0; i < total; i++) {
+    TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i)));
+  }
+  int hourlyCount = storage.getHourlyCount();
+  TEST_ASSERT_EQUAL(1 + 3 * OFFLINE_SEGMENT_RECORDS / 4, hourlyCount);
+  
+  // One aggregate per hour, the hours between the ends holding four readings
+  int aggregates = 0;
+  uint32_t previousHour = 0;
+  int count;
+  while (aggregates < hourlyCount &&
+         (count = storage.readOldest(batch, SYNC_BATCH_MAX_READINGS, summaries)) > 0) {
+    for (int i = 0; i < count && summaries[i].samples > 0; i++, aggregates++) {
+      uint32_t hour = batch[i].timestamp / 3600;
+      if (aggregates > 0) {
+        TEST_ASSERT_EQUAL(previousHour + 1, hour);
+      }
+      if (aggregates > 0 && aggregates < hourlyCount - 1) {
+        TEST_ASSERT_EQUAL(4, summaries[i].samples);
+      }
+      previousHour = hour;
+    }
+    TEST_ASSERT_TRUE(storage.removeOldest(count));
+  }
+  TEST_ASSERT_EQUAL(hourlyCount, aggregates);
+}
+
+void test_aggregates_survive_reboot() {
+  int hourlyCount;
+  int storedCount;
+  {
+    LocalStorage storage(COMPACTION_TEST_CAPACITY);
+    TEST_ASSERT_TRUE(storage.begin());
+    for (int i = 0; i < COMPACTION_TEST_CAPACITY + 10; i++) {
+      TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i)));
+    }
+    TEST_ASSERT_EQUAL(3, storage.readOldest(batch, 3, summaries));
+    TEST_ASSERT_TRUE(storage.removeOldest(3));
+    hourlyCount = storage.getHourlyCount();
+    storedCount = storage.getStoredCount();
+  }
+  
+  LocalStorage storage(COMPACTION_TEST_CAPACITY);
+  TEST_ASSERT_TRUE(storage.begin());
+  TEST_ASSERT_EQUAL(hourlyCount, storage.getHourlyCount());
+  TEST_ASSERT_EQUAL(storedCount, storage.getStoredCount());
+  TEST_ASSERT_EQUAL(1, storage.readOldest(batch, 1, summaries));
+  TEST_ASSERT_EQUAL(4, summaries[0].samples);
+  TEST_ASSERT_EQUAL(1736937000UL + 10 * 900, batch[0].timestamp);
+}
+
+void test_hourly_tier_compacts_into_daily() {
+  LocalStorage storage(COMPACTION_TEST_CAPACITY);
+  TEST_ASSERT_TRUE(storage.begin());
+  
+  // Six hours apart, so every reading fills an hourly aggregate of its own
+  int total = 16 * OFFLINE_SEGMENT_RECORDS;
+  for (int i = 0; i < total; i++) {
+    TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i, 6 * 3600)));
+  }
+  TEST_ASSERT_TRUE(storage.getDailyCount() > 0);
+  TEST_ASSERT_TRUE(storage.getHourlyCount() <= OFFLINE_HOURLY_SEGMENTS * OFFLINE_SEGMENT_RECORDS);
+  TEST_ASSERT_TRUE(storage.getDailyCount() <= OFFLINE_DAILY_SEGMENTS * OFFLINE_SEGMENT_RECORDS);
+  
+  // Once the daily tier filled, its oldest segment was dropped
+  TEST_ASSERT_EQUAL(1, storage.readOldest(batch, 1, summaries));
+  TEST_ASSERT_TRUE(batch[0].timestamp > sampleReadings(0, 6 * 3600).timestamp);
+  TEST_ASSERT_TRUE(summaries[0].samples <= 4);
+  int samples = drainSamples(storage);
+  TEST_ASSERT_TRUE(samples < total);
+  TEST_ASSERT_TRUE(samples > total / 2);
+}
+
+void test_capacity_sized_from_partition() {
+  LocalStorage storage;
+  TEST_ASSERT_TRUE(storage.begin());
+  
+  // Whole raw segments beyond the reserve and the aggregate tiers
+  int capacity = storage.getCapacity();
+  TEST_ASSERT_TRUE(capacity > COMPACTION_TEST_CAPACITY);
+  TEST_ASSERT_EQUAL(0, capacity % OFFLINE_SEGMENT_RECORDS);
+  size_t tiers = (capacity / OFFLINE_SEGMENT_RECORDS) * OFFLINE_FS_BLOCK_BYTES * 2 +
+                 (OFFLINE_HOURLY_SEGMENTS + OFFLINE_DAILY_SEGMENTS) * OFFLINE_FS_BLOCK_BYTES * 2;
+  TEST_ASSERT_TRUE(tiers + OFFLINE_STORAGE_RESERVE_BYTES <= LittleFS.totalBytes());
+}
+
+void test_bench_mount_with_backlog() {
+  {
+    LocalStorage storage;
+    TEST_ASSERT_TRUE(storage.begin());
+    for (int i = 0; i < BENCH_BACKLOG_READINGS; i++) {
+      TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i)));
+    }
+  }
+  
+  LocalStorage storage;
+  unsigned long start = micros();
+  TEST_ASSERT_TRUE(storage.begin());
+  unsigned long elapsed = micros() - start;
+  TEST_ASSERT_EQUAL(BENCH_BACKLOG_READINGS, storage.getStoredCount());
+  
+  printf("BENCH mount_full_backlog %lu us\n", elapsed);
+}
+
+int main(int argc, char** argv) {
+  nativeSetSerialOutput(false);
+  
+  UNITY_BEGIN();
+  RUN_TEST(test_blank_partition_is_formatted);
+  RUN_TEST(test_segments_rotate_and_are_deleted);
+  RUN_TEST(test_state_survives_reboot);
+  RUN_TEST(test_torn_record_is_overwritten);
+  RUN_TEST(test_migrates_spiffs_journal_and_legacy_file);
+  RUN_TEST(test_soil_probes_round_trip);
+  RUN_TEST(test_upgrades_version1_segments);
+  RUN_TEST(test_full_raw_tier_compacts_into_hourly);
+  RUN_TEST(test_bucket_split_across_compactions_is_one_aggregate);
+  RUN_TEST(test_aggregates_survive_reboot);
+  RUN_TEST(test_hourly_tier_compacts_into_daily);
+  RUN_TEST(test_capacity_sized_from_partition);
+  RUN_TEST(test_bench_mount_with_backlog);
+  return UNITY_END();
+}
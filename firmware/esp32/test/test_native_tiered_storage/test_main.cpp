@@ -0,0 +1,183 @@
+// CarbonReady tiered offline storage tests (host)
+// Checks that readings stay in the PSRAM ring until it fills, ages or is
+// flushed, that sync drains the ring before flash, and that readings
+// spilled while a batch was in flight are neither lost nor removed twice.
+//
+// Run on host: pio test -e native -f test_native_tiered_storage
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <unity.h>
+#include "config.h"
+#include "local_storage.h"
+#include "tiered_storage.h"
+#include "../sample_readings.h"
+
+static SensorReadings batch[SYNC_BATCH_MAX_READINGS];
+
+// Reading index from its timestamp
+static int indexOf(const SensorReadings& readings) {
+  return (readings.timestamp - SAMPLE_READINGS_START) / 900;
+}
+
+void setUp() {
+  LittleFS.erase();
+  nativePsramAvailable = true;
+}
+
+void tearDown() {
+}
+
+void test_short_outage_stays_in_psram() {
+  LocalStorage flash;
+  TEST_ASSERT_TRUE(flash.begin());
+  TieredStorage storage(flash, 256, 0);
+  TEST_ASSERT_TRUE(storage.begin());
+  
+  for (int i = 0; i < 40; i++) {
+    TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i)));
+  }
+  TEST_ASSERT_EQUAL(40, storage.getStoredCount());
+  TEST_ASSERT_EQUAL(40, storage.getBufferedCount());
+  TEST_ASSERT_EQUAL(0, flash.getHeadOffset());
+  
+  // Drained oldest first without a single flash write
+  int synced = 0;
+  while (storage.getStoredCount() > 0) {
+    int count = storage.readOldest(batch, SYNC_BATCH_MAX_READINGS);
+    TEST_ASSERT_EQUAL(synced, indexOf(batch[0]));
+    TEST_ASSERT_TRUE(storage.removeOldest(count));
+    synced += count;
+  }
+  TEST_ASSERT_EQUAL(40, synced);
+  TEST_ASSERT_EQUAL(0, flash.getHeadOffset());
+}
+
+void test_full_ring_spills_oldest_to_flash() {
+  LocalStorage flash;
+  TEST_ASSERT_TRUE(flash.begin());
+  int capacity = PSRAM_SPILL_RECORDS * 2;
+  TieredStorage storage(flash, capacity, 0);
+  TEST_ASSERT_TRUE(storage.begin());
+  
+  for (int i = 0; i < capacity + 1; i++) {
+    TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i)));
+  }
+  TEST_ASSERT_EQUAL(PSRAM_SPILL_RECORDS, flash.getStoredCount());
+  TEST_ASSERT_EQUAL(capacity + 1 - PSRAM_SPILL_RECORDS, storage.getBufferedCount());
+  
+  // The ring goes out first, then the spilled readings in order
+  TEST_ASSERT_EQUAL(1, storage.readOldest(batch, 1));
+  TEST_ASSERT_EQUAL(PSRAM_SPILL_RECORDS, indexOf(batch[0]));
+  TEST_ASSERT_TRUE(storage.removeOldest(storage.getBufferedCount()));
+  TEST_ASSERT_EQUAL(1, storage.readOldest(batch, 1));
+  TEST_ASSERT_EQUAL(0, indexOf(batch[0]));
+}
+
+void test_spill_during_sync_keeps_readings() {
+  LocalStorage flash;
+  TEST_ASSERT_TRUE(flash.begin());
+  TieredStorage storage(flash, PSRAM_SPILL_RECORDS, 0);
+  TEST_ASSERT_TRUE(storage.begin());
+  
+  for (int i = 0; i < PSRAM_SPILL_RECORDS; i++) {
+    TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i)));
+  }
+  
+  // A batch is read from the ring, then the sampler fills it while the
+  // batch is being published
+  int count = storage.readOldest(batch, SYNC_BATCH_MAX_READINGS);
+  TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(PSRAM_SPILL_RECORDS)));
+  TEST_ASSERT_TRUE(storage.removeOldest(count));
+  
+  // The sent readings were spilled, so nothing else leaves the ring
+  TEST_ASSERT_EQUAL(PSRAM_SPILL_RECORDS, flash.getStoredCount());
+  TEST_ASSERT_EQUAL(1, storage.getBufferedCount());
+  TEST_ASSERT_EQUAL(PSRAM_SPILL_RECORDS + 1, storage.getStoredCount());
+}
+
+void test_flush_moves_ring_to_flash() {
+  {
+    LocalStorage flash;
+    TEST_ASSERT_TRUE(flash.begin());
+    TieredStorage storage(flash, 256, 0);
+    TEST_ASSERT_TRUE(storage.begin());
+    
+    for (int i = 0; i < 200; i++) {
+      TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i)));
+    }
+    int count = storage.readOldest(batch, 10);
+    TEST_ASSERT_TRUE(storage.removeOldest(count));
+    TEST_ASSERT_TRUE(storage.flush());
+    TEST_ASSERT_EQUAL(0, storage.getBufferedCount());
+  }
+  
+  // Survives a restart in order
+  LocalStorage flash;
+  TEST_ASSERT_TRUE(flash.begin());
+  TEST_ASSERT_EQUAL(190, flash.getStoredCount());
+  TEST_ASSERT_EQUAL(1, flash.readOldest(batch, 1));
+  TEST_ASSERT_EQUAL(10, indexOf(batch[0]));
+}
+
+void test_aged_ring_moves_to_flash() {
+  LocalStorage flash;
+  TEST_ASSERT_TRUE(flash.begin());
+  TieredStorage storage(flash, 256, 20);
+  TEST_ASSERT_TRUE(storage.begin());
+  
+  TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(0)));
+  TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(1)));
+  delay(30);
+  TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(2)));
+  
+  TEST_ASSERT_EQUAL(2, flash.getStoredCount());
+  TEST_ASSERT_EQUAL(1, storage.getBufferedCount());
+}
+
+void test_without_psram_goes_to_flash() {
+  nativePsramAvailable = false;
+  
+  LocalStorage flash;
+  TEST_ASSERT_TRUE(flash.begin());
+  TieredStorage storage(flash, 256, 0);
+  TEST_ASSERT_FALSE(storage.begin());
+  
+  TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(0)));
+  TEST_ASSERT_EQUAL(1, flash.getStoredCount());
+  TEST_ASSERT_EQUAL(0, storage.getBufferedCount());
+  TEST_ASSERT_EQUAL(1, storage.readOldest(batch, SYNC_BATCH_MAX_READINGS));
+  TEST_ASSERT_TRUE(storage.removeOldest(1));
+  TEST_ASSERT_EQUAL(0, storage.getStoredCount());
+}
+
+void test_full_flash_rejects_reading() {
+  LocalStorage flash(PSRAM_SPILL_RECORDS / 2);
+  TEST_ASSERT_TRUE(flash.begin());
+  TieredStorage storage(flash, PSRAM_SPILL_RECORDS, 0);
+  TEST_ASSERT_TRUE(storage.begin());
+  
+  for (int i = 0; i < PSRAM_SPILL_RECORDS; i++) {
+    TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i)));
+  }
+  
+  // Half the ring fits on flash, which makes room for the next reading
+  TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(PSRAM_SPILL_RECORDS)));
+  TEST_ASSERT_EQUAL(PSRAM_SPILL_RECORDS / 2, flash.getStoredCount());
+  TEST_ASSERT_FALSE(storage.flush());
+  TEST_ASSERT_EQUAL(PSRAM_SPILL_RECORDS / 2 + 1, storage.getBufferedCount());
+}
+
+int main(int argc, char** argv) {
+  nativeSetSerialOutput(false);
+  
+  UNITY_BEGIN();
+  RUN_TEST(test_short_outage_stays_in_psram);
+  RUN_TEST(test_full_ring_spills_oldest_to_flash);
+  RUN_TEST(test_spill_during_sync_keeps_readings);
+  RUN_TEST(test_flush_moves_ring_to_flash);
+  RUN_TEST(test_aged_ring_moves_to_flash);
+  RUN_TEST(test_without_psram_goes_to_flash);
+  RUN_TEST(test_full_flash_rejects_reading);
+  return UNITY_END();
+}
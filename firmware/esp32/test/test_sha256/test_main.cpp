@@ -0,0 +1,70 @@
+// CarbonReady SHA-256 benchmark
+// Compares Sha256Hasher (one reused context on the hardware SHA engine,
+// table-driven hex) with the per-call context and sprintf hex encoding it
+// replaced, on a single-message (200-byte) and a full-batch (4 KB) payload.
+//
+// Run on device: pio test -e esp32dev_test -f test_sha256
+
+#include <Arduino.h>
+#include <unity.h>
+#include "config.h"
+#include "sha256_hasher.h"
+#include "../hash_benchmark.h"
+
+#define HASH_ITERATIONS 500
+
+static uint8_t payload[4096];
+
+static void benchmarkHash(size_t length) {
+  fillHashPayload(payload, length);
+  
+  char legacyHex[HASH_HEX_SIZE];
+  char hashHex[HASH_HEX_SIZE];
+  unsigned long legacyElapsed = timeLegacyHash(payload, length, HASH_ITERATIONS, legacyHex);
+  
+  Sha256Hasher hasher;
+  uint32_t freeHeap = ESP.getFreeHeap();
+  unsigned long elapsed = timeHasher(hasher, payload, length, HASH_ITERATIONS, hashHex);
+  
+  TEST_ASSERT_EQUAL_STRING(legacyHex, hashHex);
+  TEST_ASSERT_EQUAL_UINT32(freeHeap, ESP.getFreeHeap());
+  
+  char report[112];
+  snprintf(report, sizeof(report), "%4u bytes: %.1f us per hash (was %.1f us), %.2f MB/s",
+           (unsigned)length, (double)elapsed / HASH_ITERATIONS,
+           (double)legacyElapsed / HASH_ITERATIONS,
+           (double)HASH_ITERATIONS * length / max(elapsed, 1UL));
+  TEST_MESSAGE(report);
+}
+
+void test_hash_single_message() {
+  benchmarkHash(200);
+}
+
+void test_hash_full_batch() {
+  benchmarkHash(sizeof(payload));
+}
+
+void test_known_answer() {
+  // FIPS 180-2 "abc" vector, through the hardware engine
+  Sha256Hasher hasher;
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  char hashHex[HASH_HEX_SIZE];
+  hasher.hash("abc", 3, digest);
+  Sha256Hasher::toHex(digest, sizeof(digest), hashHex);
+  TEST_ASSERT_EQUAL_STRING("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+                           hashHex);
+}
+
+void setup() {
+  delay(2000); // Allow the serial monitor to attach
+  
+  UNITY_BEGIN();
+  RUN_TEST(test_known_answer);
+  RUN_TEST(test_hash_single_message);
+  RUN_TEST(test_hash_full_batch);
+  UNITY_END();
+}
+
+void loop() {
+}
@@ -0,0 +1,127 @@
+// CarbonReady offline storage benchmark (on device)
+// Compares mount time and per-append latency of the LittleFS segment store
+// against the previous SPIFFS ring journal (preallocated journal file, one
+// slot write plus a metadata rewrite per reading) on the real flash.
+//
+// Formats the data partition. Run on a bench board, not a deployed device:
+//   pio test -e esp32dev_test -f test_storage
+
+#include <Arduino.h>
+#include <unity.h>
+#include <SPIFFS.h>
+#include <LittleFS.h>
+#include "config.h"
+#include "local_storage.h"
+#include "../sample_readings.h"
+
+#define APPEND_COUNT 200
+
+// Slots the SPIFFS firmware preallocated (its MAX_OFFLINE_READINGS)
+#define SPIFFS_JOURNAL_SLOTS 1000
+
+struct AppendStats {
+  unsigned long totalMicros;
+  unsigned long maxMicros;
+};
+
+static void reportAppends(const char* name, const AppendStats& stats) {
+  char report[96];
+  snprintf(report, sizeof(report), "%s append: mean %lu us, max %lu us",
+           name, stats.totalMicros / APPEND_COUNT, stats.maxMicros);
+  TEST_MESSAGE(report);
+}
+
+static void reportMount(const char* name, unsigned long elapsed) {
+  char report[96];
+  snprintf(report, sizeof(report), "%s mount with %d readings: %lu ms",
+           name, APPEND_COUNT, elapsed / 1000);
+  TEST_MESSAGE(report);
+}
+
+void test_spiffs_journal_baseline() {
+  TEST_ASSERT_TRUE(SPIFFS.begin(true));
+  TEST_ASSERT_TRUE(SPIFFS.format());
+  
+  // Preallocate the journal as the SPIFFS implementation did
+  File journal = SPIFFS.open("/offline_journal.bin", "w");
+  TEST_ASSERT_TRUE(journal);
+  OfflineRecordV1 record = {};
+  for (int i = 0; i < SPIFFS_JOURNAL_SLOTS; i++) {
+    TEST_ASSERT_EQUAL(sizeof(record), journal.write((const uint8_t*)&record, sizeof(record)));
+  }
+  journal.close();
+  
+  AppendStats stats = {0, 0};
+  uint32_t meta[4] = {0x324A5243, 0, 0, 0};
+  
+  for (int i = 0; i < APPEND_COUNT; i++) {
+    record.timestamp = sampleReadings(i).timestamp;
+    
+    unsigned long start = micros();
+    File file = SPIFFS.open("/offline_journal.bin", "r+");
+    file.seek(i * sizeof(record), SeekSet);
+    file.write((const uint8_t*)&record, sizeof(record));
+    file.close();
+    meta[1] = i + 1;
+    meta[3] = i + 1;
+    File metaFile = SPIFFS.open("/offline_meta.bin", "w");
+    metaFile.write((const uint8_t*)meta, sizeof(meta));
+    metaFile.close();
+    unsigned long elapsed = micros() - start;
+    
+    stats.totalMicros += elapsed;
+    stats.maxMicros = max(stats.maxMicros, elapsed);
+  }
+  reportAppends("SPIFFS journal", stats);
+  
+  SPIFFS.end();
+  unsigned long start = micros();
+  TEST_ASSERT_TRUE(SPIFFS.begin(false));
+  reportMount("SPIFFS journal", micros() - start);
+  SPIFFS.end();
+}
+
+void test_littlefs_segments() {
+  // Start from an empty LittleFS image
+  TEST_ASSERT_TRUE(LittleFS.format());
+  
+  AppendStats stats = {0, 0};
+  {
+    LocalStorage storage;
+    TEST_ASSERT_TRUE(storage.begin());
+    TEST_ASSERT_TRUE(storage.clearReadings());
+    
+    for (int i = 0; i < APPEND_COUNT; i++) {
+      unsigned long start = micros();
+      TEST_ASSERT_TRUE(storage.storeReading(sampleReadings(i)));
+      unsigned long elapsed = micros() - start;
+      
+      stats.totalMicros += elapsed;
+      stats.maxMicros = max(stats.maxMicros, elapsed);
+    }
+  }
+  reportAppends("LittleFS segments", stats);
+  
+  // Mount plus segment scan, as at boot
+  LittleFS.end();
+  LocalStorage storage;
+  unsigned long start = micros();
+  TEST_ASSERT_TRUE(storage.begin());
+  reportMount("LittleFS segments", micros() - start);
+  TEST_ASSERT_EQUAL(APPEND_COUNT, storage.getStoredCount());
+  
+  // Leave an empty store for the firmware
+  TEST_ASSERT_TRUE(storage.clearReadings());
+}
+
+void setup() {
+  delay(2000); // Allow the serial monitor to attach
+  
+  UNITY_BEGIN();
+  RUN_TEST(test_spiffs_journal_baseline);
+  RUN_TEST(test_littlefs_segments);
+  UNITY_END();
+}
+
+void loop() {
+}
@@ -0,0 +1,135 @@
+// CarbonReady Tiered Storage Implementation
+
+#include "tiered_storage.h"
+
+TieredStorage::TieredStorage(LocalStorage& flash, int capacity, unsigned long spillAgeMs)
+  : flash(flash), capacity(capacity), spillAgeMs(spillAgeMs) {
+  slots = nullptr;
+  head = 0;
+  tail = 0;
+  filledAt = 0;
+  readFromRing = false;
+  readTail = 0;
+}
+
+TieredStorage::~TieredStorage() {
+  free(slots);
+}
+
+bool TieredStorage::begin() {
+  if (slots != nullptr || capacity <= 0) {
+    return true;
+  }
+  
+  if (!psramFound()) {
+    Serial.println("No PSRAM, offline readings go straight to flash");
+    return false;
+  }
+  
+  slots = (SensorReadings*)ps_malloc(capacity * sizeof(SensorReadings));
+  if (slots == nullptr) {
+    Serial.println("Error: Failed to allocate PSRAM ring, using flash only");
+    return false;
+  }
+  
+  Serial.printf("PSRAM ring ready (%d readings, %d bytes)\n",
+                capacity, (int)(capacity * sizeof(SensorReadings)));
+  return true;
+}
+
+bool TieredStorage::storeReading(const SensorReadings& readings) {
+  if (slots == nullptr) {
+    return flash.storeReading(readings);
+  }
+  
+  int buffered = getBufferedCount();
+  
+  // Bound what a power cut can take from PSRAM
+  if (buffered > 0 && spillAgeMs > 0 && millis() - filledAt >= spillAgeMs) {
+    Serial.printf("Moving %d buffered readings to flash\n", buffered);
+    flush();
+    buffered = getBufferedCount();
+  }
+  
+  if (buffered >= capacity) {
+    spill(min(PSRAM_SPILL_RECORDS, capacity));
+    buffered = getBufferedCount();
+    if (buffered >= capacity) {
+      Serial.println("Warning: Offline storage is full");
+      return false;
+    }
+  }
+  
+  if (buffered == 0) {
+    filledAt = millis();
+  }
+  
+  slots[head % capacity] = readings;
+  head++;
+  return true;
+}
+
+int TieredStorage::getStoredCount() {
+  return getBufferedCount() + flash.getStoredCount();
+}
+
+int TieredStorage::getBufferedCount() {
+  return head - tail;
+}
+
+int TieredStorage::readOldest(SensorReadings* readings, int maxCount, ReadingSummary* summaries) {
+  int buffered = getBufferedCount();
+  readFromRing = buffered > 0;
+  
+  if (!readFromRing) {
+    return flash.readOldest(readings, maxCount, summaries);
+  }
+  
+  int readCount = min(maxCount, buffered);
+  for (int i = 0; i < readCount; i++) {
+    readings[i] = slots[(tail + i) % capacity];
+    if (summaries != nullptr) {
+      summaries[i].samples = 0;
+    }
+  }
+  readTail = tail;
+  
+  return readCount;
+}
+
+bool TieredStorage::removeOldest(int removeCount) {
+  if (!readFromRing) {
+    return flash.removeOldest(removeCount);
+  }
+  
+  // Readings spilled since they were read were the first ones sent; they
+  // are on flash now and will go out again from there
+  uint32_t spilled = tail - readTail;
+  removeCount = removeCount > (int)spilled ? removeCount - spilled : 0;
+  removeCount = min(removeCount, getBufferedCount());
+  
+  tail += removeCount;
+  readTail = tail;
+  return true;
+}
+
+bool TieredStorage::flush() {
+  return spill(getBufferedCount());
+}
+
+bool TieredStorage::spill(int spillCount) {
+  while (spillCount > 0) {
+    int index = tail % capacity;
+    int run = min(spillCount, capacity - index);
+    
+    int stored = flash.storeReadings(slots + index, run);
+    tail += stored;
+    spillCount -= stored;
+    
+    if (stored < run) {
+      return false;
+    }
+  }
+  
+  return true;
+}
@@ -0,0 +1,78 @@
+// CarbonReady Tiered Storage
+// Buffers offline readings in a PSRAM ring ahead of LocalStorage
+//
+// Most outages are short, so readings that could not be published are
+// kept in PSRAM first and only reach flash when the ring fills (its oldest
+// PSRAM_SPILL_RECORDS are appended in one run), when the ring has held
+// readings for PSRAM_SPILL_AGE_MS, or on flush() before deep sleep or a
+// restart. Sync drains the ring before flash, so a short outage never
+// writes to flash at all.
+//
+// PSRAM is lost on a power cut, and the brownout detector resets the chip
+// without giving code a chance to run, so PSRAM_SPILL_AGE_MS bounds how
+// much a power loss can take. Without PSRAM every reading goes straight to
+// flash as before.
+//
+// Not thread-safe; PublishPipeline serializes access with its storage mutex.
+
+#ifndef TIERED_STORAGE_H
+#define TIERED_STORAGE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "sensor_manager.h"
+#include "local_storage.h"
+
+class TieredStorage {
+public:
+  TieredStorage(LocalStorage& flash,
+                int capacity = PSRAM_TIER_CAPACITY,
+                unsigned long spillAgeMs = PSRAM_SPILL_AGE_MS);
+  ~TieredStorage();
+  
+  // Allocate the ring in PSRAM (flash only if there is none). The flash
+  // tier is mounted separately.
+  bool begin();
+  
+  // Buffer a reading, spilling the oldest ones to flash if the ring is full
+  bool storeReading(const SensorReadings& readings);
+  
+  // Readings held in both tiers
+  int getStoredCount();
+  
+  // Readings held in PSRAM
+  int getBufferedCount();
+  
+  // Read up to maxCount of the oldest readings in PSRAM, or in flash once
+  // PSRAM is empty, without removing them (summaries as for LocalStorage;
+  // PSRAM only holds single readings)
+  int readOldest(SensorReadings* readings, int maxCount, ReadingSummary* summaries = nullptr);
+  
+  // Remove readings returned by the last readOldest() from their tier
+  bool removeOldest(int removeCount);
+  
+  // Move everything in PSRAM to flash (before deep sleep or a restart)
+  bool flush();
+  
+private:
+  LocalStorage& flash;
+  int capacity;
+  unsigned long spillAgeMs;
+  
+  SensorReadings* slots;  // Ring in PSRAM (nullptr: flash only)
+  uint32_t head;          // Total readings buffered
+  uint32_t tail;          // Total readings removed or spilled
+  
+  // When the ring last went from empty to holding readings
+  unsigned long filledAt;
+  
+  // Tier the last readOldest() came from, and the ring tail at that point
+  bool readFromRing;
+  uint32_t readTail;
+  
+  // Append the oldest spillCount readings to flash, in runs that do not
+  // wrap around the ring; fails if flash fills first
+  bool spill(int spillCount);
+};
+
+#endif // TIERED_STORAGE_H
@@ -0,0 +1,376 @@
+// CarbonReady TLS Client Implementation
+
+#include "tls_client.h"
+#include <mbedtls/error.h>
+#include <string.h>
+#include "metrics.h"
+
+// Identifies an initialized session cache ("CRTS")
+#define TLS_SESSION_MAGIC 0x53545243
+
+// Lives in RTC slow memory so a session survives both reconnects and
+// deep sleep; cleared by power loss
+struct TlsSessionCache {
+  uint32_t magic;
+  char host[96];
+  uint32_t length;
+  uint8_t data[TLS_SESSION_CACHE_SIZE];
+};
+
+RTC_DATA_ATTR static TlsSessionCache sessionCache;
+
+TlsClient::TlsClient() {
+  configured = false;
+  sessionOpen = false;
+  resumed = false;
+  handshakeMs = 0;
+  peekByte = -1;
+  
+  mbedtls_net_init(&net);
+  mbedtls_ssl_init(&ssl);
+  mbedtls_ssl_config_init(&conf);
+  mbedtls_entropy_init(&entropy);
+  mbedtls_ctr_drbg_init(&drbg);
+  mbedtls_x509_crt_init(&caCert);
+  mbedtls_x509_crt_init(&clientCert);
+  mbedtls_pk_init(&clientKey);
+}
+
+TlsClient::~TlsClient() {
+  stop();
+  mbedtls_pk_free(&clientKey);
+  mbedtls_x509_crt_free(&clientCert);
+  mbedtls_x509_crt_free(&caCert);
+  mbedtls_ctr_drbg_free(&drbg);
+  mbedtls_entropy_free(&entropy);
+  mbedtls_ssl_config_free(&conf);
+  mbedtls_ssl_free(&ssl);
+}
+
+bool TlsClient::begin(const char* rootCA, const char* deviceCert, const char* deviceKey) {
+  // Parsed certificates and the SSL context are reused by every connect
+  if (configured) {
+    return true;
+  }
+  
+  int ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, NULL, 0);
+  if (ret != 0) {
+    logError("DRBG seed", ret);
+    return false;
+  }
+  
+  // PEM parsing needs the length including the terminating NUL
+  ret = mbedtls_x509_crt_parse(&caCert, (const unsigned char*)rootCA, strlen(rootCA) + 1);
+  if (ret != 0) {
+    logError("CA certificate parse", ret);
+    return false;
+  }
+  
+  ret = mbedtls_x509_crt_parse(&clientCert, (const unsigned char*)deviceCert, strlen(deviceCert) + 1);
+  if (ret != 0) {
+    logError("Device certificate parse", ret);
+    return false;
+  }
+  
+  ret = mbedtls_pk_parse_key(&clientKey, (const unsigned char*)deviceKey, strlen(deviceKey) + 1, NULL, 0);
+  if (ret != 0) {
+    logError("Device key parse", ret);
+    return false;
+  }
+  
+  ret = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT,
+                                    MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  if (ret != 0) {
+    logError("SSL config", ret);
+    return false;
+  }
+  
+  mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+  mbedtls_ssl_conf_ca_chain(&conf, &caCert, NULL);
+  mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+  mbedtls_ssl_conf_read_timeout(&conf, TLS_HANDSHAKE_TIMEOUT_MS);
+  mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+  
+  ret = mbedtls_ssl_conf_own_cert(&conf, &clientCert, &clientKey);
+  if (ret != 0) {
+    logError("Own certificate", ret);
+    return false;
+  }
+  
+  ret = mbedtls_ssl_setup(&ssl, &conf);
+  if (ret != 0) {
+    logError("SSL setup", ret);
+    return false;
+  }
+  
+  configured = true;
+  return true;
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip.toString().c_str(), port);
+}
+
+int TlsClient::connect(const char* host, uint16_t port) {
+  if (!configured) {
+    Serial.println("TLS: Not configured");
+    return 0;
+  }
+  
+  stop();
+  
+  char portStr[6];
+  snprintf(portStr, sizeof(portStr), "%u", port);
+  
+  unsigned long tcpStart = micros();
+  int ret = mbedtls_net_connect(&net, host, portStr, MBEDTLS_NET_PROTO_TCP);
+  deviceMetrics.record(STAGE_TCP_CONNECT, micros() - tcpStart);
+  if (ret != 0) {
+    logError("TCP connect", ret);
+    return 0;
+  }
+  
+  if (!handshake(host)) {
+    mbedtls_net_free(&net);
+    return 0;
+  }
+  
+  // PubSubClient polls available(), so reads must not block
+  mbedtls_net_set_nonblock(&net);
+  mbedtls_ssl_set_bio(&ssl, &net, mbedtls_net_send, mbedtls_net_recv, NULL);
+  
+  sessionOpen = true;
+  return 1;
+}
+
+bool TlsClient::handshake(const char* host) {
+  // Reuse the SSL context and its parsed configuration from begin()
+  mbedtls_ssl_session_reset(&ssl);
+  mbedtls_ssl_set_hostname(&ssl, host);
+  mbedtls_ssl_set_bio(&ssl, &net, mbedtls_net_send, NULL, mbedtls_net_recv_timeout);
+  
+  bool offered = restoreSession(host);
+  unsigned char offeredId[32];
+  size_t offeredIdLength = 0;
+  
+  unsigned long start = millis();
+  unsigned long startMicros = micros();
+  int ret = 0;
+  
+  // Step through the handshake so the session ID actually sent in the
+  // ClientHello (random when resuming from a ticket) can be captured. A
+  // server that accepts the resumption echoes it back in its ServerHello.
+  while (ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+    int state = ssl.state;
+    ret = mbedtls_ssl_handshake_step(&ssl);
+    
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+      if (millis() - start > TLS_HANDSHAKE_TIMEOUT_MS) {
+        break;
+      }
+      continue;
+    }
+    if (ret != 0) {
+      break;
+    }
+    
+    if (state == MBEDTLS_SSL_CLIENT_HELLO && ssl.session_negotiate != NULL) {
+      offeredIdLength = ssl.session_negotiate->id_len;
+      memcpy(offeredId, ssl.session_negotiate->id, offeredIdLength);
+    }
+  }
+  
+  handshakeMs = millis() - start;
+  deviceMetrics.record(STAGE_TLS_HANDSHAKE, micros() - startMicros);
+  
+  if (ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+    logError("TLS handshake", ret);
+    
+    // A stale session could be the reason; start fresh next time
+    if (offered) {
+      clearSession();
+    }
+    return false;
+  }
+  
+  resumed = offered && offeredIdLength > 0 &&
+            ssl.session->id_len == offeredIdLength &&
+            memcmp(ssl.session->id, offeredId, offeredIdLength) == 0;
+  
+  Serial.printf("TLS handshake %s in %lu ms\n",
+                resumed ? "resumed" : "completed", handshakeMs);
+  
+  saveSession(host);
+  return true;
+}
+
+bool TlsClient::restoreSession(const char* host) {
+#if TLS_SESSION_RESUMPTION
+  if (sessionCache.magic != TLS_SESSION_MAGIC ||
+      sessionCache.length == 0 || sessionCache.length > TLS_SESSION_CACHE_SIZE ||
+      strncmp(sessionCache.host, host, sizeof(sessionCache.host)) != 0) {
+    return false;
+  }
+  
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  
+  bool restored = mbedtls_ssl_session_load(&session, sessionCache.data, sessionCache.length) == 0 &&
+                  mbedtls_ssl_set_session(&ssl, &session) == 0;
+  
+  mbedtls_ssl_session_free(&session);
+  
+  if (!restored) {
+    clearSession();
+  }
+  return restored;
+#else
+  return false;
+#endif
+}
+
+void TlsClient::saveSession(const char* host) {
+#if TLS_SESSION_RESUMPTION
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  
+  size_t length = 0;
+  if (mbedtls_ssl_get_session(&ssl, &session) == 0 &&
+      mbedtls_ssl_session_save(&session, sessionCache.data, sizeof(sessionCache.data), &length) == 0) {
+    sessionCache.magic = TLS_SESSION_MAGIC;
+    sessionCache.length = length;
+    strncpy(sessionCache.host, host, sizeof(sessionCache.host) - 1);
+    sessionCache.host[sizeof(sessionCache.host) - 1] = '\0';
+  } else {
+    Serial.println("Warning: TLS session too large to cache");
+    clearSession();
+  }
+  
+  mbedtls_ssl_session_free(&session);
+#endif
+}
+
+void TlsClient::clearSession() {
+  sessionCache.magic = 0;
+  sessionCache.length = 0;
+}
+
+size_t TlsClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t TlsClient::write(const uint8_t* buf, size_t size) {
+  if (!sessionOpen) {
+    return 0;
+  }
+  
+  size_t written = 0;
+  unsigned long start = millis();
+  
+  while (written < size) {
+    int ret = mbedtls_ssl_write(&ssl, buf + written, size - written);
+    if (ret > 0) {
+      written += ret;
+    } else if (ret == MBEDTLS_ERR_SSL_WANT_WRITE || ret == MBEDTLS_ERR_SSL_WANT_READ) {
+      if (millis() - start > TLS_HANDSHAKE_TIMEOUT_MS) {
+        break;
+      }
+      delay(1);
+    } else {
+      logError("TLS write", ret);
+      stop();
+      break;
+    }
+  }
+  
+  return written;
+}
+
+int TlsClient::available() {
+  if (!sessionOpen) {
+    return 0;
+  }
+  
+  // A zero-length read pulls pending records into the SSL buffer
+  int ret = mbedtls_ssl_read(&ssl, NULL, 0);
+  if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    if (ret != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+      logError("TLS read", ret);
+    }
+    stop();
+    return 0;
+  }
+  
+  return mbedtls_ssl_get_bytes_avail(&ssl) + (peekByte >= 0 ? 1 : 0);
+}
+
+int TlsClient::read() {
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsClient::read(uint8_t* buf, size_t size) {
+  if (!sessionOpen || size == 0) {
+    return -1;
+  }
+  
+  size_t offset = 0;
+  if (peekByte >= 0) {
+    buf[offset++] = peekByte;
+    peekByte = -1;
+    if (offset == size) {
+      return offset;
+    }
+  }
+  
+  int ret = mbedtls_ssl_read(&ssl, buf + offset, size - offset);
+  if (ret > 0) {
+    return offset + ret;
+  }
+  if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE && ret != 0) {
+    stop();
+  }
+  
+  return offset > 0 ? (int)offset : -1;
+}
+
+int TlsClient::peek() {
+  if (peekByte < 0) {
+    uint8_t b;
+    if (available() > 0 && mbedtls_ssl_read(&ssl, &b, 1) == 1) {
+      peekByte = b;
+    }
+  }
+  return peekByte;
+}
+
+void TlsClient::flush() {
+  // Writes go straight to the socket
+}
+
+void TlsClient::stop() {
+  if (sessionOpen) {
+    mbedtls_ssl_close_notify(&ssl);
+    sessionOpen = false;
+  }
+  mbedtls_net_free(&net);
+  peekByte = -1;
+}
+
+uint8_t TlsClient::connected() {
+  return sessionOpen;
+}
+
+bool TlsClient::lastHandshakeResumed() {
+  return resumed;
+}
+
+unsigned long TlsClient::lastHandshakeMs() {
+  return handshakeMs;
+}
+
+void TlsClient::logError(const char* operation, int ret) {
+  char message[96];
+  mbedtls_strerror(ret, message, sizeof(message));
+  Serial.printf("TLS: %s failed: -0x%04x %s\n", operation, -ret, message);
+}
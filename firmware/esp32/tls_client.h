@@ -0,0 +1,77 @@
+// CarbonReady TLS Client
+// mbedtls transport for PubSubClient with session resumption and
+// certificates parsed once per boot
+
+#ifndef TLS_CLIENT_H
+#define TLS_CLIENT_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
+#include <mbedtls/pk.h>
+#include "config.h"
+
+class TlsClient : public Client {
+public:
+  TlsClient();
+  ~TlsClient();
+  
+  // Parse certificates and build the TLS configuration (once per boot)
+  bool begin(const char* rootCA, const char* deviceCert, const char* deviceKey);
+  
+  // Client interface
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected(); }
+  
+  // Whether the last handshake resumed a cached session
+  bool lastHandshakeResumed();
+  
+  // Duration of the last TLS handshake (excluding TCP connect)
+  unsigned long lastHandshakeMs();
+  
+  // Drop the cached session so the next connect does a full handshake
+  void clearSession();
+  
+private:
+  mbedtls_net_context net;
+  mbedtls_ssl_context ssl;
+  mbedtls_ssl_config conf;
+  mbedtls_entropy_context entropy;
+  mbedtls_ctr_drbg_context drbg;
+  mbedtls_x509_crt caCert;
+  mbedtls_x509_crt clientCert;
+  mbedtls_pk_context clientKey;
+  
+  bool configured;
+  bool sessionOpen;
+  bool resumed;
+  unsigned long handshakeMs;
+  int peekByte;
+  
+  // Run the handshake, offering the cached session when there is one
+  bool handshake(const char* host);
+  
+  // Offer the cached session for host; returns true if one was set
+  bool restoreSession(const char* host);
+  
+  // Serialize the negotiated session into the RTC cache
+  void saveSession(const char* host);
+  
+  static void logError(const char* operation, int ret);
+};
+
+#endif // TLS_CLIENT_H
@@ -0,0 +1,94 @@
+// CarbonReady WiFi Fast-Reconnect Cache Implementation
+
+#include "wifi_cache.h"
+#include <WiFi.h>
+#include <Preferences.h>
+
+// Identifies a valid cache entry ("CRWF")
+#define WIFI_CACHE_MAGIC 0x46575243
+
+// NVS namespace and key holding the entry
+#define WIFI_CACHE_NAMESPACE "carbonready"
+#define WIFI_CACHE_KEY "wifi"
+
+RTC_DATA_ATTR static WifiCacheEntry rtcEntry;
+RTC_DATA_ATTR static WifiStats rtcStats;
+
+WifiCache wifiCache;
+
+bool WifiCache::load(const char* ssid, WifiCacheEntry& entry) {
+  if (rtcEntry.magic == WIFI_CACHE_MAGIC) {
+    entry = rtcEntry;
+  } else {
+    // Power-on: RTC memory is blank, fall back to NVS
+    Preferences preferences;
+    if (!preferences.begin(WIFI_CACHE_NAMESPACE, true)) {
+      return false;
+    }
+    size_t length = preferences.getBytes(WIFI_CACHE_KEY, &entry, sizeof(entry));
+    preferences.end();
+    
+    if (length != sizeof(entry) || entry.magic != WIFI_CACHE_MAGIC) {
+      return false;
+    }
+    rtcEntry = entry;
+  }
+  
+  // A re-provisioned network invalidates the entry
+  return entry.channel != 0 && strncmp(entry.ssid, ssid, sizeof(entry.ssid)) == 0;
+}
+
+void WifiCache::store(const char* ssid) {
+  WifiCacheEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.magic = WIFI_CACHE_MAGIC;
+  strlcpy(entry.ssid, ssid, sizeof(entry.ssid));
+  memcpy(entry.bssid, WiFi.BSSID(), sizeof(entry.bssid));
+  entry.channel = WiFi.channel();
+  entry.localIP = WiFi.localIP();
+  entry.gateway = WiFi.gatewayIP();
+  entry.subnet = WiFi.subnetMask();
+  entry.dns = WiFi.dnsIP();
+  
+  if (memcmp(&entry, &rtcEntry, sizeof(entry)) == 0) {
+    return;
+  }
+  rtcEntry = entry;
+  
+  // Only changes reach flash, so a stable network costs no NVS writes
+  Preferences preferences;
+  if (!preferences.begin(WIFI_CACHE_NAMESPACE, false) ||
+      preferences.putBytes(WIFI_CACHE_KEY, &entry, sizeof(entry)) != sizeof(entry)) {
+    Serial.println("Warning: Failed to persist WiFi cache");
+  }
+  preferences.end();
+  
+  Serial.printf("WiFi cache updated: channel %d, BSSID %02X:%02X:%02X:%02X:%02X:%02X\n",
+                entry.channel, entry.bssid[0], entry.bssid[1], entry.bssid[2],
+                entry.bssid[3], entry.bssid[4], entry.bssid[5]);
+}
+
+void WifiCache::invalidate() {
+  rtcEntry.magic = 0;
+  
+  Preferences preferences;
+  if (preferences.begin(WIFI_CACHE_NAMESPACE, false)) {
+    preferences.remove(WIFI_CACHE_KEY);
+    preferences.end();
+  }
+}
+
+void WifiCache::recordConnect(bool cached, bool fellBack, uint32_t elapsedMs) {
+  rtcStats.connects++;
+  if (cached) {
+    rtcStats.cachedConnects++;
+  }
+  if (fellBack) {
+    rtcStats.scanFallbacks++;
+  }
+  rtcStats.lastConnectMs = elapsedMs;
+}
+
+WifiStats WifiCache::getStats() {
+  return rtcStats;
+}
@@ -0,0 +1,48 @@
+// CarbonReady WiFi Fast-Reconnect Cache
+// Remembers the last good access point so reconnects skip the channel scan
+//
+// The entry (SSID, BSSID, channel and the DHCP-assigned addresses) lives in
+// RTC slow memory for deep-sleep wakeups and in NVS for power-on boots. NVS
+// is only rewritten when the entry changes, e.g. after roaming to another AP.
+// Association counters for the metrics summary are kept alongside in RTC
+// memory, so they accumulate across deep-sleep wakeups.
+
+#ifndef WIFI_CACHE_H
+#define WIFI_CACHE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "metrics.h"
+
+struct WifiCacheEntry {
+  uint32_t magic;
+  char ssid[33];
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint32_t localIP;      // Addresses from the last DHCP lease (network byte order)
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+};
+
+class WifiCache {
+public:
+  // Look up the entry for ssid (RTC memory first, then NVS)
+  bool load(const char* ssid, WifiCacheEntry& entry);
+  
+  // Remember the current association (call once connected)
+  void store(const char* ssid);
+  
+  // Forget the entry after a failed direct association
+  void invalidate();
+  
+  // Count a completed association and its duration
+  void recordConnect(bool cached, bool fellBack, uint32_t elapsedMs);
+  
+  // Association counters
+  WifiStats getStats();
+};
+
+extern WifiCache wifiCache;
+
+#endif // WIFI_CACHE_H
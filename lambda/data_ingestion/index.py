@@ -4,8 +4,10 @@ Processes incoming sensor data from IoT Core
 """
 import json
 import os
+import base64
 import hashlib
 import gzip
+import struct
 import traceback
 from datetime import datetime, timedelta, timezone
 from decimal import Decimal
@@ -21,64 +23,45 @@ SENSOR_DATA_BUCKET = os.environ['SENSOR_DATA_BUCKET']
 CRITICAL_ALERTS_TOPIC = os.environ['CRITICAL_ALERTS_TOPIC']
 WARNINGS_TOPIC = os.environ['WARNINGS_TOPIC']
 
+# heatshrink parameters used by the ESP32 firmware
+HEATSHRINK_WINDOW_BITS = 10
+HEATSHRINK_LOOKAHEAD_BITS = 5
+
+# MessagePack message schemas understood by this function
+SUPPORTED_SCHEMA_VERSIONS = {1, 2, 3}
+BINARY_READING_FIELDS = ('soilMoisture', 'soilTemperature', 'airTemperature', 'humidity')
+
+# Order the firmware writes JSON readings in (the hashed form depends on it)
+JSON_READING_FIELDS = BINARY_READING_FIELDS + ('soilTemperatureProbes',)
+
 
 def lambda_handler(event, context):
     """
     Main handler for data ingestion
     Validates sensor data, verifies hash, stores in DynamoDB and S3
+    Accepts a single sensor message, a batch of messages under 'batch' or a
+    delta-encoded batch (see expand_delta_batch), optionally compressed
+    (see decode_payload), or MessagePack messages (see process_binary)
     """
     try:
-        # Parse incoming message
-        payload = event
-        
-        # Log incoming request
-        print(json.dumps({
-            "level": "INFO",
-            "message": "Processing sensor data",
-            "farmId": payload.get('farmId'),
-            "deviceId": payload.get('deviceId'),
-            "timestamp": payload.get('timestamp'),
-            "requestId": context.request_id
-        }))
-        
-        # Verify cryptographic hash
-        if not verify_hash(payload):
-            log_tampering_alert(payload, context)
-            send_sns_notification(
-                CRITICAL_ALERTS_TOPIC,
-                "Data tampering detected",
-                f"Hash mismatch for farmId: {payload.get('farmId')}, deviceId: {payload.get('deviceId')}"
-            )
-            return {"status": "rejected", "reason": "hash_mismatch"}
+        if 'contentType' in event:
+            return process_binary(event, context)
         
-        # Validate data ranges
-        validation_result = validate_sensor_data(payload)
-        if not validation_result['valid']:
-            log_validation_error(payload, validation_result['errors'], context)
-            return {"status": "rejected", "reason": "validation_failed", "errors": validation_result['errors']}
+        if 'contentEncoding' in event:
+            event = decode_payload(event)
         
-        # Check calibration status
-        calibration_status = check_calibration_status(payload.get('deviceId'))
-        if calibration_status['status'] != 'valid':
-            log_calibration_error(payload, calibration_status, context)
-            return {"status": "rejected", "reason": "calibration_invalid"}
+        if 'baseTimestamp' in event:
+            messages = expand_delta_batch(event)
+            if 'batchHash' in event:
+                canonicals = [canonical_json(message) for message in messages]
+                return process_signed_batch(event['farmId'], event['deviceId'], messages,
+                                            event['batchHash'], canonicals, context)
+            return process_batch(messages, context)
         
-        # Store in DynamoDB (hot storage)
-        store_in_dynamodb(payload)
+        if 'batch' in event:
+            return process_batch(event['batch'], context)
         
-        # Archive to S3 (cold storage)
-        archive_to_s3(payload)
-        
-        # Log success
-        print(json.dumps({
-            "level": "INFO",
-            "message": "Successfully processed sensor data",
-            "farmId": payload.get('farmId'),
-            "deviceId": payload.get('deviceId'),
-            "requestId": context.request_id
-        }))
-        
-        return {"status": "success"}
+        return process_message(event, context)
         
     except Exception as e:
         # Log error with full context
@@ -105,47 +88,550 @@ def lambda_handler(event, context):
         raise
 
 
+def decode_payload(event):
+    """Decode a compressed message forwarded by the IoT rule as base64"""
+    encoding = event['contentEncoding']
+    if encoding != 'heatshrink':
+        raise ValueError(f"Unsupported content encoding: {encoding}")
+    
+    data = decompress_heatshrink(base64.b64decode(event['payload']))
+    return json.loads(data)
+
+
+def decompress_heatshrink(data, window_bits=HEATSHRINK_WINDOW_BITS,
+                          lookahead_bits=HEATSHRINK_LOOKAHEAD_BITS):
+    """
+    Decompress a heatshrink LZSS stream
+    Tag bit 1: literal byte follows
+    Tag bit 0: (distance - 1) and (length - 1) of a back-reference follow
+    Trailing zero padding shorter than a full token is ignored
+    """
+    output = bytearray()
+    total_bits = len(data) * 8
+    position = 0
+    
+    def read_bits(count):
+        nonlocal position
+        value = 0
+        for _ in range(count):
+            byte = data[position >> 3]
+            value = (value << 1) | ((byte >> (7 - (position & 7))) & 1)
+            position += 1
+        return value
+    
+    while position < total_bits:
+        remaining = total_bits - position
+        if read_bits(1):
+            if remaining < 9:
+                break
+            output.append(read_bits(8))
+        else:
+            if remaining < 1 + window_bits + lookahead_bits:
+                break
+            distance = read_bits(window_bits) + 1
+            length = read_bits(lookahead_bits) + 1
+            if distance > len(output):
+                raise ValueError("Invalid heatshrink back-reference")
+            # Copy byte by byte; references may overlap the bytes being written
+            for _ in range(length):
+                output.append(output[-distance])
+    
+    return bytes(output)
+
+
+def process_binary(event, context):
+    """
+    Process MessagePack data forwarded by the IoT rule as base64, with
+    farmId and deviceId taken from the topic. The payload is one message
+    array, an array of message arrays (a batch) or a delta-encoded batch
+    (see expand_binary_delta_batch), signed per record or once per batch.
+    """
+    content_type = event['contentType']
+    if content_type != 'msgpack':
+        raise ValueError(f"Unsupported content type: {content_type}")
+    
+    farm_id = event['farmId']
+    device_id = event['deviceId']
+    data = unpack_msgpack(base64.b64decode(event['payload']))
+    
+    def process(message, context, verified=False):
+        return process_binary_message(message, farm_id, device_id, context, verified)
+    
+    if is_binary_delta_batch(data, 4) and isinstance(data[3], bytes):
+        messages = expand_binary_delta_batch(data)
+        if any(check_binary_message(message) for message in messages):
+            return {"status": "rejected", "reason": "malformed_message", "processed": 0}
+        canonicals = [binary_canonical(message, farm_id, device_id) for message in messages]
+        return process_signed_batch(farm_id, device_id, messages, data[3], canonicals, context, process)
+    
+    if is_binary_delta_batch(data, 3):
+        return process_batch(expand_binary_delta_batch(data), context, process)
+    
+    if isinstance(data, list) and data and isinstance(data[0], list):
+        return process_batch(data, context, process)
+    
+    return process(data, context)
+
+
+def is_binary_delta_batch(data, length):
+    """
+    Tell a delta-encoded batch ([schema, baseTimestamp, records, ...]) of
+    `length` elements from a plain batch of that many message arrays
+    """
+    return (isinstance(data, list) and len(data) == length and
+            isinstance(data[0], int) and isinstance(data[1], int) and isinstance(data[2], list))
+
+
+def process_binary_message(message, farm_id, device_id, context, verified=False):
+    """
+    Decode a MessagePack message and process it like a JSON message
+    Schema 1: [schema, timestamp, soilMoisture, soilTemperature,
+               airTemperature, humidity, hash], readings in hundredths
+    Schema 2: adds [soil probes 2..N] before the hash (empty for one probe)
+    Schema 3: adds [span, samples, [min x4], [max x4]] after the probes for
+              an aggregate of downsampled offline readings (empty otherwise)
+    """
+    if not isinstance(message, list) or not message:
+        return {"status": "rejected", "reason": "malformed_message"}
+    
+    schema = message[0]
+    if schema not in SUPPORTED_SCHEMA_VERSIONS:
+        print(json.dumps({
+            "level": "WARNING",
+            "message": "Unsupported message schema",
+            "schemaVersion": schema,
+            "farmId": farm_id,
+            "deviceId": device_id,
+            "requestId": context.request_id
+        }))
+        return {"status": "rejected", "reason": "unsupported_schema"}
+    
+    reason = check_binary_message(message)
+    if reason:
+        return {"status": "rejected", "reason": reason}
+    
+    timestamp = message[1]
+    values = message[2:6]
+    probes = message[6] if schema >= 2 else None
+    
+    readings = {field: value / 100 for field, value in zip(BINARY_READING_FIELDS, values)}
+    if probes:
+        readings['soilTemperatureProbes'] = [values[1] / 100] + [value / 100 for value in probes]
+    
+    payload = {
+        'farmId': farm_id,
+        'deviceId': device_id,
+        'timestamp': format_timestamp(timestamp),
+        'readings': readings,
+        'hash': message[-1].hex(),
+        'schemaVersion': schema
+    }
+    
+    summary = message[7] if schema >= 3 else None
+    if summary:
+        span, samples, minimums, maximums = summary
+        payload['summary'] = {
+            'span': span,
+            'samples': samples,
+            'min': {field: value / 100 for field, value in zip(BINARY_READING_FIELDS, minimums)},
+            'max': {field: value / 100 for field, value in zip(BINARY_READING_FIELDS, maximums)}
+        }
+    
+    return process_message(payload, context, binary_canonical(message, farm_id, device_id), verified)
+
+
+def check_binary_message(message):
+    """Return why a MessagePack message is malformed, or None if it is well formed"""
+    if not isinstance(message, list) or not message:
+        return "malformed_message"
+    
+    schema = message[0]
+    if schema not in SUPPORTED_SCHEMA_VERSIONS:
+        return "unsupported_schema"
+    
+    length = {1: 7, 2: 8}.get(schema, 9)
+    if len(message) != length or not isinstance(message[-1], bytes):
+        return "malformed_message"
+    if schema >= 2 and not isinstance(message[6], list):
+        return "malformed_message"
+    if schema >= 3 and not valid_binary_summary(message[7]):
+        return "malformed_message"
+    
+    return None
+
+
+def valid_binary_summary(summary):
+    """Check a schema 3 summary: empty, or [span, samples, [min x4], [max x4]]"""
+    if not isinstance(summary, list):
+        return False
+    if not summary:
+        return True
+    if len(summary) != 4 or not all(isinstance(value, int) for value in summary[:2]):
+        return False
+    return all(isinstance(bound, list) and len(bound) == len(BINARY_READING_FIELDS) and
+               all(isinstance(value, int) for value in bound)
+               for bound in summary[2:])
+
+
+def binary_canonical(message, farm_id, device_id):
+    """The bytes the device hashes: the message with the topic IDs in place of the hash"""
+    return pack_msgpack([message[0], farm_id, device_id] + message[1:-1])
+
+
+def expand_delta_batch(batch):
+    """
+    Rebuild full messages from a delta-encoded JSON batch:
+    {"farmId", "deviceId", "baseTimestamp", "batch": [{"dt", "readings", "hash"}]}
+    Each record's time is the previous record's plus dt (0 for the first),
+    and its hash covers the full message it was rebuilt into. Batches
+    signed as a whole carry "batchHash" instead of per-record hashes
+    (see process_signed_batch). Records of downsampled offline readings
+    carry "summary" ({"span", "samples", "min", "max"}) after "readings".
+    """
+    timestamp = batch['baseTimestamp']
+    messages = []
+    for record in batch['batch']:
+        timestamp += record.get('dt', 0)
+        message = {
+            'farmId': batch['farmId'],
+            'deviceId': batch['deviceId'],
+            'timestamp': format_timestamp(timestamp),
+            'readings': record.get('readings', {}),
+            'hash': record.get('hash', batch.get('batchHash'))
+        }
+        if 'summary' in record:
+            message['summary'] = record['summary']
+        messages.append(message)
+    return messages
+
+
+def expand_binary_delta_batch(batch):
+    """
+    Rebuild messages from a delta-encoded MessagePack batch:
+    [schema, baseTimestamp, [[dt, soilMoisture, soilTemperature,
+                              airTemperature, humidity, hash], ...]]
+    Schema 2 records carry the soil probe array before the hash, and schema
+    3 records the summary array after it (see process_binary_message). Batches
+    signed as a whole drop the per-record hashes and append the batch hash:
+    [schema, baseTimestamp, [[dt, ..., [soil probes 2..N]], ...], batchHash]
+    so each record is rebuilt with the batch hash in place of its own.
+    """
+    schema, timestamp, records = batch[:3]
+    suffix = batch[3:]
+    messages = []
+    for record in records:
+        if not isinstance(record, list) or len(record) < 5 or not isinstance(record[0], int):
+            # Left for process_binary_message to reject
+            messages.append([])
+            continue
+        timestamp += record[0]
+        messages.append([schema, timestamp] + record[1:] + suffix)
+    return messages
+
+
+def format_timestamp(timestamp):
+    """Format Unix seconds the way the firmware does (ISO 8601, UTC)"""
+    return datetime.fromtimestamp(timestamp, timezone.utc).strftime('%Y-%m-%dT%H:%M:%SZ')
+
+
+def unpack_msgpack(data):
+    """Decode the MessagePack subset used by the firmware (ints, strings, bin, arrays)"""
+    value, offset = _unpack_value(data, 0)
+    if offset != len(data):
+        raise ValueError("Trailing bytes after MessagePack value")
+    return value
+
+
+def _unpack_value(data, offset):
+    tag = data[offset]
+    offset += 1
+    
+    if tag <= 0x7f:
+        return tag, offset
+    if tag >= 0xe0:
+        return tag - 0x100, offset
+    if 0x90 <= tag <= 0x9f:
+        return _unpack_array(data, offset, tag & 0x0f)
+    if 0xa0 <= tag <= 0xbf:
+        length = tag & 0x1f
+        return data[offset:offset + length].decode(), offset + length
+    
+    fixed = {
+        0xcc: '>B', 0xcd: '>H', 0xce: '>I', 0xcf: '>Q',
+        0xd0: '>b', 0xd1: '>h', 0xd2: '>i', 0xd3: '>q',
+        0xca: '>f', 0xcb: '>d'
+    }
+    if tag in fixed:
+        size = struct.calcsize(fixed[tag])
+        return struct.unpack_from(fixed[tag], data, offset)[0], offset + size
+    
+    if tag in (0xc4, 0xc5, 0xd9, 0xda):
+        size_format = '>B' if tag in (0xc4, 0xd9) else '>H'
+        length = struct.unpack_from(size_format, data, offset)[0]
+        offset += struct.calcsize(size_format)
+        raw = bytes(data[offset:offset + length])
+        return (raw if tag in (0xc4, 0xc5) else raw.decode()), offset + length
+    if tag == 0xdc:
+        return _unpack_array(data, offset + 2, struct.unpack_from('>H', data, offset)[0])
+    if tag == 0xdd:
+        return _unpack_array(data, offset + 4, struct.unpack_from('>I', data, offset)[0])
+    if tag == 0xc0:
+        return None, offset
+    if tag in (0xc2, 0xc3):
+        return tag == 0xc3, offset
+    
+    raise ValueError(f"Unsupported MessagePack type: 0x{tag:02x}")
+
+
+def _unpack_array(data, offset, count):
+    items = []
+    for _ in range(count):
+        item, offset = _unpack_value(data, offset)
+        items.append(item)
+    return items, offset
+
+
+def pack_msgpack(value):
+    """Encode ints, strings and arrays in canonical (shortest) MessagePack"""
+    if isinstance(value, list):
+        if len(value) > 15:
+            raise ValueError("Array too long for canonical message form")
+        return bytes([0x90 | len(value)]) + b''.join(pack_msgpack(item) for item in value)
+    if isinstance(value, str):
+        raw = value.encode()
+        if len(raw) <= 31:
+            return bytes([0xa0 | len(raw)]) + raw
+        return bytes([0xd9, min(len(raw), 0xff)]) + raw[:0xff]
+    if isinstance(value, int):
+        if 0 <= value <= 0x7f or -32 <= value < 0:
+            return struct.pack('>b' if value < 0 else '>B', value)
+        if value >= 0:
+            for tag, fmt, limit in ((0xcc, '>B', 0xff), (0xcd, '>H', 0xffff), (0xce, '>I', 0xffffffff)):
+                if value <= limit:
+                    return bytes([tag]) + struct.pack(fmt, value)
+        for tag, fmt, limit in ((0xd0, '>b', 0x80), (0xd1, '>h', 0x8000), (0xd2, '>i', 0x80000000)):
+            if value >= -limit:
+                return bytes([tag]) + struct.pack(fmt, value)
+    raise ValueError(f"Cannot pack value: {value!r}")
+
+
+def process_batch(messages, context, process=None):
+    """Process a batch of sensor messages published in one MQTT message"""
+    print(json.dumps({
+        "level": "INFO",
+        "message": "Processing sensor data batch",
+        "batchSize": len(messages),
+        "requestId": context.request_id
+    }))
+    
+    # Each message carries its own hash and is handled independently
+    process = process or process_message
+    results = [process(message, context) for message in messages]
+    processed = sum(1 for result in results if result['status'] == 'success')
+    
+    return {
+        "status": "success" if processed == len(results) else "partial",
+        "processed": processed,
+        "results": results
+    }
+
+
+def process_signed_batch(farm_id, device_id, messages, batch_hash, canonicals, context, process=None):
+    """
+    Process a batch signed once as a whole: the batch hash is SHA-256 over
+    the canonical form of every record in order, so a change to any record,
+    or a dropped, added or reordered one, rejects the batch. The hash cannot
+    tell which record was changed, so no record is stored on a mismatch.
+    """
+    process = process or process_message
+    
+    if not verify_batch_hash(batch_hash, canonicals):
+        received = batch_hash.hex() if isinstance(batch_hash, bytes) else batch_hash
+        log_tampering_alert({'farmId': farm_id, 'deviceId': device_id, 'hash': received}, context)
+        send_sns_notification(
+            CRITICAL_ALERTS_TOPIC,
+            "Data tampering detected",
+            f"Batch hash mismatch for farmId: {farm_id}, deviceId: {device_id}"
+        )
+        return {"status": "rejected", "reason": "hash_mismatch", "processed": 0}
+    
+    def process_verified(message, context):
+        return process(message, context, verified=True)
+    
+    return process_batch(messages, context, process_verified)
+
+
+def process_message(payload, context, canonical=None, verified=False):
+    """
+    Validate and store a single sensor message
+    canonical holds the signed bytes of a binary message; JSON messages
+    are verified by re-serializing the payload. verified skips the hash
+    check for records of a batch whose batch hash has been checked.
+    """
+    # Log incoming request
+    print(json.dumps({
+        "level": "INFO",
+        "message": "Processing sensor data",
+        "farmId": payload.get('farmId'),
+        "deviceId": payload.get('deviceId'),
+        "timestamp": payload.get('timestamp'),
+        "requestId": context.request_id
+    }))
+    
+    # Verify cryptographic hash
+    if verified:
+        hash_valid = True
+    elif canonical is not None:
+        hash_valid = verify_binary_hash(payload, canonical)
+    else:
+        hash_valid = verify_hash(payload)
+    
+    if not hash_valid:
+        log_tampering_alert(payload, context)
+        send_sns_notification(
+            CRITICAL_ALERTS_TOPIC,
+            "Data tampering detected",
+            f"Hash mismatch for farmId: {payload.get('farmId')}, deviceId: {payload.get('deviceId')}"
+        )
+        return {"status": "rejected", "reason": "hash_mismatch"}
+    
+    # Validate data ranges
+    validation_result = validate_sensor_data(payload)
+    if not validation_result['valid']:
+        log_validation_error(payload, validation_result['errors'], context)
+        return {"status": "rejected", "reason": "validation_failed", "errors": validation_result['errors']}
+    
+    # Check calibration status
+    calibration_status = check_calibration_status(payload.get('deviceId'))
+    if calibration_status['status'] != 'valid':
+        log_calibration_error(payload, calibration_status, context)
+        return {"status": "rejected", "reason": "calibration_invalid"}
+    
+    # Store in DynamoDB (hot storage)
+    store_in_dynamodb(payload)
+    
+    # Archive to S3 (cold storage)
+    archive_to_s3(payload)
+    
+    # Log success
+    print(json.dumps({
+        "level": "INFO",
+        "message": "Successfully processed sensor data",
+        "farmId": payload.get('farmId'),
+        "deviceId": payload.get('deviceId'),
+        "requestId": context.request_id
+    }))
+    
+    return {"status": "success"}
+
+
 def verify_hash(payload):
     """Verify SHA-256 hash of payload"""
     if 'hash' not in payload:
         return False
     
-    received_hash = payload['hash']
+    return decode_hash(payload['hash']) == hashlib.sha256(canonical_json(payload)).digest()
+
+
+def verify_binary_hash(payload, canonical):
+    """Verify SHA-256 hash over the canonical MessagePack form of a message"""
+    return decode_hash(payload.get('hash')) == hashlib.sha256(canonical).digest()
+
+
+def verify_batch_hash(batch_hash, canonicals):
+    """Verify a batch hash: SHA-256 over the records' canonical forms in order"""
+    digest = hashlib.sha256()
+    for canonical in canonicals:
+        digest.update(canonical)
+    return decode_hash(batch_hash) == digest.digest()
+
+
+def canonical_json(payload):
+    """
+    The signed form of a JSON message, byte for byte what the firmware hashes
+    (DataProcessor::writeHeader/writeReadings): compact JSON in the
+    firmware's field order, values as received (readings are strings),
+    without the hash
+    """
+    canonical = {
+        'farmId': payload.get('farmId'),
+        'deviceId': payload.get('deviceId'),
+        'timestamp': payload.get('timestamp'),
+        'readings': firmware_order(payload.get('readings', {}), JSON_READING_FIELDS)
+    }
     
-    # Compute hash of payload (excluding hash field)
-    payload_copy = payload.copy()
-    payload_copy.pop('hash', None)
-    payload_str = json.dumps(payload_copy, sort_keys=True)
-    computed_hash = hashlib.sha256(payload_str.encode()).hexdigest()
+    summary = payload.get('summary')
+    if summary is not None:
+        canonical['summary'] = firmware_order(summary, ('span', 'samples', 'min', 'max'))
+        for bound in ('min', 'max'):
+            if isinstance(summary.get(bound), dict):
+                canonical['summary'][bound] = firmware_order(summary[bound], JSON_READING_FIELDS)
     
-    return received_hash == computed_hash
+    return json.dumps(canonical, separators=(',', ':'), ensure_ascii=False).encode()
+
+
+def firmware_order(values, fields):
+    """Reorder a received object's keys as the firmware writes them (unknown keys last)"""
+    ordered = {field: values[field] for field in fields if field in values}
+    ordered.update((key, value) for key, value in values.items() if key not in ordered)
+    return ordered
+
+
+def decode_hash(value):
+    """
+    Decode a received SHA-256 digest: raw bytes (MessagePack), base64
+    (current firmware) or hex (older firmware). Returns None if malformed.
+    """
+    if isinstance(value, bytes):
+        return value
+    if not isinstance(value, str):
+        return None
+    try:
+        if len(value) == 64:
+            return bytes.fromhex(value)
+        return base64.b64decode(value, validate=True)
+    except ValueError:
+        return None
 
 
 def validate_sensor_data(payload):
-    """Validate sensor data ranges"""
+    """Validate sensor data ranges (numbers, or the decimal strings the firmware sends)"""
     errors = []
     readings = payload.get('readings', {})
     
     # Soil moisture: 0-100%
     soil_moisture = readings.get('soilMoisture')
-    if soil_moisture is not None and (soil_moisture < 0 or soil_moisture > 100):
+    if soil_moisture is not None and (float(soil_moisture) < 0 or float(soil_moisture) > 100):
         errors.append(f"soilMoisture out of range: {soil_moisture}")
     
     # Soil temperature: -10°C to 60°C
     soil_temp = readings.get('soilTemperature')
-    if soil_temp is not None and (soil_temp < -10 or soil_temp > 60):
+    if soil_temp is not None and (float(soil_temp) < -10 or float(soil_temp) > 60):
         errors.append(f"soilTemperature out of range: {soil_temp}")
     
     # Air temperature: -10°C to 60°C
     air_temp = readings.get('airTemperature')
-    if air_temp is not None and (air_temp < -10 or air_temp > 60):
+    if air_temp is not None and (float(air_temp) < -10 or float(air_temp) > 60):
         errors.append(f"airTemperature out of range: {air_temp}")
     
     # Humidity: 0-100%
     humidity = readings.get('humidity')
-    if humidity is not None and (humidity < 0 or humidity > 100):
+    if humidity is not None and (float(humidity) < 0 or float(humidity) > 100):
         errors.append(f"humidity out of range: {humidity}")
     
+    # Per-probe soil temperatures (multi-probe devices): same range
+    for index, probe_temp in enumerate(readings.get('soilTemperatureProbes') or []):
+        if float(probe_temp) < -10 or float(probe_temp) > 60:
+            errors.append(f"soilTemperatureProbes[{index}] out of range: {probe_temp}")
+    
+    # Spread of a downsampled aggregate: same ranges as the readings
+    summary = payload.get('summary') or {}
+    for bound in ('min', 'max'):
+        for field, value in (summary.get(bound) or {}).items():
+            low, high = (0, 100) if field in ('soilMoisture', 'humidity') else (-10, 60)
+            if float(value) < low or float(value) > high:
+                errors.append(f"summary.{bound}.{field} out of range: {value}")
+    
     return {
         'valid': len(errors) == 0,
         'errors': errors
@@ -223,6 +709,20 @@ def store_in_dynamodb(payload):
         'ttl': ttl
     }
     
+    probes = payload['readings'].get('soilTemperatureProbes')
+    if probes:
+        item['soilTemperatureProbes'] = [Decimal(str(probe)) for probe in probes]
+    
+    # Aggregates of downsampled offline readings keep their spread
+    summary = payload.get('summary')
+    if summary:
+        item['summary'] = {
+            'span': int(summary['span']),
+            'samples': int(summary['samples']),
+            'min': {field: Decimal(str(value)) for field, value in summary['min'].items()},
+            'max': {field: Decimal(str(value)) for field, value in summary['max'].items()}
+        }
+    
     table.put_item(Item=item)
 
 
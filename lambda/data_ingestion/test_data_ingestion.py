@@ -3,10 +3,12 @@ Unit tests for Data Ingestion Lambda
 """
 import json
 import os
+import base64
 import hashlib
 import pytest
 from unittest.mock import Mock, patch, MagicMock
 from datetime import datetime, timedelta
+from decimal import Decimal
 
 # Set environment variables before importing
 os.environ['AWS_DEFAULT_REGION'] = 'us-east-1'
@@ -20,7 +22,45 @@ from index import (
     lambda_handler,
     verify_hash,
     validate_sensor_data,
-    check_calibration_status
+    check_calibration_status,
+    decode_payload,
+    decompress_heatshrink,
+    expand_delta_batch,
+    pack_msgpack,
+    unpack_msgpack,
+    HEATSHRINK_WINDOW_BITS,
+    HEATSHRINK_LOOKAHEAD_BITS
+)
+
+
+# Output of DataProcessor::createMessage (without and with a window summary)
+# and of a two-record delta batch
+# (createBatchHeader, createBatchRecord with and without a summary,
+# finishBatch), built from firmware/esp32/data_processor.cpp on the host
+FIRMWARE_MESSAGE = (
+    '{"farmId":"farm-001","deviceId":"esp32-farm-001","timestamp":"2025-01-15T10:30:00Z",'
+    '"readings":{"soilMoisture":"45.50","soilTemperature":"25.30","airTemperature":"28.70",'
+    '"humidity":"65.20","soilTemperatureProbes":["25.30","18.00"]},'
+    '"hash":"qJgGcn2Q5/vIEHcK0iryzLt3ax2ostTBYZWMvpreLGg="}'
+)
+FIRMWARE_WINDOW_MESSAGE = (
+    '{"farmId":"farm-001","deviceId":"esp32-farm-001","timestamp":"2025-01-15T10:30:00Z",'
+    '"readings":{"soilMoisture":"45.50","soilTemperature":"25.30","airTemperature":"28.70",'
+    '"humidity":"65.20","soilTemperatureProbes":["25.30","18.00"]},'
+    '"summary":{"span":840,"samples":15,"min":{"soilMoisture":"44.10","soilTemperature":"25.00",'
+    '"airTemperature":"27.90","humidity":"63.00"},"max":{"soilMoisture":"46.80",'
+    '"soilTemperature":"25.60","airTemperature":"29.40","humidity":"67.50"}},'
+    '"hash":"ELO16YvWTQtlxOzad/s8zWNEE+N6/RgL7vfUwF6bRJ4="}'
+)
+FIRMWARE_DELTA_BATCH = (
+    '{"farmId":"farm-001","deviceId":"esp32-farm-001","baseTimestamp":1736937000,"batch":['
+    '{"dt":0,"readings":{"soilMoisture":"45.50","soilTemperature":"25.30","airTemperature":"28.70",'
+    '"humidity":"65.20","soilTemperatureProbes":["25.30","18.00"]},'
+    '"summary":{"span":2700,"samples":4,"min":{"soilMoisture":"44.10","soilTemperature":"25.00",'
+    '"airTemperature":"27.90","humidity":"63.00"},"max":{"soilMoisture":"46.80",'
+    '"soilTemperature":"25.60","airTemperature":"29.40","humidity":"67.50"}}},'
+    '{"dt":3600,"readings":{"soilMoisture":"44.00","soilTemperature":"25.30","airTemperature":"28.70",'
+    '"humidity":"65.20"}}],"batchHash":"hYyo9BvisFjCw+dNsgxtUGq/zLwo7IrLJm+rR7GYNdA="}'
 )
 
 
@@ -53,13 +93,124 @@ def create_test_payload(readings=None):
         'readings': readings
     }
     
-    # Compute hash
-    payload_str = json.dumps(payload, sort_keys=True)
-    payload['hash'] = hashlib.sha256(payload_str.encode()).hexdigest()
+    # Compute hash over the compact, field-ordered form the firmware signs
+    payload['hash'] = hashlib.sha256(firmware_json(payload)).hexdigest()
     
     return payload
 
 
+def firmware_json(message):
+    """Helper to serialize a message (built in firmware field order) as the firmware does"""
+    return json.dumps(message, separators=(',', ':')).encode()
+
+
+def create_binary_message(farm_id='farm-001', device_id='esp32-farm-001', schema=1):
+    """Helper to create a schema 1 MessagePack message as the firmware does"""
+    fields = [1736937000, 4550, 2530, 2870, 6520]
+    canonical = pack_msgpack([schema, farm_id, device_id] + fields)
+    digest = hashlib.sha256(canonical).digest()
+    
+    # bin8 is not produced by pack_msgpack; append it by hand
+    body = pack_msgpack([schema] + fields)
+    return bytes([0x97]) + body[1:] + bytes([0xc4, len(digest)]) + digest
+
+
+def create_probe_message(probes, farm_id='farm-001', device_id='esp32-farm-001'):
+    """Helper to create a schema 2 MessagePack message with later soil probes"""
+    fields = [1736937000, 4550, 2530, 2870, 6520]
+    canonical = pack_msgpack([2, farm_id, device_id] + fields + [probes])
+    digest = hashlib.sha256(canonical).digest()
+    
+    body = pack_msgpack([2] + fields + [probes])
+    return bytes([0x98]) + body[1:] + bytes([0xc4, len(digest)]) + digest
+
+
+def create_delta_record(payload, dt):
+    """Helper to strip a test payload down to a delta batch record"""
+    return {'dt': dt, 'readings': payload['readings'], 'hash': payload['hash']}
+
+
+def create_binary_delta_record(timestamp, dt, farm_id='farm-001', device_id='esp32-farm-001'):
+    """Helper to create a MessagePack delta batch record as the firmware does"""
+    fields = [4550, 2530, 2870, 6520]
+    canonical = pack_msgpack([1, farm_id, device_id, timestamp] + fields)
+    digest = hashlib.sha256(canonical).digest()
+    
+    body = pack_msgpack([dt] + fields)
+    return bytes([0x96]) + body[1:] + bytes([0xc4, len(digest)]) + digest
+
+
+def create_signed_delta_batch(readings, dts, base=1736937000, summaries=None):
+    """Helper to create a JSON delta batch signed once with a batch hash"""
+    digest = hashlib.sha256()
+    timestamp = base
+    records = []
+    for index, (record, dt) in enumerate(zip(readings, dts)):
+        timestamp += dt
+        message = {
+            'farmId': 'farm-001',
+            'deviceId': 'esp32-farm-001',
+            'timestamp': datetime.utcfromtimestamp(timestamp).strftime('%Y-%m-%dT%H:%M:%SZ'),
+            'readings': record
+        }
+        batch_record = {'dt': dt, 'readings': record}
+        if summaries and summaries[index]:
+            message['summary'] = batch_record['summary'] = summaries[index]
+        digest.update(firmware_json(message))
+        records.append(batch_record)
+    
+    return {
+        'farmId': 'farm-001',
+        'deviceId': 'esp32-farm-001',
+        'baseTimestamp': base,
+        'batch': records,
+        'batchHash': base64.b64encode(digest.digest()).decode()
+    }
+
+
+def create_signed_binary_delta_batch(records, farm_id='farm-001', device_id='esp32-farm-001',
+                                     base=1736937000, schema=2):
+    """
+    Helper to create a MessagePack delta batch signed once, from (dt, values,
+    probes) records, or (dt, values, probes, summary) records for schema 3
+    """
+    digest = hashlib.sha256()
+    body = b''
+    timestamp = base
+    for dt, values, probes, *summary in records:
+        timestamp += dt
+        digest.update(pack_msgpack([schema, farm_id, device_id, timestamp] + values + [probes] + summary))
+        body += pack_msgpack([dt] + values + [probes] + summary)
+    
+    hash_bytes = digest.digest()
+    header = bytes([0x94]) + pack_msgpack([schema, base])[1:]
+    return (header + bytes([0xdc, 0x00, len(records)]) + body +
+            bytes([0xc4, len(hash_bytes)]) + hash_bytes)
+
+
+def create_binary_event(payload, farm_id='farm-001', device_id='esp32-farm-001'):
+    """Helper to create the event produced by the MessagePack IoT rule"""
+    return {
+        'contentType': 'msgpack',
+        'farmId': farm_id,
+        'deviceId': device_id,
+        'payload': base64.b64encode(payload).decode()
+    }
+
+
+def pack_heatshrink(tokens):
+    """Helper to build a heatshrink stream from ('lit', byte) / ('ref', distance, length) tokens"""
+    bits = ''
+    for token in tokens:
+        if token[0] == 'lit':
+            bits += '1' + format(token[1], '08b')
+        else:
+            bits += '0' + format(token[1] - 1, f'0{HEATSHRINK_WINDOW_BITS}b')
+            bits += format(token[2] - 1, f'0{HEATSHRINK_LOOKAHEAD_BITS}b')
+    bits += '0' * (-len(bits) % 8)
+    return bytes(int(bits[i:i + 8], 2) for i in range(0, len(bits), 8))
+
+
 def test_verify_hash_valid():
     """Test hash verification with valid hash"""
     payload = create_test_payload()
@@ -73,6 +224,16 @@ def test_verify_hash_invalid():
     assert verify_hash(payload) is False
 
 
+def test_verify_hash_base64():
+    """Test that base64 hashes from current firmware are accepted"""
+    payload = create_test_payload()
+    payload['hash'] = base64.b64encode(bytes.fromhex(payload['hash'])).decode()
+    assert verify_hash(payload) is True
+    
+    payload['readings'] = dict(payload['readings'], humidity=10.0)
+    assert verify_hash(payload) is False
+
+
 def test_verify_hash_missing():
     """Test hash verification with missing hash"""
     payload = create_test_payload()
@@ -80,6 +241,15 @@ def test_verify_hash_missing():
     assert verify_hash(payload) is False
 
 
+def test_verify_hash_firmware_message():
+    """Test that a message exactly as the firmware writes it verifies"""
+    payload = json.loads(FIRMWARE_MESSAGE)
+    assert verify_hash(payload) is True
+    
+    payload['readings']['humidity'] = '65.21'
+    assert verify_hash(payload) is False
+
+
 def test_validate_sensor_data_valid():
     """Test validation with valid sensor data"""
     payload = create_test_payload()
@@ -251,5 +421,669 @@ def test_lambda_handler_calibration_invalid(mock_dynamodb):
     assert result['reason'] == 'calibration_invalid'
 
 
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_batch_success(mock_dynamodb, mock_s3, mock_sns):
+    """Test that every message in a batch is stored"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    event = {'batch': [create_test_payload(), create_test_payload()]}
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'success'
+    assert result['processed'] == 2
+    assert mock_table.put_item.call_count == 2
+    assert mock_s3.put_object.call_count == 2
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_batch_partial(mock_dynamodb, mock_s3, mock_sns):
+    """Test that a tampered message does not reject the rest of its batch"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    tampered = create_test_payload()
+    tampered['hash'] = 'invalid_hash'
+    event = {'batch': [create_test_payload(), tampered]}
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'partial'
+    assert result['processed'] == 1
+    assert result['results'][1]['reason'] == 'hash_mismatch'
+    mock_table.put_item.assert_called_once()
+
+
+def test_expand_delta_batch_accumulates_timestamps():
+    """Test that record times are the base plus the running sum of deltas"""
+    batch = {
+        'farmId': 'farm-001',
+        'deviceId': 'esp32-farm-001',
+        'baseTimestamp': 1736937000,
+        'batch': [{'dt': 0}, {'dt': 900}, {'dt': -60}]
+    }
+    
+    messages = expand_delta_batch(batch)
+    
+    assert [m['timestamp'] for m in messages] == [
+        '2025-01-15T10:30:00Z', '2025-01-15T10:45:00Z', '2025-01-15T10:44:00Z'
+    ]
+    assert all(m['deviceId'] == 'esp32-farm-001' for m in messages)
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_delta_batch(mock_dynamodb, mock_s3, mock_sns):
+    """Test that delta batch records verify against their rebuilt messages"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    tampered = create_delta_record(create_test_payload(), 0)
+    tampered['readings'] = dict(tampered['readings'], humidity=10.0)
+    event = {
+        'farmId': 'farm-001',
+        'deviceId': 'esp32-farm-001',
+        'baseTimestamp': 1736937000,
+        'batch': [create_delta_record(create_test_payload(), 0),
+                  create_delta_record(create_test_payload(), 0),
+                  tampered]
+    }
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'partial'
+    assert result['processed'] == 2
+    assert result['results'][2]['reason'] == 'hash_mismatch'
+    assert mock_table.put_item.call_count == 2
+
+
+def test_decompress_heatshrink_backreference():
+    """Test literals plus an overlapping back-reference"""
+    data = pack_heatshrink([('lit', ord('a')), ('lit', ord('b')), ('lit', ord('c')), ('ref', 3, 6)])
+    assert decompress_heatshrink(data) == b'abcabcabc'
+
+
+def test_decode_payload_unsupported_encoding():
+    """Test that unknown content encodings are rejected"""
+    with pytest.raises(ValueError):
+        decode_payload({'contentEncoding': 'gzip', 'payload': ''})
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_compressed_batch(mock_dynamodb, mock_s3, mock_sns):
+    """Test a heatshrink-compressed batch forwarded by the IoT rule"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    batch = json.dumps({'batch': [create_test_payload(), create_test_payload()]}).encode()
+    compressed = pack_heatshrink([('lit', byte) for byte in batch])
+    event = {
+        'contentEncoding': 'heatshrink',
+        'payload': base64.b64encode(compressed).decode()
+    }
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'success'
+    assert mock_table.put_item.call_count == 2
+
+
+def test_unpack_msgpack_firmware_message():
+    """Test decoding a message produced by the firmware encoder"""
+    # [1, 1736937000, 4523, -215, 2850, 6580, bin8(2)]
+    data = bytes.fromhex('9701ce67878e28cd11abd1ff29cd0b22cd19b4c402abcd')
+    
+    assert unpack_msgpack(data) == [1, 1736937000, 4523, -215, 2850, 6580, b'\xab\xcd']
+
+
+def test_pack_msgpack_shortest_encoding():
+    """Test canonical packing picks the shortest integer form"""
+    assert pack_msgpack(5) == bytes([0x05])
+    assert pack_msgpack(-5) == bytes([0xfb])
+    assert pack_msgpack(200) == bytes([0xcc, 200])
+    assert pack_msgpack(-215) == bytes([0xd1, 0xff, 0x29])
+    assert pack_msgpack(['ab']) == bytes([0x91, 0xa2]) + b'ab'
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_binary_message(mock_dynamodb, mock_s3, mock_sns):
+    """Test a MessagePack message with IDs taken from the topic"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    event = create_binary_event(create_binary_message())
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'success'
+    item = mock_table.put_item.call_args[1]['Item']
+    assert item['deviceId'] == 'esp32-farm-001'
+    assert str(item['soilMoisture']) == '45.5'
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_binary_batch(mock_dynamodb, mock_s3, mock_sns):
+    """Test a MessagePack batch (array16 of messages)"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    batch = bytes([0xdc, 0x00, 0x02]) + create_binary_message() + create_binary_message()
+    event = create_binary_event(batch)
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'success'
+    assert result['processed'] == 2
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_binary_batch_of_three(mock_dynamodb, mock_s3, mock_sns):
+    """Test that a plain batch of three messages is not taken for a delta batch"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    batch = bytes([0x93]) + create_binary_message() * 3
+    event = create_binary_event(batch)
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'success'
+    assert result['processed'] == 3
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_binary_batch_of_four(mock_dynamodb, mock_s3, mock_sns):
+    """Test that a plain batch of four messages is not taken for a signed delta batch"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    batch = bytes([0x94]) + create_probe_message([1800]) * 4
+    event = create_binary_event(batch)
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'success'
+    assert result['processed'] == 4
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_binary_delta_batch(mock_dynamodb, mock_s3, mock_sns):
+    """Test a MessagePack delta batch ([schema, base, array16 of records])"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    # Same readings as create_binary_message, the second record 900 s later
+    records = create_binary_delta_record(1736937000, 0) + create_binary_delta_record(1736937900, 900)
+    batch = bytes([0x93]) + pack_msgpack([1, 1736937000])[1:] + bytes([0xdc, 0x00, 0x02]) + records
+    event = create_binary_event(batch)
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'success'
+    assert result['processed'] == 2
+    stored = [call[1]['Item'] for call in mock_table.put_item.call_args_list]
+    assert [item['timestamp'] for item in stored] == [1736937000, 1736937900]
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_binary_soil_probes(mock_dynamodb, mock_s3, mock_sns):
+    """Test a schema 2 message carrying three soil probes"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    event = create_binary_event(create_probe_message([2410, 2275]))
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'success'
+    item = mock_table.put_item.call_args[1]['Item']
+    assert [str(probe) for probe in item['soilTemperatureProbes']] == ['25.3', '24.1', '22.75']
+
+
+@patch('index.sns')
+@patch('index.dynamodb')
+def test_lambda_handler_soil_probe_out_of_range(mock_dynamodb, mock_sns):
+    """Test that every soil probe is range checked"""
+    event = create_binary_event(create_probe_message([2410, -9990]))
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'rejected'
+    assert result['reason'] == 'validation_failed'
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_binary_single_probe_schema2(mock_dynamodb, mock_s3, mock_sns):
+    """Test that a schema 2 message with no extra probes stores no probe list"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    event = create_binary_event(create_probe_message([]))
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'success'
+    assert 'soilTemperatureProbes' not in mock_table.put_item.call_args[1]['Item']
+
+
+@patch('index.sns')
+@patch('index.dynamodb')
+def test_lambda_handler_binary_wrong_topic_device(mock_dynamodb, mock_sns):
+    """Test that the hash binds a binary message to its device"""
+    event = create_binary_event(create_binary_message(), device_id='esp32-farm-002')
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'rejected'
+    assert result['reason'] == 'hash_mismatch'
+
+
+@patch('index.dynamodb')
+def test_lambda_handler_binary_unsupported_schema(mock_dynamodb):
+    """Test that unknown schema versions are rejected"""
+    event = create_binary_event(create_binary_message(schema=9))
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'rejected'
+    assert result['reason'] == 'unsupported_schema'
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_signed_delta_batch(mock_dynamodb, mock_s3, mock_sns):
+    """Test a JSON delta batch verified by its batch hash"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    readings = [
+        {'soilMoisture': 45.5, 'soilTemperature': 25.3, 'airTemperature': 28.7, 'humidity': 65.2},
+        {'soilMoisture': 44.0, 'soilTemperature': 25.1, 'airTemperature': 29.0, 'humidity': 64.0}
+    ]
+    event = create_signed_delta_batch(readings, [0, 900])
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'success'
+    assert result['processed'] == 2
+    stored = [call[1]['Item'] for call in mock_table.put_item.call_args_list]
+    assert [item['timestamp'] for item in stored] == [1736937000, 1736937900]
+    assert all(item['hash'] == event['batchHash'] for item in stored)
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_firmware_window_message(mock_dynamodb, mock_s3, mock_sns):
+    """Test an edge aggregation window exactly as the firmware writes it"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    context = create_mock_context()
+    result = lambda_handler(json.loads(FIRMWARE_WINDOW_MESSAGE), context)
+    
+    assert result['status'] == 'success'
+    stored = mock_table.put_item.call_args[1]['Item']
+    assert stored['summary']['span'] == 840
+    assert stored['summary']['samples'] == 15
+    assert stored['summary']['max']['humidity'] == Decimal('67.50')
+    mock_sns.publish.assert_not_called()
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_firmware_delta_batch(mock_dynamodb, mock_s3, mock_sns):
+    """Test a signed delta batch exactly as the firmware writes it"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    context = create_mock_context()
+    result = lambda_handler(json.loads(FIRMWARE_DELTA_BATCH), context)
+    
+    assert result['status'] == 'success'
+    assert result['processed'] == 2
+    stored = [call[1]['Item'] for call in mock_table.put_item.call_args_list]
+    assert [item['timestamp'] for item in stored] == [1736937000, 1736940600]
+    assert stored[0]['soilMoisture'] == Decimal('45.50')
+    assert stored[0]['summary']['samples'] == 4
+    mock_sns.publish.assert_not_called()
+    
+    # Any changed value, summary included, breaks the batch hash
+    mock_table.put_item.reset_mock()
+    tampered = json.loads(FIRMWARE_DELTA_BATCH)
+    tampered['batch'][0]['summary']['max']['humidity'] = '67.40'
+    result = lambda_handler(tampered, context)
+    
+    assert result['status'] == 'rejected'
+    assert result['reason'] == 'hash_mismatch'
+    mock_table.put_item.assert_not_called()
+
+
+@patch('index.sns')
+@patch('index.dynamodb')
+def test_lambda_handler_signed_delta_batch_tampered(mock_dynamodb, mock_sns):
+    """Test that changing or reordering any record rejects the whole batch"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    readings = [
+        {'soilMoisture': 45.5, 'soilTemperature': 25.3, 'airTemperature': 28.7, 'humidity': 65.2},
+        {'soilMoisture': 44.0, 'soilTemperature': 25.1, 'airTemperature': 29.0, 'humidity': 64.0}
+    ]
+    context = create_mock_context()
+    
+    tampered = create_signed_delta_batch(readings, [0, 900])
+    tampered['batch'][1]['readings'] = dict(readings[1], humidity=10.0)
+    reordered = create_signed_delta_batch(readings, [0, 900])
+    reordered['batch'].reverse()
+    
+    for event in (tampered, reordered):
+        result = lambda_handler(event, context)
+        assert result['status'] == 'rejected'
+        assert result['reason'] == 'hash_mismatch'
+    
+    mock_table.put_item.assert_not_called()
+    assert mock_sns.publish.call_count == 2
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_signed_binary_delta_batch(mock_dynamodb, mock_s3, mock_sns):
+    """Test a MessagePack delta batch ([schema, base, records, batchHash])"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    records = [(0, [4550, 2530, 2870, 6520], []), (900, [4400, 2510, 2900, 6400], [1800])]
+    event = create_binary_event(create_signed_binary_delta_batch(records))
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'success'
+    assert result['processed'] == 2
+    stored = [call[1]['Item'] for call in mock_table.put_item.call_args_list]
+    assert [item['timestamp'] for item in stored] == [1736937000, 1736937900]
+    assert stored[1]['soilTemperatureProbes'] == [Decimal('25.1'), Decimal('18')]
+    
+    # The batch hash binds every record to the topic's device
+    mock_table.put_item.reset_mock()
+    event = create_binary_event(create_signed_binary_delta_batch(records), device_id='esp32-farm-002')
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'rejected'
+    assert result['reason'] == 'hash_mismatch'
+    mock_table.put_item.assert_not_called()
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_delta_batch_summary(mock_dynamodb, mock_s3, mock_sns):
+    """Test a JSON batch mixing an hourly aggregate with a raw reading"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    readings = [
+        {'soilMoisture': 45.5, 'soilTemperature': 25.3, 'airTemperature': 28.7, 'humidity': 65.2},
+        {'soilMoisture': 44.0, 'soilTemperature': 25.1, 'airTemperature': 29.0, 'humidity': 64.0}
+    ]
+    summary = {
+        'span': 2700,
+        'samples': 4,
+        'min': {'soilMoisture': 44.1, 'soilTemperature': 25.0, 'airTemperature': 27.9, 'humidity': 63.0},
+        'max': {'soilMoisture': 46.8, 'soilTemperature': 25.6, 'airTemperature': 29.4, 'humidity': 67.5}
+    }
+    event = create_signed_delta_batch(readings, [0, 3600], summaries=[summary, None])
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'success'
+    assert result['processed'] == 2
+    stored = [call[1]['Item'] for call in mock_table.put_item.call_args_list]
+    assert stored[0]['summary']['samples'] == 4
+    assert stored[0]['summary']['max']['humidity'] == Decimal('67.5')
+    assert 'summary' not in stored[1]
+    
+    # The summary is signed with the record
+    tampered = create_signed_delta_batch(readings, [0, 3600], summaries=[summary, None])
+    tampered['batch'][0]['summary'] = dict(summary, samples=5)
+    result = lambda_handler(tampered, context)
+    
+    assert result['status'] == 'rejected'
+    assert result['reason'] == 'hash_mismatch'
+
+
+@patch('index.sns')
+@patch('index.s3')
+@patch('index.dynamodb')
+def test_lambda_handler_signed_binary_delta_batch_schema3(mock_dynamodb, mock_s3, mock_sns):
+    """Test a schema 3 MessagePack batch carrying a daily aggregate"""
+    mock_table = MagicMock()
+    mock_dynamodb.Table.return_value = mock_table
+    
+    mock_table.query.return_value = {
+        'Items': [{
+            'deviceId': 'esp32-farm-001',
+            'calibrationDate': datetime.utcnow().isoformat()
+        }]
+    }
+    
+    summary = [85500, 96, [4010, -250, 1890, 5200], [4890, 1420, 3110, 8100]]
+    records = [(0, [4550, 2530, 2870, 6520], [], summary), (86400, [4400, 2510, 2900, 6400], [], [])]
+    event = create_binary_event(create_signed_binary_delta_batch(records, schema=3))
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'success'
+    assert result['processed'] == 2
+    stored = [call[1]['Item'] for call in mock_table.put_item.call_args_list]
+    assert stored[0]['summary']['span'] == 85500
+    assert stored[0]['summary']['samples'] == 96
+    assert stored[0]['summary']['min']['soilTemperature'] == Decimal('-2.5')
+    assert stored[0]['summary']['max']['humidity'] == Decimal('81')
+    assert 'summary' not in stored[1]
+
+
+@patch('index.sns')
+@patch('index.dynamodb')
+def test_lambda_handler_summary_out_of_range(mock_dynamodb, mock_sns):
+    """Test that an aggregate's spread is range checked like its readings"""
+    summary = [3540, 4, [4010, -1250, 1890, 5200], [4890, 1420, 3110, 8100]]
+    records = [(0, [4550, 2530, 2870, 6520], [], summary)]
+    event = create_binary_event(create_signed_binary_delta_batch(records, schema=3))
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['results'][0]['status'] == 'rejected'
+    assert result['results'][0]['reason'] == 'validation_failed'
+
+
+@patch('index.sns')
+@patch('index.dynamodb')
+def test_lambda_handler_summary_malformed_bound(mock_dynamodb, mock_sns):
+    """Test that a non-integer summary bound is rejected rather than raising"""
+    summary = [3540, 4, [4010, 'x', 1890, 5200], [4890, 1420, 3110, 8100]]
+    records = [(0, [4550, 2530, 2870, 6520], [], summary)]
+    event = create_binary_event(create_signed_binary_delta_batch(records, schema=3))
+    context = create_mock_context()
+    
+    result = lambda_handler(event, context)
+    
+    assert result['status'] == 'rejected'
+    assert result['reason'] == 'malformed_message'
+    mock_sns.publish.assert_not_called()
+
+
+@patch('index.dynamodb')
+def test_lambda_handler_signed_binary_delta_batch_malformed(mock_dynamodb):
+    """Test that a malformed record rejects a signed batch before hashing"""
+    # The second record's probe array is a string
+    body = pack_msgpack([0, 4550, 2530, 2870, 6520, []]) + pack_msgpack([900, 4400, 2510, 2900, 6400, 'x'])
+    payload = (bytes([0x94]) + pack_msgpack([2, 1736937000])[1:] + bytes([0xdc, 0x00, 0x02]) + body +
+               bytes([0xc4, 32]) + bytes(32))
+    context = create_mock_context()
+    
+    result = lambda_handler(create_binary_event(payload), context)
+    
+    assert result['status'] == 'rejected'
+    assert result['reason'] == 'malformed_message'
+
+
 if __name__ == '__main__':
     pytest.main([__file__, '-v'])